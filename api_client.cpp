@@ -2,14 +2,23 @@
 #include "config.h"
 #include "curl_utils.h"
 #include "tools.h"
+#include "sse_parser.h"
+#include "context_budget.h"
+#include "trace.h"
+#include "http_routing.h"
+#include "completion_cache.h"
+#include "interrupt.h"
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <cstdlib>
 #include <stdexcept>
 #include <memory>
+#include <optional>
 #include <unordered_set>
 #include <functional>
 #include <sstream>
+#include <string_view>
 
 // Helper function to get OpenRouter API key
 static std::string get_openrouter_api_key() {
@@ -25,459 +34,784 @@ static std::string get_openrouter_api_key() {
 }
 
 ApiClient::ApiClient(UserInterface& ui_ref, std::string& active_model_id_ref)
-    : ui(ui_ref), active_model_id_ref(active_model_id_ref) {
+    : ui(ui_ref), active_model_id_ref(active_model_id_ref),
+      owned_pool(std::make_unique<HttpConnectionPool>()), connection_pool(*owned_pool) {
 }
 
-nlohmann::json ApiClient::buildApiPayload(const std::vector<Message>& context,
-                                          ToolManager& toolManager,
-                                          bool use_tools,
-                                          bool enable_streaming) {
-    nlohmann::json payload;
-    payload["model"] = this->active_model_id_ref;
-    payload["messages"] = nlohmann::json::array();
+ApiClient::ApiClient(UserInterface& ui_ref, std::string& active_model_id_ref, HttpConnectionPool& shared_pool)
+    : ui(ui_ref), active_model_id_ref(active_model_id_ref), connection_pool(shared_pool) {
+}
 
-    if (enable_streaming) {
-        payload["stream"] = true;
+ApiClient::~ApiClient() = default;
+
+// Record connect / first byte / body spans from libcurl's transfer timers.
+// Connect time is 0 when the pooled connection was reused.
+static void trace_transfer(CURL* curl, uint64_t start_ns, uint64_t output_tokens) {
+    curl_off_t connect_us = 0, first_byte_us = 0, total_us = 0;
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect_us);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte_us);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total_us);
+    uint64_t first_byte_ns = static_cast<uint64_t>(first_byte_us) * 1000;
+    uint64_t total_ns = static_cast<uint64_t>(std::max(total_us, first_byte_us)) * 1000;
+
+    Tracer& tracer = Tracer::global();
+    tracer.record("api.connect", start_ns, static_cast<uint64_t>(connect_us) * 1000);
+    tracer.record("api.ttfb", start_ns, first_byte_ns);
+    tracer.record("api.stream", start_ns + first_byte_ns, total_ns - first_byte_ns, output_tokens);
+    tracer.record("api.total", start_ns, total_ns);
+}
+
+struct curl_slist* ApiClient::getRequestHeaders() {
+    // call_once leaves the flag unset if the key lookup throws, so a later call retries
+    std::call_once(headers_once, [this]() {
+        std::string api_key = get_openrouter_api_key();
+
+        struct curl_slist* headers = nullptr;
+        headers = curl_slist_append(headers, ("Authorization: Bearer " + api_key).c_str());
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        headers = curl_slist_append(headers, "HTTP-Referer: https://llm-cli.tsatsin.com");
+        headers = curl_slist_append(headers, "X-Title: LLM-cli");
+        if (!headers) {
+            throw std::runtime_error("Failed to build API request headers");
+        }
+        request_headers.reset(headers);
+    });
+    return request_headers.get();
+}
+
+// Upper bound on cached messages; the cache is simply reset when it fills up
+static constexpr size_t kMaxCachedMessages = 1024;
+
+std::shared_ptr<const ApiClient::CachedMessage> ApiClient::getCachedMessage(const Message& msg) {
+    // Messages that were never persisted (id 0) are built on the fly and not cached
+    if (msg.id != 0) {
+        std::lock_guard<std::mutex> lock(payload_cache_mutex);
+        auto it = payload_cache.find(msg.id);
+        if (it != payload_cache.end()) {
+            return it->second;
+        }
     }
 
-    // --- Secure Conversation History Construction ---
-    std::vector<Message> limited_context;
-    if (context.size() > 10) {
-        limited_context.assign(context.end() - 10, context.end());
-    } else {
-        limited_context = context;
+    auto cached = std::make_shared<CachedMessage>();
+
+    // Tool records carry structured fields (MessageRepository fills them for
+    // older rows too), so no JSON is parsed here
+    if (msg.isToolCallRequest()) {
+        cached->kind = CachedMessage::Kind::ToolCallRequest;
+        std::string_view ids = msg.tool_call_ids;
+        while (!ids.empty()) {
+            size_t end = ids.find('\n');
+            cached->tool_call_ids.emplace_back(ids.substr(0, end));
+            ids.remove_prefix(end == std::string_view::npos ? ids.size() : end + 1);
+        }
+        // tool_calls is stored exactly as it is sent
+        const std::string& tool_calls = msg.tool_calls;
+        cached->serialized.reserve(tool_calls.size() + 64);
+        cached->serialized = R"({"role":"assistant","content":null,"tool_calls":)";
+        cached->serialized += tool_calls;
+        cached->serialized += '}';
+    } else if (msg.role == "tool") {
+        if (msg.isToolResult()) {
+            cached->kind = CachedMessage::Kind::ToolResult;
+            cached->tool_call_id = msg.tool_call_id.str();
+            cached->serialized = nlohmann::json{{"role", "tool"},
+                                                {"tool_call_id", msg.tool_call_id.str()},
+                                                {"name", msg.tool_name.str()},
+                                                {"content", msg.content.str()}}.dump();
+        } else {
+            cached->kind = CachedMessage::Kind::Invalid; // Never sent
+        }
     }
 
-    std::unordered_set<std::string> valid_tool_ids;
-    nlohmann::json msg_array = nlohmann::json::array();
-
-    for (size_t i = 0; i < limited_context.size(); ++i) {
-        const Message& msg = limited_context[i];
-
-        if (msg.role == "assistant" && !msg.content.empty() && msg.content.front() == '{') {
-            try {
-                auto asst_json = nlohmann::json::parse(msg.content);
-                if (asst_json.contains("tool_calls")) {
-                    std::vector<std::string> ids;
-                    for (const auto& tc : asst_json["tool_calls"]) {
-                        if (tc.contains("id")) ids.push_back(tc["id"].get<std::string>());
-                    }
+    if (cached->kind == CachedMessage::Kind::Plain) {
+        cached->serialized = nlohmann::json{{"role", msg.role}, {"content", msg.content.str()}}.dump();
+    }
+    if (cached->kind != CachedMessage::Kind::Invalid) {
+        cached->tokens = estimate_tokens(cached->serialized);
+    }
 
-                    bool all_results_present = true;
-                    for (const auto& id : ids) {
-                        bool found_result = false;
-                        for (size_t j = i + 1; j < limited_context.size() && !found_result; ++j) {
-                            if (limited_context[j].role != "tool") continue;
-                            try {
-                                auto tool_json = nlohmann::json::parse(limited_context[j].content);
-                                found_result = tool_json.contains("tool_call_id") &&
-                                              tool_json["tool_call_id"] == id;
-                            } catch (...) { /* Ignore */ }
-                        }
-                        if (!found_result) {
-                            all_results_present = false;
-                            break;
-                        }
-                    }
+    if (msg.id != 0) {
+        std::lock_guard<std::mutex> lock(payload_cache_mutex);
+        if (payload_cache.size() >= kMaxCachedMessages) {
+            payload_cache.clear();
+        }
+        payload_cache[msg.id] = cached;
+    }
+    return cached;
+}
+
+std::string ApiClient::buildMessagesJson(const std::vector<Message>& context,
+                                         ToolManager& toolManager,
+                                         bool use_tools) {
+    // --- Token budget packing ---
+    size_t budget = context_token_budget(active_context_length.load());
+    if (use_tools) {
+        size_t tool_tokens = estimate_tokens(toolManager.get_tool_definitions_json());
+        budget = budget > tool_tokens ? budget - tool_tokens : 0;
+    }
 
-                    if (!all_results_present) continue;
+    // A leading system message is always sent
+    std::vector<std::shared_ptr<const CachedMessage>> window;
+    bool pinned_system = !context.empty() && context.front().role == "system";
+    size_t used = 0;
+    if (pinned_system) {
+        window.push_back(getCachedMessage(context.front()));
+        used = window.front()->tokens;
+    }
 
-                    msg_array.push_back({{"role", "assistant"},
-                                       {"content", nullptr},
-                                       {"tool_calls", asst_json["tool_calls"]}});
-                    valid_tool_ids.insert(ids.begin(), ids.end());
-                    continue;
-                }
-            } catch (...) { /* Ignore */ }
+    // Walk back from the newest message until the budget is spent; the newest
+    // message is sent even if it alone exceeds the budget
+    size_t first_candidate = pinned_system ? 1 : 0;
+    std::vector<std::shared_ptr<const CachedMessage>> recent;
+    for (size_t i = context.size(); i-- > first_candidate;) {
+        auto cached = getCachedMessage(context[i]);
+        if (!recent.empty() && used + cached->tokens > budget) {
+            break;
         }
+        used += cached->tokens;
+        recent.push_back(std::move(cached));
+    }
+    window.insert(window.end(), recent.rbegin(), recent.rend());
+    size_t window_size = window.size();
 
-        if (msg.role == "tool") {
-            try {
-                auto tool_json = nlohmann::json::parse(msg.content);
-                if (tool_json.contains("tool_call_id") &&
-                    valid_tool_ids.count(tool_json["tool_call_id"].get<std::string>())) {
-                    msg_array.push_back({{"role", "tool"},
-                                       {"tool_call_id", tool_json["tool_call_id"]},
-                                       {"name", tool_json["name"]},
-                                       {"content", tool_json["content"]}});
+    // --- Secure Conversation History Construction ---
+
+    // Backward pass: an assistant tool call request is only sent if every one of its
+    // calls has a result later in the window
+    std::vector<bool> request_complete(window_size, false);
+    std::unordered_set<std::string> later_result_ids;
+    for (size_t i = window_size; i-- > 0;) {
+        const CachedMessage& cached = *window[i];
+        if (cached.kind == CachedMessage::Kind::ToolResult) {
+            later_result_ids.insert(cached.tool_call_id);
+        } else if (cached.kind == CachedMessage::Kind::ToolCallRequest) {
+            bool all_results_present = true;
+            for (const auto& id : cached.tool_call_ids) {
+                if (!later_result_ids.count(id)) {
+                    all_results_present = false;
+                    break;
                 }
-            } catch (...) { /* Ignore */ }
-            continue;
+            }
+            request_complete[i] = all_results_present;
         }
-
-        msg_array.push_back({{"role", msg.role}, {"content", msg.content}});
     }
 
-    payload["messages"] = std::move(msg_array);
+    // Forward pass: tool results are only sent after the request that produced them
+    std::unordered_set<std::string> valid_tool_ids;
+    size_t array_size = 2;
+    for (const auto& cached : window) {
+        array_size += cached->serialized.size() + 1;
+    }
+    std::string msg_array;
+    msg_array.reserve(array_size); // One allocation for the whole array
+    msg_array += '[';
+    bool first = true;
+    auto append = [&](const std::string& serialized) {
+        if (!first) msg_array += ',';
+        msg_array += serialized;
+        first = false;
+    };
+
+    for (size_t i = 0; i < window_size; ++i) {
+        const CachedMessage& cached = *window[i];
+        switch (cached.kind) {
+            case CachedMessage::Kind::ToolCallRequest:
+                if (!request_complete[i]) continue;
+                append(cached.serialized);
+                valid_tool_ids.insert(cached.tool_call_ids.begin(), cached.tool_call_ids.end());
+                break;
+            case CachedMessage::Kind::ToolResult:
+                if (valid_tool_ids.count(cached.tool_call_id)) {
+                    append(cached.serialized);
+                }
+                break;
+            case CachedMessage::Kind::Invalid:
+                break;
+            case CachedMessage::Kind::Plain:
+                append(cached.serialized);
+                break;
+        }
+    }
+    msg_array += ']';
     // --- End Secure Conversation History Construction ---
 
+    return msg_array;
+}
+
+std::string ApiClient::buildApiPayload(const std::string& messages_json,
+                                       const std::string& model,
+                                       ToolManager& toolManager,
+                                       bool use_tools,
+                                       bool enable_streaming) {
+    std::string payload;
+    payload.reserve(messages_json.size() + (use_tools ? toolManager.get_tool_definitions_json().size() : 0) + 256);
+    payload += "{\"model\":";
+    payload += nlohmann::json(model).dump();
+    payload += ",\"messages\":";
+    payload += messages_json;
+
+    if (enable_streaming) {
+        payload += ",\"stream\":true";
+    }
+
     if (use_tools) {
-        payload["tools"] = toolManager.get_tool_definitions();
-        payload["tool_choice"] = "auto";
+        payload += ",\"tools\":";
+        payload += toolManager.get_tool_definitions_json();
+        payload += ",\"tool_choice\":\"auto\"";
     }
 
+    payload += '}';
     return payload;
 }
 
+// Retry-After of a finished transfer in seconds (-1 if the server sent none)
+static long retry_after_seconds(CURL* curl) {
+    curl_off_t seconds = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &seconds) != CURLE_OK || seconds <= 0) {
+        return -1;
+    }
+    return static_cast<long>(seconds);
+}
+
 std::string ApiClient::makeApiCall(const std::vector<Message>& context, 
                                    ToolManager& toolManager,
-                                   bool use_tools) {
-    CURL* curl = nullptr;
-    CURLcode res;
-    long http_code = 0;
+                                   bool use_tools,
+                                   std::stop_token stop,
+                                   std::string* answered_by) {
     std::string response_buffer;
-    bool retried_with_default_once = false;
-    
-    while (true) {
-        curl = curl_easy_init();
-        if (!curl) {
-            throw std::runtime_error("Failed to initialize CURL");
-        }
-        auto curl_guard = std::unique_ptr<CURL, decltype(&curl_easy_cleanup)>{curl, curl_easy_cleanup};
-        
-        std::string api_key = get_openrouter_api_key();
-        
-        struct curl_slist* headers = nullptr;
-        auto headers_guard = std::unique_ptr<struct curl_slist, decltype(&curl_slist_free_all)>{nullptr, curl_slist_free_all};
-        
-        headers = curl_slist_append(headers, ("Authorization: Bearer " + api_key).c_str());
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        headers = curl_slist_append(headers, "HTTP-Referer: https://llm-cli.tsatsin.com");
-        headers = curl_slist_append(headers, "X-Title: LLM-cli");
-        headers_guard.reset(headers);
-
-        nlohmann::json payload = buildApiPayload(context, toolManager, use_tools, false);
-        std::string json_payload = payload.dump();
-        response_buffer.clear();
-        
-        curl_easy_setopt(curl, CURLOPT_URL, api_base.c_str());
-        curl_easy_setopt(curl, CURLOPT_POST, 1L);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, json_payload.size());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_buffer);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 120L);
-        
-        res = curl_easy_perform(curl);
-        
-        if (res == CURLE_OK) {
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-        }
-        
-        // Check for model-specific errors or general API failure
-        bool model_potentially_unavailable = false;
-        if (res != CURLE_OK) {
-            model_potentially_unavailable = true;
-        } else if (http_code == 404 || http_code == 429 || http_code == 500) {
-            model_potentially_unavailable = true;
-        }
-        
-        if (model_potentially_unavailable && !retried_with_default_once && this->active_model_id_ref != DEFAULT_MODEL_ID) {
-            std::string failed_model_id = this->active_model_id_ref;
-            ui.displayError("API call with model '" + failed_model_id + "' failed (Error: " + 
-                          (res != CURLE_OK ? curl_easy_strerror(res) : "HTTP " + std::to_string(http_code)) + 
-                          "). Attempting to switch to default model: " + std::string(DEFAULT_MODEL_ID));
-            
-            this->active_model_id_ref = DEFAULT_MODEL_ID;
-            ui.displayStatus("Active model set to: " + this->active_model_id_ref);
-            retried_with_default_once = true;
+    struct curl_slist* headers = getRequestHeaders();
+    const std::string request_url = route_url(api_base);
+    const std::string messages_json = [&] {
+        TraceSpan span("api.payload");
+        return buildMessagesJson(context, toolManager, use_tools);
+    }();
+    const std::vector<std::string> models = retry_policy.candidates(this->active_model_id_ref);
+    std::string last_failure = "no model available";
+
+    for (size_t m = 0; m < models.size(); ++m) {
+        const std::string& model = models[m];
+        bool last_candidate = m + 1 == models.size();
+        // An open breaker skips the model, except as the last resort
+        if (!last_candidate && !breakers.allow(model)) {
             continue;
         }
-        
-        if (res != CURLE_OK) {
-            throw std::runtime_error("API request failed: " + std::string(curl_easy_strerror(res)));
+        std::string json_payload = buildApiPayload(messages_json, model, toolManager, use_tools, false);
+        const size_t prompt_tokens = estimate_tokens(json_payload);
+        if (completion_cache) {
+            if (std::optional<std::string> cached = completion_cache->lookup(json_payload)) {
+                if (answered_by) *answered_by = model;
+                return std::move(*cached);
+            }
         }
-        
-        if (http_code != 200) {
-            throw std::runtime_error("API request returned HTTP status " + std::to_string(http_code) + ". Response: " + response_buffer);
+
+        for (int retry = 0;; ++retry) {
+            // Non-streaming calls are research sub-queries and synthesis: they
+            // queue behind interactive turns under the model's rate limits
+            if (!scheduler.acquire(model, prompt_tokens, RequestScheduler::Priority::Background, stop)) {
+                throw OperationCancelled();
+            }
+            auto handle = connection_pool.acquire();
+            CURL* curl = handle.get();
+            response_buffer.clear();
+
+            curl_easy_setopt(curl, CURLOPT_URL, request_url.c_str());
+            curl_easy_setopt(curl, CURLOPT_POST, 1L);
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload.c_str());
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, json_payload.size());
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_buffer);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 120L);
+
+            uint64_t start_ns = Tracer::nowNs();
+            CURLcode res = perform_transfer(handle, stop);
+            if (stop.stop_requested()) {
+                throw OperationCancelled();
+            }
+
+            long http_code = 0;
+            if (res == CURLE_OK) {
+                curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+                trace_transfer(curl, start_ns, 0);
+            }
+
+            RetryPolicy::Action action = RetryPolicy::classify(res, http_code);
+            if (action == RetryPolicy::Action::Done) {
+                breakers.recordSuccess(model);
+                if (completion_cache) {
+                    completion_cache->store(json_payload, response_buffer);
+                }
+                if (answered_by) *answered_by = model;
+                return response_buffer;
+            }
+            if (action == RetryPolicy::Action::Fail) {
+                throw std::runtime_error("API request returned HTTP status " + std::to_string(http_code) + ". Response: " + response_buffer);
+            }
+
+            breakers.recordFailure(model);
+            last_failure = res != CURLE_OK ? "failed: " + std::string(curl_easy_strerror(res))
+                                           : "returned HTTP status " + std::to_string(http_code) + ". Response: " + response_buffer;
+            std::string reason = res != CURLE_OK ? curl_easy_strerror(res) : "HTTP " + std::to_string(http_code);
+            if (action == RetryPolicy::Action::Retry && retry + 1 < retry_policy.options().attempts_per_model) {
+                if (auto delay = retry_policy.backoff(retry, res == CURLE_OK ? retry_after_seconds(curl) : -1)) {
+                    if (http_code == 429) {
+                        scheduler.throttle(model, *delay); // Other requests to the model hold off too
+                    }
+                    ui.displayStatus("API call with model '" + model + "' failed (" + reason + "), retrying in " +
+                                     std::to_string(delay->count()) + " ms");
+                    if (!RetryPolicy::sleepFor(*delay, stop)) {
+                        throw OperationCancelled();
+                    }
+                    continue;
+                }
+            }
+            if (!last_candidate) {
+                ui.displayError("API call with model '" + model + "' failed (Error: " + reason +
+                                "). Trying fallback model: " + models[m + 1]);
+            }
+            break;
         }
-        
-        return response_buffer;
     }
+    throw std::runtime_error("API request " + last_failure);
 }
 
-// Structure to hold streaming callback context
-struct StreamingCallbackContext {
-    std::string buffer;
-    ApiClient::StreamingResponse* response;
-    const std::function<void(const std::string&)>* chunk_callback;
-};
+// Abort a transfer once the caller's cancel flag is set
+static int cancel_progress_callback(void* cancel, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    return static_cast<const std::atomic<bool>*>(cancel)->load() ? 1 : 0;
+}
 
-// CURL write callback for streaming responses
-static size_t StreamingWriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    size_t total_size = size * nmemb;
-    StreamingCallbackContext* ctx = static_cast<StreamingCallbackContext*>(userp);
+std::vector<std::vector<float>> ApiClient::embed(const std::vector<std::string>& inputs,
+                                                 const std::string& model,
+                                                 const std::atomic<bool>* cancel,
+                                                 std::stop_token stop,
+                                                 std::chrono::milliseconds timeout) {
+    if (inputs.empty()) {
+        return {};
+    }
+    TraceSpan span("api.embed");
+    struct curl_slist* headers = getRequestHeaders();
+    const std::string request_url = route_url(embeddings_base);
+    const std::string json_payload = nlohmann::json{{"model", model}, {"input", inputs}}.dump();
+    std::string response_buffer;
 
-    // Append new data to buffer
-    ctx->buffer.append(static_cast<char*>(contents), total_size);
+    auto handle = connection_pool.acquire();
+    CURL* curl = handle.get();
+    curl_easy_setopt(curl, CURLOPT_URL, request_url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, json_payload.size());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_buffer);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout.count()));
+    if (cancel) {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, cancel_progress_callback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, const_cast<std::atomic<bool>*>(cancel));
+    }
 
-    // Process complete lines (SSE format)
-    while (true) {
-        size_t line_end = ctx->buffer.find('\n');
-        if (line_end == std::string::npos) {
-            break; // No complete line yet
-        }
+    CURLcode res = perform_transfer(handle, stop);
+    if (stop.stop_requested()) {
+        throw OperationCancelled();
+    }
+    if (res != CURLE_OK) {
+        throw std::runtime_error("Embeddings request failed: " + std::string(curl_easy_strerror(res)));
+    }
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    if (http_code != 200) {
+        throw std::runtime_error("Embeddings request returned HTTP status " + std::to_string(http_code) + ". Response: " + response_buffer);
+    }
 
-        std::string line = ctx->buffer.substr(0, line_end);
-        ctx->buffer.erase(0, line_end + 1);
+    nlohmann::json response = nlohmann::json::parse(response_buffer, nullptr, false);
+    if (response.is_discarded() || !response.contains("data") || !response["data"].is_array()) {
+        throw std::runtime_error("Malformed embeddings response: " + response_buffer.substr(0, 200));
+    }
 
-        // Trim whitespace
-        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
-            line.pop_back();
+    // Entries carry their input index; the order of "data" is not guaranteed
+    std::vector<std::vector<float>> vectors(inputs.size());
+    for (const auto& item : response["data"]) {
+        size_t index = item.value("index", size_t{0});
+        if (index >= vectors.size() || !item.contains("embedding") || !item["embedding"].is_array()) {
+            throw std::runtime_error("Malformed embeddings response entry");
         }
-
-        // Skip empty lines
-        if (line.empty()) {
-            continue;
+        vectors[index] = item["embedding"].get<std::vector<float>>();
+    }
+    for (const auto& vector : vectors) {
+        if (vector.empty()) {
+            throw std::runtime_error("Embeddings response is missing vectors");
         }
+    }
+    return vectors;
+}
 
-        // Skip SSE comments (e.g., ": OPENROUTER PROCESSING")
-        if (line[0] == ':') {
-            continue;
+void ApiClient::StreamingResponse::materializeToolCalls() {
+    if (!tool_calls_dirty) {
+        return;
+    }
+    nlohmann::json tool_calls = nlohmann::json::array();
+    for (const auto& buffer : tool_call_buffers) {
+        nlohmann::json tool_call = nlohmann::json::object();
+        if (!buffer.id.empty()) tool_call["id"] = buffer.id;
+        if (!buffer.type.empty()) tool_call["type"] = buffer.type;
+        if (buffer.has_function) {
+            nlohmann::json function = nlohmann::json::object();
+            if (!buffer.name.empty()) function["name"] = buffer.name;
+            if (buffer.has_arguments) function["arguments"] = buffer.arguments;
+            tool_call["function"] = std::move(function);
         }
+        tool_calls.push_back(std::move(tool_call));
+    }
+    accumulated_tool_calls = std::move(tool_calls);
+    tool_calls_dirty = false;
+}
+
+// CURL write callback for streaming responses - hands each chunk to the SSE parser
+static size_t StreamingWriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t total_size = size * nmemb;
+    SseStreamParser* parser = static_cast<SseStreamParser*>(userp);
+    if (!parser->feed(static_cast<const char*>(contents), total_size)) {
+        return 0; // Signal libcurl to abort transfer
+    }
+    return total_size;
+}
+
+namespace {
+
+// One streaming request with its own response, parser and pooled handle.
+// Several may race (hedging); the first to stream a token claims `winner`,
+// and only the winner's chunks and tool calls reach the caller's callbacks.
+struct StreamAttempt {
+    std::string model;
+    std::string payload;
+    HttpConnectionPool::Handle handle;
+    ApiClient::StreamingResponse response;
+    SseStreamParser::ChunkCallback chunk_gate;
+    ApiClient::ToolCallCallback tool_call_gate;
+    SseStreamParser parser;
+    uint64_t start_ns = 0;
+    CURLcode result = CURLE_OK;
+    bool running = false;
+
+    StreamAttempt(std::string model_id, std::string body, HttpConnectionPool::Handle leased,
+                  int index, int& winner,
+                  const SseStreamParser::ChunkCallback& chunk_callback,
+                  const ApiClient::ToolCallCallback& tool_call_callback)
+        : model(std::move(model_id)), payload(std::move(body)), handle(std::move(leased)),
+          chunk_gate([index, &winner, &chunk_callback](const std::string& chunk) {
+              if (winner < 0) winner = index;
+              if (winner == index && chunk_callback) chunk_callback(chunk);
+          }),
+          tool_call_gate([index, &winner, &tool_call_callback](const ApiClient::StreamingResponse::ToolCallBuffer& call) {
+              if (winner < 0) winner = index;
+              if (winner == index && tool_call_callback) tool_call_callback(call);
+          }),
+          parser(response, &chunk_gate, &tool_call_gate) {
+    }
 
-        // Process SSE data lines
-        if (line.rfind("data: ", 0) == 0) {
-            std::string data = line.substr(6);
+    bool hasToken() const { return !response.accumulated_content.empty() || response.has_tool_calls; }
+};
+
+// Run attempts[0]; a second attempt, if given, is started once hedge_after
+// passes without a token (and admit_hedge agrees). The first to stream a
+// token wins and the other is dropped; one that fails first leaves the other
+// running alone. Returns the index of the attempt whose outcome counts.
+size_t run_streams(std::vector<std::unique_ptr<StreamAttempt>>& attempts, const int& winner,
+                   std::chrono::milliseconds hedge_after, const std::function<bool()>& admit_hedge,
+                   const std::stop_token& stop) {
+    if (attempts.size() == 1) {
+        attempts[0]->start_ns = Tracer::nowNs();
+        attempts[0]->result = perform_transfer(attempts[0]->handle, stop);
+        return 0;
+    }
 
-            // Check for stream end
-            if (data == "[DONE]") {
+    // Both run on the first attempt's pooled multi, whose connection cache
+    // keeps whichever connections finish cleanly
+    CURLM* multi = attempts[0]->handle.multi();
+    auto start = [multi](StreamAttempt& attempt) {
+        attempt.start_ns = Tracer::nowNs();
+        attempt.running = curl_multi_add_handle(multi, attempt.handle.get()) == CURLM_OK;
+    };
+    auto drop = [multi](StreamAttempt& attempt) {
+        if (attempt.running) curl_multi_remove_handle(multi, attempt.handle.get());
+        attempt.running = false;
+    };
+
+    start(*attempts[0]);
+    const auto hedge_at = std::chrono::steady_clock::now() + hedge_after;
+    bool hedge_started = false;
+    std::optional<size_t> decided;
+    {
+        auto wake_multi = [multi]() { curl_multi_wakeup(multi); };
+        std::stop_callback<decltype(wake_multi)> wake(stop, wake_multi);
+        while (!decided && !stop.stop_requested()) {
+            int still_running = 0;
+            if (curl_multi_perform(multi, &still_running) != CURLM_OK) {
+                for (auto& attempt : attempts) attempt->result = CURLE_RECV_ERROR;
+                decided = winner >= 0 ? static_cast<size_t>(winner) : 0;
                 break;
             }
+            int leader = winner;
+            for (size_t i = 0; leader < 0 && i < attempts.size(); ++i) {
+                if (attempts[i]->running && attempts[i]->hasToken()) leader = static_cast<int>(i);
+            }
 
-            // Parse JSON chunk
-            try {
-                auto chunk_json = nlohmann::json::parse(data);
-
-                // Check for mid-stream error
-                if (chunk_json.contains("error")) {
-                    ctx->response->has_error = true;
-                    ctx->response->error_message = chunk_json["error"]["message"].get<std::string>();
-
-                    // Check for error finish_reason
-                    if (chunk_json.contains("choices") && !chunk_json["choices"].empty()) {
-                        auto finish_reason = chunk_json["choices"][0].value("finish_reason", "");
-                        if (finish_reason == "error") {
-                            ctx->response->finish_reason = "error";
-                        }
+            std::vector<StreamAttempt*> finished;
+            int messages_left = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi, &messages_left)) {
+                if (msg->msg != CURLMSG_DONE) continue;
+                for (auto& attempt : attempts) {
+                    if (attempt->running && attempt->handle.get() == msg->easy_handle) {
+                        attempt->result = msg->data.result;
+                        finished.push_back(attempt.get());
                     }
-                    break;
                 }
+            }
+            for (StreamAttempt* attempt : finished) drop(*attempt);
 
-                // Extract content delta and tool calls
-                if (chunk_json.contains("choices") && !chunk_json["choices"].empty()) {
-                    const auto& choice = chunk_json["choices"][0];
-
-                    if (choice.contains("delta")) {
-                        const auto& delta = choice["delta"];
-
-                        // Handle content
-                        if (delta.contains("content") && !delta["content"].is_null()) {
-                            std::string content = delta["content"].get<std::string>();
-                            ctx->response->accumulated_content += content;
-
-                            // Call the chunk callback (must not let exceptions escape to C code)
-                            if (ctx->chunk_callback && *ctx->chunk_callback) {
-                                try {
-                                    (*ctx->chunk_callback)(content);
-                                } catch (const std::exception& e) {
-                                    // Capture exception and signal error to stop transfer
-                                    ctx->response->callback_exception = true;
-                                    ctx->response->callback_exception_message =
-                                        std::string("Callback exception: ") + e.what();
-                                    return 0; // Signal libcurl to abort transfer
-                                } catch (...) {
-                                    // Capture unknown exception
-                                    ctx->response->callback_exception = true;
-                                    ctx->response->callback_exception_message =
-                                        "Unknown callback exception occurred";
-                                    return 0; // Signal libcurl to abort transfer
-                                }
-                            }
-                        }
-
-                        // Handle tool_calls - accumulate deltas properly
-                        if (delta.contains("tool_calls") && !delta["tool_calls"].is_null()) {
-                            ctx->response->has_tool_calls = true;
-
-                            // Initialize accumulated_tool_calls as array if needed
-                            if (!ctx->response->accumulated_tool_calls.is_array()) {
-                                ctx->response->accumulated_tool_calls = nlohmann::json::array();
-                            }
-
-                            // Merge each tool_call delta by index
-                            for (const auto& tool_call_delta : delta["tool_calls"]) {
-                                if (!tool_call_delta.contains("index")) continue;
-
-                                int index = tool_call_delta["index"].get<int>();
-
-                                // Ensure array is large enough
-                                while (ctx->response->accumulated_tool_calls.size() <= static_cast<size_t>(index)) {
-                                    ctx->response->accumulated_tool_calls.push_back(nlohmann::json::object());
-                                }
-
-                                auto& accumulated = ctx->response->accumulated_tool_calls[index];
-
-                                // Merge id (appears once)
-                                if (tool_call_delta.contains("id")) {
-                                    accumulated["id"] = tool_call_delta["id"];
-                                }
-
-                                // Merge type (appears once)
-                                if (tool_call_delta.contains("type")) {
-                                    accumulated["type"] = tool_call_delta["type"];
-                                }
-
-                                // Merge function object
-                                if (tool_call_delta.contains("function")) {
-                                    if (!accumulated.contains("function")) {
-                                        accumulated["function"] = nlohmann::json::object();
-                                    }
-
-                                    const auto& func_delta = tool_call_delta["function"];
-                                    auto& accumulated_func = accumulated["function"];
-
-                                    // Merge function name (appears once)
-                                    if (func_delta.contains("name")) {
-                                        accumulated_func["name"] = func_delta["name"];
-                                    }
-
-                                    // Accumulate function arguments (streamed incrementally)
-                                    if (func_delta.contains("arguments")) {
-                                        if (!accumulated_func.contains("arguments")) {
-                                            accumulated_func["arguments"] = "";
-                                        }
-                                        std::string current_args = accumulated_func["arguments"].get<std::string>();
-                                        std::string delta_args = func_delta["arguments"].get<std::string>();
-                                        accumulated_func["arguments"] = current_args + delta_args;
-                                    }
-                                }
-                            }
-                        }
-                    }
-
-                    // Check for finish_reason
-                    if (choice.contains("finish_reason") && !choice["finish_reason"].is_null()) {
-                        ctx->response->finish_reason = choice["finish_reason"].get<std::string>();
-                    }
+            if (leader >= 0) {
+                // The race is settled: the slower request is abandoned
+                for (size_t i = 0; i < attempts.size(); ++i) {
+                    if (static_cast<int>(i) != leader) drop(*attempts[i]);
                 }
-            } catch (const nlohmann::json::exception& e) {
-                // Ignore JSON parsing errors for individual chunks
+                if (!attempts[leader]->running) decided = static_cast<size_t>(leader);
+            } else if (!finished.empty()) {
+                // Failed (or ended empty) before any token: the other one
+                // carries on; if none is left its outcome counts
+                bool any_running = std::any_of(attempts.begin(), attempts.end(),
+                                               [](const auto& attempt) { return attempt->running; });
+                if (!any_running) {
+                    decided = static_cast<size_t>(finished.back() == attempts[0].get() ? 0 : 1);
+                }
+            }
+            if (decided) break;
+
+            auto now = std::chrono::steady_clock::now();
+            if (!hedge_started && leader < 0 && now >= hedge_at) {
+                if (admit_hedge()) start(*attempts[1]);
+                hedge_started = true;
             }
+            int timeout_ms = 1000;
+            if (!hedge_started) {
+                auto until_hedge = std::chrono::duration_cast<std::chrono::milliseconds>(hedge_at - now).count();
+                timeout_ms = static_cast<int>(std::clamp<long long>(until_hedge, 0, 1000));
+            }
+            curl_multi_poll(multi, nullptr, 0, timeout_ms, nullptr);
         }
     }
+    for (auto& attempt : attempts) drop(*attempt);
+    if (!decided) {
+        decided = winner >= 0 ? static_cast<size_t>(winner) : 0;
+    }
+    return *decided;
+}
 
-    return total_size;
+// Error description for a non-200 streaming response (JSON error message if present)
+std::string streaming_http_error(long http_code, std::string_view body) {
+    std::string error_msg = "HTTP " + std::to_string(http_code);
+    if (!body.empty()) {
+        try {
+            auto error_json = nlohmann::json::parse(body);
+            if (error_json.contains("error") && error_json["error"].contains("message")) {
+                error_msg += ": " + error_json["error"]["message"].get<std::string>();
+            }
+        } catch (...) {
+            error_msg += ". Response: " + std::string(body);
+        }
+    }
+    return error_msg;
+}
+
+} // namespace
+
+std::optional<ApiClient::StreamingResponse> ApiClient::cachedStream(
+    const std::string& request_body, const std::string& model,
+    const std::function<void(const std::string&)>& chunk_callback) {
+    std::optional<std::string> cached = completion_cache->lookup(request_body);
+    if (!cached) {
+        return std::nullopt;
+    }
+    nlohmann::json response = nlohmann::json::parse(*cached, nullptr, false);
+    if (response.is_discarded() || !response.contains("choices") || response["choices"].empty()) {
+        return std::nullopt;
+    }
+    const nlohmann::json& message = response["choices"][0].value("message", nlohmann::json::object());
+    if (!message.contains("content") || !message["content"].is_string() ||
+        (message.contains("tool_calls") && !message["tool_calls"].is_null())) {
+        return std::nullopt;
+    }
+    StreamingResponse streamed;
+    streamed.accumulated_content = message["content"].get<std::string>();
+    streamed.finish_reason = "stop";
+    streamed.model = response.value("model", model);
+    if (chunk_callback && !streamed.accumulated_content.empty()) {
+        chunk_callback(streamed.accumulated_content);
+    }
+    return streamed;
+}
+
+void ApiClient::storeStream(const std::string& request_body, const StreamingResponse& response) {
+    if (response.accumulated_content.empty()) {
+        return;
+    }
+    // In the shape of a non-streaming completion, so either call can reuse it
+    nlohmann::json completion = {
+        {"model", response.model},
+        {"choices", nlohmann::json::array({{
+            {"index", 0},
+            {"message", {{"role", "assistant"}, {"content", response.accumulated_content}}},
+            {"finish_reason", response.finish_reason.empty() ? "stop" : response.finish_reason},
+        }})},
+    };
+    completion_cache->store(request_body, completion.dump());
 }
 
 ApiClient::StreamingResponse ApiClient::makeStreamingApiCall(
     const std::vector<Message>& context,
     ToolManager& toolManager,
     bool use_tools,
-    const std::function<void(const std::string&)>& chunk_callback) {
-
-    CURL* curl = nullptr;
-    CURLcode res;
-    long http_code = 0;
-    StreamingCallbackContext callback_ctx;
-    StreamingResponse streaming_response;
-    callback_ctx.response = &streaming_response;
-    callback_ctx.chunk_callback = &chunk_callback;
-    bool retried_with_default_once = false;
-
-    while (true) {
-        curl = curl_easy_init();
-        if (!curl) {
-            throw std::runtime_error("Failed to initialize CURL");
+    const std::function<void(const std::string&)>& chunk_callback,
+    const ToolCallCallback& tool_call_callback,
+    std::stop_token stop,
+    RequestScheduler::Priority priority) {
+
+    struct curl_slist* headers = getRequestHeaders();
+    const std::string request_url = route_url(api_base);
+    const std::string messages_json = [&] {
+        TraceSpan span("api.payload");
+        return buildMessagesJson(context, toolManager, use_tools);
+    }();
+    const std::vector<std::string> models = retry_policy.candidates(this->active_model_id_ref);
+    const std::chrono::milliseconds hedge_after = retry_policy.options().hedge_after;
+    std::string last_failure = "no model available";
+
+    for (size_t m = 0; m < models.size(); ++m) {
+        const std::string& model = models[m];
+        bool last_candidate = m + 1 == models.size();
+        // An open breaker skips the model, except as the last resort
+        if (!last_candidate && !breakers.allow(model)) {
+            continue;
+        }
+        // Cached under the body of the equivalent non-streaming request
+        const bool use_cache = completion_cache && priority == RequestScheduler::Priority::Background;
+        if (use_cache) {
+            if (std::optional<StreamingResponse> cached = cachedStream(
+                    buildApiPayload(messages_json, model, toolManager, use_tools, false), model, chunk_callback)) {
+                return std::move(*cached);
+            }
         }
-        auto curl_guard = std::unique_ptr<CURL, decltype(&curl_easy_cleanup)>{curl, curl_easy_cleanup};
-
-        std::string api_key = get_openrouter_api_key();
-
-        struct curl_slist* headers = nullptr;
-        auto headers_guard = std::unique_ptr<struct curl_slist, decltype(&curl_slist_free_all)>{nullptr, curl_slist_free_all};
-
-        headers = curl_slist_append(headers, ("Authorization: Bearer " + api_key).c_str());
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        headers = curl_slist_append(headers, "HTTP-Referer: https://llm-cli.tsatsin.com");
-        headers = curl_slist_append(headers, "X-Title: LLM-cli");
-        headers_guard.reset(headers);
 
-        nlohmann::json payload = buildApiPayload(context, toolManager, use_tools, true);
-        std::string json_payload = payload.dump();
+        for (int retry = 0;; ++retry) {
+            int winner = -1;
+            std::vector<std::unique_ptr<StreamAttempt>> attempts;
+            auto add_attempt = [&](const std::string& attempt_model) {
+                auto attempt = std::make_unique<StreamAttempt>(
+                    attempt_model, buildApiPayload(messages_json, attempt_model, toolManager, use_tools, true),
+                    connection_pool.acquire(), static_cast<int>(attempts.size()), winner,
+                    chunk_callback, tool_call_callback);
+                CURL* curl = attempt->handle.get();
+                curl_easy_setopt(curl, CURLOPT_URL, request_url.c_str());
+                curl_easy_setopt(curl, CURLOPT_POST, 1L);
+                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, attempt->payload.c_str());
+                curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, attempt->payload.size());
+                curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamingWriteCallback);
+                curl_easy_setopt(curl, CURLOPT_WRITEDATA, &attempt->parser);
+                curl_easy_setopt(curl, CURLOPT_TIMEOUT, 120L);
+                attempts.push_back(std::move(attempt));
+            };
+            add_attempt(model);
+            // Hedge with the next candidate unless its breaker is open
+            if (hedge_after.count() > 0 && !last_candidate && !breakers.isOpen(models[m + 1])) {
+                add_attempt(models[m + 1]);
+            }
 
-        // Reset streaming response for potential retry
-        streaming_response = StreamingResponse();
-        callback_ctx.buffer.clear();
-        callback_ctx.response = &streaming_response;
+            // Interactive turns go ahead of queued background calls
+            if (!scheduler.acquire(model, estimate_tokens(attempts[0]->payload), priority, stop)) {
+                StreamingResponse cancelled;
+                cancelled.cancelled = true;
+                return cancelled;
+            }
+            // A hedge is only sent if its model has capacity to spare right then
+            auto admit_hedge = [&]() {
+                return scheduler.tryAcquire(attempts[1]->model, estimate_tokens(attempts[1]->payload));
+            };
+
+            StreamAttempt& attempt = *attempts[run_streams(attempts, winner, hedge_after, admit_hedge, stop)];
+            StreamingResponse& streaming_response = attempt.response;
+            streaming_response.model = attempt.model;
+            if (stop.stop_requested()) {
+                // Return what was streamed so far for the caller to save
+                streaming_response.cancelled = true;
+                return std::move(streaming_response);
+            }
 
-        curl_easy_setopt(curl, CURLOPT_URL, api_base.c_str());
-        curl_easy_setopt(curl, CURLOPT_POST, 1L);
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload.c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, json_payload.size());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamingWriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &callback_ctx);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 120L);
+            CURL* curl = attempt.handle.get();
+            long http_code = 0;
+            if (attempt.result == CURLE_OK) {
+                curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+                trace_transfer(curl, attempt.start_ns, estimate_tokens(streaming_response.accumulated_content));
+            }
 
-        res = curl_easy_perform(curl);
+            RetryPolicy::Action action = RetryPolicy::classify(attempt.result, http_code);
+            if (action == RetryPolicy::Action::Done) {
+                breakers.recordSuccess(attempt.model);
 
-        if (res == CURLE_OK) {
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-        }
+                // Check if streaming completed with an error
+                if (streaming_response.has_error) {
+                    throw std::runtime_error("Streaming error: " + streaming_response.error_message);
+                }
 
-        // Check for model-specific errors or general API failure
-        bool model_potentially_unavailable = false;
-        if (res != CURLE_OK) {
-            model_potentially_unavailable = true;
-        } else if (http_code == 404 || http_code == 429 || http_code == 500) {
-            model_potentially_unavailable = true;
-        }
+                // Check if a callback exception occurred
+                if (streaming_response.callback_exception) {
+                    throw std::runtime_error("Streaming callback error: " + streaming_response.callback_exception_message);
+                }
 
-        if (model_potentially_unavailable && !retried_with_default_once && this->active_model_id_ref != DEFAULT_MODEL_ID) {
-            std::string failed_model_id = this->active_model_id_ref;
-            ui.displayError("Streaming API call with model '" + failed_model_id + "' failed (Error: " +
-                          (res != CURLE_OK ? curl_easy_strerror(res) : "HTTP " + std::to_string(http_code)) +
-                          "). Attempting to switch to default model: " + std::string(DEFAULT_MODEL_ID));
+                // Streams that end without a finish_reason still need their tool_calls materialized
+                streaming_response.materializeToolCalls();
 
-            this->active_model_id_ref = DEFAULT_MODEL_ID;
-            ui.displayStatus("Active model set to: " + this->active_model_id_ref);
-            retried_with_default_once = true;
-            continue;
-        }
+                if (use_cache && !streaming_response.has_tool_calls) {
+                    storeStream(buildApiPayload(messages_json, attempt.model, toolManager, use_tools, false),
+                                streaming_response);
+                }
+                return std::move(streaming_response);
+            }
 
-        if (res != CURLE_OK) {
-            throw std::runtime_error("Streaming API request failed: " + std::string(curl_easy_strerror(res)));
-        }
+            // For streaming, HTTP 200 is expected even for errors that occur mid-stream
+            std::string reason = attempt.result != CURLE_OK ? curl_easy_strerror(attempt.result)
+                                                            : streaming_http_error(http_code, attempt.parser.pending());
+            if (action == RetryPolicy::Action::Fail) {
+                throw std::runtime_error("Streaming API request returned " + reason);
+            }
+            breakers.recordFailure(attempt.model);
+            last_failure = attempt.result != CURLE_OK ? "failed: " + reason : "returned " + reason;
+            // Output already shown cannot be taken back, so a broken stream is not retried
+            if (attempt.hasToken()) {
+                throw std::runtime_error("Streaming API request " + last_failure);
+            }
 
-        // For streaming, HTTP 200 is expected even for errors that occur mid-stream
-        if (http_code != 200) {
-            // Try to parse error from buffer if available
-            std::string error_msg = "HTTP " + std::to_string(http_code);
-            if (!callback_ctx.buffer.empty()) {
-                try {
-                    auto error_json = nlohmann::json::parse(callback_ctx.buffer);
-                    if (error_json.contains("error") && error_json["error"].contains("message")) {
-                        error_msg += ": " + error_json["error"]["message"].get<std::string>();
+            if (action == RetryPolicy::Action::Retry && retry + 1 < retry_policy.options().attempts_per_model) {
+                long retry_after = attempt.result == CURLE_OK ? retry_after_seconds(curl) : -1;
+                if (auto delay = retry_policy.backoff(retry, retry_after)) {
+                    if (http_code == 429) {
+                        scheduler.throttle(attempt.model, *delay); // Other requests to the model hold off too
+                    }
+                    ui.displayStatus("Streaming API call with model '" + attempt.model + "' failed (" + reason +
+                                     "), retrying in " + std::to_string(delay->count()) + " ms");
+                    if (!RetryPolicy::sleepFor(*delay, stop)) {
+                        StreamingResponse cancelled;
+                        cancelled.cancelled = true;
+                        return cancelled;
                     }
-                } catch (...) {
-                    error_msg += ". Response: " + callback_ctx.buffer;
+                    continue;
                 }
             }
-            throw std::runtime_error("Streaming API request returned " + error_msg);
-        }
-
-        // Check if streaming completed with an error
-        if (streaming_response.has_error) {
-            throw std::runtime_error("Streaming error: " + streaming_response.error_message);
-        }
-
-        // Check if a callback exception occurred
-        if (streaming_response.callback_exception) {
-            throw std::runtime_error("Streaming callback error: " + streaming_response.callback_exception_message);
+            if (!last_candidate) {
+                ui.displayError("Streaming API call with model '" + attempt.model + "' failed (Error: " + reason +
+                                "). Trying fallback model: " + models[m + 1]);
+            }
+            break;
         }
-
-        return streaming_response;
     }
-}
\ No newline at end of file
+    throw std::runtime_error("Streaming API request " + last_failure);
+}
@@ -3,11 +3,23 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <unordered_map>
 #include <nlohmann/json.hpp>
 #include "database.h"
 #include "ui_interface.h"
+#include "http_connection_pool.h"
+#include "json_completeness.h"
+#include "retry_policy.h"
+#include "request_scheduler.h"
 
 // Forward declarations
+class CompletionCache;
 class PersistenceManager;
 class UserInterface;
 class ToolManager;
@@ -15,20 +27,42 @@ class ToolManager;
 /**
  * ApiClient handles all communication with the OpenRouter API:
  * - Constructing API requests with context and tools
- * - Managing CURL operations
+ * - Managing CURL operations over a persistent, shared connection pool
  * - Handling API responses and errors
- * - Implementing retry logic with fallback models
+ * - Retrying with backoff and failing over to fallback models per request
+ *   (RetryPolicy, CircuitBreakers); the active model is never changed
+ * - Metering requests per model through the shared RequestScheduler
  */
 class ApiClient {
 public:
     explicit ApiClient(UserInterface& ui_ref, std::string& active_model_id_ref);
-    
+    // Client that leases handles from an existing pool (e.g. one ApiClient per
+    // concurrent batch worker, all sharing connections); the pool must outlive it
+    ApiClient(UserInterface& ui_ref, std::string& active_model_id_ref, HttpConnectionPool& shared_pool);
+    ~ApiClient();
+
+    // Connection pool shared with other OpenRouter consumers (e.g. ModelManager)
+    HttpConnectionPool& connectionPool() { return connection_pool; }
+
+    // Context length of the active model (0 = unknown); sets the token budget
+    // that request contexts are packed into
+    void setContextLength(int context_length) { active_context_length.store(context_length); }
+    int contextLength() const { return active_context_length.load(); }
+
+    // Consult (and fill) a completion cache in makeApiCall() and background
+    // streams before any network I/O; nullptr disables it. Interactive
+    // streams are never cached.
+    void setCompletionCache(CompletionCache* cache) { completion_cache = cache; }
+
     // Make an API call with the given context and optional tool definitions
-    // Returns the raw JSON response string
-    // Throws on failure after retry attempts
+    // Returns the raw JSON response string; *answered_by (if given) is set to
+    // the model that produced it
+    // Throws on failure after retry attempts, OperationCancelled once stop is requested
     std::string makeApiCall(const std::vector<Message>& context,
                            ToolManager& toolManager,
-                           bool use_tools = false);
+                           bool use_tools = false,
+                           std::stop_token stop = {},
+                           std::string* answered_by = nullptr);
 
     // Structure to hold streaming response data
     struct StreamingResponse {
@@ -37,28 +71,118 @@ public:
         bool has_error = false;
         std::string error_message;
         bool has_tool_calls = false;
-        nlohmann::json accumulated_tool_calls;  // Accumulated tool_calls array with merged deltas
+        nlohmann::json accumulated_tool_calls;  // Accumulated tool_calls array, materialized at finish_reason
         bool callback_exception = false;
         std::string callback_exception_message;
+        bool cancelled = false;  // Stopped mid-stream; the content so far is kept
+        std::string model;       // Model that produced the response (may be a fallback)
+
+        // Per-index native buffers that tool_call deltas are appended to in place while streaming
+        struct ToolCallBuffer {
+            std::string id;
+            std::string type;
+            bool has_function = false;
+            std::string name;
+            bool has_arguments = false;
+            std::string arguments;
+            JsonCompletenessScanner arguments_scanner; // Fed each arguments fragment
+            bool announced = false;  // Passed to the tool call callback
+        };
+        std::vector<ToolCallBuffer> tool_call_buffers;
+        bool tool_calls_dirty = false; // Buffers changed since the last materialization
+
+        // Build accumulated_tool_calls from the native buffers (no-op if unchanged)
+        void materializeToolCalls();
     };
 
+    // Called mid-stream, once per tool call, as soon as the call's id, name and
+    // complete arguments object have arrived (later calls may still be streaming)
+    using ToolCallCallback = std::function<void(const StreamingResponse::ToolCallBuffer&)>;
+
     // Make a streaming API call with the given context
-    // Calls the chunk_callback for each content chunk received
-    // Returns StreamingResponse with accumulated content and metadata
+    // Calls the chunk_callback for each content chunk received and the
+    // tool_call_callback (if set) for each tool call whose arguments are complete
+    // Returns StreamingResponse with accumulated content and metadata; a stop
+    // request ends the stream early with `cancelled` set
+    // Failed attempts are retried only while nothing has been streamed; with
+    // LLM_CLI_HEDGE_AFTER_MS set, a slow first token races the next candidate
+    // Background streams (tool output such as research reports) queue behind
+    // interactive turns and, like makeApiCall(), go through the completion
+    // cache: a hit is passed to chunk_callback in one piece
     // Throws on failure after retry attempts
     StreamingResponse makeStreamingApiCall(const std::vector<Message>& context,
                                           ToolManager& toolManager,
                                           bool use_tools,
-                                          const std::function<void(const std::string&)>& chunk_callback);
+                                          const std::function<void(const std::string&)>& chunk_callback,
+                                          const ToolCallCallback& tool_call_callback = {},
+                                          std::stop_token stop = {},
+                                          RequestScheduler::Priority priority = RequestScheduler::Priority::Interactive);
+
+    // Embed texts with an embeddings model (one request, no model fallback)
+    // Returns one vector per input, in input order; setting *cancel or
+    // stopping stop aborts the transfer, which gives up after timeout
+    // Throws on transport (including cancellation), HTTP or response format errors
+    std::vector<std::vector<float>> embed(const std::vector<std::string>& inputs,
+                                          const std::string& model,
+                                          const std::atomic<bool>* cancel = nullptr,
+                                          std::stop_token stop = {},
+                                          std::chrono::milliseconds timeout = std::chrono::seconds(60));
+
+    // Request body assembly used by both calls (public so llm_bench can measure it offline)
+
+    // Build the serialized "messages" array (shared between streaming and non-streaming)
+    // Packs the most recent messages (plus a leading system message) into the token
+    // budget of the active model; built once per call and reused across retries
+    std::string buildMessagesJson(const std::vector<Message>& context,
+                                  ToolManager& toolManager,
+                                  bool use_tools);
+
+    // Assemble the request body for `model` around a pre-built messages array
+    std::string buildApiPayload(const std::string& messages_json,
+                                const std::string& model,
+                                ToolManager& toolManager,
+                                bool use_tools,
+                                bool enable_streaming);
 
 private:
     UserInterface& ui;
-    std::string& active_model_id_ref; // Reference to the active model ID
+    std::string& active_model_id_ref; // Reference to the active model ID (read, never switched)
+    std::atomic<int> active_context_length{0};
+    CompletionCache* completion_cache = nullptr;
+    RetryPolicy retry_policy{RetryPolicy::Options::fromEnvironment()};
+    CircuitBreakers& breakers = CircuitBreakers::shared();
+    RequestScheduler& scheduler = RequestScheduler::shared();
     std::string api_base = "https://openrouter.ai/api/v1/chat/completions";
+    std::string embeddings_base = "https://openrouter.ai/api/v1/embeddings";
+
+    // Kept-alive handles and shared DNS/TLS caches for all API calls
+    std::unique_ptr<HttpConnectionPool> owned_pool; // Unset when a shared pool was passed in
+    HttpConnectionPool& connection_pool;
+
+    // Request headers are built once (on first use) and reused for every call and retry
+    std::once_flag headers_once;
+    std::unique_ptr<struct curl_slist, decltype(&curl_slist_free_all)> request_headers{nullptr, curl_slist_free_all};
+    struct curl_slist* getRequestHeaders();
+
+    // Parsed and pre-serialized form of a stored message, cached per Message::id
+    struct CachedMessage {
+        enum class Kind { Plain, ToolCallRequest, ToolResult, Invalid };
+        Kind kind = Kind::Plain;
+        std::vector<std::string> tool_call_ids; // ToolCallRequest: ids of the requested calls
+        std::string tool_call_id;               // ToolResult: id this result answers
+        std::string serialized;                 // Message JSON as it appears in the request body
+        size_t tokens = 0;                      // Estimated prompt tokens for serialized
+    };
+    std::mutex payload_cache_mutex;
+    std::unordered_map<int, std::shared_ptr<const CachedMessage>> payload_cache;
+
+    // Look up (or parse and cache) the request form of a message
+    std::shared_ptr<const CachedMessage> getCachedMessage(const Message& msg);
 
-    // Helper to build the JSON payload (shared between streaming and non-streaming)
-    nlohmann::json buildApiPayload(const std::vector<Message>& context,
-                                   ToolManager& toolManager,
-                                   bool use_tools,
-                                   bool enable_streaming);
+    // Completion cache for background streams, keyed by the non-streaming
+    // request body: a hit replayed as one chunk, and a finished stream stored
+    // as a completion
+    std::optional<StreamingResponse> cachedStream(const std::string& request_body, const std::string& model,
+                                                  const std::function<void(const std::string&)>& chunk_callback);
+    void storeStream(const std::string& request_body, const StreamingResponse& response);
 };
\ No newline at end of file
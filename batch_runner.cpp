@@ -0,0 +1,202 @@
+#include "batch_runner.h"
+#include "api_client.h"
+#include "config.h"
+#include "database.h"
+#include "http_connection_pool.h"
+#include "tools.h"
+#include "ui_interface.h"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Status and errors from ApiClient (e.g. model fallback) go to stderr so stdout stays JSONL
+class BatchInterface : public NullUserInterface {
+public:
+    void displayError(const std::string& error) override { print("error: " + error); }
+    void displayStatus(const std::string& status) override { print(status); }
+
+private:
+    std::mutex mutex_;
+
+    void print(const std::string& text) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::cerr << text << std::endl;
+    }
+};
+
+struct BatchRequest {
+    size_t index = 0;
+    nlohmann::json id;          // Echoed back as given (null if absent)
+    std::string model_id;       // Empty: the batch default
+    std::vector<Message> context;
+};
+
+// Parse one input line; throws std::invalid_argument for malformed JSON requests
+BatchRequest parse_request(const std::string& line, size_t index) {
+    BatchRequest request;
+    request.index = index;
+    if (line.empty() || line.front() != '{') {
+        request.context.push_back({"user", line});
+        return request;
+    }
+
+    auto json = nlohmann::json::parse(line, nullptr, false);
+    if (!json.is_object()) {
+        throw std::invalid_argument("line is not valid JSON");
+    }
+    if (json.contains("id")) request.id = json["id"];
+    if (json.contains("model") && json["model"].is_string()) request.model_id = json["model"].get<std::string>();
+
+    if (json.contains("messages")) {
+        if (!json["messages"].is_array() || json["messages"].empty()) {
+            throw std::invalid_argument("\"messages\" must be a non-empty array");
+        }
+        for (const auto& message : json["messages"]) {
+            if (!message.is_object() || !message.contains("role") || !message["role"].is_string() ||
+                !message.contains("content") || !message["content"].is_string()) {
+                throw std::invalid_argument("each message needs string \"role\" and \"content\"");
+            }
+            request.context.push_back({message["role"].get<std::string>(), message["content"].get<std::string>()});
+        }
+        return request;
+    }
+
+    if (!json.contains("prompt") || !json["prompt"].is_string()) {
+        throw std::invalid_argument("expected a \"prompt\" string or a \"messages\" array");
+    }
+    if (json.contains("system") && json["system"].is_string()) {
+        request.context.push_back({"system", json["system"].get<std::string>()});
+    }
+    request.context.push_back({"user", json["prompt"].get<std::string>()});
+    return request;
+}
+
+// Text of choices[0].message.content; throws with the API's error message otherwise
+std::string response_text(const std::string& raw_response) {
+    auto json = nlohmann::json::parse(raw_response, nullptr, false);
+    if (json.is_discarded()) {
+        throw std::runtime_error("API response is not valid JSON");
+    }
+    if (json.contains("error")) {
+        const auto& error = json["error"];
+        throw std::runtime_error(error.is_object() && error.contains("message") && error["message"].is_string()
+                                     ? error["message"].get<std::string>()
+                                     : error.dump());
+    }
+    if (!json.contains("choices") || !json["choices"].is_array() || json["choices"].empty() ||
+        !json["choices"][0].contains("message")) {
+        throw std::runtime_error("API response has no choices");
+    }
+    const auto& content = json["choices"][0]["message"].value("content", nlohmann::json());
+    return content.is_string() ? content.get<std::string>() : std::string();
+}
+
+} // anonymous namespace
+
+BatchRunner::BatchRunner(PersistenceManager& db_ref, Options options_ref)
+    : db(db_ref), options(std::move(options_ref)) {
+    if (options.concurrency == 0) options.concurrency = 1;
+}
+
+size_t BatchRunner::run(std::istream& input, std::ostream& output) {
+    // Same default as the interactive client: the last model chosen with /model
+    std::string default_model = options.model_id;
+    if (default_model.empty()) {
+        default_model = db.loadSetting("selected_model_id").value_or(DEFAULT_MODEL_ID);
+    }
+    // Context lengths size each request's token budget; looked up once per model
+    std::mutex db_mutex;
+    std::map<std::string, int> context_lengths;
+    auto context_length_of = [&](const std::string& model_id) {
+        std::lock_guard<std::mutex> lock(db_mutex);
+        auto it = context_lengths.find(model_id);
+        if (it == context_lengths.end()) {
+            auto model = db.getModelById(model_id);
+            it = context_lengths.emplace(model_id, model ? model->context_length : 0).first;
+        }
+        return it->second;
+    };
+
+    BatchInterface ui;
+    ToolManager tool_manager;
+    // Workers transfer concurrently, so each pooled handle keeps its own connections
+    HttpConnectionPool pool(options.concurrency, /*share_connections=*/false);
+
+    std::mutex input_mutex;
+    size_t next_index = 0;
+    bool input_done = false;
+
+    // Results are written in input order; finished ones wait here for their turn
+    std::mutex output_mutex;
+    std::map<size_t, std::string> finished;
+    size_t next_to_write = 0;
+    size_t failures = 0;
+
+    auto worker = [&]() {
+        std::string model_id;
+        ApiClient client(ui, model_id, pool);
+
+        while (true) {
+            std::string line;
+            size_t index;
+            {
+                std::lock_guard<std::mutex> lock(input_mutex);
+                if (input_done) return;
+                do {
+                    if (!std::getline(input, line)) {
+                        input_done = true;
+                        return;
+                    }
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                } while (line.empty());
+                index = next_index++;
+            }
+
+            nlohmann::json result = {{"index", index}};
+            auto started = std::chrono::steady_clock::now();
+            try {
+                BatchRequest request = parse_request(line, index);
+                result["id"] = request.id;
+                model_id = request.model_id.empty() ? default_model : request.model_id;
+                client.setContextLength(context_length_of(model_id));
+                result["model"] = model_id;
+                std::string answered_by;
+                std::string text = response_text(client.makeApiCall(request.context, tool_manager, false, {}, &answered_by));
+                result["model"] = answered_by; // May be a fallback model
+                result["response"] = std::move(text);
+            } catch (const std::exception& e) {
+                result["error"] = e.what();
+            }
+            result["latency_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - started).count();
+
+            std::lock_guard<std::mutex> lock(output_mutex);
+            if (result.contains("error")) ++failures;
+            finished.emplace(index, result.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace));
+            for (auto it = finished.find(next_to_write); it != finished.end(); it = finished.find(next_to_write)) {
+                output << it->second << '\n';
+                finished.erase(it);
+                ++next_to_write;
+            }
+            output.flush();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(options.concurrency);
+    for (size_t i = 0; i < options.concurrency; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    return failures;
+}
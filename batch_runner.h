@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+
+class PersistenceManager;
+
+/**
+ * BatchRunner - non-interactive mode (llm-cli --batch)
+ *
+ * Reads one request per input line and writes one JSON response line per
+ * request, in input order. A line is either plain text (the prompt) or a JSON
+ * object:
+ *   {"id": any, "prompt": "...", "system": "...", "model": "..."}
+ *   {"id": any, "messages": [{"role": "...", "content": "..."}, ...]}
+ * and the matching output line is
+ *   {"index": n, "id": any, "model": "...", "response": "...", "latency_ms": n}
+ * or, on failure, the same with "error" instead of "response".
+ *
+ * Every request is independent: its context is exactly what the line holds,
+ * and nothing is written to the conversation history. Up to `concurrency`
+ * requests are in flight at once, each worker with its own ApiClient over one
+ * shared HttpConnectionPool. Tools are not offered in batch mode.
+ */
+class BatchRunner {
+public:
+    struct Options {
+        size_t concurrency = 4;
+        std::string model_id; // Empty: the model selected in the interactive client
+    };
+
+    BatchRunner(PersistenceManager& db, Options options);
+
+    // Process every line of input; returns the number of failed requests
+    size_t run(std::istream& input, std::ostream& output);
+
+private:
+    PersistenceManager& db;
+    Options options;
+};
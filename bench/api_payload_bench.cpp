@@ -0,0 +1,88 @@
+#include "bench.h"
+#include "api_client.h"
+#include "tools.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Request body assembly (ApiClient::buildMessagesJson + buildApiPayload) for
+// 10, 100 and 1000-message contexts. "cold" builds every message's request
+// form (a fresh ApiClient, as for the first request after startup); "warm"
+// reuses the per-message payload cache, as every later turn does.
+
+namespace {
+
+// System prompt, then user / assistant turns with a tool call and its result
+// every tenth message (fixed content, so runs are comparable)
+std::vector<Message> buildContext(size_t messages) {
+    std::vector<Message> context;
+    context.push_back({"system", std::string(600, 's'), 1});
+    for (size_t i = 1; context.size() < messages; ++i) {
+        int id = static_cast<int>(context.size()) + 1;
+        if (i % 10 == 0 && context.size() + 2 <= messages) {
+            std::string call_id = "call_" + std::to_string(i);
+            Message request{"assistant", SharedText(), id};
+            request.tool_calls = R"([{"id":")" + call_id +
+                                 R"(","type":"function","function":{"name":"search_web","arguments":"{\"query\":\"bench query\"}"}}])";
+            request.tool_call_ids = call_id;
+            context.push_back(std::move(request));
+
+            Message result{"tool", std::string(400, 'r'), id + 1};
+            result.tool_call_id = call_id;
+            result.tool_name = "search_web";
+            context.push_back(std::move(result));
+        } else if (i % 2 == 1) {
+            context.push_back({"user", std::string(120, 'u'), id});
+        } else {
+            context.push_back({"assistant", std::string(240, 'a'), id});
+        }
+    }
+    return context;
+}
+
+} // anonymous namespace
+
+namespace bench {
+
+void api_payload() {
+    NullUserInterface ui;
+    ToolManager tool_manager;
+    std::string model_id = "bench/model";
+    header("API request body (messages + tools, per request)");
+
+    for (size_t messages : {10, 100, 1000}) {
+        std::vector<Message> context = buildContext(messages);
+        size_t runs = messages >= 1000 ? 50 : 500;
+        std::string label = std::to_string(messages) + " messages";
+
+        {
+            std::vector<std::unique_ptr<ApiClient>> clients;
+            for (size_t run = 0; run < runs; ++run) {
+                clients.push_back(std::make_unique<ApiClient>(ui, model_id));
+                clients.back()->setContextLength(1000000);
+            }
+            AllocationScope allocs;
+            Stopwatch timer;
+            for (auto& client : clients) {
+                std::string messages_json = client->buildMessagesJson(context, tool_manager, true);
+                std::string payload = client->buildApiPayload(messages_json, model_id, tool_manager, true, true);
+            }
+            report(label + ", cold", runs, allocs.delta(), timer.elapsedNs());
+        }
+
+        ApiClient client(ui, model_id);
+        client.setContextLength(1000000);
+        client.buildMessagesJson(context, tool_manager, true); // Fill the payload cache
+        AllocationScope allocs;
+        Stopwatch timer;
+        size_t bytes = 0;
+        for (size_t run = 0; run < runs; ++run) {
+            std::string messages_json = client.buildMessagesJson(context, tool_manager, true);
+            std::string payload = client.buildApiPayload(messages_json, model_id, tool_manager, true, true);
+            bytes = payload.size();
+        }
+        report(label + ", warm (" + std::to_string(bytes / 1024) + " KB body)", runs, allocs.delta(), timer.elapsedNs());
+    }
+}
+
+} // namespace bench
@@ -0,0 +1,74 @@
+#include "bench.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+std::atomic<size_t> g_allocation_count{0};
+std::atomic<size_t> g_allocation_bytes{0};
+} // anonymous namespace
+
+// Counting replacements for the global allocation functions (array and
+// nothrow forms forward to these by default)
+void* operator new(std::size_t size) {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    g_allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace bench {
+
+AllocationStats allocations() {
+    return {g_allocation_count.load(std::memory_order_relaxed),
+            g_allocation_bytes.load(std::memory_order_relaxed)};
+}
+
+void header(const std::string& title) {
+    std::printf("\n== %s ==\n", title.c_str());
+    std::printf("%-52s %12s %14s %12s\n", "case", "allocs/op", "bytes/op", "us/op");
+}
+
+void report(const std::string& name, size_t ops, const AllocationStats& allocs, double elapsed_ns) {
+    double divisor = ops ? static_cast<double>(ops) : 1.0;
+    std::printf("%-52s %12.1f %14.0f %12.2f\n", name.c_str(),
+                static_cast<double>(allocs.count) / divisor,
+                static_cast<double>(allocs.bytes) / divisor,
+                elapsed_ns / divisor / 1000.0);
+}
+
+std::string enterScratchDirectory() {
+    std::string pattern = (std::filesystem::temp_directory_path() / "llm_bench_XXXXXX").string();
+    if (!mkdtemp(pattern.data())) {
+        throw std::runtime_error("Failed to create scratch directory for benchmarks");
+    }
+    std::filesystem::current_path(pattern);
+    return pattern;
+}
+
+std::string loadFixture(const std::string& name) {
+    std::string path = std::string(LLM_BENCH_FIXTURE_DIR) + "/" + name;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open benchmark fixture " + path);
+    }
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+} // namespace bench
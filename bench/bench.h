@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/**
+ * Minimal harness for llm_bench (opt-in: -DLLM_CLI_BUILD_BENCHMARKS=ON)
+ * - Global operator new/delete are replaced in bench.cpp to count allocations
+ * - AllocationScope / Stopwatch measure a region; report() prints one row
+ * - Each benchmark lives in its own file and is listed in bench_main.cpp
+ * - Inputs come from bench/fixtures (loadFixture) or are generated with a
+ *   fixed seed, so runs are offline and reproducible
+ */
+namespace bench {
+
+struct AllocationStats {
+    size_t count = 0; // operator new calls
+    size_t bytes = 0; // bytes requested
+};
+
+// Totals since process start
+AllocationStats allocations();
+
+// Allocations made between construction and delta()
+class AllocationScope {
+public:
+    AllocationScope() : start_(allocations()) {}
+    AllocationStats delta() const {
+        AllocationStats now = allocations();
+        return {now.count - start_.count, now.bytes - start_.bytes};
+    }
+
+private:
+    AllocationStats start_;
+};
+
+class Stopwatch {
+public:
+    Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+    double elapsedNs() const {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Print a section header and the column titles
+void header(const std::string& title);
+
+// Print one result row, normalized per operation
+void report(const std::string& name, size_t ops, const AllocationStats& allocs, double elapsed_ns);
+
+// Create a scratch directory and make it the working directory, so benchmarks
+// that open llm_chat_history.db never touch the user's real history
+std::string enterScratchDirectory();
+
+// Contents of bench/fixtures/<name>; throws if it cannot be read
+std::string loadFixture(const std::string& name);
+
+// --- Benchmarks ---
+void message_pipeline();
+void sse_stream();
+void api_payload();
+void html_parsing();
+void database_queries();
+void embedding_search();
+
+} // namespace bench
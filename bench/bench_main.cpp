@@ -0,0 +1,37 @@
+#include "bench.h"
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+// llm_bench [name...] - runs the named benchmarks (default: all)
+int main(int argc, char** argv) {
+    struct Entry {
+        const char* name;
+        void (*run)();
+    };
+    static const Entry kBenchmarks[] = {
+        {"message_pipeline", bench::message_pipeline},
+        {"sse_stream", bench::sse_stream},
+        {"api_payload", bench::api_payload},
+        {"html_parsing", bench::html_parsing},
+        {"database_queries", bench::database_queries},
+        {"embedding_search", bench::embedding_search},
+    };
+
+    try {
+        std::string scratch = bench::enterScratchDirectory();
+        std::printf("llm_bench scratch directory: %s\n", scratch.c_str());
+
+        for (const Entry& entry : kBenchmarks) {
+            bool selected = argc < 2;
+            for (int i = 1; i < argc; ++i) {
+                if (std::strcmp(argv[i], entry.name) == 0) selected = true;
+            }
+            if (selected) entry.run();
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "llm_bench failed: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "bench.h"
+#include "database.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// SQLite paths on a synthetic large database: loading the context window
+// from a long history, and syncing a catalog-sized model list (first import,
+// unchanged re-sync, and a sync where a few models changed).
+
+namespace {
+
+constexpr size_t kHistoryMessages = 20000;
+constexpr size_t kModels = 2000;
+
+void seedHistory(PersistenceManager& db) {
+    db.beginTransaction();
+    for (size_t i = 0; i < kHistoryMessages; ++i) {
+        if (i % 2 == 0) {
+            db.saveUserMessage(std::string(150, 'u'));
+        } else {
+            db.saveAssistantMessage(std::string(900, 'a'), "bench/model");
+        }
+    }
+    db.commitTransaction();
+}
+
+std::vector<ModelData> buildCatalog(size_t changed_every) {
+    std::vector<ModelData> models;
+    models.reserve(kModels);
+    for (size_t i = 0; i < kModels; ++i) {
+        ModelData model("provider" + std::to_string(i % 40) + "/model-" + std::to_string(i),
+                        "Provider " + std::to_string(i % 40) + ": Model " + std::to_string(i));
+        model.description = std::string(400, 'd');
+        model.context_length = 8192 << (i % 6);
+        model.pricing_prompt = "0.000001";
+        model.pricing_completion = "0.000002";
+        if (changed_every && i % changed_every == 0) {
+            model.pricing_completion = "0.000003";
+        }
+        model.architecture_input_modalities = R"(["text","image"])";
+        model.architecture_output_modalities = R"(["text"])";
+        model.architecture_tokenizer = "GPT";
+        model.per_request_limits = "{}";
+        model.supported_parameters = R"(["tools","temperature","top_p","max_tokens"])";
+        model.created_at_api = 1700000000 + static_cast<long long>(i);
+        models.push_back(std::move(model));
+    }
+    return models;
+}
+
+} // anonymous namespace
+
+namespace bench {
+
+void database_queries() {
+    PersistenceManager db;
+    seedHistory(db);
+    header("database (" + std::to_string(kHistoryMessages) + " messages, " + std::to_string(kModels) + " models)");
+
+    for (size_t pairs : {10, 50}) {
+        size_t runs = 500;
+        size_t loaded = 0;
+        AllocationScope allocs;
+        Stopwatch timer;
+        for (size_t run = 0; run < runs; ++run) {
+            loaded = db.getContextHistory(pairs).size();
+        }
+        report("getContextHistory(" + std::to_string(pairs) + ")", runs, allocs.delta(), timer.elapsedNs());
+        if (loaded == 0) {
+            throw std::runtime_error("getContextHistory returned no messages");
+        }
+    }
+
+    // Each case runs once; the catalog table state carries over between them
+    struct SyncCase {
+        const char* name;
+        size_t changed_every;
+    };
+    for (const SyncCase& sync_case : {SyncCase{"replaceModels, first import", 0},
+                                      SyncCase{"replaceModels, unchanged catalog", 0},
+                                      SyncCase{"replaceModels, 5% of models changed", 20}}) {
+        std::vector<ModelData> models = buildCatalog(sync_case.changed_every);
+        AllocationScope allocs;
+        Stopwatch timer;
+        ModelSyncResult result = db.replaceModelsInDB(models);
+        report(std::string(sync_case.name) + " (" + std::to_string(result.changed()) + " rows written)",
+               1, allocs.delta(), timer.elapsedNs());
+    }
+}
+
+} // namespace bench
@@ -0,0 +1,99 @@
+#include "bench.h"
+#include "embedding_index.h"
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Semantic recall over a history-sized embedding index: quantizing a query,
+// the exhaustive int8 scan (all sessions and one session) and the HNSW graph
+// search over the same vectors. Vectors are clustered so the graph is tested
+// on data with neighbourhoods, as real embeddings have.
+
+namespace {
+
+constexpr size_t kVectors = 30000;
+constexpr size_t kDimensions = 1536;
+constexpr size_t kClusters = 64;
+constexpr size_t kSessions = 4;
+
+struct Corpus {
+    std::vector<std::vector<float>> centers;
+    std::mt19937 rng{42};
+    std::normal_distribution<float> noise{0.0f, 1.0f};
+
+    Corpus() : centers(kClusters, std::vector<float>(kDimensions)) {
+        for (auto& center : centers) {
+            for (float& value : center) value = noise(rng);
+        }
+    }
+
+    std::vector<float> sample(size_t cluster) {
+        std::vector<float> vector(kDimensions);
+        for (size_t i = 0; i < kDimensions; ++i) {
+            vector[i] = centers[cluster % kClusters][i] + 0.8f * noise(rng);
+        }
+        return vector;
+    }
+};
+
+} // anonymous namespace
+
+namespace bench {
+
+void embedding_search() {
+    Corpus corpus;
+    EmbeddingIndex scan_index(kVectors + 1);  // Never builds the graph
+    EmbeddingIndex graph_index(1);
+    for (size_t i = 0; i < kVectors; ++i) {
+        EmbeddingIndex::Quantized vector = EmbeddingIndex::quantize(corpus.sample(i));
+        int session = static_cast<int>((i / kClusters) % kSessions) + 1; // Every cluster spans all sessions
+        scan_index.add(static_cast<int>(i) + 1, session, vector);
+        graph_index.add(static_cast<int>(i) + 1, session, vector);
+    }
+    if (!graph_index.usesGraph()) {
+        throw std::runtime_error("HNSW graph was not built");
+    }
+    header("embedding search (" + std::to_string(kVectors) + " x " + std::to_string(kDimensions) +
+           ", kernel " + EmbeddingIndex::kernelName() + ")");
+
+    std::vector<std::vector<float>> queries;
+    for (size_t i = 0; i < 64; ++i) queries.push_back(corpus.sample(i * 7));
+
+    {
+        size_t runs = 2000;
+        AllocationScope allocs;
+        Stopwatch timer;
+        for (size_t run = 0; run < runs; ++run) {
+            EmbeddingIndex::quantize(queries[run % queries.size()]);
+        }
+        report("quantize", runs, allocs.delta(), timer.elapsedNs());
+    }
+
+    std::vector<EmbeddingIndex::Quantized> quantized;
+    for (const auto& query : queries) quantized.push_back(EmbeddingIndex::quantize(query));
+
+    struct SearchCase {
+        const char* name;
+        const EmbeddingIndex& index;
+        int session_id;
+    };
+    for (const SearchCase& search_case : {SearchCase{"scan top-5, all sessions", scan_index, 0},
+                                          SearchCase{"scan top-5, one session", scan_index, 2},
+                                          SearchCase{"hnsw top-5, all sessions", graph_index, 0},
+                                          SearchCase{"hnsw top-5, one session", graph_index, 2}}) {
+        size_t runs = 200;
+        size_t hits = 0;
+        AllocationScope allocs;
+        Stopwatch timer;
+        for (size_t run = 0; run < runs; ++run) {
+            hits += search_case.index.search(quantized[run % quantized.size()], 5, search_case.session_id).size();
+        }
+        report(search_case.name, runs, allocs.delta(), timer.elapsedNs());
+        if (hits == 0) {
+            throw std::runtime_error(std::string(search_case.name) + " returned no hits");
+        }
+    }
+}
+
+} // namespace bench
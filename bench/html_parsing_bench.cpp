@@ -0,0 +1,62 @@
+#include "bench.h"
+#include "tools_impl/search_web_tool.h"
+#include "tools_impl/visit_url_tool.h"
+#include <stdexcept>
+#include <string>
+
+// HTML parsing on saved pages: Brave and DuckDuckGo result pages
+// (search_web's single-pass scan against the Gumbo DOM walks it falls back
+// to) and an article page (visit_url's text extraction).
+
+namespace {
+
+constexpr size_t kRuns = 200;
+
+template <typename Parse>
+void parseFixture(const std::string& fixture, const std::string& name, Parse parse) {
+    const std::string html = bench::loadFixture(fixture);
+    size_t output_bytes = 0;
+    bench::AllocationScope allocs;
+    bench::Stopwatch timer;
+    for (size_t run = 0; run < kRuns; ++run) {
+        output_bytes = parse(html).size();
+    }
+    bench::report(name + " (" + std::to_string(html.size() / 1024) + " KB)", kRuns, allocs.delta(), timer.elapsedNs());
+    if (output_bytes == 0) {
+        throw std::runtime_error("Fixture produced no output: " + fixture);
+    }
+}
+
+// The fast path must give exactly what the DOM walk gives on the fixture
+void checkSameOutput(const std::string& fixture, std::string (*scan)(const std::string&),
+                     std::string (*dom)(const std::string&)) {
+    const std::string html = bench::loadFixture(fixture);
+    if (scan(html) != dom(html)) {
+        throw std::runtime_error("Single-pass and DOM parsers disagree on " + fixture);
+    }
+}
+
+} // anonymous namespace
+
+namespace bench {
+
+void html_parsing() {
+    header("HTML parsing (per page)");
+    checkSameOutput("brave_search.html", parse_brave_search_html, parse_brave_search_html_dom);
+    checkSameOutput("ddg_search.html", parse_ddg_html, parse_ddg_html_dom);
+    parseFixture("brave_search.html", "parse_brave_search_html", [](const std::string& html) {
+        std::string results = parse_brave_search_html(html);
+        if (results.rfind("No results", 0) == 0) throw std::runtime_error("Brave fixture yielded no results");
+        return results;
+    });
+    parseFixture("brave_search.html", "parse_brave_search_html_dom", parse_brave_search_html_dom);
+    parseFixture("ddg_search.html", "parse_ddg_html", [](const std::string& html) {
+        std::string results = parse_ddg_html(html);
+        if (results.rfind("No results", 0) == 0) throw std::runtime_error("DuckDuckGo fixture yielded no results");
+        return results;
+    });
+    parseFixture("ddg_search.html", "parse_ddg_html_dom", parse_ddg_html_dom);
+    parseFixture("article.html", "extract_html_text (visit_url)", extract_html_text);
+}
+
+} // namespace bench
@@ -0,0 +1,103 @@
+#include "bench.h"
+#include "context_window.h"
+#include "database.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+// Per-turn allocations of the Message pipeline: loading the context from
+// SQLite every turn (the old path) against the in-memory ContextWindow, and
+// copying a context with owned std::string content against SharedText.
+
+namespace {
+
+constexpr size_t kTurns = 200;
+constexpr size_t kContextPairs = 10;
+
+// Message layout before content became SharedText
+struct OwnedMessage {
+    std::string role;
+    std::string content;
+    int id = 0;
+    std::string timestamp;
+    std::optional<std::string> model_id;
+};
+
+Message toolResult(size_t i, size_t size) {
+    Message result{"tool", std::string(size, 'r')};
+    result.tool_call_id = "call_" + std::to_string(i);
+    result.tool_name = "web_research";
+    return result;
+}
+
+// A realistic mix: short user turn, medium reply, large tool result
+void seedHistory(PersistenceManager& db, size_t messages) {
+    for (size_t i = 0; i < messages; ++i) {
+        switch (i % 3) {
+            case 0: db.saveUserMessage(std::string(200, 'u')); break;
+            case 1: db.saveAssistantMessage(std::string(2000, 'a'), "bench/model"); break;
+            default: db.saveToolMessage(toolResult(i, 8000)); break;
+        }
+    }
+}
+
+} // anonymous namespace
+
+namespace bench {
+
+void message_pipeline() {
+    PersistenceManager db;
+    seedHistory(db, 3 * kContextPairs * 2);
+    header("message pipeline (per turn, " + std::to_string(kContextPairs * 2) + "-message context)");
+
+    // Old path: re-query SQLite, then copy the context for the request
+    {
+        AllocationScope allocs;
+        Stopwatch timer;
+        for (size_t turn = 0; turn < kTurns; ++turn) {
+            std::vector<Message> context = db.getContextHistory(kContextPairs);
+            std::vector<Message> request_context = context;
+        }
+        report("reload context from SQLite + copy", kTurns, allocs.delta(), timer.elapsedNs());
+    }
+
+    // New path: append the saved message to the window and read it in place
+    {
+        ContextWindow window(kContextPairs);
+        window.seed(db.getContextHistory(kContextPairs));
+        // Retries copy the window (e.g. to add a no-tools instruction)
+        AllocationScope copy_allocs;
+        Stopwatch copy_timer;
+        for (size_t turn = 0; turn < kTurns; ++turn) {
+            std::vector<Message> retry_context = window.messages();
+        }
+        report("copy context (SharedText content)", kTurns, copy_allocs.delta(), copy_timer.elapsedNs());
+
+        std::vector<OwnedMessage> owned;
+        for (const Message& msg : window.messages()) {
+            std::optional<std::string> model_id;
+            if (msg.model_id) model_id = msg.model_id->str();
+            owned.push_back({msg.role, msg.content.str(), msg.id, msg.timestamp.str(), model_id});
+        }
+        AllocationScope owned_allocs;
+        Stopwatch owned_timer;
+        for (size_t turn = 0; turn < kTurns; ++turn) {
+            std::vector<OwnedMessage> retry_context = owned;
+        }
+        report("copy context (owned std::string content)", kTurns, owned_allocs.delta(), owned_timer.elapsedNs());
+
+        const std::string input(200, 'u');
+
+        AllocationScope allocs;
+        Stopwatch timer;
+        for (size_t turn = 0; turn < kTurns; ++turn) {
+            SharedText text(input);
+            window.append({"user", text, static_cast<int>(100000 + turn)});
+            const std::vector<Message>& context = window.messages();
+            (void)context;
+        }
+        report("in-memory window append + view", kTurns, allocs.delta(), timer.elapsedNs());
+    }
+}
+
+} // namespace bench
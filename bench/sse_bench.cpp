@@ -0,0 +1,82 @@
+#include "bench.h"
+#include "api_client.h"
+#include "sse_parser.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+// SseStreamParser (what StreamingWriteCallback feeds) on recorded OpenRouter
+// transcripts: a plain content reply and three parallel tool calls whose
+// arguments arrive in small fragments. libcurl hands over up to 16 KB per
+// write; 256-byte writes model a slow, trickling connection.
+
+namespace {
+
+constexpr size_t kRuns = 200;
+
+ApiClient::StreamingResponse parseTranscript(const std::string& transcript, size_t chunk_size,
+                                              size_t runs, const std::string& name) {
+    ApiClient::StreamingResponse response;
+    size_t streamed_bytes = 0;
+    SseStreamParser::ChunkCallback callback = [&streamed_bytes](const std::string& chunk) {
+        streamed_bytes += chunk.size();
+    };
+    SseStreamParser parser(response, &callback);
+
+    bench::AllocationScope allocs;
+    bench::Stopwatch timer;
+    for (size_t run = 0; run < runs; ++run) {
+        response = ApiClient::StreamingResponse();
+        parser.reset(response);
+        for (size_t offset = 0; offset < transcript.size(); offset += chunk_size) {
+            size_t size = std::min(chunk_size, transcript.size() - offset);
+            if (!parser.feed(transcript.data() + offset, size)) {
+                throw std::runtime_error("SSE parser aborted on fixture transcript");
+            }
+        }
+    }
+    bench::report(name, runs, allocs.delta(), timer.elapsedNs());
+
+    if (response.finish_reason.empty()) {
+        throw std::runtime_error("Fixture transcript did not finish: " + name);
+    }
+    return response;
+}
+
+} // anonymous namespace
+
+namespace bench {
+
+void sse_stream() {
+    const std::string content = loadFixture("sse_content.txt");
+    const std::string tool_calls = loadFixture("sse_tool_calls.txt");
+    header("SSE stream parsing (per transcript, " + std::to_string(content.size() / 1024) + " KB content / " +
+           std::to_string(tool_calls.size() / 1024) + " KB tool_calls)");
+
+    parseTranscript(content, 16384, kRuns, "content transcript, 16 KB writes");
+    parseTranscript(content, 256, kRuns, "content transcript, 256 B writes");
+    parseTranscript(tool_calls, 16384, kRuns, "tool_calls transcript, 16 KB writes");
+    ApiClient::StreamingResponse response = parseTranscript(tool_calls, 256, kRuns, "tool_calls transcript, 256 B writes");
+
+    // What ToolExecutor does with the result: build the tool_calls array and
+    // parse each call's arguments
+    size_t parsed = 0;
+    AllocationScope allocs;
+    Stopwatch timer;
+    for (size_t run = 0; run < kRuns; ++run) {
+        response.tool_calls_dirty = true;
+        response.materializeToolCalls();
+        for (const auto& tool_call : response.accumulated_tool_calls) {
+            auto args = nlohmann::json::parse(tool_call["function"]["arguments"].get<std::string>());
+            parsed += args.size();
+        }
+    }
+    report("materialize tool_calls + parse arguments", kRuns, allocs.delta(), timer.elapsedNs());
+    if (parsed == 0) {
+        throw std::runtime_error("Fixture tool_calls had no arguments");
+    }
+}
+
+} // namespace bench
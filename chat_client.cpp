@@ -1,40 +1,91 @@
 #include "chat_client.h"
 #include "config.h"
+#include "context_budget.h"
+#include "trace.h"
 #include <iostream>
 #include <nlohmann/json.hpp>
 #include <stdexcept>
 
+// Messages kept in memory as candidates for the request context; how many are
+// actually sent is decided by the active model's token budget (ApiClient)
+constexpr size_t kContextWindowPairs = 100;
+
 // Constructor
 ChatClient::ChatClient(UserInterface& ui_ref, PersistenceManager& db_ref)
-    : db(db_ref), toolManager(), ui(ui_ref), active_model_id(DEFAULT_MODEL_ID) {
+    : db(db_ref), toolManager(), ui(ui_ref), active_model_id(DEFAULT_MODEL_ID),
+      contextWindow(kContextWindowPairs) {
     // Initialize modular components after active_model_id is set
-    modelManager = std::make_unique<ModelManager>(ui, db);
     apiClient = std::make_unique<ApiClient>(ui, active_model_id);
-    toolExecutor = std::make_unique<ToolExecutor>(ui, db, toolManager, *apiClient, *this, active_model_id);
-    commandHandler = std::make_unique<CommandHandler>(ui, db, *modelManager);
+    if (std::optional<int64_t> ttl = CompletionCache::ttlFromEnvironment()) {
+        completionCache = std::make_unique<CompletionCache>(db, *ttl);
+        apiClient->setCompletionCache(completionCache.get());
+    }
+    modelManager = std::make_unique<ModelManager>(ui, db, apiClient->connectionPool());
+    toolExecutor = std::make_unique<ToolExecutor>(ui, db, toolManager, *apiClient, *this, contextWindow, active_model_id);
+    commandHandler = std::make_unique<CommandHandler>(ui, db, *modelManager, contextWindow, completionCache.get());
+    EmbeddingService::Options memory_options = EmbeddingService::Options::fromEnvironment();
+    if (memory_options.enabled()) {
+        embeddingService = std::make_unique<EmbeddingService>(ui, std::move(memory_options));
+    }
 }
 
 // Destructor
-ChatClient::~ChatClient() = default;
+ChatClient::~ChatClient() {
+    awaitSession();
+}
 
 // Initialization
 void ChatClient::initialize_model_manager() {
     modelManager->initialize();
-    // Sync active_model_id with ModelManager
+    syncActiveModel();
+}
+
+void ChatClient::syncActiveModel() {
     active_model_id = modelManager->getActiveModelId();
+    apiClient->setContextLength(modelManager->getActiveContextLength());
+}
+
+void ChatClient::startSession() {
+    if (sessionStarted) return;
+    sessionStarted = true;
+    // Off the startup path: nothing reads the context before the first turn
+    sessionLoader = std::thread([this]() {
+        TraceSpan span("startup.session_load");
+        try {
+            db.cleanupOrphanedToolMessages();
+            // The only context query of the session - later turns use the in-memory window
+            contextWindow.seed(db.getContextHistory(kContextWindowPairs));
+        } catch (const std::exception& e) {
+            ui.displayError("Failed to load the session history: " + std::string(e.what()));
+        }
+    });
+}
+
+void ChatClient::awaitSession() {
+    if (sessionLoader.joinable()) {
+        sessionLoader.join();
+    }
 }
 
 // Main application loop
-void ChatClient::run() {
-    db.cleanupOrphanedToolMessages();
-    ui.displayStatus("ChatClient ready. Active model: " + this->active_model_id);
+void ChatClient::run(TurnInterrupter* interrupter) {
+    startSession();
+    auto session = db.findSession(std::to_string(db.activeSession()));
+    ui.displayStatus("ChatClient ready. Active model: " + this->active_model_id +
+                     (session ? ", session: " + session->name : ""));
     
     while (true) {
         try {
             auto input_opt = promptUserInput();
             if (!input_opt) break;
             if (input_opt->empty()) continue;
-            processTurn(*input_opt);
+            {
+                std::optional<TurnInterrupter::Turn> turn;
+                if (interrupter) turn.emplace(interrupter->beginTurn());
+                processTurn(*input_opt, turn ? turn->token() : std::stop_token());
+            }
+            // Embed the turn's messages in the background
+            if (embeddingService) embeddingService->notify();
         } catch (const std::exception& e) {
             ui.displayError("Unhandled error in main loop: " + std::string(e.what()));
         } catch (...) {
@@ -46,12 +97,23 @@ void ChatClient::run() {
 // Model management delegation
 void ChatClient::setActiveModel(const std::string& model_id) {
     modelManager->setActiveModel(model_id);
-    active_model_id = modelManager->getActiveModelId();
+    syncActiveModel();
 }
 
 // Public API call method (for tools)
 std::string ChatClient::makeApiCall(const std::vector<Message>& context, bool use_tools) {
-    return apiClient->makeApiCall(context, toolManager, use_tools);
+    return apiClient->makeApiCall(context, toolManager, use_tools, turnStop);
+}
+
+ApiClient::StreamingResponse ChatClient::makeStreamingApiCall(const std::vector<Message>& context,
+                                                             const std::function<void(const std::string&)>& chunk_callback) {
+    // Tool output (research reports) yields to interactive turns and is cacheable
+    return apiClient->makeStreamingApiCall(context, toolManager, false, chunk_callback, {}, turnStop,
+                                           RequestScheduler::Priority::Background);
+}
+
+size_t ChatClient::requestTokenBudget() const {
+    return context_token_budget(apiClient->contextLength());
 }
 
 // Private helper methods
@@ -59,8 +121,68 @@ std::optional<std::string> ChatClient::promptUserInput() {
     return ui.promptUserInput();
 }
 
+// The text is copied once into a SharedText that the database queue and the
+// context window both hold
 void ChatClient::saveUserInput(const std::string& input) {
-    db.saveUserMessage(input);
+    SharedText text(input);
+    contextWindow.append({"user", text, db.saveUserMessage(text)});
+}
+
+void ChatClient::saveAssistantMessage(SharedText content, const std::string& model_id) {
+    const std::string& model = model_id.empty() ? this->active_model_id : model_id;
+    Message msg{"assistant", content, db.saveAssistantMessage(content, model)};
+    if (!model.empty()) msg.model_id = model;
+    contextWindow.append(std::move(msg));
+}
+
+std::optional<Message> ChatClient::recallRelatedMessages(const std::string& input) {
+    if (!embeddingService || embeddingService->options().recall == 0 || recallFailed) {
+        return std::nullopt;
+    }
+    const std::vector<Message>& window = contextWindow.messages();
+    int oldest_in_window = 0;
+    for (const auto& msg : window) {
+        if (msg.id > 0 && msg.role != "system") {
+            oldest_in_window = msg.id;
+            break;
+        }
+    }
+
+    // Only messages older than the window: the recent ones are already sent.
+    // The input's vector is kept as the embedding of the saved user message.
+    EmbeddingService::Query query;
+    query.text = input;
+    query.limit = embeddingService->options().recall;
+    query.session_id = db.activeSession();
+    query.before_message_id = oldest_in_window;
+    query.message_id = window.back().id;
+    query.stop = turnStop;
+    query.timeout = embeddingService->options().recall_timeout;
+    std::vector<int> ids;
+    try {
+        for (const auto& hit : embeddingService->search(query)) {
+            if (hit.score >= embeddingService->options().recall_min_score) {
+                ids.push_back(hit.message_id);
+            }
+        }
+    } catch (const OperationCancelled&) {
+        return std::nullopt; // The turn's own request sees the stop next
+    } catch (const std::exception& e) {
+        // Recall is best effort: an unreachable endpoint must not delay every turn
+        recallFailed = true;
+        ui.displayStatus("Semantic recall turned off for this session: " + std::string(e.what()));
+        return std::nullopt;
+    }
+    if (ids.empty()) {
+        return std::nullopt;
+    }
+
+    std::string note = "Possibly relevant earlier messages from this conversation "
+                       "(recalled by similarity to the user's latest message; older than the recent context):\n";
+    for (const auto& msg : db.getMessagesById(ids)) {
+        note += "[" + msg.timestamp.str() + "] " + msg.role + ": " + recall_excerpt(msg.content.str()) + "\n";
+    }
+    return Message{"system", std::move(note), 0};
 }
 
 bool ChatClient::handleApiError(const nlohmann::json& api_response,
@@ -103,24 +225,27 @@ bool ChatClient::handleApiError(const nlohmann::json& api_response,
 void ChatClient::printAndSaveAssistantContent(const nlohmann::json& response_message) {
     if (!response_message.is_null() && response_message.contains("content")) {
         if (response_message["content"].is_string()) {
-            std::string txt = response_message["content"];
-            db.saveAssistantMessage(txt, this->active_model_id);
-            ui.displayOutput(txt + "\n\n", this->active_model_id);
+            SharedText txt(response_message["content"].get<std::string>());
+            saveAssistantMessage(txt);
+            ui.displayOutput(txt.str() + "\n\n", this->active_model_id);
         } else if (!response_message["content"].is_null()) {
             std::string dumped = response_message["content"].dump();
-            db.saveAssistantMessage(dumped, this->active_model_id);
+            saveAssistantMessage(dumped);
             ui.displayOutput(dumped + "\n\n", this->active_model_id);
         }
     }
 }
 
-void ChatClient::processTurn(const std::string& input) {
+void ChatClient::processTurn(const std::string& input, std::stop_token stop) {
+    turnStop = stop;
     try {
+        awaitSession(); // Usually long done by the time the first input arrives
+
         // Check for slash commands first
         if (!input.empty() && input[0] == '/') {
             if (commandHandler->handleCommand(input)) {
-                // Sync active_model_id with ModelManager in case a /model command was executed
-                active_model_id = modelManager->getActiveModelId();
+                // Sync with ModelManager in case a /model command was executed
+                syncActiveModel();
                 return;
             }
         }
@@ -128,8 +253,15 @@ void ChatClient::processTurn(const std::string& input) {
         // Save user input
         saveUserInput(input);
 
-        // Load context
-        auto context = db.getContextHistory();
+        // Context is maintained in memory as messages are saved; a recall note
+        // goes into a copy, just before the new user message, and is not saved
+        const std::vector<Message>* context = &contextWindow.messages();
+        std::vector<Message> recall_context;
+        if (std::optional<Message> recall_note = recallRelatedMessages(input)) {
+            recall_context = *context;
+            recall_context.insert(recall_context.end() - 1, std::move(*recall_note));
+            context = &recall_context;
+        }
 
         // Make initial streaming API call with tools enabled
         ui.displayStatus("Waiting for response...");
@@ -149,6 +281,14 @@ void ChatClient::processTurn(const std::string& input) {
             }
         };
 
+        // Tool calls start as soon as their arguments are complete, while the
+        // rest of the response is still streaming
+        EarlyToolCalls early_tool_calls;
+        ApiClient::ToolCallCallback dispatch_tool_call =
+            [this, &early_tool_calls, &stop](const ApiClient::StreamingResponse::ToolCallBuffer& tool_call) {
+                toolExecutor->dispatchEarly(tool_call, early_tool_calls, stop);
+            };
+
         // Use streaming for the response with RAII guard to ensure cleanup
         ApiClient::StreamingResponse streaming_result;
         {
@@ -157,17 +297,28 @@ void ChatClient::processTurn(const std::string& input) {
             StreamingGuard guard(ui, streaming_active);
 
             streaming_result = apiClient->makeStreamingApiCall(
-                context,
+                *context,
                 toolManager,
                 true,  // use_tools = true
                 [this](const std::string& chunk) {
                     // Display each chunk in real-time
                     ui.displayStreamingChunk(chunk);
-                }
+                },
+                dispatch_tool_call,
+                stop
             );
             // Guard destructor will call endStreamingOutput automatically here
         }
 
+        // Ctrl+C: keep the part of the reply that was shown; tool calls are not run
+        if (streaming_result.cancelled) {
+            if (!streaming_result.accumulated_content.empty()) {
+                saveAssistantMessage(streaming_result.accumulated_content + kInterruptedReplyMarker, streaming_result.model);
+            }
+            ui.displayStatus("Interrupted.");
+            return;
+        }
+
         // Check if tool calls were detected during streaming
         if (streaming_result.has_tool_calls) {
             // Tool calls detected - construct response_message from streaming result
@@ -184,15 +335,15 @@ void ChatClient::processTurn(const std::string& input) {
                 response_message["content"] = nullptr;
             }
 
-            // Include the accumulated tool_calls
-            response_message["tool_calls"] = streaming_result.accumulated_tool_calls;
+            // Include the accumulated tool_calls (not needed afterwards - move instead of a deep copy)
+            response_message["tool_calls"] = std::move(streaming_result.accumulated_tool_calls);
 
             // Execute tool calls using the streaming-captured data
-            bool turn_completed_via_standard_tools = toolExecutor->executeStandardToolCalls(response_message, context);
+            bool turn_completed_via_standard_tools = toolExecutor->executeStandardToolCalls(response_message, stop, &early_tool_calls);
 
             // Fallback to content if tools didn't execute
             if (!turn_completed_via_standard_tools && !streaming_result.accumulated_content.empty()) {
-                toolExecutor->executeFallbackFunctionTags(streaming_result.accumulated_content, context);
+                toolExecutor->executeFallbackFunctionTags(streaming_result.accumulated_content, stop);
             }
 
             ui.displayStatus("Ready.");
@@ -201,11 +352,14 @@ void ChatClient::processTurn(const std::string& input) {
 
         // No tool calls, save the streamed content as the assistant response
         if (!streaming_result.accumulated_content.empty()) {
-            db.saveAssistantMessage(streaming_result.accumulated_content, this->active_model_id);
+            saveAssistantMessage(std::move(streaming_result.accumulated_content), streaming_result.model);
         }
 
         ui.displayStatus("Ready.");
 
+    } catch (const OperationCancelled&) {
+        // Everything saved so far is consistent: tool requests have their results
+        ui.displayStatus("Interrupted.");
     } catch (const nlohmann::json::parse_error& e) {
         ui.displayError("Error parsing API response: " + std::string(e.what()));
         ui.displayStatus("Error.");
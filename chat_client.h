@@ -4,13 +4,18 @@
 #include <vector>
 #include <optional>
 #include <memory>
+#include <thread>
 #include "database.h"
+#include "context_window.h"
 #include "tools.h"
 #include "ui_interface.h"
 #include "model_manager.h"
 #include "api_client.h"
 #include "tool_executor.h"
 #include "command_handler.h"
+#include "embedding_service.h"
+#include "completion_cache.h"
+#include "interrupt.h"
 
 // Forward declarations
 class ModelManager;
@@ -24,7 +29,11 @@ class CommandHandler;
  * - Delegates API communication to ApiClient
  * - Delegates tool execution to ToolExecutor
  * - Delegates command handling to CommandHandler
- * - Coordinates the overall conversation loop
+ * - Keeps the conversation context in memory (ContextWindow), seeded once from the DB
+ *   on a background thread while startup continues (the first turn waits for it)
+ * - Optionally recalls similar older messages into each request (EmbeddingService)
+ * - Coordinates the overall conversation loop; a turn stopped with Ctrl+C keeps
+ *   what was streamed and the results of the tools that ran
  */
 class ChatClient {
 private:
@@ -36,16 +45,39 @@ private:
     // Active model state (shared with components)
     std::string active_model_id;
     
+    // Context sent with each request; every saved message is appended to it
+    ContextWindow contextWindow;
+    
+    // Orphaned tool message cleanup and context seeding (startSession())
+    std::thread sessionLoader;
+    bool sessionStarted = false;
+    
+    // Stop token of the turn in progress (tools running on other threads read it)
+    std::stop_token turnStop;
+    
     // Modular components (initialized after active_model_id)
+    std::unique_ptr<CompletionCache> completionCache; // Set when LLM_CLI_COMPLETION_CACHE_HOURS is set
+    std::unique_ptr<ApiClient> apiClient;       // Owns the HTTP connection pool, so it outlives ModelManager
     std::unique_ptr<ModelManager> modelManager;
-    std::unique_ptr<ApiClient> apiClient;
     std::unique_ptr<ToolExecutor> toolExecutor;
     std::unique_ptr<CommandHandler> commandHandler;
+    std::unique_ptr<EmbeddingService> embeddingService; // Set when semantic memory is enabled
     
     // Private helper methods
     std::optional<std::string> promptUserInput();
-    void processTurn(const std::string& user_input);
+    void processTurn(const std::string& user_input, std::stop_token stop);
     void saveUserInput(const std::string& input);
+    void saveAssistantMessage(SharedText content, const std::string& model_id = {});
+    
+    // Semantic recall: a system note with older messages similar to the input
+    // just saved (nullopt when recall is off or nothing is similar enough).
+    // The query embedding is bounded by the recall timeout and the turn's stop
+    // token; after a failure recall is off for the rest of the session.
+    std::optional<Message> recallRelatedMessages(const std::string& input);
+    bool recallFailed = false;
+    
+    // Pick up the active model (id and context length) from ModelManager
+    void syncActiveModel();
     
     // Handle API errors and extract response or fallback content
     bool handleApiError(const nlohmann::json& api_response,
@@ -63,12 +95,35 @@ public:
     // Initialization - must be called before run()
     void initialize_model_manager();
     
-    // Main application loop
-    void run();
+    // Clean up the active session and seed the context window from it in the
+    // background; run() calls it if it has not been called yet
+    void startSession();
+    
+    // Block until startSession()'s background work is done
+    void awaitSession();
+    
+    // Main application loop; with an interrupter, Ctrl+C cancels the running turn
+    void run(TurnInterrupter* interrupter = nullptr);
     
     // Model management delegation
     void setActiveModel(const std::string& model_id);
 
-    // Public API call method (for tools)
+    // Semantic memory for the recall_history tool (nullptr when disabled)
+    EmbeddingService* semanticMemory() { return embeddingService.get(); }
+
+    // Public API call method (for tools); cancelled together with the turn
+    // (throws OperationCancelled)
     std::string makeApiCall(const std::vector<Message>& context, bool use_tools = true);
+
+    // Streaming, tool-less counterpart for tools that show their output as it
+    // is written; a stop ends it early with `cancelled` set. Runs at background
+    // priority and through the completion cache, like makeApiCall()
+    ApiClient::StreamingResponse makeStreamingApiCall(const std::vector<Message>& context,
+                                                      const std::function<void(const std::string&)>& chunk_callback);
+
+    // Stop token of the current turn, for tools to pass to their transfers
+    const std::stop_token& stopToken() const { return turnStop; }
+
+    // Tokens a request's messages may take with the active model (see context_token_budget())
+    size_t requestTokenBudget() const;
 };
@@ -2,31 +2,114 @@
 #include <iostream>                                                                                                                                                      
 #include <readline/readline.h>                                                                                                                                           
 #include <readline/history.h>                                                                                                                                            
-#include <cstdlib> // For free()                                                                                                                                         
+#include <cstdlib> // For free()
+#include <cstring> // For strdup()
+#include <string_view>
+
+// Instance used by the readline completion hook (there is one CLI per process)
+static CliInterface* completion_instance = nullptr;                                                                                                                                         
                                                                                                                                                                          
 // Performs any necessary initialization for the CLI.
-// (Currently no specific initialization steps are required).
+// Installs tab completion for slash commands and model ids.
 void CliInterface::initialize() {
     // Readline library initializes itself implicitly on first use.
     // History loading could be added here if desired.
+    completion_instance = this;
+    rl_attempted_completion_function = &CliInterface::completeInput;
 }
 
 // Performs any necessary cleanup for the CLI.
-// (Currently no specific shutdown steps are required).
+// Removes the completion hook installed by initialize().
 void CliInterface::shutdown() {
     // History saving could be added here if desired.
+    renderer_.flush();
+    rl_attempted_completion_function = nullptr;
+    completion_instance = nullptr;
+}
+
+std::shared_ptr<const ModelIndex> CliInterface::completionIndex() {
+    std::lock_guard<std::mutex> lock(completion_mutex_);
+    return completion_index_;
+}
+
+// Completes command names ("/mo" -> "/model"/"/models") and "/model <prefix>" -> model ids.
+// Ids that start with the typed text are offered first; if none do, fuzzy
+// matches are offered without replacing the typed text.
+char** CliInterface::completeInput(const char* text, int start, int end) {
+    (void)end;
+    rl_attempted_completion_over = 1; // Never fall back to filename completion
+
+    std::vector<std::string> candidates;
+    bool replace_with_common_prefix = true;
+    std::string_view typed(text);
+    std::string_view before(rl_line_buffer, static_cast<size_t>(start));
+
+    if (start == 0 && !typed.empty() && typed.front() == '/') {
+        for (const char* command : {"/model", "/models", "/stats", "/session"}) {
+            if (std::string_view(command).substr(0, typed.size()) == typed) {
+                candidates.emplace_back(command);
+            }
+        }
+    } else if (completion_instance && before.substr(0, 7) == "/model " &&
+               before.find_first_not_of(' ', 7) == std::string_view::npos) {
+        auto index = completion_instance->completionIndex();
+        if (!index) return nullptr;
+        for (const ModelIndex::Entry* entry : index->prefixMatches(typed, 200)) {
+            candidates.emplace_back(entry->id);
+        }
+        if (candidates.empty() && !typed.empty()) {
+            for (const ModelIndex::Entry* entry : index->fuzzyMatches(typed, 20)) {
+                candidates.emplace_back(entry->id);
+            }
+            replace_with_common_prefix = false;
+        }
+    }
+    if (candidates.empty()) {
+        return nullptr;
+    }
+
+    // readline's format: [0] replaces the typed word, then the matches, then NULL
+    std::string replacement;
+    if (candidates.size() == 1) {
+        replacement = candidates.front();
+    } else if (!replace_with_common_prefix) {
+        replacement = text;
+    } else {
+        replacement = candidates.front();
+        for (const auto& candidate : candidates) {
+            size_t common = 0;
+            while (common < replacement.size() && common < candidate.size() && replacement[common] == candidate[common]) {
+                ++common;
+            }
+            replacement.resize(common);
+        }
+    }
+    char** matches = static_cast<char**>(malloc((candidates.size() + 2) * sizeof(char*)));
+    matches[0] = strdup(replacement.c_str());
+    size_t count = 1;
+    if (candidates.size() > 1) {
+        for (const auto& candidate : candidates) {
+            matches[count++] = strdup(candidate.c_str());
+        }
+    }
+    matches[count] = nullptr;
+    return matches;
 }
 
 // Prompts the user for input using the readline library.
 // Readline provides line editing, history (up/down arrows), and completion capabilities.
 // Handles Ctrl+D (returns nullopt) and adds valid input to history.
 std::optional<std::string> CliInterface::promptUserInput() {
+    // Everything rendered so far must be out before readline draws the prompt
+    renderer_.flush();
+
     // Display the prompt "> " and read a line of input.
     char* input_cstr = readline("> ");
 
     // Check if readline returned nullptr (indicates EOF, typically Ctrl+D).
     if (!input_cstr) {
-        std::cout << std::endl; // Print a newline after Ctrl+D for cleaner terminal output
+        renderer_.write("\n"); // Print a newline after Ctrl+D for cleaner terminal output
+        renderer_.flush();
         return std::nullopt; // Signal to the caller to exit.
     }                                                                                                                                                                    
     std::string input(input_cstr);                                                                                                                                       
@@ -44,17 +127,18 @@ std::optional<std::string> CliInterface::promptUserInput() {
 void CliInterface::displayOutput(const std::string& output, const std::string& model_id) {
     // model_id is not currently used in CLI display but is part of the interface
     (void)model_id; // Mark as unused to prevent compiler warnings
-    std::cout << output;
-    // Add newline if output doesn't already end with one
+    // Add newline if output doesn't already end with one (which also gets it written at once)
     if (output.empty() || output.back() != '\n') {
-        std::cout << '\n';
+        renderer_.write(output + '\n');
+    } else {
+        renderer_.write(output);
     }
-    std::cout.flush(); // Ensure output is displayed immediately
 }
                                                                                                                                                                          
 // Displays error messages to the console (stderr).                                                                                                                      
 // Prefixes with "Error: " and ensures output ends with a newline.                                                                                                       
-void CliInterface::displayError(const std::string& error) {                                                                                                              
+void CliInterface::displayError(const std::string& error) {
+    renderer_.flush(); // Keep the error after the stdout text that preceded it                                                                                                              
     std::cerr << "Error: " << error; // Add "Error: " prefix                                                                                                             
     // Add newline if error doesn't already end with one                                                                                                                 
     if (error.empty() || error.back() != '\n') {                                                                                                                         
@@ -64,13 +148,13 @@ void CliInterface::displayError(const std::string& error) {
 }                                          
  // Displays status messages to the console (stdout).                                                                                                                     
 // Prefixes with "[Status]" for clarity and ensures a newline.                                                                                                           
-void CliInterface::displayStatus(const std::string& status) {                                                                                                            
-    std::cout << "[Status] " << status;                                                                                                                                  
-    // Add newline if status doesn't already end with one                                                                                                                
-    if (status.empty() || status.back() != '\n') {                                                                                                                       
-        std::cout << '\n';                                                                                                                                               
-    }                                                                                                                                                                    
-    std::cout.flush(); // Ensure status is displayed immediately                                                                                                         
+void CliInterface::displayStatus(const std::string& status) {
+    std::string line = "[Status] " + status;
+    // Add newline if status doesn't already end with one
+    if (status.empty() || status.back() != '\n') {
+        line += '\n';
+    }
+    renderer_.write(line); // Written at once, as it ends with a newline
 }       
 
 // Implementation for isGuiMode - CLI is never GUI mode.
@@ -99,6 +183,10 @@ void CliInterface::updateModelsList(const std::vector<ModelData>& models) {
     }
     // Actual model selection in CLI is not dynamically updated via this method.
     // It's assumed to be handled by ChatClient's active_model_id or future commands.
+    // The ids are kept for tab completion of /model.
+    auto index = std::make_shared<const ModelIndex>(models);
+    std::lock_guard<std::mutex> lock(completion_mutex_);
+    completion_index_ = std::move(index);
 }
 // --- End Implementation for Model Loading UI Feedback ---
 
@@ -109,12 +197,81 @@ void CliInterface::startStreamingOutput(const std::string& model_id) {
 }
 
 void CliInterface::displayStreamingChunk(const std::string& chunk) {
-    // Display chunk immediately without newline, flush to ensure real-time display
-    std::cout << chunk << std::flush;
+    // Coalesced with the other chunks of the frame and styled as markdown on a terminal
+    renderer_.writeMarkdown(chunk);
 }
 
 void CliInterface::endStreamingOutput() {
     // Add two newlines after streaming completes for consistent spacing with non-streaming output
-    std::cout << "\n\n" << std::flush;
+    renderer_.endMarkdown();
+    renderer_.write("\n\n");
 }
 // --- End Implementation for Streaming Support ---
+
+// --- Implementation for Tool Progress ---
+void CliInterface::displayPartialResult(const std::string& title, const std::string& content) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    std::string text = "\n[" + title + "]\n" + content;
+    if (content.empty() || content.back() != '\n') {
+        text += '\n';
+    }
+    renderer_.write(text + '\n');
+}
+
+void CliInterface::startToolOutput(const std::string& title) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    std::string header = "\n[" + title + "]\n";
+    if (live_tool_output_) {
+        buffered_tool_output_.push_back({std::this_thread::get_id(), {header, false}});
+        return;
+    }
+    live_tool_output_ = std::this_thread::get_id();
+    renderer_.write(header);
+}
+
+void CliInterface::displayToolOutputChunk(const std::string& chunk) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if (live_tool_output_ == std::this_thread::get_id()) {
+        renderer_.write(chunk);
+        return;
+    }
+    for (auto& [owner, buffered] : buffered_tool_output_) {
+        if (owner == std::this_thread::get_id() && !buffered.finished) {
+            buffered.text += chunk;
+            return;
+        }
+    }
+}
+
+void CliInterface::endToolOutput() {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if (live_tool_output_ != std::this_thread::get_id()) {
+        for (auto& [owner, buffered] : buffered_tool_output_) {
+            if (owner == std::this_thread::get_id() && !buffered.finished) {
+                buffered.finished = true;
+                break;
+            }
+        }
+        return;
+    }
+    std::string text = "\n\n";
+    live_tool_output_.reset();
+
+    // Streams that finished while waiting are shown whole; the oldest one
+    // still running then goes live
+    for (auto it = buffered_tool_output_.begin(); it != buffered_tool_output_.end();) {
+        if (it->second.finished) {
+            text += it->second.text + "\n\n";
+            it = buffered_tool_output_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (!buffered_tool_output_.empty()) {
+        live_tool_output_ = buffered_tool_output_.front().first;
+        text += buffered_tool_output_.front().second.text;
+        buffered_tool_output_.erase(buffered_tool_output_.begin());
+    }
+    renderer_.write(text);
+}
+// --- End Implementation for Tool Progress ---
@@ -5,6 +5,12 @@
 #include <optional>
 #include <vector> // Required for ModelData
 #include "model_types.h" // Required for ModelData
+#include "model_index.h" // Model ids for tab completion
+#include "terminal_renderer.h" // Buffered stdout
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h> // STDOUT_FILENO
 
 // Concrete implementation of UserInterface for a command-line environment.
 class CliInterface : public UserInterface {
@@ -31,4 +37,36 @@ public:
     virtual void displayStreamingChunk(const std::string& chunk) override;
     virtual void endStreamingOutput() override;
     // --- End Implementation for Streaming Support ---
+
+    // --- Implementation for Tool Progress ---
+    virtual void displayPartialResult(const std::string& title, const std::string& content) override;
+    virtual void startToolOutput(const std::string& title) override;
+    virtual void displayToolOutputChunk(const std::string& chunk) override;
+    virtual void endToolOutput() override;
+    // --- End Implementation for Tool Progress ---
+
+private:
+    // Partial results and tool output arrive from tool threads. One tool
+    // stream is shown live at a time; streams started meanwhile are buffered
+    // (by thread) and shown when the live one ends
+    struct BufferedToolOutput {
+        std::string text; // Title line included
+        bool finished = false;
+    };
+    std::mutex output_mutex_;
+    std::optional<std::thread::id> live_tool_output_;
+    std::vector<std::pair<std::thread::id, BufferedToolOutput>> buffered_tool_output_;
+
+    // All stdout output goes through here (coalesced per frame on a terminal)
+    TerminalRenderer renderer_{STDOUT_FILENO};
+
+    // Models offered by tab completion after "/model " (updated from the
+    // model refresh thread, read by readline on the input thread)
+    std::mutex completion_mutex_;
+    std::shared_ptr<const ModelIndex> completion_index_;
+
+    std::shared_ptr<const ModelIndex> completionIndex();
+
+    // readline attempted-completion hook: slash commands and model ids
+    static char** completeInput(const char* text, int start, int end);
 };
\ No newline at end of file
@@ -1,11 +1,21 @@
 #include "command_handler.h"
+#include "completion_cache.h"
 #include "model_manager.h"
+#include "model_index.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 #include <stdexcept>
 
 CommandHandler::CommandHandler(UserInterface& ui_ref,
                                PersistenceManager& db_ref,
-                               ModelManager& model_manager_ref)
-    : ui(ui_ref), db(db_ref), modelManager(model_manager_ref) {
+                               ModelManager& model_manager_ref,
+                               ContextWindow& context_window_ref,
+                               const CompletionCache* completion_cache_ptr)
+    : ui(ui_ref), db(db_ref), modelManager(model_manager_ref), contextWindow(context_window_ref),
+      completionCache(completion_cache_ptr) {
 }
 
 bool CommandHandler::handleCommand(const std::string& input) {
@@ -17,7 +27,7 @@ bool CommandHandler::handleCommand(const std::string& input) {
     
     // Route to appropriate handler
     if (command == "/models") {
-        handleModelsCommand();
+        handleModelsCommand(space_pos != std::string::npos ? input.substr(space_pos + 1) : "");
         return true;
     } else if (command == "/model") {
         if (space_pos == std::string::npos) {
@@ -46,62 +56,101 @@ bool CommandHandler::handleCommand(const std::string& input) {
         
         handleModelCommand(model_id);
         return true;
+    } else if (command == "/stats") {
+        handleStatsCommand(space_pos != std::string::npos ? input.substr(space_pos + 1) : "");
+        return true;
+    } else if (command == "/session") {
+        handleSessionCommand(space_pos != std::string::npos ? input.substr(space_pos + 1) : "");
+        return true;
     } else {
         // Unknown command
         ui.displayOutput("\nUnknown command. Available commands:\n"
-                        "  /models - List all available models\n"
-                        "  /model <model-id> - Change the active model\n", "");
+                        "  /models [query] [--min-context N] [--max-price USD] [--modality M] - List models\n"
+                        "  /model <model-id> - Change the active model\n"
+                        "  /stats [trace [file]] - Latency percentiles per stage, or write a Chrome trace\n"
+                        "  /session [list] | new [name] | switch <name|id> - Manage conversations\n", "");
         return true;
     }
 }
 
-void CommandHandler::handleModelsCommand() {
+void CommandHandler::handleModelsCommand(const std::string& args) {
+    static const char* kUsage =
+        "Usage: /models [query] [--min-context N] [--max-price USD] [--modality text|image|audio|file|video]\n"
+        "  --max-price is the prompt price in USD per million tokens";
+    
+    // Parse the query words and filter options
+    ModelIndex::Filter filter;
+    std::istringstream tokens(args);
+    std::string token;
     try {
-        std::vector<ModelData> models = db.getAllModels();
-        
-        if (models.empty()) {
-            ui.displayError("No models available. Models may still be loading.");
-            return;
-        }
-        
-        // Build output string
-        std::string output = "\nAvailable Models";
-        
-        // Add current model info to header
-        std::string current_model_id = modelManager.getActiveModelId();
-        try {
-            auto current_model = db.getModelById(current_model_id);
-            if (current_model.has_value()) {
-                output += " (current: " + current_model->name + ")";
-            }
-        } catch (...) {
-            // Ignore errors getting current model name
-        }
-        output += ":\n\n";
-        
-        // List all models with status indicator
-        for (const auto& model : models) {
-            // Mark current model with [*]
-            if (model.id == current_model_id) {
-                output += "  [*] ";
+        while (tokens >> token) {
+            if (token == "--min-context" || token == "--max-price" || token == "--modality") {
+                std::string value;
+                if (!(tokens >> value)) {
+                    ui.displayError(kUsage);
+                    return;
+                }
+                if (token == "--min-context") {
+                    filter.min_context_length = std::stoi(value);
+                } else if (token == "--max-price") {
+                    filter.max_prompt_price = std::stod(value);
+                } else {
+                    uint8_t modality = ModelIndex::parseModality(value);
+                    if (modality == 0) {
+                        ui.displayError(kUsage);
+                        return;
+                    }
+                    filter.required_modalities |= modality;
+                }
             } else {
-                output += "      ";
+                if (!filter.query.empty()) filter.query += ' ';
+                filter.query += token;
             }
-            
-            // Format: Name (ID) - Context: XXXX tokens
-            output += model.name + " (" + model.id + ")";
-            if (model.context_length > 0) {
-                output += " - Context: " + std::to_string(model.context_length) + " tokens";
-            }
-            output += "\n";
+        }
+    } catch (const std::exception&) {
+        ui.displayError(kUsage);
+        return;
+    }
+    
+    auto index = modelManager.modelIndex();
+    if (index->empty()) {
+        ui.displayError("No models available. Models may still be loading.");
+        return;
+    }
+    std::vector<const ModelIndex::Entry*> models = index->filter(filter);
+    
+    // Build output string
+    std::string output = "\nAvailable Models";
+    
+    // Add current model info to header
+    std::string current_model_id = modelManager.getActiveModelId();
+    if (const ModelIndex::Entry* current_model = index->find(current_model_id)) {
+        output += " (current: " + std::string(current_model->name) + ")";
+    }
+    if (models.size() != index->size()) {
+        output += " - " + std::to_string(models.size()) + " of " + std::to_string(index->size()) + " match";
+    }
+    output += ":\n\n";
+    
+    // List all models with status indicator
+    for (const ModelIndex::Entry* model : models) {
+        // Mark current model with [*]
+        if (model->id == current_model_id) {
+            output += "  [*] ";
+        } else {
+            output += "      ";
         }
         
-        output += "\nUse /model <model-id> to change the active model.\n";
-        ui.displayOutput(output, "");
-        
-    } catch (const std::exception& e) {
-        ui.displayError("Error listing models: " + std::string(e.what()));
+        // Format: Name (ID) - Context: XXXX tokens
+        output += std::string(model->name) + " (" + std::string(model->id) + ")";
+        if (model->context_length > 0) {
+            output += " - Context: " + std::to_string(model->context_length) + " tokens";
+        }
+        output += "\n";
     }
+    
+    output += "\nUse /model <model-id> to change the active model.\n";
+    ui.displayOutput(output, "");
 }
 
 void CommandHandler::handleModelCommand(const std::string& model_id) {
@@ -111,4 +160,127 @@ void CommandHandler::handleModelCommand(const std::string& model_id) {
     } catch (const std::exception& e) {
         ui.displayError("Error changing model: " + std::string(e.what()));
     }
-}
\ No newline at end of file
+}
+void CommandHandler::handleStatsCommand(const std::string& args) {
+    std::istringstream tokens(args);
+    std::string subcommand;
+    tokens >> subcommand;
+
+    Tracer& tracer = Tracer::global();
+    if (subcommand == "trace") {
+        std::string path;
+        if (!(tokens >> path)) {
+            path = "llm-cli-trace.json";
+        }
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << tracer.chromeTraceJson();
+        if (!out) {
+            ui.displayError("Failed to write trace to " + path);
+            return;
+        }
+        ui.displayStatus("Trace written to " + path + " (open in chrome://tracing or ui.perfetto.dev)");
+        return;
+    } else if (!subcommand.empty()) {
+        ui.displayError("Usage: /stats [trace [file]]");
+        return;
+    }
+
+    // Completion cache counters are shown even before any latency sample
+    std::string cache_line;
+    if (completionCache) {
+        CompletionCache::Stats cache = completionCache->stats();
+        uint64_t lookups = cache.hits + cache.misses;
+        char line[160];
+        std::snprintf(line, sizeof(line), "\nCompletion cache: %llu hits, %llu misses (%.0f%% hit rate), %llu stored, TTL %lldh\n",
+                      static_cast<unsigned long long>(cache.hits), static_cast<unsigned long long>(cache.misses),
+                      lookups ? 100.0 * static_cast<double>(cache.hits) / static_cast<double>(lookups) : 0.0,
+                      static_cast<unsigned long long>(cache.stores),
+                      static_cast<long long>(completionCache->ttlSeconds() / 3600));
+        cache_line = line;
+    }
+
+    std::vector<Tracer::StageStats> stats = tracer.stageStats();
+    if (stats.empty()) {
+        ui.displayOutput("\nNo latency samples recorded yet.\n" + cache_line, "");
+        return;
+    }
+
+    std::string output = "\nLatency by stage (ms, last " +
+                         std::to_string(std::min<uint64_t>(tracer.recordedCount(), Tracer::kCapacity)) +
+                         " spans):\n\n";
+    char line[160];
+    std::snprintf(line, sizeof(line), "  %-32s %7s %9s %9s %9s %9s\n", "stage", "count", "p50", "p95", "p99", "max");
+    output += line;
+    for (const auto& stage : stats) {
+        std::snprintf(line, sizeof(line), "  %-32s %7zu %9.1f %9.1f %9.1f %9.1f",
+                      stage.stage.c_str(), stage.count, stage.p50_ms, stage.p95_ms, stage.p99_ms, stage.max_ms);
+        output += line;
+        if (stage.p50_rate > 0) {
+            std::snprintf(line, sizeof(line), "  (~%.0f tokens/s)", stage.p50_rate);
+            output += line;
+        }
+        output += "\n";
+    }
+    output += cache_line;
+    ui.displayOutput(output, "");
+}
+
+void CommandHandler::handleSessionCommand(const std::string& args) {
+    static const char* kUsage = "Usage: /session [list] | /session new [name] | /session switch <name|id>";
+
+    std::istringstream tokens(args);
+    std::string subcommand;
+    tokens >> subcommand;
+    std::string rest;
+    std::getline(tokens >> std::ws, rest);
+    size_t end = rest.find_last_not_of(" \t\n\r");
+    rest = end != std::string::npos ? rest.substr(0, end + 1) : "";
+
+    try {
+        if (subcommand.empty() || subcommand == "list") {
+            if (!rest.empty()) {
+                ui.displayError(kUsage);
+                return;
+            }
+            std::string output = "\nSessions:\n";
+            char line[256];
+            for (const auto& session : db.listSessions()) {
+                std::snprintf(line, sizeof(line), "  %s %4d  %-24s %6d messages  %s\n",
+                              session.id == db.activeSession() ? "[*]" : "   ", session.id, session.name.c_str(),
+                              session.message_count,
+                              session.last_active.empty() ? "" : ("last active " + session.last_active).c_str());
+                output += line;
+            }
+            output += "\nUse /session switch <name|id> to resume one, or /session new [name] to start one.\n";
+            ui.displayOutput(output, "");
+        } else if (subcommand == "new") {
+            int id = db.createSession(rest);
+            auto session = db.findSession(std::to_string(id));
+            if (session) {
+                switchSession(*session);
+            }
+        } else if (subcommand == "switch") {
+            if (rest.empty()) {
+                ui.displayError(kUsage);
+                return;
+            }
+            auto session = db.findSession(rest);
+            if (!session) {
+                ui.displayError("No session named '" + rest + "'. Use /session list to see the sessions.");
+                return;
+            }
+            switchSession(*session);
+        } else {
+            ui.displayError(kUsage);
+        }
+    } catch (const std::exception& e) {
+        ui.displayError("Session command failed: " + std::string(e.what()));
+    }
+}
+
+void CommandHandler::switchSession(const SessionInfo& session) {
+    db.setActiveSession(session.id);
+    db.cleanupOrphanedToolMessages();
+    contextWindow.seed(db.getContextHistory(contextWindow.maxPairs()));
+    ui.displayStatus("Session: " + session.name + " (" + std::to_string(session.message_count) + " messages)");
+}
@@ -2,24 +2,33 @@
 
 #include <string>
 #include "database.h"
+#include "context_window.h"
 #include "ui_interface.h"
 
 // Forward declarations
+class CompletionCache;
 class PersistenceManager;
 class UserInterface;
 class ModelManager;
 
 /**
  * CommandHandler processes slash commands:
- * - /models - List all available models
- * - /model <id> - Change the active model
+ * - /models [query] [--min-context N] [--max-price USD] [--modality M] - List
+ *   (or search and filter) the available models
+ * - /model <id> - Change the active model (unique prefix / fuzzy match accepted)
+ * - /stats [trace [file]] - Latency percentiles per stage (see Tracer) and
+ *   completion cache counters, or write the recorded spans as a Chrome trace
+ * - /session [list] | new [name] | switch <name|id> - List, start or resume a
+ *   conversation; switching reloads the context window from that session
  * Provides centralized command parsing and execution
  */
 class CommandHandler {
 public:
     explicit CommandHandler(UserInterface& ui_ref,
                            PersistenceManager& db_ref,
-                           ModelManager& model_manager_ref);
+                           ModelManager& model_manager_ref,
+                           ContextWindow& context_window_ref,
+                           const CompletionCache* completion_cache_ptr = nullptr);
     
     // Handle a command input. Returns true if command was handled, false otherwise
     bool handleCommand(const std::string& input);
@@ -28,8 +37,15 @@ private:
     UserInterface& ui;
     PersistenceManager& db;
     ModelManager& modelManager;
+    ContextWindow& contextWindow;
+    const CompletionCache* completionCache; // Counters for /stats (nullptr when disabled)
     
     // Individual command handlers
-    void handleModelsCommand();
+    void handleModelsCommand(const std::string& args);
     void handleModelCommand(const std::string& model_id_arg);
+    void handleStatsCommand(const std::string& args);
+    void handleSessionCommand(const std::string& args);
+    
+    // Make a session active and reload the context window from it
+    void switchSession(const SessionInfo& session);
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "completion_cache.h"
+#include "database.h"
+#include "fnv1a.h"
+#include "tools_impl/content_cache.h"
+#include "trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+#include <utility>
+
+namespace {
+
+// Two 64-bit FNV-1a lanes, one over the body forwards and one backwards,
+// form a 128-bit key; with the body length in the key as well, a false hit
+// is not a practical concern
+std::pair<uint64_t, uint64_t> body_hash(const std::string& body) {
+    uint64_t backward = kFnvOffsetBasis;
+    for (auto it = body.rbegin(); it != body.rend(); ++it) {
+        backward = fnv1a_mix(backward, static_cast<unsigned char>(*it));
+    }
+    return {fnv1a_hash(body), backward};
+}
+
+} // namespace
+
+std::optional<int64_t> CompletionCache::ttlFromEnvironment() {
+    const char* value = std::getenv("LLM_CLI_COMPLETION_CACHE_HOURS");
+    if (!value || !*value) return std::nullopt;
+    char* end = nullptr;
+    double hours = std::strtod(value, &end);
+    if (*end != '\0' || !(hours > 0)) return std::nullopt;
+    return static_cast<int64_t>(hours * 3600);
+}
+
+CompletionCache::CompletionCache(PersistenceManager& store, int64_t ttl_seconds)
+    : store_(store), ttl_seconds_(ttl_seconds) {
+}
+
+std::string CompletionCache::cacheKey(const std::string& request_body) {
+    auto [a, b] = body_hash(request_body);
+    char hex[33];
+    std::snprintf(hex, sizeof(hex), "%016llx%016llx", static_cast<unsigned long long>(a),
+                  static_cast<unsigned long long>(b));
+    return "completion:" + std::string(hex) + ":" + std::to_string(request_body.size());
+}
+
+std::optional<std::string> CompletionCache::lookup(const std::string& request_body) {
+    TraceSpan span("api.cache_lookup");
+    try {
+        auto cached = store_.getCachedContent(cacheKey(request_body));
+        if (cached && cached->isFresh(cache_now())) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return std::move(cached->content);
+        }
+    } catch (const std::exception&) {
+        // Cache errors only cost a live request
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+void CompletionCache::store(const std::string& request_body, const std::string& response) {
+    nlohmann::json parsed = nlohmann::json::parse(response, nullptr, false);
+    if (parsed.is_discarded() || parsed.contains("error") || !parsed.contains("choices") ||
+        !parsed["choices"].is_array() || parsed["choices"].empty()) {
+        return;
+    }
+    CachedContent entry;
+    entry.key = cacheKey(request_body);
+    entry.content = response;
+    entry.fetched_at = cache_now();
+    entry.expires_at = entry.fetched_at + ttl_seconds_;
+    try {
+        store_.storeCachedContent(entry);
+        stores_.fetch_add(1, std::memory_order_relaxed);
+    } catch (const std::exception&) {
+        // Not cached; the response itself is still returned
+    }
+}
+
+CompletionCache::Stats CompletionCache::stats() const {
+    return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed),
+            stores_.load(std::memory_order_relaxed)};
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+class PersistenceManager;
+
+/**
+ * CompletionCache - reuse of completions for identical requests
+ *
+ * Internal calls (deep_research sub-query planning, web_research and
+ * deep_research synthesis) build their prompts purely from their inputs, so
+ * researching the same topic again sends byte-identical request bodies. The
+ * cache keys a response by a 128-bit hash of that body, which covers the
+ * model, messages, tools and parameters, and keeps it in the content cache
+ * table (TTL plus size-bounded LRU) for ttl_seconds.
+ *
+ * Only well-formed completions (a "choices" array, no "error") are stored.
+ * Streamed synthesis is keyed by its non-streaming request body and stored
+ * as a completion (ApiClient::makeStreamingApiCall at background priority).
+ * Opt-in: enabled when LLM_CLI_COMPLETION_CACHE_HOURS is a positive number.
+ * Thread-safe (research workers call the API concurrently).
+ */
+class CompletionCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t stores = 0;
+    };
+
+    // TTL from LLM_CLI_COMPLETION_CACHE_HOURS, nullopt if the cache is disabled
+    static std::optional<int64_t> ttlFromEnvironment();
+
+    /**
+     * Constructor
+     * @param store Content cache holding the entries (must outlive the cache)
+     * @param ttl_seconds Lifetime of a stored completion
+     */
+    CompletionCache(PersistenceManager& store, int64_t ttl_seconds);
+
+    CompletionCache(const CompletionCache&) = delete;
+    CompletionCache& operator=(const CompletionCache&) = delete;
+
+    // Fresh cached response for a request body (counts a hit or a miss)
+    std::optional<std::string> lookup(const std::string& request_body);
+
+    // Remember a response to a request body, if it is a completion
+    void store(const std::string& request_body, const std::string& response);
+
+    Stats stats() const;
+    int64_t ttlSeconds() const { return ttl_seconds_; }
+
+    // "completion:" + 32 hex digits of the body hash + ":" + body length
+    static std::string cacheKey(const std::string& request_body);
+
+private:
+    PersistenceManager& store_;
+    int64_t ttl_seconds_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> stores_{0};
+};
@@ -0,0 +1,40 @@
+#include "context_budget.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+// Fixed per-message cost (role, separators) on top of the content
+constexpr size_t kMessageOverheadTokens = 4;
+
+// Share of the context window kept free for the completion
+constexpr int kReplyReserveDivisor = 4;
+constexpr int kMaxReplyReserveTokens = 8192;
+
+constexpr size_t kDefaultMaxContextTokens = 64000;
+
+size_t estimate_tokens(std::string_view text) {
+    return (text.size() + 3) / 4 + kMessageOverheadTokens;
+}
+
+static size_t max_context_tokens() {
+    static const size_t limit = []() {
+        const char* value = std::getenv("LLM_CLI_MAX_CONTEXT_TOKENS");
+        if (!value || !*value) return kDefaultMaxContextTokens;
+        try {
+            long long parsed = std::stoll(value);
+            return parsed > 0 ? static_cast<size_t>(parsed) : kDefaultMaxContextTokens;
+        } catch (...) {
+            return kDefaultMaxContextTokens;
+        }
+    }();
+    return limit;
+}
+
+size_t context_token_budget(int context_length) {
+    if (context_length <= 0) {
+        context_length = kDefaultContextLength;
+    }
+    int reserve = std::min(context_length / kReplyReserveDivisor, kMaxReplyReserveTokens);
+    size_t available = static_cast<size_t>(context_length - reserve);
+    return std::min(available, max_context_tokens());
+}
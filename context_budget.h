@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Context length assumed for models whose context_length is unknown
+constexpr int kDefaultContextLength = 8192;
+
+// Rough token count for request text (about 4 bytes per token for English
+// prose and JSON); errs on the high side so packed requests stay in budget
+size_t estimate_tokens(std::string_view text);
+
+// Tokens available for the messages array of a request to a model with the
+// given context length: room is left for the reply, and the total is capped
+// by LLM_CLI_MAX_CONTEXT_TOKENS (default 64000) to bound prompt cost
+size_t context_token_budget(int context_length);
@@ -0,0 +1,38 @@
+#include "context_window.h"
+
+ContextWindow::ContextWindow(size_t max_pairs)
+    : max_messages_(max_pairs * 2) {
+    messages_.reserve(max_messages_ + 1);
+}
+
+void ContextWindow::seed(std::vector<Message> history) {
+    messages_ = std::move(history);
+    // getContextHistory() returns a default system message (id 0) when the table is empty
+    placeholder_only_ = messages_.size() == 1 && messages_[0].role == "system" && messages_[0].id == 0;
+    has_system_ = !placeholder_only_ && !messages_.empty() && messages_[0].role == "system";
+}
+
+void ContextWindow::append(Message msg) {
+    if (placeholder_only_) {
+        // The database would no longer return the default system message
+        messages_.clear();
+        placeholder_only_ = false;
+    }
+
+    if (msg.role == "system") {
+        // Only the most recent system message is kept, at the front
+        if (has_system_) {
+            messages_[0] = std::move(msg);
+        } else {
+            messages_.insert(messages_.begin(), std::move(msg));
+            has_system_ = true;
+        }
+        return;
+    }
+
+    messages_.push_back(std::move(msg));
+    size_t first = has_system_ ? 1 : 0;
+    if (messages_.size() - first > max_messages_) {
+        messages_.erase(messages_.begin() + static_cast<std::ptrdiff_t>(first));
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "database.h"
+
+/**
+ * ContextWindow keeps the conversation context sent to the model in memory:
+ * - Seeded once from PersistenceManager::getContextHistory() at startup
+ * - Appended to as messages are saved, so building a request needs no DB query
+ * - Holds the most recent system message plus the last max_pairs * 2
+ *   user/assistant/tool messages, matching getContextHistory()
+ *
+ * The full history stays in the database for read_history.
+ */
+class ContextWindow {
+public:
+    explicit ContextWindow(size_t max_pairs = 10);
+
+    // Replace the window contents with history loaded from the database
+    void seed(std::vector<Message> history);
+
+    // Add a message that has just been saved (dropping the oldest one past the limit)
+    void append(Message msg);
+
+    // Current context, oldest first
+    const std::vector<Message>& messages() const { return messages_; }
+
+    // Pairs of messages kept (the max_pairs the window was created with)
+    size_t maxPairs() const { return max_messages_ / 2; }
+
+private:
+    size_t max_messages_;
+    bool has_system_ = false;       // messages_[0] is a real system message
+    bool placeholder_only_ = false; // Only the default system message (empty history)
+    std::vector<Message> messages_;
+};
@@ -2,9 +2,18 @@
 #include "database/database_core.h"
 #include "database/message_repository.h"
 #include "database/model_repository.h"
+#include "database/content_cache_repository.h"
+#include "database/session_repository.h"
+#include "database/message_writer.h"
+#include "database/reader_pool.h"
+#include "trace.h"
+#include <atomic>
 #include <memory>
 #include <stdexcept>
 #include <optional>
+#include <cstdlib>
+#include <string>
+#include <thread>
 
 namespace { // Or make these part of a utility struct/namespace if preferred
 struct SQLiteStmtDeleter {
@@ -17,17 +26,107 @@ struct SQLiteStmtDeleter {
 using unique_sqlite_stmt_ptr = std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter>;
 } // end anonymous namespace
 
+// Size bound for the on-disk content cache (search results and page text)
+constexpr int64_t kContentCacheMaxBytes = 64LL * 1024 * 1024;
+
+// Set once tool messages written as JSON envelopes have been converted
+constexpr const char* kStructuredToolMessagesKey = "structured_tool_messages_v1";
+
+// Session made active most recently (by any PersistenceManager), resumed at startup
+constexpr const char* kActiveSessionKey = "active_session_id";
+
+// Query-only connections kept open for reads (more are opened under higher concurrency)
+constexpr size_t kMaxIdleReaders = 4;
+
+namespace {
+
+std::optional<std::string> load_setting(database::DatabaseCore& core, const std::string& key) {
+    const char* sql = "SELECT value FROM settings WHERE key = ?";
+    std::optional<std::string> result = std::nullopt;
+
+    auto stmt = core.cachedStatement(sql);
+
+    // Use SQLITE_TRANSIENT to ensure SQLite makes a copy of the string data
+    if (sqlite3_bind_text(stmt.get(), 1, key.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK) {
+        throw std::runtime_error("Failed to bind key in loadSetting: " + std::string(sqlite3_errmsg(core.getConnection())));
+    }
+
+    int step_result = sqlite3_step(stmt.get());
+    if (step_result == SQLITE_ROW) {
+        const unsigned char* text = sqlite3_column_text(stmt.get(), 0);
+        if (text) {
+            result = reinterpret_cast<const char*>(text);
+        }
+    } else if (step_result != SQLITE_DONE) {
+        throw std::runtime_error("loadSetting query failed: " + std::string(sqlite3_errmsg(core.getConnection())));
+    }
+    return result;
+}
+
+} // anonymous namespace
+
 // Pimpl implementation using the new repository pattern
+// Writes use the writer connection `core`; queries lease a reader connection
+// from `readers`. The content cache (written from tool threads, and updating
+// access times on lookup) has a writer connection of its own, so its inserts
+// never land inside a message transaction or move core's last insert rowid.
 struct PersistenceManager::Impl {
     database::DatabaseCore core;
+    database::DatabaseCore cache_core;
     database::MessageRepository messages;
     database::ModelRepository models;
+    database::ContentCacheRepository content_cache;
+    database::SessionRepository sessions;
+    database::ReaderPool readers;
+    
+    // Synchronous mode inside beginTransaction(): the thread that opened the
+    // transaction must read its uncommitted writes (default id: none open)
+    std::atomic<std::thread::id> transaction_owner{};
+    
+    // Session that message saves and history queries apply to
+    int session_id = database::SessionRepository::kDefaultSessionId;
+    
+    // Write-behind state (WriteMode::WriteBehind only)
+    std::unique_ptr<database::MessageWriter> writer;
+    bool grouping = false;              // Inside beginTransaction()/commitTransaction()
+    std::vector<Message> pending_group; // Saves held until the group commits
     
-    Impl() 
+    explicit Impl(WriteMode mode) 
         : core()
+        , cache_core()
         , messages(core)
         , models(core)
-    {}
+        , content_cache(cache_core, kContentCacheMaxBytes)
+        , sessions(core)
+        , readers(kMaxIdleReaders)
+    {
+        convertLegacyToolMessages();
+        resumeSession();
+        if (mode == WriteMode::WriteBehind) {
+            writer = std::make_unique<database::MessageWriter>();
+        }
+    }
+    
+    // Run a query against a pooled reader connection. The query is called with
+    // an object exposing core/messages/models/sessions: a reader, or this Impl
+    // on the thread with an open synchronous transaction (its writes are uncommitted)
+    template <typename Query>
+    auto read(Query&& query) {
+        if (transaction_owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            return query(*this);
+        }
+        auto reader = readers.acquire();
+        return query(*reader);
+    }
+    
+    // Route a message save to the writer (or the current group), returning its id
+    int queueMessage(Message msg);
+    
+    // One-time conversion of pre-structured tool messages (before the writer starts)
+    void convertLegacyToolMessages();
+    
+    // Start in the session last made active, if it still exists
+    void resumeSession();
     
     // Settings management remains in Impl (simple operations)
     void saveSetting(const std::string& key, const std::string& value);
@@ -38,7 +137,7 @@ struct PersistenceManager::Impl {
 void PersistenceManager::Impl::saveSetting(const std::string& key, const std::string& value) {
     const char* sql = "INSERT OR REPLACE INTO settings (key, value) VALUES (?, ?)";
     
-    auto stmt = this->core.prepareStatement(sql);
+    auto stmt = this->core.cachedStatement(sql);
 
     // Use SQLITE_TRANSIENT to ensure SQLite makes a copy of the string data
     // This avoids dangling pointer issues since c_str() returns a temporary pointer
@@ -55,101 +154,254 @@ void PersistenceManager::Impl::saveSetting(const std::string& key, const std::st
 }
 
 std::optional<std::string> PersistenceManager::Impl::loadSetting(const std::string& key) {
-    const char* sql = "SELECT value FROM settings WHERE key = ?";
-    std::optional<std::string> result = std::nullopt;
+    return load_setting(this->core, key);
+}
 
-    auto stmt = this->core.prepareStatement(sql);
+void PersistenceManager::Impl::convertLegacyToolMessages() {
+    if (loadSetting(kStructuredToolMessagesKey)) {
+        return;
+    }
+    try {
+        messages.convertLegacyToolMessages();
+        saveSetting(kStructuredToolMessagesKey, "1");
+    } catch (const std::exception&) {
+        // Unconverted rows are still structured when read; retried next start
+    }
+}
 
-    // Use SQLITE_TRANSIENT to ensure SQLite makes a copy of the string data
-    if (sqlite3_bind_text(stmt.get(), 1, key.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK) {
-        throw std::runtime_error("Failed to bind key in Impl::loadSetting: " + std::string(sqlite3_errmsg(this->core.getConnection())));
+void PersistenceManager::Impl::resumeSession() {
+    auto saved = loadSetting(kActiveSessionKey);
+    if (!saved) {
+        return;
     }
+    int id = std::atoi(saved->c_str());
+    if (id > 0 && sessions.findSessionById(id)) {
+        session_id = id;
+    }
+}
 
-    int step_result = sqlite3_step(stmt.get());
-    if (step_result == SQLITE_ROW) {
-        const unsigned char* text = sqlite3_column_text(stmt.get(), 0);
-        if (text) {
-            result = reinterpret_cast<const char*>(text);
-        }
-    } else if (step_result != SQLITE_DONE) {
-        throw std::runtime_error("Impl::loadSetting query failed: " + std::string(sqlite3_errmsg(this->core.getConnection())));
+int PersistenceManager::Impl::queueMessage(Message msg) {
+    msg.id = writer->reserveId();
+    msg.session_id = session_id;
+    int id = msg.id;
+    if (grouping) {
+        pending_group.push_back(std::move(msg));
+    } else {
+        std::vector<Message> group;
+        group.push_back(std::move(msg));
+        writer->enqueue(std::move(group));
     }
-    return result;
+    return id;
 }
 
 // PersistenceManager public API implementation - delegates to repositories
 
-PersistenceManager::PersistenceManager() : impl(std::make_unique<Impl>()) {}
+PersistenceManager::PersistenceManager(WriteMode mode) : impl(std::make_unique<Impl>(mode)) {}
 PersistenceManager::~PersistenceManager() = default;
 
-// Transaction Management - delegates to DatabaseCore
+void PersistenceManager::flush() {
+    TraceSpan span("db.flush");
+    if (impl->writer) {
+        impl->writer->flush();
+    }
+}
+
+// Transaction Management - delegates to DatabaseCore (or groups queued writes)
 void PersistenceManager::beginTransaction() {
+    if (impl->writer) {
+        impl->grouping = true;
+        impl->pending_group.clear();
+        return;
+    }
     impl->core.beginTransaction();
+    impl->transaction_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
 }
 
 void PersistenceManager::commitTransaction() {
+    TraceSpan span("db.commitTransaction");
+    if (impl->writer) {
+        impl->grouping = false;
+        impl->writer->enqueue(std::move(impl->pending_group));
+        impl->pending_group.clear();
+        return;
+    }
     impl->core.commitTransaction();
+    impl->transaction_owner.store(std::thread::id(), std::memory_order_relaxed);
 }
 
 void PersistenceManager::rollbackTransaction() {
+    if (impl->writer) {
+        impl->grouping = false;
+        impl->pending_group.clear();
+        return;
+    }
+    impl->transaction_owner.store(std::thread::id(), std::memory_order_relaxed);
     impl->core.rollbackTransaction();
 }
 
-// Message operations - delegate to MessageRepository
-void PersistenceManager::saveUserMessage(const std::string& content) {
-    impl->messages.insertUserMessage(content);
+// Sessions - delegate to SessionRepository
+int PersistenceManager::activeSession() const {
+    return impl->session_id;
 }
 
-void PersistenceManager::saveAssistantMessage(const std::string& content, const std::string& model_id) {
-    impl->messages.insertAssistantMessage(content, model_id);
+void PersistenceManager::setActiveSession(int session_id) {
+    TraceSpan span("db.setActiveSession");
+    if (!impl->sessions.findSessionById(session_id)) {
+        throw std::runtime_error("No session with id " + std::to_string(session_id));
+    }
+    // Saves already queued keep the session they were made in
+    impl->session_id = session_id;
+    impl->saveSetting(kActiveSessionKey, std::to_string(session_id));
 }
 
-void PersistenceManager::saveToolMessage(const std::string& content) {
-    impl->messages.insertToolMessage(content);
+int PersistenceManager::createSession(const std::string& name) {
+    TraceSpan span("db.createSession");
+    return impl->sessions.createSession(name);
+}
+
+std::optional<SessionInfo> PersistenceManager::findSession(const std::string& name_or_id) {
+    TraceSpan span("db.findSession");
+    flush(); // Message counts include queued saves
+    return impl->read([&](auto& db) { return db.sessions.findSession(name_or_id); });
+}
+
+std::vector<SessionInfo> PersistenceManager::listSessions() {
+    TraceSpan span("db.listSessions");
+    flush(); // Message counts include queued saves
+    return impl->read([&](auto& db) { return db.sessions.listSessions(); });
+}
+
+// Message operations - delegate to MessageRepository (or the write-behind queue)
+int PersistenceManager::saveUserMessage(const SharedText& content) {
+    TraceSpan span("db.saveUserMessage");
+    if (impl->writer) {
+        return impl->queueMessage({"user", content});
+    }
+    return impl->messages.insertUserMessage(impl->session_id, content);
+}
+
+int PersistenceManager::saveAssistantMessage(const SharedText& content, const std::string& model_id) {
+    TraceSpan span("db.saveAssistantMessage");
+    if (impl->writer) {
+        Message msg{"assistant", content};
+        if (!model_id.empty()) msg.model_id = model_id;
+        return impl->queueMessage(std::move(msg));
+    }
+    return impl->messages.insertAssistantMessage(impl->session_id, content, model_id);
+}
+
+int PersistenceManager::saveAssistantToolCalls(const Message& msg) {
+    TraceSpan span("db.saveAssistantToolCalls");
+    if (impl->writer) {
+        // Validate up front so callers still see malformed records
+        database::MessageRepository::validateToolCallRequest(msg);
+        Message queued = msg;
+        queued.role = "assistant";
+        return impl->queueMessage(std::move(queued));
+    }
+    return impl->messages.insertAssistantToolCalls(impl->session_id, msg);
+}
+
+int PersistenceManager::saveToolMessage(const Message& msg) {
+    TraceSpan span("db.saveToolMessage");
+    if (impl->writer) {
+        // Validate up front so callers still see malformed tool results
+        database::MessageRepository::validateToolMessage(msg);
+        Message queued = msg;
+        queued.role = "tool";
+        return impl->queueMessage(std::move(queued));
+    }
+    return impl->messages.insertToolMessage(impl->session_id, msg);
 }
 
 void PersistenceManager::cleanupOrphanedToolMessages() {
-    impl->messages.cleanupOrphanedToolMessages();
+    TraceSpan span("db.cleanupOrphanedToolMessages");
+    flush();
+    impl->messages.cleanupOrphanedToolMessages(impl->session_id);
 }
 
 std::vector<Message> PersistenceManager::getContextHistory(size_t max_pairs) {
-    return impl->messages.getContextHistory(max_pairs);
+    TraceSpan span("db.getContextHistory");
+    flush(); // Read-your-writes
+    int session_id = impl->session_id;
+    return impl->read([&](auto& db) { return db.messages.getContextHistory(session_id, max_pairs); });
 }
 
 std::vector<Message> PersistenceManager::getHistoryRange(const std::string& start_time, const std::string& end_time, size_t limit) {
-    return impl->messages.getHistoryRange(start_time, end_time, limit);
+    TraceSpan span("db.getHistoryRange");
+    flush(); // Read-your-writes
+    int session_id = impl->session_id;
+    return impl->read([&](auto& db) { return db.messages.getHistoryRange(session_id, start_time, end_time, limit); });
+}
+
+std::vector<HistorySearchHit> PersistenceManager::searchHistory(const std::string& match, size_t limit, size_t offset,
+                                                                bool all_sessions) {
+    TraceSpan span("db.searchHistory");
+    flush(); // Read-your-writes
+    int session_id = all_sessions ? 0 : impl->session_id;
+    return impl->read([&](auto& db) { return db.messages.searchHistory(match, session_id, limit, offset); });
+}
+
+std::vector<Message> PersistenceManager::getMessagesById(const std::vector<int>& ids) {
+    TraceSpan span("db.getMessagesById");
+    flush(); // Read-your-writes
+    return impl->read([&](auto& db) { return db.messages.getMessagesById(ids); });
 }
 
 // Model operations - delegate to ModelRepository
 void PersistenceManager::clearModelsTable() {
+    TraceSpan span("db.clearModelsTable");
     impl->models.clearAllModels();
 }
 
 void PersistenceManager::insertOrUpdateModel(const ModelData& model) {
+    TraceSpan span("db.insertOrUpdateModel");
     impl->models.insertOrUpdateModel(model);
 }
 
 std::vector<ModelData> PersistenceManager::getAllModels() {
-    return impl->models.getAllModels();
+    TraceSpan span("db.getAllModels");
+    return impl->read([](auto& db) { return db.models.getAllModels(); });
 }
 
 std::optional<ModelData> PersistenceManager::getModelById(const std::string& model_id) {
-    return impl->models.getModelById(model_id);
+    TraceSpan span("db.getModelById");
+    return impl->read([&](auto& db) { return db.models.getModelById(model_id); });
 }
 
 std::optional<std::string> PersistenceManager::getModelNameById(const std::string& model_id) {
-    return impl->models.getModelNameById(model_id);
+    TraceSpan span("db.getModelNameById");
+    return impl->read([&](auto& db) { return db.models.getModelNameById(model_id); });
 }
 
-void PersistenceManager::replaceModelsInDB(const std::vector<ModelData>& models) {
-    impl->models.replaceModels(models);
+ModelSyncResult PersistenceManager::replaceModelsInDB(const std::vector<ModelData>& models) {
+    TraceSpan span("db.replaceModelsInDB");
+    return impl->models.replaceModels(models);
 }
 
 // Settings management - delegate to Impl
 void PersistenceManager::saveSetting(const std::string& key, const std::string& value) {
+    TraceSpan span("db.saveSetting");
     impl->saveSetting(key, value);
 }
 
 std::optional<std::string> PersistenceManager::loadSetting(const std::string& key) {
-    return impl->loadSetting(key);
+    TraceSpan span("db.loadSetting");
+    return impl->read([&](auto& db) { return load_setting(db.core, key); });
+}
+
+// Content cache - delegate to ContentCacheRepository
+std::optional<CachedContent> PersistenceManager::getCachedContent(const std::string& key) {
+    TraceSpan span("db.getCachedContent");
+    return impl->content_cache.lookup(key);
+}
+
+void PersistenceManager::storeCachedContent(const CachedContent& entry) {
+    TraceSpan span("db.storeCachedContent");
+    impl->content_cache.store(entry);
+}
+
+void PersistenceManager::refreshCachedContent(const std::string& key, int64_t expires_at) {
+    TraceSpan span("db.refreshCachedContent");
+    impl->content_cache.refresh(key, expires_at);
 }
@@ -3,29 +3,106 @@
 #include <string>
 #include <memory>
 #include <optional>
+#include <cstdint>
 #include "model_types.h"
+#include "shared_text.h"
 struct sqlite3;
 
 // Message struct represents a single message in the chat history.
+// Text fields are shared and immutable, so copying a Message does not copy the text.
 struct Message {
-    std::string role;
+    std::string role; // Always fits the small-string buffer
+    SharedText content;
+    int id = 0;
+    SharedText timestamp;
+    std::optional<SharedText> model_id;
+
+    // Structured tool fields (empty for other messages)
+    SharedText tool_call_id;  // role "tool": id of the call this result answers
+    SharedText tool_name;     // role "tool": tool that produced content
+    SharedText tool_calls;    // role "assistant": JSON array of requested calls, as sent to the API
+    SharedText tool_call_ids; // role "assistant": ids of those calls, '\n'-separated
+
+    int session_id = 0;       // Conversation the message belongs to (set when saved or loaded)
+
+    bool isToolResult() const { return role == "tool" && !tool_call_id.empty(); }
+    bool isToolCallRequest() const { return role == "assistant" && !tool_calls.empty(); }
+};
+
+// CachedContent is one entry of the on-disk content cache
+// (search results or extracted page text, keyed by normalized query/URL).
+struct CachedContent {
+    std::string key;
     std::string content;
+    std::string etag;          // Validators for conditional revalidation (may be empty)
+    std::string last_modified;
+    int64_t fetched_at = 0;    // Unix seconds
+    int64_t expires_at = 0;    // Unix seconds
+
+    bool isFresh(int64_t now) const { return now < expires_at; }
+};
+
+// HistorySearchHit is one ranked full-text match from searchHistory().
+struct HistorySearchHit {
     int id = 0;
+    int session_id = 0;
+    std::string role;
     std::string timestamp;
-    std::optional<std::string> model_id;
+    std::string snippet;       // Matching excerpt, terms wrapped in ** **
+};
+
+// SessionInfo describes one conversation in the message store.
+struct SessionInfo {
+    int id = 0;
+    std::string name;
+    std::string created_at;
+    std::string last_active;   // Timestamp of the newest message (empty if none)
+    int message_count = 0;
 };
 
 class PersistenceManager {
 public:
-    PersistenceManager();
+    // How message saves reach the database
+    enum class WriteMode {
+        Synchronous, // Insert on the calling thread
+        WriteBehind  // Queue for a background writer; reads flush the queue first
+    };
+
+    explicit PersistenceManager(WriteMode mode = WriteMode::Synchronous);
     ~PersistenceManager();
     
-    void saveUserMessage(const std::string& content);
-    void saveAssistantMessage(const std::string& content, const std::string& model_id);
-    void saveToolMessage(const std::string& content);
+    // Block until all queued message writes are committed (no-op when synchronous)
+    void flush();
+    
+    // Sessions: message saves and history queries below apply to the active session.
+    // It starts as the session last made active (setting "active_session_id"),
+    // or the default session 1; each PersistenceManager tracks its own.
+    int activeSession() const;
+    // Throws std::runtime_error if the session does not exist
+    void setActiveSession(int session_id);
+    // New session named `name` (or "session-<id>" if empty); throws if the name is taken
+    int createSession(const std::string& name = "");
+    // Look up a session by name, or by numeric id
+    std::optional<SessionInfo> findSession(const std::string& name_or_id);
+    std::vector<SessionInfo> listSessions();
+
+    // Message saves return the message's row id (reserved up front in WriteBehind mode)
+    // Content is taken as SharedText so the write-behind queue shares the caller's buffer
+    int saveUserMessage(const SharedText& content);
+    int saveAssistantMessage(const SharedText& content, const std::string& model_id);
+    // Assistant message requesting tools (tool_calls and tool_call_ids set)
+    int saveAssistantToolCalls(const Message& msg);
+    // Tool result (tool_call_id and tool_name set; content is the raw tool output)
+    int saveToolMessage(const Message& msg);
     void cleanupOrphanedToolMessages();
     std::vector<Message> getContextHistory(size_t max_pairs = 10);
     std::vector<Message> getHistoryRange(const std::string& start_time, const std::string& end_time, size_t limit = 50);
+    // Ranked full-text search over user and assistant messages (best match first)
+    // match: an FTS5 MATCH expression; all_sessions: search every session, not just the active one
+    std::vector<HistorySearchHit> searchHistory(const std::string& match, size_t limit, size_t offset = 0,
+                                                bool all_sessions = false);
+    // Messages by row id in any session, in the order given (missing ids are skipped)
+    std::vector<Message> getMessagesById(const std::vector<int>& ids);
 
     // Model specific operations
     void clearModelsTable();
@@ -35,17 +112,24 @@ public:
     std::optional<std::string> getModelNameById(const std::string& model_id);
 
     // Transaction management
+    // In WriteBehind mode these group the message saves made in between so the
+    // writer commits them in one transaction (rollback discards them)
     void beginTransaction();
     void commitTransaction();
     void rollbackTransaction();
 
-    // Atomic replacement of models
-    void replaceModelsInDB(const std::vector<ModelData>& models);
+    // Atomic replacement of models (writes only the rows that differ)
+    ModelSyncResult replaceModelsInDB(const std::vector<ModelData>& models);
 
     // Settings management
     void saveSetting(const std::string& key, const std::string& value);
     std::optional<std::string> loadSetting(const std::string& key);
 
+    // Content cache for search_web / visit_url (thread-safe)
+    std::optional<CachedContent> getCachedContent(const std::string& key);
+    void storeCachedContent(const CachedContent& entry);
+    void refreshCachedContent(const std::string& key, int64_t expires_at);
+
 private:
     // Forward declaration for the Pimpl idiom
     // Implementation is completely hidden in database.cpp
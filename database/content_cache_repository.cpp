@@ -0,0 +1,131 @@
+#include "content_cache_repository.h"
+#include <ctime>
+#include <stdexcept>
+
+namespace database {
+
+static int64_t now_seconds() {
+    return static_cast<int64_t>(std::time(nullptr));
+}
+
+ContentCacheRepository::ContentCacheRepository(DatabaseCore& core, int64_t max_total_bytes)
+    : core_(core), max_total_bytes_(max_total_bytes) {
+}
+
+std::optional<CachedContent> ContentCacheRepository::lookup(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const char* sql = R"(
+SELECT content, etag, last_modified, fetched_at, expires_at
+FROM content_cache WHERE cache_key = ?
+)";
+    auto stmt = core_.cachedStatement(sql);
+    if (sqlite3_bind_text(stmt.get(), 1, key.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK) {
+        throw std::runtime_error("Failed to bind key in ContentCacheRepository::lookup: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+
+    int step_result = sqlite3_step(stmt.get());
+    if (step_result == SQLITE_DONE) {
+        return std::nullopt;
+    }
+    if (step_result != SQLITE_ROW) {
+        throw std::runtime_error("ContentCacheRepository::lookup failed: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+
+    auto column_string = [&stmt](int column) -> std::string {
+        const unsigned char* text = sqlite3_column_text(stmt.get(), column);
+        return text ? reinterpret_cast<const char*>(text) : "";
+    };
+
+    CachedContent entry;
+    entry.key = key;
+    entry.content = column_string(0);
+    entry.etag = column_string(1);
+    entry.last_modified = column_string(2);
+    entry.fetched_at = sqlite3_column_int64(stmt.get(), 3);
+    entry.expires_at = sqlite3_column_int64(stmt.get(), 4);
+    stmt.reset();
+
+    auto touch = core_.cachedStatement("UPDATE content_cache SET last_accessed = ? WHERE cache_key = ?");
+    sqlite3_bind_int64(touch.get(), 1, now_seconds());
+    sqlite3_bind_text(touch.get(), 2, key.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(touch.get()) != SQLITE_DONE) {
+        throw std::runtime_error("ContentCacheRepository::lookup touch failed: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    return entry;
+}
+
+void ContentCacheRepository::store(const CachedContent& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const char* sql = R"(
+INSERT OR REPLACE INTO content_cache (
+    cache_key, content, etag, last_modified, fetched_at, expires_at, last_accessed, size_bytes
+) VALUES (?, ?, ?, ?, ?, ?, ?, ?)
+)";
+    auto stmt = core_.cachedStatement(sql);
+    sqlite3_bind_text(stmt.get(), 1, entry.key.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt.get(), 2, entry.content.data(), static_cast<int>(entry.content.size()), SQLITE_TRANSIENT);
+    if (entry.etag.empty()) {
+        sqlite3_bind_null(stmt.get(), 3);
+    } else {
+        sqlite3_bind_text(stmt.get(), 3, entry.etag.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    if (entry.last_modified.empty()) {
+        sqlite3_bind_null(stmt.get(), 4);
+    } else {
+        sqlite3_bind_text(stmt.get(), 4, entry.last_modified.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    sqlite3_bind_int64(stmt.get(), 5, entry.fetched_at);
+    sqlite3_bind_int64(stmt.get(), 6, entry.expires_at);
+    sqlite3_bind_int64(stmt.get(), 7, now_seconds());
+    sqlite3_bind_int64(stmt.get(), 8, static_cast<int64_t>(entry.key.size() + entry.content.size()));
+
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+        throw std::runtime_error("ContentCacheRepository::store failed: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    evictToFit();
+}
+
+void ContentCacheRepository::refresh(const std::string& key, int64_t expires_at) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto stmt = core_.cachedStatement(
+        "UPDATE content_cache SET expires_at = ?, last_accessed = ? WHERE cache_key = ?");
+    sqlite3_bind_int64(stmt.get(), 1, expires_at);
+    sqlite3_bind_int64(stmt.get(), 2, now_seconds());
+    sqlite3_bind_text(stmt.get(), 3, key.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+        throw std::runtime_error("ContentCacheRepository::refresh failed: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+}
+
+void ContentCacheRepository::evictToFit() {
+    auto total_stmt = core_.cachedStatement("SELECT COALESCE(SUM(size_bytes), 0) FROM content_cache");
+    if (sqlite3_step(total_stmt.get()) != SQLITE_ROW) {
+        throw std::runtime_error("ContentCacheRepository size query failed: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    int64_t total = sqlite3_column_int64(total_stmt.get(), 0);
+    if (total <= max_total_bytes_) {
+        return;
+    }
+
+    // Delete the least recently used rows whose running size covers the excess
+    const char* sql = R"(
+DELETE FROM content_cache WHERE cache_key IN (
+    SELECT cache_key FROM (
+        SELECT cache_key,
+               SUM(size_bytes) OVER (ORDER BY last_accessed, cache_key
+                                     ROWS BETWEEN UNBOUNDED PRECEDING AND 1 PRECEDING) AS freed_before
+        FROM content_cache
+    ) WHERE COALESCE(freed_before, 0) < ?
+)
+)";
+    auto stmt = core_.cachedStatement(sql);
+    sqlite3_bind_int64(stmt.get(), 1, total - max_total_bytes_);
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+        throw std::runtime_error("ContentCacheRepository eviction failed: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+}
+
+} // namespace database
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "database_core.h"
+#include "../database.h"  // For CachedContent struct
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace database {
+
+/**
+ * ContentCacheRepository - On-disk cache for fetched web content
+ * 
+ * Responsibilities:
+ * - Lookup of cached search results / page text by normalized key
+ * - Insert or replace entries together with their HTTP validators
+ * - Expiry refresh after a successful conditional revalidation (304)
+ * - Size-bounded LRU eviction by last access time
+ * 
+ * Safe to call from the research worker threads: operations are serialized
+ * by an internal mutex.
+ */
+class ContentCacheRepository {
+public:
+    /**
+     * Constructor
+     * @param core Reference to DatabaseCore for connection access
+     * @param max_total_bytes Upper bound on the summed size of cached content
+     */
+    ContentCacheRepository(DatabaseCore& core, int64_t max_total_bytes);
+
+    /**
+     * Look up an entry and mark it as recently used
+     * @param key The normalized cache key
+     * @return The entry (fresh or stale) if present, nullopt otherwise
+     * @throws std::runtime_error if the query fails
+     */
+    std::optional<CachedContent> lookup(const std::string& key);
+
+    /**
+     * Insert or replace an entry, then evict least recently used entries
+     * until the cache fits in the size bound
+     * @param entry The entry to store
+     * @throws std::runtime_error if the operation fails
+     */
+    void store(const CachedContent& entry);
+
+    /**
+     * Extend the lifetime of an entry that the server confirmed unchanged
+     * @param key The normalized cache key
+     * @param expires_at New expiry time (Unix seconds)
+     * @throws std::runtime_error if the update fails
+     */
+    void refresh(const std::string& key, int64_t expires_at);
+
+private:
+    DatabaseCore& core_;  // Reference to database core for connection access
+    int64_t max_total_bytes_;
+    std::mutex mutex_;
+
+    /**
+     * Delete least recently used entries until the total size fits
+     */
+    void evictToFit();
+};
+
+} // namespace database
@@ -1,14 +1,45 @@
 #include "database_core.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <utility>
 
 namespace database {
 
-DatabaseCore::DatabaseCore() : db_(nullptr) {
+namespace {
+
+int64_t env_int(const char* name, int64_t fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    char* end = nullptr;
+    long long parsed = std::strtoll(value, &end, 10);
+    return (*end == '\0' && parsed >= 0) ? parsed : fallback;
+}
+
+} // anonymous namespace
+
+const ConnectionSettings& ConnectionSettings::fromEnvironment() {
+    static const ConnectionSettings settings = [] {
+        ConnectionSettings s;
+        s.busy_timeout_ms = static_cast<int>(env_int("LLM_CLI_SQLITE_BUSY_TIMEOUT_MS", s.busy_timeout_ms));
+        s.mmap_size_bytes = env_int("LLM_CLI_SQLITE_MMAP_MB", s.mmap_size_bytes >> 20) << 20;
+        s.cache_size_kib = env_int("LLM_CLI_SQLITE_CACHE_MB", s.cache_size_kib >> 10) << 10;
+        s.wal_autocheckpoint_pages = static_cast<int>(
+            env_int("LLM_CLI_SQLITE_WAL_AUTOCHECKPOINT", s.wal_autocheckpoint_pages));
+        return s;
+    }();
+    return settings;
+}
+
+DatabaseCore::DatabaseCore(Role role)
+    : db_(nullptr), busy_timeout_ms_(ConnectionSettings::fromEnvironment().busy_timeout_ms) {
     std::filesystem::path db_path = getDatabasePath();
     std::string path = db_path.string();
 
@@ -28,11 +59,22 @@ DatabaseCore::DatabaseCore() : db_(nullptr) {
     // Initialize schema and run migrations
     // Wrap in try-catch to ensure db_ is closed if initialization fails
     try {
-        initializeSchema();
-        runMigrations();
-        
-        // Enable Write-Ahead Logging (WAL) mode for better concurrency
-        exec("PRAGMA journal_mode=WAL");
+        configureConnection(role);
+        if (role == Role::Writer) {
+            // Schema and migrations only run when the recorded version is behind;
+            // an older binary on a newer database leaves both alone
+            if (storedSchemaVersion() < kSchemaVersion) {
+                initializeSchema();
+                runMigrations();
+                // Never lowers the version another process may have just recorded
+                exec("INSERT INTO settings (key, value) VALUES ('schema_version', '" + std::to_string(kSchemaVersion) +
+                     "') ON CONFLICT(key) DO UPDATE SET value = excluded.value"
+                     " WHERE CAST(settings.value AS INTEGER) < CAST(excluded.value AS INTEGER)");
+            }
+            
+            // Enable Write-Ahead Logging (WAL) mode for better concurrency
+            exec("PRAGMA journal_mode=WAL");
+        }
     } catch (...) {
         // Initialization failed after successful open - must close handle to prevent leak
         // The destructor won't run if constructor throws, so we clean up manually
@@ -43,13 +85,20 @@ DatabaseCore::DatabaseCore() : db_(nullptr) {
 }
 
 DatabaseCore::~DatabaseCore() {
+    // Cached statements must be finalized before the connection can close
+    for (auto& [sql, statements] : statement_cache_) {
+        for (sqlite3_stmt* stmt : statements) {
+            sqlite3_finalize(stmt);
+        }
+    }
+    statement_cache_.clear();
     if (db_) {
         sqlite3_close(db_);
     }
 }
 
 void DatabaseCore::beginTransaction() {
-    exec("BEGIN");
+    exec("BEGIN IMMEDIATE");
 }
 
 void DatabaseCore::commitTransaction() {
@@ -73,6 +122,92 @@ unique_stmt_ptr DatabaseCore::prepareStatement(const std::string& sql) {
     return unique_stmt_ptr(raw_stmt);
 }
 
+CachedStatement DatabaseCore::cachedStatement(std::string_view sql) {
+    const std::string* key = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(statement_cache_mutex_);
+        auto it = statement_cache_.find(sql);
+        if (it == statement_cache_.end()) {
+            it = statement_cache_.emplace(std::string(sql), std::vector<sqlite3_stmt*>{}).first;
+        }
+        // unordered_map nodes are stable, so the key can identify the slot later
+        key = &it->first;
+        if (!it->second.empty()) {
+            sqlite3_stmt* stmt = it->second.back();
+            it->second.pop_back();
+            statement_cache_hits_.fetch_add(1, std::memory_order_relaxed);
+            return CachedStatement(this, key, stmt);
+        }
+    }
+
+    sqlite3_stmt* raw_stmt = nullptr;
+    if (sqlite3_prepare_v3(db_, key->c_str(), static_cast<int>(key->size()), SQLITE_PREPARE_PERSISTENT,
+                           &raw_stmt, nullptr) != SQLITE_OK) {
+        std::string err_msg = "Failed to prepare statement: ";
+        err_msg += sqlite3_errmsg(db_);
+        if (raw_stmt) {
+            sqlite3_finalize(raw_stmt);
+        }
+        throw std::runtime_error(err_msg);
+    }
+    statement_compiles_.fetch_add(1, std::memory_order_relaxed);
+    return CachedStatement(this, key, raw_stmt);
+}
+
+void DatabaseCore::returnStatement(const std::string* sql, sqlite3_stmt* stmt) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    std::lock_guard<std::mutex> lock(statement_cache_mutex_);
+    auto it = statement_cache_.find(*sql);
+    if (it != statement_cache_.end()) {
+        it->second.push_back(stmt);
+    } else {
+        sqlite3_finalize(stmt);
+    }
+}
+
+StatementCacheStats DatabaseCore::statementCacheStats() const {
+    StatementCacheStats stats;
+    stats.hits = statement_cache_hits_.load(std::memory_order_relaxed);
+    stats.compiles = statement_compiles_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// --- CachedStatement ---
+
+CachedStatement::CachedStatement(CachedStatement&& other) noexcept
+    : core_(other.core_), sql_(other.sql_), stmt_(other.stmt_) {
+    other.core_ = nullptr;
+    other.sql_ = nullptr;
+    other.stmt_ = nullptr;
+}
+
+CachedStatement& CachedStatement::operator=(CachedStatement&& other) noexcept {
+    if (this != &other) {
+        reset();
+        core_ = other.core_;
+        sql_ = other.sql_;
+        stmt_ = other.stmt_;
+        other.core_ = nullptr;
+        other.sql_ = nullptr;
+        other.stmt_ = nullptr;
+    }
+    return *this;
+}
+
+CachedStatement::~CachedStatement() {
+    reset();
+}
+
+void CachedStatement::reset() {
+    if (core_ && stmt_) {
+        core_->returnStatement(sql_, stmt_);
+    }
+    core_ = nullptr;
+    sql_ = nullptr;
+    stmt_ = nullptr;
+}
+
 void DatabaseCore::exec(const char* sql) {
     char* err_msg_ptr = nullptr;
     if (sqlite3_exec(db_, sql, nullptr, nullptr, &err_msg_ptr) != SQLITE_OK) {
@@ -105,11 +240,70 @@ void DatabaseCore::exec(const std::string& sql) {
     }
 }
 
+void DatabaseCore::configureConnection(Role role) {
+    const ConnectionSettings& settings = ConnectionSettings::fromEnvironment();
+    sqlite3_busy_handler(db_, &DatabaseCore::busyHandler, this);
+    
+    exec("PRAGMA mmap_size=" + std::to_string(settings.mmap_size_bytes));
+    exec("PRAGMA cache_size=-" + std::to_string(settings.cache_size_kib)); // Negative: KiB, not pages
+    exec("PRAGMA temp_store=MEMORY");
+    
+    if (role == Role::Reader) {
+        exec("PRAGMA query_only=ON");
+        // Checkpoints are left to writers, so reads never pay for them
+        sqlite3_wal_autocheckpoint(db_, 0);
+        return;
+    }
+    // In WAL mode NORMAL only risks the last transactions on power loss, never corruption
+    exec("PRAGMA synchronous=NORMAL");
+    exec("PRAGMA journal_size_limit=" + std::to_string(settings.journal_size_limit_bytes));
+    sqlite3_wal_autocheckpoint(db_, settings.wal_autocheckpoint_pages);
+}
+
+int DatabaseCore::busyHandler(void* core_ptr, int attempt) {
+    auto* core = static_cast<DatabaseCore*>(core_ptr);
+    auto now = std::chrono::steady_clock::now();
+    if (attempt == 0) {
+        core->busy_since_ = now;
+    }
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(now - core->busy_since_).count();
+    if (waited >= core->busy_timeout_ms_) {
+        return 0; // Give up: the statement fails with SQLITE_BUSY
+    }
+    
+    // 1, 2, 4 ... 64 ms, each with up to 50% jitter so processes retrying the
+    // same lock do not wake in lockstep
+    thread_local std::minstd_rand jitter(std::random_device{}());
+    int64_t base_ms = int64_t{1} << std::min(attempt, 6);
+    int64_t delay_ms = base_ms / 2 + static_cast<int64_t>(jitter() % static_cast<uint32_t>(base_ms / 2 + 1));
+    delay_ms = std::min<int64_t>(std::max<int64_t>(delay_ms, 1), core->busy_timeout_ms_ - waited);
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    return 1;
+}
+
 std::filesystem::path DatabaseCore::getDatabasePath() {
     return "llm_chat_history.db";
 }
 
 
+int DatabaseCore::storedSchemaVersion() {
+    // A new database has no settings table yet: prepare fails, version 0
+    sqlite3_stmt* raw_stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, "SELECT value FROM settings WHERE key = 'schema_version'", -1, &raw_stmt,
+                           nullptr) != SQLITE_OK) {
+        if (raw_stmt) {
+            sqlite3_finalize(raw_stmt);
+        }
+        return 0;
+    }
+    unique_stmt_ptr stmt(raw_stmt);
+    if (sqlite3_step(stmt.get()) != SQLITE_ROW) {
+        return 0;
+    }
+    const unsigned char* text = sqlite3_column_text(stmt.get(), 0);
+    return text ? std::atoi(reinterpret_cast<const char*>(text)) : 0;
+}
+
 void DatabaseCore::initializeSchema() {
     // Define the database schema
     const char* schema = R"(
@@ -118,9 +312,23 @@ void DatabaseCore::initializeSchema() {
             timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,
             role TEXT CHECK(role IN ('system','user','assistant', 'tool')),
             content TEXT,
-            model_id TEXT
+            model_id TEXT,
+            tool_call_id TEXT,
+            tool_name TEXT,
+            tool_calls TEXT,
+            tool_call_ids TEXT,
+            content_blob BLOB,
+            session_id INTEGER NOT NULL DEFAULT 1
+        );
+
+        CREATE TABLE IF NOT EXISTS sessions (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            name TEXT UNIQUE,
+            created_at DATETIME DEFAULT CURRENT_TIMESTAMP
         );
 
+        INSERT OR IGNORE INTO sessions (id, name) VALUES (1, 'default');
+
         CREATE TABLE IF NOT EXISTS settings (
             key TEXT PRIMARY KEY NOT NULL,
             value TEXT
@@ -140,18 +348,42 @@ void DatabaseCore::initializeSchema() {
             per_request_limits TEXT, 
             supported_parameters TEXT, 
             created_at_api INTEGER, 
-            last_updated_db TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+            last_updated_db TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+            content_hash TEXT
+        );
+
+        CREATE TABLE IF NOT EXISTS content_cache (
+            cache_key TEXT PRIMARY KEY NOT NULL,
+            content TEXT NOT NULL,
+            etag TEXT,
+            last_modified TEXT,
+            fetched_at INTEGER NOT NULL,
+            expires_at INTEGER NOT NULL,
+            last_accessed INTEGER NOT NULL,
+            size_bytes INTEGER NOT NULL
+        );
+
+        CREATE INDEX IF NOT EXISTS idx_content_cache_last_accessed ON content_cache(last_accessed);
+
+        CREATE TABLE IF NOT EXISTS message_embeddings (
+            message_id INTEGER PRIMARY KEY,
+            model TEXT NOT NULL,
+            scale REAL NOT NULL,
+            vector BLOB NOT NULL
         );
+
+        CREATE TRIGGER IF NOT EXISTS message_embeddings_delete AFTER DELETE ON messages BEGIN
+            DELETE FROM message_embeddings WHERE message_id = old.id;
+        END;
     )";
     
     exec(schema);
 }
 
-void DatabaseCore::runMigrations() {
-    // Migration: Add model_id to messages table if it doesn't exist
-    bool model_id_column_exists = false;
+std::unordered_set<std::string> DatabaseCore::tableColumns(const char* table) {
+    std::unordered_set<std::string> columns;
     sqlite3_stmt* raw_stmt_check_column = nullptr;
-    std::string pragma_sql = "PRAGMA table_info('messages');";
+    std::string pragma_sql = std::string("PRAGMA table_info('") + table + "');";
 
     if (sqlite3_prepare_v2(db_, pragma_sql.c_str(), -1, &raw_stmt_check_column, nullptr) == SQLITE_OK) {
         unique_stmt_ptr stmt_check_column_guard(raw_stmt_check_column);
@@ -159,25 +391,120 @@ void DatabaseCore::runMigrations() {
         while (sqlite3_step(stmt_check_column_guard.get()) == SQLITE_ROW) {
             const unsigned char* col_name_text = sqlite3_column_text(stmt_check_column_guard.get(), 1);
             if (col_name_text) {
-                std::string col_name(reinterpret_cast<const char*>(col_name_text));
-                if (col_name == "model_id") {
-                    model_id_column_exists = true;
-                    break;
-                }
+                columns.insert(reinterpret_cast<const char*>(col_name_text));
             }
         }
     } else {
-        std::string err_msg = "Failed to prepare PRAGMA table_info('messages'): ";
+        std::string err_msg = "Failed to prepare " + pragma_sql + " ";
         err_msg += sqlite3_errmsg(db_);
         if (raw_stmt_check_column) {
              sqlite3_finalize(raw_stmt_check_column);
         }
         throw std::runtime_error(err_msg);
     }
+    return columns;
+}
+
+void DatabaseCore::runMigrations() {
+    // Collect the current messages columns so missing ones can be added
+    std::unordered_set<std::string> message_columns = tableColumns("messages");
+
+    // Migration: Columns added to messages after the original schema
+    // - model_id: model that produced an assistant message
+    // - tool_call_id, tool_name: structured tool results (large output is
+    //   compressed into content_blob instead of content)
+    // - tool_calls, tool_call_ids: assistant tool call requests
+    // - session_id: conversation the message belongs to (existing rows join
+    //   the default session 1)
+    static const std::pair<const char*, const char*> kAddedColumns[] = {
+        {"model_id", "TEXT"},
+        {"tool_call_id", "TEXT"},
+        {"tool_name", "TEXT"},
+        {"tool_calls", "TEXT"},
+        {"tool_call_ids", "TEXT"},
+        {"content_blob", "BLOB"},
+        {"session_id", "INTEGER NOT NULL DEFAULT 1"},
+    };
+    for (const auto& [column, type] : kAddedColumns) {
+        if (!message_columns.count(column)) {
+            exec(std::string("ALTER TABLE messages ADD COLUMN ") + column + " " + type + ";");
+        }
+    }
+
+    // Migration: models.content_hash - hash of the catalog fields, compared by
+    // ModelRepository::replaceModels to write only changed rows
+    if (!tableColumns("models").count("content_hash")) {
+        exec("ALTER TABLE models ADD COLUMN content_hash TEXT;");
+    }
 
-    if (!model_id_column_exists) {
-        exec("ALTER TABLE messages ADD COLUMN model_id TEXT;");
+    // Migration: Secondary indexes for history hot paths, all led by
+    // session_id so a session's queries never scan other sessions' rows
+    // - (session_id, id): recent messages for the context window
+    // - (session_id, role, id): latest system message lookup and the orphaned
+    //   tool message cleanup
+    // - (session_id, timestamp): getHistoryRange range scans
+    // The unscoped (timestamp) and (role, id) indexes they replace are dropped.
+    exec(R"(
+        DROP INDEX IF EXISTS idx_messages_timestamp;
+        DROP INDEX IF EXISTS idx_messages_role_id;
+        CREATE INDEX IF NOT EXISTS idx_messages_session_id ON messages(session_id, id);
+        CREATE INDEX IF NOT EXISTS idx_messages_session_role_id ON messages(session_id, role, id);
+        CREATE INDEX IF NOT EXISTS idx_messages_session_timestamp ON messages(session_id, timestamp);
+    )");
+
+    createFullTextIndex();
+}
+
+void DatabaseCore::createFullTextIndex() {
+    // External-content FTS5 index over user and assistant text (search_history).
+    // Tool output and system prompts are not indexed; the content "table" is a
+    // view of exactly the indexed rows, so integrity-check and rebuild agree
+    // with the triggers. Triggers keep it in sync with inserts, deletes (orphan
+    // cleanup) and updates (legacy conversion); existing rows are indexed once
+    // when the table is first created.
+    beginTransaction();
+    try {
+        bool exists = false;
+        {
+            auto stmt = prepareStatement("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'messages_fts'");
+            exists = sqlite3_step(stmt.get()) == SQLITE_ROW;
+        }
+        if (!exists) {
+            exec(R"(
+                CREATE VIEW IF NOT EXISTS messages_fts_source AS
+                    SELECT id, content FROM messages WHERE role IN ('user', 'assistant') AND content <> '';
+
+                CREATE VIRTUAL TABLE messages_fts USING fts5(
+                    content, content = 'messages_fts_source', content_rowid = 'id', tokenize = 'porter unicode61'
+                );
+
+                CREATE TRIGGER IF NOT EXISTS messages_fts_insert AFTER INSERT ON messages
+                WHEN new.role IN ('user', 'assistant') AND new.content <> '' BEGIN
+                    INSERT INTO messages_fts (rowid, content) VALUES (new.id, new.content);
+                END;
+
+                CREATE TRIGGER IF NOT EXISTS messages_fts_delete AFTER DELETE ON messages
+                WHEN old.role IN ('user', 'assistant') AND old.content <> '' BEGIN
+                    INSERT INTO messages_fts (messages_fts, rowid, content) VALUES ('delete', old.id, old.content);
+                END;
+
+                CREATE TRIGGER IF NOT EXISTS messages_fts_update AFTER UPDATE OF role, content ON messages BEGIN
+                    INSERT INTO messages_fts (messages_fts, rowid, content)
+                        SELECT 'delete', old.id, old.content
+                        WHERE old.role IN ('user', 'assistant') AND old.content <> '';
+                    INSERT INTO messages_fts (rowid, content)
+                        SELECT new.id, new.content
+                        WHERE new.role IN ('user', 'assistant') AND new.content <> '';
+                END;
+
+                INSERT INTO messages_fts (messages_fts) VALUES ('rebuild');
+            )");
+        }
+        commitTransaction();
+    } catch (const std::exception&) {
+        rollbackTransaction();
+        // SQLite built without FTS5: history search is unavailable, everything else works
     }
 }
 
-} // namespace database
\ No newline at end of file
+} // namespace database
@@ -1,9 +1,17 @@
 #pragma once
 
 #include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace database {
 
@@ -19,6 +27,62 @@ struct SQLiteStmtDeleter {
 // Type alias for unique pointer to sqlite3_stmt with custom deleter
 using unique_stmt_ptr = std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter>;
 
+class DatabaseCore;
+
+/**
+ * CachedStatement - RAII lease of a prepared statement from DatabaseCore's cache
+ * 
+ * On destruction (or reset()) the statement is reset, its bindings are cleared
+ * and it goes back to the cache for the next caller with the same SQL text.
+ */
+class CachedStatement {
+public:
+    CachedStatement() = default;
+    CachedStatement(CachedStatement&& other) noexcept;
+    CachedStatement& operator=(CachedStatement&& other) noexcept;
+    CachedStatement(const CachedStatement&) = delete;
+    CachedStatement& operator=(const CachedStatement&) = delete;
+    ~CachedStatement();
+
+    sqlite3_stmt* get() const { return stmt_; }
+    explicit operator bool() const { return stmt_ != nullptr; }
+
+    // Return the statement to the cache early
+    void reset();
+
+private:
+    friend class DatabaseCore;
+    CachedStatement(DatabaseCore* core, const std::string* sql, sqlite3_stmt* stmt)
+        : core_(core), sql_(sql), stmt_(stmt) {}
+
+    DatabaseCore* core_ = nullptr;
+    const std::string* sql_ = nullptr;  // Key in the owning cache (stable node storage)
+    sqlite3_stmt* stmt_ = nullptr;
+};
+
+// Counters for DatabaseCore's prepared statement cache
+struct StatementCacheStats {
+    uint64_t hits = 0;      // Checkouts served by an already compiled statement
+    uint64_t compiles = 0;  // Checkouts that had to compile (sqlite3_prepare_v3, SQLITE_PREPARE_PERSISTENT)
+};
+
+/**
+ * Per-connection tuning, read from the environment once per process:
+ * - LLM_CLI_SQLITE_BUSY_TIMEOUT_MS: how long a locked database is retried
+ * - LLM_CLI_SQLITE_MMAP_MB: memory-mapped I/O window (0 disables)
+ * - LLM_CLI_SQLITE_CACHE_MB: page cache per connection
+ * - LLM_CLI_SQLITE_WAL_AUTOCHECKPOINT: WAL pages between automatic checkpoints
+ */
+struct ConnectionSettings {
+    int busy_timeout_ms = 5000;
+    int64_t mmap_size_bytes = 256LL * 1024 * 1024;
+    int64_t cache_size_kib = 16 * 1024;
+    int wal_autocheckpoint_pages = 1000;
+    int64_t journal_size_limit_bytes = 64LL * 1024 * 1024; // WAL file is truncated back to this after checkpoints
+
+    static const ConnectionSettings& fromEnvironment();
+};
+
 /**
  * DatabaseCore - Foundation layer for SQLite database operations
  * 
@@ -28,15 +92,36 @@ using unique_stmt_ptr = std::unique_ptr<sqlite3_stmt, SQLiteStmtDeleter>;
  * - Schema initialization and migrations
  * - Transaction management
  * - SQL execution utilities
+ * - Prepared statement cache keyed by SQL text
  * - RAII wrappers for safe resource management
+ * - Lock contention: a busy handler retries with jittered exponential
+ *   backoff up to ConnectionSettings::busy_timeout_ms, so several threads
+ *   and processes can share the database file
+ * 
+ * Writer connections create the schema, run migrations and own WAL
+ * checkpointing; Reader connections are query-only and never checkpoint.
  */
 class DatabaseCore {
 public:
+    enum class Role {
+        Writer, // Schema, migrations, writes, automatic WAL checkpoints
+        Reader  // PRAGMA query_only; opened after a Writer has set up the schema
+    };
+
+    /**
+     * Version of the schema built by initializeSchema() and runMigrations(),
+     * recorded in settings.schema_version. A Writer skips both (and their
+     * PRAGMA table_info checks) when the database already has this version or
+     * a newer one, and never lowers it: bump it with every schema or
+     * migration change.
+     */
+    static constexpr int kSchemaVersion = 1;
+
     /**
-     * Constructor - Initializes database connection and schema
+     * Constructor - Initializes database connection (and, for writers, the schema)
      * @throws std::runtime_error if connection fails or schema initialization fails
      */
-    DatabaseCore();
+    explicit DatabaseCore(Role role = Role::Writer);
     
     /**
      * Destructor - Ensures proper cleanup of database connection
@@ -47,7 +132,8 @@ public:
     DatabaseCore(const DatabaseCore&) = delete;
     DatabaseCore& operator=(const DatabaseCore&) = delete;
     
-    // Transaction management
+    // Transaction management (BEGIN IMMEDIATE: the write lock is taken, or
+    // waited for, up front instead of failing with SQLITE_BUSY on first write)
     void beginTransaction();
     void commitTransaction();
     void rollbackTransaction();
@@ -60,6 +146,22 @@ public:
      */
     unique_stmt_ptr prepareStatement(const std::string& sql);
     
+    /**
+     * Check out a prepared statement from the statement cache
+     * Compiles the SQL on first use; later checkouts reuse the compiled statement.
+     * Concurrent checkouts of the same SQL get separate statements.
+     * @param sql The SQL query (used as cache key)
+     * @return CachedStatement that returns the statement to the cache when destroyed
+     * @throws std::runtime_error if preparation fails
+     * @note All checkouts must be released before the DatabaseCore is destroyed
+     */
+    CachedStatement cachedStatement(std::string_view sql);
+    
+    /**
+     * Get statement cache hit/compile counters
+     */
+    StatementCacheStats statementCacheStats() const;
+    
     /**
      * Execute a simple SQL statement without expecting results
      * @param sql The SQL statement to execute
@@ -82,7 +184,28 @@ public:
     sqlite3* getConnection() { return db_; }
 
 private:
+    friend class CachedStatement;
+
+    // Transparent hash so lookups by string_view don't allocate
+    struct SqlHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view sql) const { return std::hash<std::string_view>{}(sql); }
+    };
+
     sqlite3* db_;  // SQLite database connection handle
+    int busy_timeout_ms_;
+    std::chrono::steady_clock::time_point busy_since_;  // Start of the current lock wait
+    
+    // Idle compiled statements by SQL text
+    std::mutex statement_cache_mutex_;
+    std::unordered_map<std::string, std::vector<sqlite3_stmt*>, SqlHash, std::equal_to<>> statement_cache_;
+    std::atomic<uint64_t> statement_cache_hits_{0};
+    std::atomic<uint64_t> statement_compiles_{0};
+    
+    /**
+     * Reset a statement and put it back into the cache
+     */
+    void returnStatement(const std::string* sql, sqlite3_stmt* stmt);
     
     /**
      * Determine the appropriate database file path (cross-platform)
@@ -90,6 +213,21 @@ private:
      */
     std::filesystem::path getDatabasePath();
     
+    /**
+     * Apply the busy handler and ConnectionSettings pragmas for the role
+     */
+    void configureConnection(Role role);
+    
+    /**
+     * sqlite3_busy_handler callback: sleep with backoff, give up after the timeout
+     */
+    static int busyHandler(void* core, int attempt);
+    
+    /**
+     * settings.schema_version of this database (0 if unset or no settings table)
+     */
+    int storedSchemaVersion();
+    
     /**
      * Initialize database schema (create tables if they don't exist)
      */
@@ -99,6 +237,18 @@ private:
      * Run any necessary database migrations
      */
     void runMigrations();
+    
+    /**
+     * Create the messages_fts full-text index, its sync triggers and the
+     * initial backfill (once; skipped if SQLite lacks FTS5)
+     */
+    void createFullTextIndex();
+    
+    /**
+     * Column names of a table (PRAGMA table_info)
+     * @throws std::runtime_error if the pragma cannot be prepared
+     */
+    std::unordered_set<std::string> tableColumns(const char* table);
 };
 
 } // namespace database
\ No newline at end of file
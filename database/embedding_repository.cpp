@@ -0,0 +1,91 @@
+#include "embedding_repository.h"
+#include <stdexcept>
+
+namespace database {
+
+EmbeddingRepository::EmbeddingRepository(DatabaseCore& core)
+    : core_(core) {
+}
+
+std::vector<EmbeddingRepository::PendingText> EmbeddingRepository::pendingMessages(const std::string& model,
+                                                                                   int after_id, size_t limit) {
+    const char* sql = R"(
+        SELECT m.id, m.session_id, m.content
+        FROM messages m
+        LEFT JOIN message_embeddings e ON e.message_id = m.id
+        WHERE m.id > ?1 AND m.role IN ('user', 'assistant') AND m.content <> ''
+          AND (e.message_id IS NULL OR e.model <> ?2)
+        ORDER BY m.id DESC
+        LIMIT ?3
+    )";
+
+    auto stmt = core_.cachedStatement(sql);
+    sqlite3_bind_int(stmt.get(), 1, after_id);
+    sqlite3_bind_text(stmt.get(), 2, model.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt.get(), 3, static_cast<int>(limit));
+
+    std::vector<PendingText> pending;
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        PendingText text;
+        text.message_id = sqlite3_column_int(stmt.get(), 0);
+        text.session_id = sqlite3_column_int(stmt.get(), 1);
+        const unsigned char* content = sqlite3_column_text(stmt.get(), 2);
+        text.content = content ? reinterpret_cast<const char*>(content) : "";
+        pending.push_back(std::move(text));
+    }
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("Failed to list messages to embed: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    return pending;
+}
+
+bool EmbeddingRepository::storeEmbedding(int message_id, const std::string& model, float scale,
+                                         const std::vector<int8_t>& vector) {
+    // Skipped if the message is not in the table (deleted while it was being
+    // embedded, or still queued in another connection's write-behind queue)
+    auto stmt = core_.cachedStatement(R"(
+        INSERT OR REPLACE INTO message_embeddings (message_id, model, scale, vector)
+        SELECT ?1, ?2, ?3, ?4 WHERE EXISTS (SELECT 1 FROM messages WHERE id = ?1)
+    )");
+    sqlite3_bind_int(stmt.get(), 1, message_id);
+    sqlite3_bind_text(stmt.get(), 2, model.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_double(stmt.get(), 3, scale);
+    sqlite3_bind_blob(stmt.get(), 4, vector.data(), static_cast<int>(vector.size()), SQLITE_STATIC);
+
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+        throw std::runtime_error("Failed to store embedding: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    return sqlite3_changes(core_.getConnection()) > 0;
+}
+
+void EmbeddingRepository::forEachEmbedding(const std::string& model,
+                                           const std::function<void(int, int, float, const int8_t*, size_t)>& visit) {
+    const char* sql = R"(
+        SELECT e.message_id, m.session_id, e.scale, e.vector
+        FROM message_embeddings e
+        JOIN messages m ON m.id = e.message_id
+        WHERE e.model = ?
+        ORDER BY e.message_id
+    )";
+
+    auto stmt = core_.cachedStatement(sql);
+    sqlite3_bind_text(stmt.get(), 1, model.c_str(), -1, SQLITE_STATIC);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        const void* blob = sqlite3_column_blob(stmt.get(), 3);
+        size_t dims = static_cast<size_t>(sqlite3_column_bytes(stmt.get(), 3));
+        if (!blob || dims == 0) {
+            continue;
+        }
+        visit(sqlite3_column_int(stmt.get(), 0), sqlite3_column_int(stmt.get(), 1),
+              static_cast<float>(sqlite3_column_double(stmt.get(), 2)),
+              static_cast<const int8_t*>(blob), dims);
+    }
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("Failed to load embeddings: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+}
+
+} // namespace database
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "database_core.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace database {
+
+/**
+ * EmbeddingRepository - Stored message embeddings (message_embeddings)
+ *
+ * Responsibilities:
+ * - Finding user and assistant messages not yet embedded with a model
+ * - Storing quantized vectors (int8 components plus one float scale)
+ * - Streaming every stored vector of a model to rebuild the in-memory index
+ *
+ * One vector per message: embedding a message with another model replaces it.
+ * Vectors are deleted together with their message (trigger on messages).
+ */
+class EmbeddingRepository {
+public:
+    // A message waiting to be embedded
+    struct PendingText {
+        int message_id = 0;
+        int session_id = 0;
+        std::string content;
+    };
+
+    /**
+     * Constructor
+     * @param core Reference to DatabaseCore for connection access
+     */
+    explicit EmbeddingRepository(DatabaseCore& core);
+
+    /**
+     * User and assistant messages without an embedding from `model`, newest first
+     * @param model Embedding model id
+     * @param after_id Only messages with a larger id (0 = all)
+     * @param limit Maximum number of messages
+     * @throws std::runtime_error if the query fails
+     */
+    std::vector<PendingText> pendingMessages(const std::string& model, int after_id, size_t limit);
+
+    /**
+     * Insert or replace the embedding of a message
+     * @param vector int8 components; the value of component i is vector[i] * scale
+     * @return false if the message does not exist (deleted, or not committed yet)
+     * @throws std::runtime_error if the insert fails
+     */
+    bool storeEmbedding(int message_id, const std::string& model, float scale, const std::vector<int8_t>& vector);
+
+    /**
+     * Call `visit` for every stored embedding of `model`, oldest message first
+     * @param visit (message_id, session_id, scale, components, dimensions)
+     * @throws std::runtime_error if the query fails
+     */
+    void forEachEmbedding(const std::string& model,
+                          const std::function<void(int, int, float, const int8_t*, size_t)>& visit);
+
+private:
+    DatabaseCore& core_;  // Reference to database core for connection access
+};
+
+} // namespace database
@@ -1,96 +1,128 @@
 #include "message_repository.h"
+#include "text_compression.h"
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <stdexcept>
 
 namespace database {
 
+// Columns read by buildMessageFromRow, in order
+#define MESSAGE_COLUMNS "id, role, content, timestamp, model_id, tool_call_id, tool_name, tool_calls, tool_call_ids, content_blob, session_id"
+
+namespace {
+
+// Rows written before the structured tool columns existed keep tool results as
+// {"tool_call_id", "name", "content"} JSON and tool call requests as the raw
+// assistant message JSON. Fill the structured fields from that JSON.
+// Returns false if the row is not (valid) legacy tool JSON.
+bool structureLegacyMessage(Message& msg) {
+    try {
+        if (msg.role == "tool" && msg.tool_call_id.empty()) {
+            auto tool_json = nlohmann::json::parse(msg.content.str());
+            if (!tool_json.contains("tool_call_id") || !tool_json["tool_call_id"].is_string() ||
+                !tool_json.contains("name") || !tool_json["name"].is_string() ||
+                !tool_json.contains("content")) {
+                return false;
+            }
+            const auto& content = tool_json["content"];
+            msg.tool_call_id = tool_json["tool_call_id"].get<std::string>();
+            msg.tool_name = tool_json["name"].get<std::string>();
+            msg.content = content.is_string() ? content.get<std::string>() : content.dump();
+            return true;
+        }
+        if (msg.role == "assistant" && msg.tool_calls.empty() &&
+            !msg.content.empty() && msg.content.front() == '{') {
+            auto asst_json = nlohmann::json::parse(msg.content.str());
+            if (!asst_json.contains("tool_calls") || !asst_json["tool_calls"].is_array()) {
+                return false;
+            }
+            std::string ids;
+            for (const auto& tool_call : asst_json["tool_calls"]) {
+                if (tool_call.contains("id") && tool_call["id"].is_string()) {
+                    if (!ids.empty()) ids += '\n';
+                    ids += tool_call["id"].get<std::string>();
+                }
+            }
+            msg.tool_calls = asst_json["tool_calls"].dump();
+            msg.tool_call_ids = std::move(ids);
+            const auto& content = asst_json.value("content", nlohmann::json());
+            msg.content = content.is_string() ? content.get<std::string>() : std::string();
+            return true;
+        }
+    } catch (const nlohmann::json::exception&) {
+        // Not JSON - an ordinary message (or an invalid tool record)
+    }
+    return false;
+}
+
+void bindOptionalText(sqlite3_stmt* stmt, int index, const SharedText& text) {
+    if (text.empty()) {
+        sqlite3_bind_null(stmt, index);
+    } else {
+        sqlite3_bind_text(stmt, index, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+    }
+}
+
+} // anonymous namespace
+
 MessageRepository::MessageRepository(DatabaseCore& core)
     : core_(core) {
 }
 
-void MessageRepository::insertUserMessage(const std::string& content) {
-    Message msg;
-    msg.role = "user";
-    msg.content = content;
-    msg.model_id = std::nullopt;
-    insertMessage(msg);
+int MessageRepository::insertUserMessage(int session_id, const std::string& content) {
+    return insertRow(0, session_id, "user", content, nullptr, nullptr);
 }
 
-void MessageRepository::insertAssistantMessage(const std::string& content, const std::string& model_id) {
-    Message msg;
-    msg.role = "assistant";
-    msg.content = content;
-    msg.model_id = model_id.empty() ? std::nullopt : std::make_optional(model_id);
-    insertMessage(msg);
+int MessageRepository::insertAssistantMessage(int session_id, const std::string& content, const std::string& model_id) {
+    return insertRow(0, session_id, "assistant", content, model_id.empty() ? nullptr : &model_id, nullptr);
+}
+
+int MessageRepository::insertAssistantToolCalls(int session_id, const Message& msg) {
+    validateToolCallRequest(msg);
+    return insertRow(0, session_id, "assistant", msg.content, msg.model_id ? &msg.model_id->str() : nullptr, &msg);
 }
 
-void MessageRepository::insertToolMessage(const std::string& content) {
-    // Validate tool message format before insertion
-    validateToolMessage(content);
+int MessageRepository::insertToolMessage(int session_id, const Message& msg) {
+    // Validate tool message fields before insertion
+    validateToolMessage(msg);
     
-    Message msg;
-    msg.role = "tool";
-    msg.content = content;
-    msg.model_id = std::nullopt;
-    insertMessage(msg);
+    return insertRow(0, session_id, "tool", msg.content, nullptr, &msg);
 }
 
-std::vector<Message> MessageRepository::getContextHistory(size_t max_pairs) {
+std::vector<Message> MessageRepository::getContextHistory(int session_id, size_t max_pairs) {
     // First, get the most recent system message
-    const std::string system_sql = "SELECT id, role, content, timestamp, model_id FROM messages WHERE role='system' ORDER BY id DESC LIMIT 1";
+    const std::string system_sql =
+        "SELECT " MESSAGE_COLUMNS " FROM messages WHERE session_id = ? AND role = 'system' ORDER BY id DESC LIMIT 1";
     
-    auto system_stmt = core_.prepareStatement(system_sql);
+    auto system_stmt = core_.cachedStatement(system_sql);
+    sqlite3_bind_int(system_stmt.get(), 1, session_id);
     
     std::vector<Message> history;
+    history.reserve(max_pairs * 2 + 1);
     if (sqlite3_step(system_stmt.get()) == SQLITE_ROW) {
-        Message system_msg;
-        system_msg.id = sqlite3_column_int(system_stmt.get(), 0);
-        system_msg.role = reinterpret_cast<const char*>(sqlite3_column_text(system_stmt.get(), 1));
-        system_msg.content = reinterpret_cast<const char*>(sqlite3_column_text(system_stmt.get(), 2));
-        const unsigned char* ts = sqlite3_column_text(system_stmt.get(), 3);
-        system_msg.timestamp = ts ? reinterpret_cast<const char*>(ts) : "";
-        
-        if (sqlite3_column_type(system_stmt.get(), 4) != SQLITE_NULL) {
-            system_msg.model_id = reinterpret_cast<const char*>(sqlite3_column_text(system_stmt.get(), 4));
-        } else {
-            system_msg.model_id = std::nullopt;
-        }
-        history.push_back(system_msg);
+        history.push_back(buildMessageFromRow(system_stmt.get()));
     }
     
     // Get recent user/assistant/tool messages
     const std::string msgs_sql = R"(
         WITH recent_msgs AS (
-            SELECT id, role, content, timestamp, model_id FROM messages
-            WHERE role IN ('user', 'assistant', 'tool')
+            SELECT )" MESSAGE_COLUMNS R"( FROM messages
+            WHERE session_id = ? AND role IN ('user', 'assistant', 'tool')
             ORDER BY id DESC
             LIMIT ?
         )
-        SELECT id, role, content, timestamp, model_id FROM recent_msgs ORDER BY id ASC
+        SELECT )" MESSAGE_COLUMNS R"( FROM recent_msgs ORDER BY id ASC
     )";
 
-    auto msgs_stmt = core_.prepareStatement(msgs_sql);
-    sqlite3_bind_int(msgs_stmt.get(), 1, static_cast<int>(max_pairs * 2));
+    auto msgs_stmt = core_.cachedStatement(msgs_sql);
+    sqlite3_bind_int(msgs_stmt.get(), 1, session_id);
+    sqlite3_bind_int(msgs_stmt.get(), 2, static_cast<int>(max_pairs * 2));
     
-    std::vector<Message> recent_messages;
+    // Rows are built straight into the result (after the system message)
     while(sqlite3_step(msgs_stmt.get()) == SQLITE_ROW) {
-        Message msg;
-        msg.id = sqlite3_column_int(msgs_stmt.get(), 0);
-        msg.role = reinterpret_cast<const char*>(sqlite3_column_text(msgs_stmt.get(), 1));
-        msg.content = reinterpret_cast<const char*>(sqlite3_column_text(msgs_stmt.get(), 2));
-        const unsigned char* ts = sqlite3_column_text(msgs_stmt.get(), 3);
-        msg.timestamp = ts ? reinterpret_cast<const char*>(ts) : "";
-        
-        if (sqlite3_column_type(msgs_stmt.get(), 4) != SQLITE_NULL) {
-            msg.model_id = reinterpret_cast<const char*>(sqlite3_column_text(msgs_stmt.get(), 4));
-        } else {
-            msg.model_id = std::nullopt;
-        }
-        recent_messages.push_back(msg);
+        history.push_back(buildMessageFromRow(msgs_stmt.get()));
     }
     
-    history.insert(history.end(), recent_messages.begin(), recent_messages.end());
-    
     // If no messages exist, add a default system message
     if (history.empty()) {
         Message default_system_msg;
@@ -99,113 +131,354 @@ std::vector<Message> MessageRepository::getContextHistory(size_t max_pairs) {
         default_system_msg.id = 0;
         default_system_msg.timestamp = "";
         default_system_msg.model_id = std::nullopt;
-        history.push_back(default_system_msg);
+        default_system_msg.session_id = session_id;
+        history.push_back(std::move(default_system_msg));
     }
     
     return history;
 }
 
-std::vector<Message> MessageRepository::getHistoryRange(const std::string& start_time,
+std::vector<Message> MessageRepository::getHistoryRange(int session_id,
+                                                         const std::string& start_time,
                                                          const std::string& end_time,
                                                          size_t limit) {
     const char* sql = R"(
-        SELECT id, role, content, timestamp, model_id FROM messages
-        WHERE timestamp BETWEEN ? AND ?
+        SELECT )" MESSAGE_COLUMNS R"( FROM messages
+        WHERE session_id = ? AND timestamp BETWEEN ? AND ?
         ORDER BY timestamp ASC
         LIMIT ?
     )";
     
-    auto stmt = core_.prepareStatement(sql);
+    auto stmt = core_.cachedStatement(sql);
     
-    sqlite3_bind_text(stmt.get(), 1, start_time.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt.get(), 2, end_time.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt.get(), 3, static_cast<int>(limit));
+    sqlite3_bind_int(stmt.get(), 1, session_id);
+    sqlite3_bind_text(stmt.get(), 2, start_time.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 3, end_time.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt.get(), 4, static_cast<int>(limit));
 
     std::vector<Message> history_range;
     while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
-        Message msg;
-        msg.id = sqlite3_column_int(stmt.get(), 0);
-        msg.role = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
-        msg.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 2));
-        const unsigned char* ts = sqlite3_column_text(stmt.get(), 3);
-        msg.timestamp = ts ? reinterpret_cast<const char*>(ts) : "";
-        
-        if (sqlite3_column_type(stmt.get(), 4) != SQLITE_NULL) {
-            msg.model_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 4));
-        } else {
-            msg.model_id = std::nullopt;
-        }
-        history_range.push_back(msg);
+        history_range.push_back(buildMessageFromRow(stmt.get()));
     }
     
     return history_range;
 }
 
-void MessageRepository::cleanupOrphanedToolMessages() {
+std::vector<HistorySearchHit> MessageRepository::searchHistory(const std::string& match, int session_id,
+                                                               size_t limit, size_t offset) {
+    const char* sql = R"(
+        SELECT m.id, m.session_id, m.role, m.timestamp,
+               snippet(messages_fts, 0, '**', '**', '...', 24)
+        FROM messages_fts
+        JOIN messages m ON m.id = messages_fts.rowid
+        WHERE messages_fts MATCH ?1 AND (?2 = 0 OR m.session_id = ?2)
+        ORDER BY messages_fts.rank
+        LIMIT ?3 OFFSET ?4
+    )";
+    
+    auto stmt = core_.cachedStatement(sql);
+    sqlite3_bind_text(stmt.get(), 1, match.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt.get(), 2, session_id);
+    sqlite3_bind_int(stmt.get(), 3, static_cast<int>(limit));
+    sqlite3_bind_int(stmt.get(), 4, static_cast<int>(offset));
+    
+    auto columnString = [&stmt](int column) -> std::string {
+        const unsigned char* text = sqlite3_column_text(stmt.get(), column);
+        return text ? reinterpret_cast<const char*>(text) : "";
+    };
+    
+    std::vector<HistorySearchHit> hits;
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        HistorySearchHit hit;
+        hit.id = sqlite3_column_int(stmt.get(), 0);
+        hit.session_id = sqlite3_column_int(stmt.get(), 1);
+        hit.role = columnString(2);
+        hit.timestamp = columnString(3);
+        hit.snippet = columnString(4);
+        hits.push_back(std::move(hit));
+    }
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("History search failed: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    return hits;
+}
+
+std::vector<Message> MessageRepository::getMessagesById(const std::vector<int>& ids) {
+    if (ids.empty()) {
+        return {};
+    }
+    // One statement for any number of ids: the ids are bound as a JSON array
+    std::string id_list = "[";
+    for (size_t i = 0; i < ids.size(); ++i) {
+        id_list += (i ? "," : "") + std::to_string(ids[i]);
+    }
+    id_list += "]";
+    
+    auto stmt = core_.cachedStatement(
+        "SELECT " MESSAGE_COLUMNS " FROM messages WHERE id IN (SELECT value FROM json_each(?))");
+    sqlite3_bind_text(stmt.get(), 1, id_list.c_str(), -1, SQLITE_STATIC);
+    
+    std::vector<Message> found;
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        found.push_back(buildMessageFromRow(stmt.get()));
+    }
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("Failed to fetch messages: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    
+    std::vector<Message> ordered;
+    ordered.reserve(found.size());
+    for (int id : ids) {
+        auto it = std::find_if(found.begin(), found.end(), [id](const Message& msg) { return msg.id == id; });
+        if (it != found.end()) {
+            ordered.push_back(*it);
+        }
+    }
+    return ordered;
+}
+
+void MessageRepository::cleanupOrphanedToolMessages(int session_id) {
+    // A tool message is kept only if the closest preceding assistant message
+    // of its session requested tools. A running MAX over the
+    // (session_id, role, id) index finds that assistant for every tool row in
+    // one ordered pass, replacing the per-row correlated COUNT(*) over
+    // intervening assistant messages.
     const char* sql = R"(
         DELETE FROM messages
-        WHERE role = 'tool'
-        AND id NOT IN (
+        WHERE id IN (
             SELECT t.id
-            FROM messages t
-            JOIN messages a ON a.id < t.id
+            FROM (
+                SELECT id, role,
+                       MAX(CASE WHEN role = 'assistant' THEN id END)
+                           OVER (ORDER BY id ROWS UNBOUNDED PRECEDING) AS owner_id
+                FROM messages
+                WHERE session_id = ? AND role IN ('assistant', 'tool')
+            ) t
+            LEFT JOIN messages a ON a.id = t.owner_id
             WHERE t.role = 'tool'
-              AND a.role = 'assistant'
-              AND (a.content LIKE '%"tool_calls"%' OR a.content LIKE '%<function>%')
-              AND (
-                  SELECT COUNT(*)
-                  FROM messages intervening_a
-                  WHERE intervening_a.id > a.id AND intervening_a.id < t.id AND intervening_a.role = 'assistant'
-              ) = 0
+              AND (a.id IS NULL
+                   OR NOT (a.tool_calls IS NOT NULL
+                           OR COALESCE(a.content, '') LIKE '%"tool_calls"%'
+                           OR COALESCE(a.content, '') LIKE '%<function>%'))
         )
     )";
     
-    try {
-        core_.exec(sql);
-    } catch (const std::exception& e) {
-        throw;
+    auto stmt = core_.cachedStatement(sql);
+    sqlite3_bind_int(stmt.get(), 1, session_id);
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+        throw std::runtime_error("Orphaned tool message cleanup failed: " +
+                                 std::string(sqlite3_errmsg(core_.getConnection())));
     }
 }
 
-void MessageRepository::insertMessage(const Message& msg) {
-    const char* sql = "INSERT INTO messages (role, content, model_id) VALUES (?, ?, ?)";
-    
-    auto stmt = core_.prepareStatement(sql);
+int MessageRepository::insertMessage(const Message& msg) {
+    bool structured = msg.isToolResult() || msg.isToolCallRequest();
+    return insertRow(msg.id, msg.session_id, msg.role, msg.content, msg.model_id ? &msg.model_id->str() : nullptr,
+                     structured ? &msg : nullptr);
+}
+
+int MessageRepository::insertRow(int id, int session_id, std::string_view role, std::string_view content,
+                                 const std::string* model_id, const Message* tool_fields) {
+    // Large tool output is stored compressed instead of as TEXT
+    std::string blob;
+    if (tool_fields && role == "tool" && content.size() >= kCompressMinBytes) {
+        blob = compressText(content);
+    }
     
-    sqlite3_bind_text(stmt.get(), 1, msg.role.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt.get(), 2, msg.content.c_str(), -1, SQLITE_STATIC);
+    // Bound in place (SQLITE_STATIC) - the caller's buffers outlive the step
+    auto bindFields = [&](sqlite3_stmt* stmt, int first) {
+        sqlite3_bind_text(stmt, first, role.data(), static_cast<int>(role.size()), SQLITE_STATIC);
+        if (blob.empty()) {
+            sqlite3_bind_text(stmt, first + 1, content.data(), static_cast<int>(content.size()), SQLITE_STATIC);
+            sqlite3_bind_null(stmt, first + 7);
+        } else {
+            sqlite3_bind_text(stmt, first + 1, "", 0, SQLITE_STATIC); // Text lives in content_blob
+            sqlite3_bind_blob(stmt, first + 7, blob.data(), static_cast<int>(blob.size()), SQLITE_STATIC);
+        }
+        
+        if (model_id) {
+            sqlite3_bind_text(stmt, first + 2, model_id->c_str(), -1, SQLITE_STATIC);
+        } else {
+            sqlite3_bind_null(stmt, first + 2);
+        }
+        
+        static const Message kNoToolFields;
+        const Message& fields = tool_fields ? *tool_fields : kNoToolFields;
+        bindOptionalText(stmt, first + 3, fields.tool_call_id);
+        bindOptionalText(stmt, first + 4, fields.tool_name);
+        bindOptionalText(stmt, first + 5, fields.tool_calls);
+        bindOptionalText(stmt, first + 6, fields.tool_call_ids);
+        sqlite3_bind_int(stmt, first + 8, session_id);
+    };
     
-    if (msg.model_id.has_value()) {
-        sqlite3_bind_text(stmt.get(), 3, msg.model_id.value().c_str(), -1, SQLITE_STATIC);
-    } else {
-        sqlite3_bind_null(stmt.get(), 3);
+    if (id != 0) {
+        // Id reserved by the caller (write-behind, see reserveMessageId())
+        auto stmt = core_.cachedStatement(R"(
+            INSERT INTO messages (id, role, content, model_id, tool_call_id, tool_name, tool_calls, tool_call_ids, content_blob, session_id)
+            VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+        )");
+        sqlite3_bind_int(stmt.get(), 1, id);
+        bindFields(stmt.get(), 2);
+        
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
+            throw std::runtime_error("Insert of message " + std::to_string(id) + " failed: " +
+                                     std::string(sqlite3_errmsg(core_.getConnection())));
+        }
+        return id;
     }
+    
+    const char* sql = R"(
+        INSERT INTO messages (role, content, model_id, tool_call_id, tool_name, tool_calls, tool_call_ids, content_blob, session_id)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)
+    )";
+    
+    auto stmt = core_.cachedStatement(sql);
+    bindFields(stmt.get(), 1);
 
     if(sqlite3_step(stmt.get()) != SQLITE_DONE) {
         throw std::runtime_error("Insert failed: " + std::string(sqlite3_errmsg(core_.getConnection())));
     }
+    return static_cast<int>(sqlite3_last_insert_rowid(core_.getConnection()));
 }
 
-void MessageRepository::validateToolMessage(const std::string& content) {
+int MessageRepository::maxMessageId() {
+    // AUTOINCREMENT never reuses ids, so deleted rows still count
+    const char* sql = R"(
+        SELECT MAX(COALESCE((SELECT MAX(id) FROM messages), 0),
+                   COALESCE((SELECT seq FROM sqlite_sequence WHERE name = 'messages'), 0))
+    )";
+    
+    auto stmt = core_.cachedStatement(sql);
+    if (sqlite3_step(stmt.get()) != SQLITE_ROW) {
+        throw std::runtime_error("Failed to read max message id: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    return sqlite3_column_int(stmt.get(), 0);
+}
+
+int MessageRepository::reserveMessageId() {
+    // sqlite_sequence is the counter AUTOINCREMENT inserts take ids from; it
+    // has no unique key on name, hence update-or-insert inside the transaction
+    core_.beginTransaction();
+    try {
+        int id = maxMessageId() + 1;
+        auto update = core_.cachedStatement("UPDATE sqlite_sequence SET seq = ? WHERE name = 'messages'");
+        sqlite3_bind_int(update.get(), 1, id);
+        if (sqlite3_step(update.get()) != SQLITE_DONE) {
+            throw std::runtime_error("Failed to reserve a message id: " +
+                                     std::string(sqlite3_errmsg(core_.getConnection())));
+        }
+        if (sqlite3_changes(core_.getConnection()) == 0) {
+            auto insert = core_.cachedStatement("INSERT INTO sqlite_sequence (name, seq) VALUES ('messages', ?)");
+            sqlite3_bind_int(insert.get(), 1, id);
+            if (sqlite3_step(insert.get()) != SQLITE_DONE) {
+                throw std::runtime_error("Failed to reserve a message id: " +
+                                         std::string(sqlite3_errmsg(core_.getConnection())));
+            }
+        }
+        core_.commitTransaction();
+        return id;
+    } catch (...) {
+        core_.rollbackTransaction();
+        throw;
+    }
+}
+
+void MessageRepository::validateToolMessage(const Message& msg) {
+    if (msg.tool_call_id.empty() || msg.tool_name.empty()) {
+        throw std::runtime_error("Invalid tool message: missing required fields (tool_call_id, name). Content: " + msg.content.str());
+    }
+}
+
+void MessageRepository::validateToolCallRequest(const Message& msg) {
+    if (msg.tool_calls.empty() || msg.tool_calls.front() != '[') {
+        throw std::runtime_error("Invalid tool call request: tool_calls must be a JSON array. Got: " + msg.tool_calls.str());
+    }
+}
+
+int MessageRepository::convertLegacyToolMessages() {
+    // Batched by id so large histories are never held in memory at once
+    const char* select_sql = R"(
+        SELECT id, role, content FROM messages
+        WHERE id > ?
+          AND ((role = 'tool' AND tool_call_id IS NULL)
+               OR (role = 'assistant' AND tool_calls IS NULL AND content LIKE '{%'))
+        ORDER BY id
+        LIMIT 100
+    )";
+    const char* update_sql = R"(
+        UPDATE messages
+        SET content = ?, tool_call_id = ?, tool_name = ?, tool_calls = ?, tool_call_ids = ?, content_blob = ?
+        WHERE id = ?
+    )";
+    
+    int converted = 0;
+    int last_id = 0;
+    core_.beginTransaction();
     try {
-        auto json_content = nlohmann::json::parse(content);
-        if (!json_content.contains("tool_call_id") || !json_content["tool_call_id"].is_string() ||
-            !json_content.contains("name") || !json_content["name"].is_string() ||
-            !json_content.contains("content")) {
-            throw std::runtime_error("Invalid tool message content: missing required fields (tool_call_id, name, content) or incorrect types (id/name must be strings). Content: " + content);
+        while (true) {
+            std::vector<Message> batch;
+            {
+                auto select = core_.cachedStatement(select_sql);
+                sqlite3_bind_int(select.get(), 1, last_id);
+                while (sqlite3_step(select.get()) == SQLITE_ROW) {
+                    Message msg;
+                    msg.id = sqlite3_column_int(select.get(), 0);
+                    msg.role = reinterpret_cast<const char*>(sqlite3_column_text(select.get(), 1));
+                    const unsigned char* content = sqlite3_column_text(select.get(), 2);
+                    if (content) msg.content = reinterpret_cast<const char*>(content);
+                    batch.push_back(std::move(msg));
+                }
+            }
+            if (batch.empty()) break;
+            last_id = batch.back().id;
+            
+            for (Message& msg : batch) {
+                if (!structureLegacyMessage(msg)) continue;
+                
+                std::string blob;
+                if (msg.role == "tool" && msg.content.size() >= kCompressMinBytes) {
+                    blob = compressText(msg.content.str());
+                }
+                auto update = core_.cachedStatement(update_sql);
+                if (blob.empty()) {
+                    sqlite3_bind_text(update.get(), 1, msg.content.data(), static_cast<int>(msg.content.size()), SQLITE_STATIC);
+                    sqlite3_bind_null(update.get(), 6);
+                } else {
+                    sqlite3_bind_text(update.get(), 1, "", 0, SQLITE_STATIC); // Text lives in content_blob
+                    sqlite3_bind_blob(update.get(), 6, blob.data(), static_cast<int>(blob.size()), SQLITE_STATIC);
+                }
+                bindOptionalText(update.get(), 2, msg.tool_call_id);
+                bindOptionalText(update.get(), 3, msg.tool_name);
+                bindOptionalText(update.get(), 4, msg.tool_calls);
+                bindOptionalText(update.get(), 5, msg.tool_call_ids);
+                sqlite3_bind_int(update.get(), 7, msg.id);
+                if (sqlite3_step(update.get()) != SQLITE_DONE) {
+                    throw std::runtime_error("Failed to convert message " + std::to_string(msg.id) + ": " +
+                                             std::string(sqlite3_errmsg(core_.getConnection())));
+                }
+                ++converted;
+            }
         }
-    } catch (const nlohmann::json::parse_error& e) {
-         throw std::runtime_error("Invalid tool message content: not valid JSON. Parse error: " + std::string(e.what()) + ". Content: " + content);
-    } catch (const std::exception& e) {
-        throw std::runtime_error("Error validating tool message content: " + std::string(e.what()) + ". Content: " + content);
+        core_.commitTransaction();
+    } catch (...) {
+        core_.rollbackTransaction();
+        throw;
     }
+    return converted;
 }
 
 Message MessageRepository::buildMessageFromRow(sqlite3_stmt* stmt) {
     Message msg;
     msg.id = sqlite3_column_int(stmt, 0);
     msg.role = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-    msg.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    // Content is copied out of SQLite exactly once; later Message copies share it
+    const unsigned char* content = sqlite3_column_text(stmt, 2);
+    if (content) {
+        msg.content = SharedText(reinterpret_cast<const char*>(content),
+                                 static_cast<size_t>(sqlite3_column_bytes(stmt, 2)));
+    }
     const unsigned char* ts = sqlite3_column_text(stmt, 3);
     msg.timestamp = ts ? reinterpret_cast<const char*>(ts) : "";
     
@@ -215,6 +488,27 @@ Message MessageRepository::buildMessageFromRow(sqlite3_stmt* stmt) {
         msg.model_id = std::nullopt;
     }
     
+    auto columnText = [stmt](int index) -> SharedText {
+        const unsigned char* text = sqlite3_column_text(stmt, index);
+        if (!text) return {};
+        return SharedText(reinterpret_cast<const char*>(text), static_cast<size_t>(sqlite3_column_bytes(stmt, index)));
+    };
+    msg.tool_call_id = columnText(5);
+    msg.tool_name = columnText(6);
+    msg.tool_calls = columnText(7);
+    msg.tool_call_ids = columnText(8);
+    
+    // Large tool output is stored compressed in content_blob
+    if (sqlite3_column_type(stmt, 9) == SQLITE_BLOB) {
+        msg.content = decompressText(sqlite3_column_blob(stmt, 9), static_cast<size_t>(sqlite3_column_bytes(stmt, 9)));
+    }
+    msg.session_id = sqlite3_column_int(stmt, 10);
+    
+    // Rows not yet converted by convertLegacyToolMessages()
+    if (msg.tool_call_id.empty() && msg.tool_calls.empty()) {
+        structureLegacyMessage(msg);
+    }
+    
     return msg;
 }
 
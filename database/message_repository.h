@@ -4,6 +4,7 @@
 #include "../database.h"  // For Message struct
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace database {
 
@@ -17,6 +18,13 @@ namespace database {
  * - Time-range queries for history viewing
  * - Orphaned tool message cleanup
  * - Tool message validation
+ * 
+ * Every message belongs to a session (session_id); insertion and retrieval
+ * are scoped to one session and served by session-leading indexes.
+ * 
+ * Tool results and assistant tool call requests are stored in structured
+ * columns (tool_call_id, tool_name, tool_calls, tool_call_ids); tool output of
+ * kCompressMinBytes or more is stored compressed in content_blob.
  */
 class MessageRepository {
 public:
@@ -30,67 +38,145 @@ public:
     
     /**
      * Insert a user message into the database
+     * @param session_id Session the message belongs to
      * @param content The message content
+     * @return Row id of the new message
      */
-    void insertUserMessage(const std::string& content);
+    int insertUserMessage(int session_id, const std::string& content);
     
     /**
      * Insert an assistant message into the database
+     * @param session_id Session the message belongs to
      * @param content The message content
      * @param model_id The ID of the model that generated the response
+     * @return Row id of the new message
+     */
+    int insertAssistantMessage(int session_id, const std::string& content, const std::string& model_id);
+    
+    /**
+     * Insert an assistant message that requests tool calls
+     * @param session_id Session the message belongs to
+     * @param msg Message with tool_calls (JSON array) and tool_call_ids set
+     * @return Row id of the new message
+     * @throws std::runtime_error if tool_calls is missing
      */
-    void insertAssistantMessage(const std::string& content, const std::string& model_id);
+    int insertAssistantToolCalls(int session_id, const Message& msg);
     
     /**
-     * Insert a tool message into the database
-     * @param content The tool response content (must be valid JSON)
-     * @throws std::runtime_error if content is not valid tool message JSON
+     * Insert a tool result message into the database
+     * @param session_id Session the message belongs to
+     * @param msg Message with tool_call_id, tool_name and the raw tool output
+     * @return Row id of the new message
+     * @throws std::runtime_error if tool_call_id or tool_name is missing
      */
-    void insertToolMessage(const std::string& content);
+    int insertToolMessage(int session_id, const Message& msg);
+    
+    /**
+     * Insert a message as-is (no tool message validation)
+     * @param msg The message to insert (into msg.session_id); a non-zero msg.id
+     *            (from reserveMessageId()) is used as the row id
+     * @return Row id of the new message
+     * @throws std::runtime_error if the reserved id is already taken
+     */
+    int insertMessage(const Message& msg);
+    
+    /**
+     * Highest message id ever assigned (including deleted rows)
+     */
+    int maxMessageId();
+    
+    /**
+     * Allocate the next message id in the database itself (sqlite_sequence,
+     * under BEGIN IMMEDIATE), so ids reserved by different processes and
+     * plain AUTOINCREMENT inserts never collide
+     * @return An id above every id assigned or reserved so far
+     */
+    int reserveMessageId();
     
     // Message retrieval methods
     
     /**
      * Get recent conversation context for API calls
+     * @param session_id Session to read
      * @param max_pairs Maximum number of user-assistant message pairs to retrieve
      * @return Vector of messages including system message and recent history
      */
-    std::vector<Message> getContextHistory(size_t max_pairs = 10);
+    std::vector<Message> getContextHistory(int session_id, size_t max_pairs = 10);
     
     /**
      * Get messages within a specific time range
+     * @param session_id Session to read
      * @param start_time Start timestamp in SQLite datetime format
      * @param end_time End timestamp in SQLite datetime format
      * @param limit Maximum number of messages to retrieve
      * @return Vector of messages within the specified time range
      */
-    std::vector<Message> getHistoryRange(const std::string& start_time,
+    std::vector<Message> getHistoryRange(int session_id,
+                                          const std::string& start_time,
                                           const std::string& end_time,
                                           size_t limit = 50);
     
+    /**
+     * Ranked full-text search over user and assistant messages (messages_fts)
+     * @param match FTS5 MATCH expression
+     * @param session_id Session to search, or 0 for all sessions
+     * @param limit Maximum number of hits
+     * @param offset Hits to skip (paging)
+     * @return Hits ordered by BM25 rank, best first
+     * @throws std::runtime_error if the expression is invalid or the index is missing
+     */
+    std::vector<HistorySearchHit> searchHistory(const std::string& match, int session_id,
+                                                size_t limit, size_t offset);
+    
+    /**
+     * Messages with the given ids, in any session
+     * @param ids Row ids to fetch
+     * @return The messages found, in the order of ids (missing ids are skipped)
+     */
+    std::vector<Message> getMessagesById(const std::vector<int>& ids);
+    
     // Maintenance operations
     
     /**
      * Clean up orphaned tool messages (tool messages without preceding assistant message)
+     * @param session_id Session to clean up
      * @throws std::runtime_error if cleanup fails
      */
-    void cleanupOrphanedToolMessages();
-
-private:
-    DatabaseCore& core_;  // Reference to database core for connection access
+    void cleanupOrphanedToolMessages(int session_id);
+    
+    /**
+     * Move tool messages written as JSON envelopes (older versions) into the
+     * structured columns, compressing large tool output
+     * @return Number of rows converted
+     * @throws std::runtime_error if the conversion fails (rolled back)
+     */
+    int convertLegacyToolMessages();
     
     /**
-     * Internal helper to insert a message
-     * @param msg The message to insert
+     * Validate a tool result message (tool_call_id and tool_name are required)
+     * @throws std::runtime_error if validation fails
      */
-    void insertMessage(const Message& msg);
+    static void validateToolMessage(const Message& msg);
     
     /**
-     * Validate tool message content (must be valid JSON with required fields)
-     * @param content The tool message content to validate
+     * Validate a tool call request (tool_calls must be a JSON array)
      * @throws std::runtime_error if validation fails
      */
-    void validateToolMessage(const std::string& content);
+    static void validateToolCallRequest(const Message& msg);
+
+private:
+    DatabaseCore& core_;  // Reference to database core for connection access
+    
+    /**
+     * Insert one row, binding the caller's buffers without copying
+     * @param id Explicit row id, or 0 to let SQLite assign one
+     * @param session_id Session the message belongs to
+     * @param model_id Model that produced the message, or nullptr
+     * @param tool_fields Message supplying the structured tool columns, or nullptr
+     * @return Row id of the new message
+     */
+    int insertRow(int id, int session_id, std::string_view role, std::string_view content,
+                  const std::string* model_id, const Message* tool_fields);
     
     /**
      * Build a Message object from a database row
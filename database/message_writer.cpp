@@ -0,0 +1,169 @@
+#include "message_writer.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <stdexcept>
+
+namespace database {
+
+// Signal received by the crash-signal handlers (0 = none)
+static std::atomic<int> g_pending_signal{0};
+
+// Writer threads that will act on g_pending_signal
+static std::atomic<int> g_running_writers{0};
+
+// Queued messages are committed by the writer thread before the signal's
+// default action runs; the handler itself only records the signal. With no
+// writer running, or on a repeat while a drain is under way, the default
+// action runs at once.
+static void handleFlushSignal(int sig) {
+    if (!MessageWriter::deferSignal(sig)) {
+        std::signal(sig, SIG_DFL);
+        std::raise(sig);
+    }
+}
+
+// How often the writer checks for a pending signal while idle
+constexpr auto kSignalPollInterval = std::chrono::milliseconds(100);
+
+MessageWriter::MessageWriter(size_t max_queued, size_t max_batch)
+    : core_()
+    , messages_(core_)
+    , max_queued_(max_queued > 0 ? max_queued : 1)
+    , max_batch_(max_batch > 0 ? max_batch : 1) {
+    installSignalHandlers();
+    thread_ = std::thread([this]() { run(); });
+    g_running_writers.fetch_add(1);
+}
+
+MessageWriter::~MessageWriter() {
+    g_running_writers.fetch_sub(1);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    thread_.join();
+}
+
+int MessageWriter::reserveId() {
+    std::lock_guard<std::mutex> lock(core_mutex_);
+    return messages_.reserveMessageId();
+}
+
+void MessageWriter::enqueue(std::vector<Message> group) {
+    if (group.empty()) return;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // A group larger than the whole queue is admitted once the queue is empty
+        space_cv_.wait(lock, [&]() {
+            return queued_messages_ == 0 || queued_messages_ + group.size() <= max_queued_;
+        });
+        queued_messages_ += group.size();
+        queue_.push_back(std::move(group));
+        ++enqueued_groups_;
+    }
+    work_cv_.notify_one();
+}
+
+void MessageWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = enqueued_groups_;
+    committed_cv_.wait(lock, [&]() { return committed_groups_ >= target; });
+    if (!last_error_.empty()) {
+        std::string error = std::move(last_error_);
+        last_error_.clear();
+        throw std::runtime_error("Background message write failed: " + error);
+    }
+}
+
+void MessageWriter::run() {
+    while (true) {
+        std::vector<std::vector<Message>> batch;
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (queue_.empty() && !stopping_ && g_pending_signal.load() == 0) {
+                work_cv_.wait_for(lock, kSignalPollInterval);
+            }
+
+            // Take whole groups until the batch reaches the soft limit
+            size_t batch_messages = 0;
+            while (!queue_.empty() && (batch.empty() || batch_messages + queue_.front().size() <= max_batch_)) {
+                batch_messages += queue_.front().size();
+                batch.push_back(std::move(queue_.front()));
+                queue_.pop_front();
+            }
+            queued_messages_ -= batch_messages;
+            stop = queue_.empty() && (stopping_ || g_pending_signal.load() != 0);
+        }
+        space_cv_.notify_all();
+
+        if (!batch.empty()) {
+            writeBatch(batch);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                committed_groups_ += batch.size();
+            }
+            committed_cv_.notify_all();
+        }
+
+        if (stop) {
+            int sig = g_pending_signal.load();
+            if (sig != 0) {
+                // Everything is on disk - let the signal terminate the process
+                std::signal(sig, SIG_DFL);
+                std::raise(sig);
+            }
+            return;
+        }
+    }
+}
+
+bool MessageWriter::deferSignal(int sig) {
+    if (g_running_writers.load() == 0) {
+        return false;
+    }
+    // A repeated signal while the queue drains ends the process at once
+    int none = 0;
+    return g_pending_signal.compare_exchange_strong(none, sig);
+}
+
+void MessageWriter::writeBatch(const std::vector<std::vector<Message>>& batch) {
+    std::lock_guard<std::mutex> core_lock(core_mutex_);
+    try {
+        core_.beginTransaction();
+        try {
+            for (const auto& group : batch) {
+                for (const auto& msg : group) {
+                    // Tool messages were validated when they were queued
+                    messages_.insertMessage(msg);
+                }
+            }
+            core_.commitTransaction();
+        } catch (...) {
+            core_.rollbackTransaction();
+            throw;
+        }
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_error_ = e.what();
+    }
+}
+
+void MessageWriter::installSignalHandlers() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+        for (int sig : {SIGTERM, SIGHUP, SIGQUIT}) {
+            struct sigaction current {};
+            if (sigaction(sig, nullptr, &current) == 0 && current.sa_handler == SIG_DFL) {
+                struct sigaction action {};
+                action.sa_handler = handleFlushSignal;
+                sigemptyset(&action.sa_mask);
+                sigaction(sig, &action, nullptr);
+            }
+        }
+    });
+}
+
+} // namespace database
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "database_core.h"
+#include "message_repository.h"
+#include "../database.h"  // For Message struct
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace database {
+
+/**
+ * MessageWriter - Write-behind queue for message inserts
+ * 
+ * Responsibilities:
+ * - Own a dedicated SQLite connection and writer thread
+ * - Accept message groups into a bounded queue (callers block when it is full)
+ * - Commit everything queued so far in a single transaction per batch
+ * - flush() for read-your-writes before queries on the main connection
+ * - Drain on destruction and on SIGTERM/SIGHUP/SIGQUIT (and SIGINT, via
+ *   deferSignal()) before the process exits
+ * 
+ * A group (one enqueue call) is always committed in one transaction.
+ * Message ids are handed out at save time (reserveId()) so callers can refer
+ * to a message before the writer has inserted it. They are allocated in the
+ * database, not in memory, so processes sharing it never reserve the same id.
+ */
+class MessageWriter {
+public:
+    /**
+     * Constructor - opens the writer connection and starts the writer thread
+     * @param max_queued Maximum number of queued messages before enqueue blocks
+     * @param max_batch Soft limit on messages per transaction
+     * @throws std::runtime_error if the connection cannot be opened
+     */
+    explicit MessageWriter(size_t max_queued = 256, size_t max_batch = 64);
+    
+    /**
+     * Destructor - commits everything still queued, then stops the thread
+     */
+    ~MessageWriter();
+    
+    MessageWriter(const MessageWriter&) = delete;
+    MessageWriter& operator=(const MessageWriter&) = delete;
+    
+    /**
+     * Reserve the row id for the next message to be queued (one short write
+     * transaction on the writer connection)
+     * @return An id above every id assigned or reserved in the database
+     * @throws std::runtime_error if the id cannot be allocated
+     */
+    int reserveId();
+    
+    /**
+     * Queue messages to be inserted together
+     * @param group Messages (role user, assistant or tool) in insertion order,
+     *              each carrying an id from reserveId() and its session_id
+     */
+    void enqueue(std::vector<Message> group);
+    
+    /**
+     * Let a running writer commit its queue, then end the process with sig
+     * (default action). Async-signal-safe; for handlers that own a signal,
+     * such as TurnInterrupter's SIGINT.
+     * @return false if no writer is running or a signal is already pending:
+     *         the caller should apply the default action itself
+     */
+    static bool deferSignal(int sig);
+    
+    /**
+     * Block until everything queued so far has been committed
+     * @throws std::runtime_error if a batch failed since the last flush
+     */
+    void flush();
+
+private:
+    DatabaseCore core_;
+    MessageRepository messages_;
+    size_t max_queued_;
+    size_t max_batch_;
+    
+    std::mutex core_mutex_;                // Connection: one transaction at a time (batches, reserveId())
+    std::mutex mutex_;
+    std::condition_variable work_cv_;      // Writer waits for groups
+    std::condition_variable space_cv_;     // Producers wait for queue space
+    std::condition_variable committed_cv_; // flush() waits for commits
+    std::deque<std::vector<Message>> queue_;
+    size_t queued_messages_ = 0;
+    uint64_t enqueued_groups_ = 0;
+    uint64_t committed_groups_ = 0;
+    bool stopping_ = false;
+    std::string last_error_;
+    std::thread thread_;
+    
+    void run();
+    
+    /**
+     * Insert a batch of groups in one transaction
+     */
+    void writeBatch(const std::vector<std::vector<Message>>& batch);
+    
+    /**
+     * Install crash-signal handlers (once per process, only over SIG_DFL)
+     */
+    static void installSignalHandlers();
+};
+
+} // namespace database
@@ -1,5 +1,10 @@
 #include "model_repository.h"
+#include "fnv1a.h"
+#include <cstdint>
 #include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace database {
 
@@ -8,12 +13,17 @@ ModelRepository::ModelRepository(DatabaseCore& core)
 }
 
 void ModelRepository::insertOrUpdateModel(const ModelData& model) {
+    upsertModel(model, contentHash(model));
+}
+
+void ModelRepository::upsertModel(const ModelData& model, const std::string& content_hash) {
     const char* sql = R"(
 INSERT INTO models (
     id, name, description, context_length, pricing_prompt, pricing_completion,
     architecture_input_modalities, architecture_output_modalities, architecture_tokenizer,
-    top_provider_is_moderated, per_request_limits, supported_parameters, created_at_api
-) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+    top_provider_is_moderated, per_request_limits, supported_parameters, created_at_api,
+    content_hash
+) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
 ON CONFLICT(id) DO UPDATE SET
     name=excluded.name,
     description=excluded.description,
@@ -27,11 +37,13 @@ ON CONFLICT(id) DO UPDATE SET
     per_request_limits=excluded.per_request_limits,
     supported_parameters=excluded.supported_parameters,
     created_at_api=excluded.created_at_api,
+    content_hash=excluded.content_hash,
     last_updated_db=CURRENT_TIMESTAMP
 )";
 
-    auto stmt = core_.prepareStatement(sql);
+    auto stmt = core_.cachedStatement(sql);
     bindModelToStatement(stmt.get(), model);
+    sqlite3_bind_text(stmt.get(), 14, content_hash.c_str(), -1, SQLITE_STATIC);
 
     if (sqlite3_step(stmt.get()) != SQLITE_DONE) {
         throw std::runtime_error("insertOrUpdateModel failed: " + std::string(sqlite3_errmsg(core_.getConnection())));
@@ -42,18 +54,78 @@ void ModelRepository::clearAllModels() {
     core_.exec("DELETE FROM models;");
 }
 
-void ModelRepository::replaceModels(const std::vector<ModelData>& models) {
+std::string ModelRepository::contentHash(const ModelData& model) {
+    // FNV-1a over the fields, each terminated by a separator byte
+    uint64_t hash = kFnvOffsetBasis;
+    auto mix = [&hash](std::string_view field) {
+        hash = fnv1a_mix(fnv1a_hash(field, hash), 0x1f);
+    };
+    mix(model.id);
+    mix(model.name);
+    mix(model.description);
+    mix(std::to_string(model.context_length));
+    mix(model.pricing_prompt);
+    mix(model.pricing_completion);
+    mix(model.architecture_input_modalities);
+    mix(model.architecture_output_modalities);
+    mix(model.architecture_tokenizer);
+    mix(model.top_provider_is_moderated ? "1" : "0");
+    mix(model.per_request_limits);
+    mix(model.supported_parameters);
+    mix(std::to_string(model.created_at_api));
+    return std::to_string(hash);
+}
+
+ModelSyncResult ModelRepository::replaceModels(const std::vector<ModelData>& models) {
+    ModelSyncResult result;
     core_.beginTransaction();
     try {
-        clearAllModels();
+        // Cached rows by id; rows written before content_hash existed have none
+        // and are rewritten once
+        std::unordered_map<std::string, std::string> cached_hashes;
+        {
+            auto select = core_.cachedStatement("SELECT id, COALESCE(content_hash, '') FROM models");
+            while (sqlite3_step(select.get()) == SQLITE_ROW) {
+                cached_hashes.emplace(reinterpret_cast<const char*>(sqlite3_column_text(select.get(), 0)),
+                                      reinterpret_cast<const char*>(sqlite3_column_text(select.get(), 1)));
+            }
+        }
+        
+        std::unordered_set<std::string> seen; // ids present in the fetched list
+        seen.reserve(models.size());
         for (const auto& model : models) {
-            insertOrUpdateModel(model);
+            std::string hash = contentHash(model);
+            auto cached = cached_hashes.find(model.id);
+            if (cached == cached_hashes.end()) {
+                upsertModel(model, hash);
+                cached_hashes.emplace(model.id, hash);
+                ++result.inserted;
+            } else if (cached->second != hash) {
+                upsertModel(model, hash);
+                // A duplicate id in the fetched list already counted as inserted
+                if (!seen.count(model.id)) ++result.updated;
+                cached->second = std::move(hash);
+            } else if (!seen.count(model.id)) {
+                ++result.unchanged;
+            }
+            seen.insert(model.id);
+        }
+        
+        for (const auto& [id, hash] : cached_hashes) {
+            if (seen.count(id)) continue;
+            auto remove = core_.cachedStatement("DELETE FROM models WHERE id = ?");
+            sqlite3_bind_text(remove.get(), 1, id.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(remove.get()) != SQLITE_DONE) {
+                throw std::runtime_error("Failed to delete model '" + id + "': " + std::string(sqlite3_errmsg(core_.getConnection())));
+            }
+            ++result.deleted;
         }
         core_.commitTransaction();
     } catch (const std::exception& e) {
         core_.rollbackTransaction();
         throw std::runtime_error("Failed to replace models in DB: " + std::string(e.what()));
     }
+    return result;
 }
 
 std::vector<ModelData> ModelRepository::getAllModels() {
@@ -66,7 +138,7 @@ SELECT
 FROM models ORDER BY name ASC;
 )";
 
-    auto stmt = core_.prepareStatement(sql);
+    auto stmt = core_.cachedStatement(sql);
     
     // Helper lambda to safely get text, handling NULLs by returning empty string
     auto get_text_or_empty = [&](int col_idx) {
@@ -107,7 +179,7 @@ FROM models ORDER BY name ASC;
 std::optional<ModelData> ModelRepository::getModelById(const std::string& model_id) {
     const char* sql = "SELECT id, name, description, context_length, pricing_prompt, pricing_completion, architecture_input_modalities, architecture_output_modalities, architecture_tokenizer, top_provider_is_moderated, per_request_limits, supported_parameters, created_at_api, DATETIME(last_updated_db, 'localtime') as last_updated_db FROM models WHERE id = ?;";
     
-    auto stmt = core_.prepareStatement(sql);
+    auto stmt = core_.cachedStatement(sql);
 
     if (sqlite3_bind_text(stmt.get(), 1, model_id.c_str(), -1, SQLITE_STATIC) != SQLITE_OK) {
         throw std::runtime_error("Failed to bind model_id in getModelById: " + std::string(sqlite3_errmsg(core_.getConnection())));
@@ -165,7 +237,7 @@ std::optional<ModelData> ModelRepository::getModelById(const std::string& model_
 std::optional<std::string> ModelRepository::getModelNameById(const std::string& model_id) {
     const char* sql = "SELECT name FROM models WHERE id = ?";
     
-    auto stmt = core_.prepareStatement(sql);
+    auto stmt = core_.cachedStatement(sql);
 
     if (sqlite3_bind_text(stmt.get(), 1, model_id.c_str(), -1, SQLITE_STATIC) != SQLITE_OK) {
         throw std::runtime_error("Failed to bind model_id in getModelNameById: " + std::string(sqlite3_errmsg(core_.getConnection())));
@@ -13,7 +13,7 @@ namespace database {
  * 
  * Responsibilities:
  * - Model CRUD operations (Create, Read, Update, Delete)
- * - Bulk model replacement (atomic)
+ * - Bulk model replacement (atomic, diffed against the cached rows)
  * - Model queries by ID
  * - Model name lookup for UI display
  * - Model caching (future enhancement)
@@ -43,11 +43,18 @@ public:
     
     /**
      * Atomically replace all models in the database
-     * Uses transactions to ensure atomicity
+     * Compares each model's content hash with the cached row and writes only
+     * inserts, updates and deletes, in one transaction
      * @param models Vector of models to replace existing models with
+     * @return Number of rows inserted, updated, deleted and left unchanged
      * @throws std::runtime_error if operation fails (transaction will be rolled back)
      */
-    void replaceModels(const std::vector<ModelData>& models);
+    ModelSyncResult replaceModels(const std::vector<ModelData>& models);
+    
+    /**
+     * Hash of the catalog fields of a model (everything except last_updated_db)
+     */
+    static std::string contentHash(const ModelData& model);
     
     // Query operations
     
@@ -90,6 +97,11 @@ private:
      * @param model The model data to bind
      */
     void bindModelToStatement(sqlite3_stmt* stmt, const ModelData& model);
+    
+    /**
+     * Insert or update a model, storing its precomputed content hash
+     */
+    void upsertModel(const ModelData& model, const std::string& content_hash);
 };
 
 } // namespace database
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "reader_pool.h"
+
+namespace database {
+
+ReaderPool::Reader::Reader()
+    : core(DatabaseCore::Role::Reader)
+    , messages(core)
+    , models(core)
+    , sessions(core) {
+}
+
+ReaderPool::ReaderPool(size_t max_idle_readers)
+    : max_idle_readers_(max_idle_readers) {
+}
+
+ReaderPool::Lease ReaderPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            std::unique_ptr<Reader> reader = std::move(idle_.back());
+            idle_.pop_back();
+            return Lease(this, std::move(reader));
+        }
+    }
+    // Opened outside the lock; a new connection costs a file open and the pragmas
+    return Lease(this, std::make_unique<Reader>());
+}
+
+void ReaderPool::release(std::unique_ptr<Reader> reader) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() < max_idle_readers_) {
+            idle_.push_back(std::move(reader));
+            return;
+        }
+    }
+    // Pool is full: the reader (and its connection) is closed here, outside the lock
+}
+
+// --- Lease ---
+
+ReaderPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_), reader_(std::move(other.reader_)) {
+    other.pool_ = nullptr;
+}
+
+ReaderPool::Lease::~Lease() {
+    if (pool_ && reader_) {
+        pool_->release(std::move(reader_));
+    }
+}
+
+} // namespace database
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "database_core.h"
+#include "message_repository.h"
+#include "model_repository.h"
+#include "session_repository.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace database {
+
+/**
+ * ReaderPool - Query-only connections for concurrent reads
+ *
+ * Responsibilities:
+ * - Lease one Reader (connection plus read repositories) per concurrent caller
+ * - Keep up to max_idle readers open between leases, with their statement caches
+ *
+ * In WAL mode readers never block the writer or each other, so reads from the
+ * main thread, research workers and tool threads run in parallel instead of
+ * queueing on the writer connection. Readers see committed data only.
+ *
+ * The pool is thread-safe; each Lease is used by a single thread until it
+ * goes out of scope and the reader is returned to the pool.
+ */
+class ReaderPool {
+public:
+    struct Reader {
+        DatabaseCore core;
+        MessageRepository messages;
+        ModelRepository models;
+        SessionRepository sessions;
+
+        Reader();
+    };
+
+    // RAII lease of a pooled reader - returned to the pool on destruction
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&&) = delete;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        Reader* operator->() const { return reader_.get(); }
+        Reader& operator*() const { return *reader_; }
+
+    private:
+        friend class ReaderPool;
+        Lease(ReaderPool* pool, std::unique_ptr<Reader> reader) : pool_(pool), reader_(std::move(reader)) {}
+
+        ReaderPool* pool_;
+        std::unique_ptr<Reader> reader_;
+    };
+
+    /**
+     * Constructor
+     * @param max_idle_readers Readers kept open while not leased
+     */
+    explicit ReaderPool(size_t max_idle_readers = 8);
+
+    ReaderPool(const ReaderPool&) = delete;
+    ReaderPool& operator=(const ReaderPool&) = delete;
+
+    /**
+     * Lease an idle reader, opening a new connection if none is idle
+     * @throws std::runtime_error if the connection cannot be opened
+     */
+    Lease acquire();
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Reader>> idle_;
+    size_t max_idle_readers_;
+
+    void release(std::unique_ptr<Reader> reader);
+};
+
+} // namespace database
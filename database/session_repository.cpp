@@ -0,0 +1,99 @@
+#include "session_repository.h"
+#include <cstdlib>
+#include <stdexcept>
+
+namespace database {
+
+// Columns read by buildSessionFromRow; the per-session aggregates are range
+// scans on the (session_id, id) and (session_id, timestamp) indexes
+#define SESSION_COLUMNS \
+    "s.id, s.name, s.created_at, " \
+    "(SELECT COUNT(*) FROM messages m WHERE m.session_id = s.id), " \
+    "(SELECT MAX(m.timestamp) FROM messages m WHERE m.session_id = s.id)"
+
+SessionRepository::SessionRepository(DatabaseCore& core)
+    : core_(core) {
+}
+
+int SessionRepository::createSession(const std::string& name) {
+    auto stmt = core_.cachedStatement("INSERT INTO sessions (name) VALUES (?)");
+    if (name.empty()) {
+        sqlite3_bind_null(stmt.get(), 1);
+    } else {
+        sqlite3_bind_text(stmt.get(), 1, name.c_str(), -1, SQLITE_STATIC);
+    }
+
+    int rc = sqlite3_step(stmt.get());
+    if (rc == SQLITE_CONSTRAINT) {
+        throw std::runtime_error("A session named '" + name + "' already exists");
+    }
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("Failed to create session: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    int id = static_cast<int>(sqlite3_last_insert_rowid(core_.getConnection()));
+
+    if (name.empty()) {
+        auto rename = core_.cachedStatement("UPDATE sessions SET name = 'session-' || id WHERE id = ?");
+        sqlite3_bind_int(rename.get(), 1, id);
+        if (sqlite3_step(rename.get()) != SQLITE_DONE) {
+            throw std::runtime_error("Failed to name session: " + std::string(sqlite3_errmsg(core_.getConnection())));
+        }
+    }
+    return id;
+}
+
+std::optional<SessionInfo> SessionRepository::findSession(const std::string& name_or_id) {
+    {
+        auto stmt = core_.cachedStatement("SELECT " SESSION_COLUMNS " FROM sessions s WHERE s.name = ?");
+        sqlite3_bind_text(stmt.get(), 1, name_or_id.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            return buildSessionFromRow(stmt.get());
+        }
+    }
+
+    char* end = nullptr;
+    long id = std::strtol(name_or_id.c_str(), &end, 10);
+    if (name_or_id.empty() || *end != '\0' || id <= 0) {
+        return std::nullopt;
+    }
+    return findSessionById(static_cast<int>(id));
+}
+
+std::optional<SessionInfo> SessionRepository::findSessionById(int session_id) {
+    auto stmt = core_.cachedStatement("SELECT " SESSION_COLUMNS " FROM sessions s WHERE s.id = ?");
+    sqlite3_bind_int(stmt.get(), 1, session_id);
+    if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+        return buildSessionFromRow(stmt.get());
+    }
+    return std::nullopt;
+}
+
+std::vector<SessionInfo> SessionRepository::listSessions() {
+    auto stmt = core_.cachedStatement("SELECT " SESSION_COLUMNS " FROM sessions s ORDER BY s.id");
+    std::vector<SessionInfo> sessions;
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        sessions.push_back(buildSessionFromRow(stmt.get()));
+    }
+    if (rc != SQLITE_DONE) {
+        throw std::runtime_error("Failed to list sessions: " + std::string(sqlite3_errmsg(core_.getConnection())));
+    }
+    return sessions;
+}
+
+SessionInfo SessionRepository::buildSessionFromRow(sqlite3_stmt* stmt) {
+    auto column_string = [stmt](int column) -> std::string {
+        const unsigned char* text = sqlite3_column_text(stmt, column);
+        return text ? reinterpret_cast<const char*>(text) : "";
+    };
+
+    SessionInfo session;
+    session.id = sqlite3_column_int(stmt, 0);
+    session.name = column_string(1);
+    session.created_at = column_string(2);
+    session.message_count = sqlite3_column_int(stmt, 3);
+    session.last_active = column_string(4);
+    return session;
+}
+
+} // namespace database
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "database_core.h"
+#include "../database.h"  // For SessionInfo struct
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace database {
+
+/**
+ * SessionRepository - Conversations in the message store
+ *
+ * Responsibilities:
+ * - Session creation (named, or "session-<id>")
+ * - Lookup by name or id
+ * - Listing with per-session message counts and last activity
+ *
+ * Session 1 ("default") always exists; messages written before sessions were
+ * introduced belong to it.
+ */
+class SessionRepository {
+public:
+    static constexpr int kDefaultSessionId = 1;
+
+    /**
+     * Constructor
+     * @param core Reference to DatabaseCore for connection access
+     */
+    explicit SessionRepository(DatabaseCore& core);
+
+    /**
+     * Create a session
+     * @param name Unique session name, or empty for "session-<id>"
+     * @return Id of the new session
+     * @throws std::runtime_error if the name is already taken or the insert fails
+     */
+    int createSession(const std::string& name);
+
+    /**
+     * Look up a session by exact name, falling back to a numeric id
+     * @param name_or_id Session name or id
+     * @return The session if found, nullopt otherwise
+     */
+    std::optional<SessionInfo> findSession(const std::string& name_or_id);
+
+    /**
+     * Look up a session by id
+     * @return The session if found, nullopt otherwise
+     */
+    std::optional<SessionInfo> findSessionById(int session_id);
+
+    /**
+     * All sessions, oldest first
+     */
+    std::vector<SessionInfo> listSessions();
+
+private:
+    DatabaseCore& core_;  // Reference to database core for connection access
+
+    /**
+     * Build a SessionInfo from a row of (id, name, created_at, message_count, last_active)
+     */
+    static SessionInfo buildSessionFromRow(sqlite3_stmt* stmt);
+};
+
+} // namespace database
@@ -0,0 +1,54 @@
+#include "text_compression.h"
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace database {
+
+constexpr size_t kSizePrefixBytes = 4;
+
+std::string compressText(std::string_view text) {
+    if (text.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Text too large to compress: " + std::to_string(text.size()) + " bytes");
+    }
+    uLongf bound = compressBound(static_cast<uLong>(text.size()));
+    std::string blob(kSizePrefixBytes + bound, '\0');
+
+    uint32_t original = static_cast<uint32_t>(text.size());
+    for (size_t i = 0; i < kSizePrefixBytes; ++i) {
+        blob[i] = static_cast<char>((original >> (8 * i)) & 0xFF);
+    }
+
+    uLongf compressed_size = bound;
+    int rc = compress2(reinterpret_cast<Bytef*>(&blob[kSizePrefixBytes]), &compressed_size,
+                       reinterpret_cast<const Bytef*>(text.data()), static_cast<uLong>(text.size()),
+                       Z_DEFAULT_COMPRESSION);
+    if (rc != Z_OK) {
+        throw std::runtime_error("zlib compression failed (code " + std::to_string(rc) + ")");
+    }
+    blob.resize(kSizePrefixBytes + compressed_size);
+    return blob;
+}
+
+std::string decompressText(const void* data, size_t size) {
+    if (size < kSizePrefixBytes) {
+        throw std::runtime_error("Compressed text is truncated");
+    }
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    uint32_t original = 0;
+    for (size_t i = 0; i < kSizePrefixBytes; ++i) {
+        original |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+    }
+
+    std::string text(original, '\0');
+    uLongf text_size = original;
+    int rc = uncompress(reinterpret_cast<Bytef*>(text.data()), &text_size,
+                        bytes + kSizePrefixBytes, static_cast<uLong>(size - kSizePrefixBytes));
+    if (rc != Z_OK || text_size != original) {
+        throw std::runtime_error("Compressed text is corrupt (zlib code " + std::to_string(rc) + ")");
+    }
+    return text;
+}
+
+} // namespace database
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace database {
+
+// Text at least this long is stored compressed; shorter text stays in the TEXT column
+constexpr size_t kCompressMinBytes = 512;
+
+/**
+ * Compress text for a BLOB column (zlib stream prefixed with the original
+ * size as 4 little-endian bytes)
+ * @throws std::runtime_error if compression fails
+ */
+std::string compressText(std::string_view text);
+
+/**
+ * Restore text written by compressText()
+ * @throws std::runtime_error if the blob is truncated or corrupt
+ */
+std::string decompressText(const void* data, size_t size);
+
+} // namespace database
@@ -0,0 +1,363 @@
+#include "embedding_index.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <queue>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define LLM_CLI_EMBEDDING_AVX2 1
+#endif
+
+namespace {
+
+// Plain int8 dot product; at -O3 the compiler vectorizes this for the
+// baseline instruction set (SSE2 on x86-64, NEON on aarch64)
+int32_t dot_generic(const int8_t* a, const int8_t* b, size_t n) {
+    int32_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+    }
+    return sum;
+}
+
+#ifdef LLM_CLI_EMBEDDING_AVX2
+// 32 int8 pairs per iteration: sign-extend to int16, then vpmaddwd sums
+// adjacent products into int32 lanes (at most 2 * 127 * 127, no overflow)
+__attribute__((target("avx2")))
+int32_t dot_avx2(const int8_t* a, const int8_t* b, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i a_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(va));
+        __m256i a_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(va, 1));
+        __m256i b_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(vb));
+        __m256i b_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(vb, 1));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a_lo, b_lo));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a_hi, b_hi));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_hadd_epi32(sum, sum);
+    sum = _mm_hadd_epi32(sum, sum);
+    int32_t total = _mm_cvtsi128_si32(sum);
+    for (; i < n; ++i) {
+        total += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+    }
+    return total;
+}
+#endif
+
+using DotKernel = int32_t (*)(const int8_t*, const int8_t*, size_t);
+
+struct Kernel {
+    DotKernel dot;
+    const char* name;
+};
+
+Kernel select_kernel() {
+#ifdef LLM_CLI_EMBEDDING_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return {dot_avx2, "avx2"};
+    }
+#endif
+    return {dot_generic, "generic"};
+}
+
+// Chosen once at startup from the running CPU, not the build machine
+const Kernel kernel = select_kernel();
+
+// Search breadth on layer 0 for a query asking for `limit` hits
+size_t search_breadth(size_t limit) {
+    return std::max<size_t>(64, limit * 4);
+}
+
+} // namespace
+
+EmbeddingIndex::EmbeddingIndex(size_t hnsw_min_size)
+    : hnsw_min_size_(std::max<size_t>(hnsw_min_size, 1)) {
+}
+
+const char* EmbeddingIndex::kernelName() {
+    return kernel.name;
+}
+
+EmbeddingIndex::Quantized EmbeddingIndex::quantize(const std::vector<float>& vector) {
+    Quantized quantized;
+    quantized.data.assign(vector.size(), 0);
+
+    double norm_squared = 0;
+    float max_abs = 0;
+    for (float value : vector) {
+        norm_squared += static_cast<double>(value) * value;
+        max_abs = std::max(max_abs, std::fabs(value));
+    }
+    if (norm_squared <= 0 || max_abs <= 0) {
+        return quantized;
+    }
+
+    // Largest normalized component maps to +-127
+    float norm = static_cast<float>(std::sqrt(norm_squared));
+    quantized.scale = max_abs / norm / 127.0f;
+    float to_int8 = 127.0f / max_abs;
+    for (size_t i = 0; i < vector.size(); ++i) {
+        quantized.data[i] = static_cast<int8_t>(std::lround(vector[i] * to_int8));
+    }
+    return quantized;
+}
+
+size_t EmbeddingIndex::size() const {
+    std::shared_lock lock(mutex_);
+    return message_ids_.size();
+}
+
+size_t EmbeddingIndex::dimensions() const {
+    std::shared_lock lock(mutex_);
+    return dims_;
+}
+
+bool EmbeddingIndex::usesGraph() const {
+    std::shared_lock lock(mutex_);
+    return graph_rows_ > 0 && graph_rows_ == message_ids_.size();
+}
+
+float EmbeddingIndex::similarity(const Quantized& query, uint32_t index) const {
+    return static_cast<float>(kernel.dot(query.data.data(), row(index), dims_)) * query.scale * scales_[index];
+}
+
+float EmbeddingIndex::similarity(uint32_t a, uint32_t b) const {
+    return static_cast<float>(kernel.dot(row(a), row(b), dims_)) * scales_[a] * scales_[b];
+}
+
+bool EmbeddingIndex::matches(uint32_t index, int session_id, int max_message_id) const {
+    return (session_id == 0 || session_ids_[index] == session_id)
+        && (max_message_id == 0 || message_ids_[index] < max_message_id);
+}
+
+bool EmbeddingIndex::add(int message_id, int session_id, const Quantized& vector) {
+    if (vector.data.empty()) {
+        return false;
+    }
+    std::unique_lock lock(mutex_);
+    if (dims_ == 0) {
+        dims_ = vector.data.size();
+    }
+    if (vector.data.size() != dims_) {
+        return false;
+    }
+
+    auto existing = row_of_message_.find(message_id);
+    if (existing != row_of_message_.end()) {
+        // Re-embedded message: overwrite in place; its graph links stay approximate
+        uint32_t index = existing->second;
+        std::copy(vector.data.begin(), vector.data.end(), matrix_.begin() + static_cast<size_t>(index) * dims_);
+        scales_[index] = vector.scale;
+        session_ids_[index] = session_id;
+        return true;
+    }
+
+    uint32_t index = static_cast<uint32_t>(message_ids_.size());
+    matrix_.insert(matrix_.end(), vector.data.begin(), vector.data.end());
+    scales_.push_back(vector.scale);
+    message_ids_.push_back(message_id);
+    session_ids_.push_back(session_id);
+    row_of_message_.emplace(message_id, index);
+
+    if (message_ids_.size() >= hnsw_min_size_) {
+        for (size_t inserted = 0; inserted < Graph::kInsertsPerAdd && graph_rows_ < message_ids_.size(); ++inserted) {
+            graphInsert(graph_rows_++);
+        }
+    }
+    return true;
+}
+
+std::vector<EmbeddingIndex::Hit> EmbeddingIndex::search(const Quantized& query, size_t limit,
+                                                        int session_id, int max_message_id) const {
+    std::shared_lock lock(mutex_);
+    if (limit == 0 || dims_ == 0 || query.data.size() != dims_) {
+        return {};
+    }
+    if (graph_rows_ > 0 && graph_rows_ == message_ids_.size()) {
+        std::vector<Hit> hits = graphSearch(query, limit, session_id, max_message_id);
+        if (hits.size() >= limit) {
+            return hits;
+        }
+        // The filter removed most of the graph's candidates (e.g. a small
+        // session in a large index); scan so no match is missed
+    }
+    return scan(query, limit, session_id, max_message_id);
+}
+
+std::vector<EmbeddingIndex::Hit> EmbeddingIndex::scan(const Quantized& query, size_t limit,
+                                                      int session_id, int max_message_id) const {
+    // Min-heap of the best `limit` rows seen so far
+    using Scored = std::pair<float, uint32_t>;
+    std::priority_queue<Scored, std::vector<Scored>, std::greater<Scored>> best;
+    const uint32_t rows = static_cast<uint32_t>(message_ids_.size());
+    for (uint32_t index = 0; index < rows; ++index) {
+        if (!matches(index, session_id, max_message_id)) {
+            continue;
+        }
+        float score = similarity(query, index);
+        if (best.size() < limit) {
+            best.emplace(score, index);
+        } else if (score > best.top().first) {
+            best.pop();
+            best.emplace(score, index);
+        }
+    }
+
+    std::vector<Hit> hits(best.size());
+    for (size_t i = hits.size(); i-- > 0;) {
+        auto [score, index] = best.top();
+        best.pop();
+        hits[i] = {message_ids_[index], session_ids_[index], score};
+    }
+    return hits;
+}
+
+std::vector<EmbeddingIndex::Hit> EmbeddingIndex::graphSearch(const Quantized& query, size_t limit,
+                                                             int session_id, int max_message_id) const {
+    auto similarity_to = [&](uint32_t index) { return similarity(query, index); };
+
+    // Greedy descent through the upper layers, then a wide search on layer 0
+    uint32_t entry = static_cast<uint32_t>(graph_.entry_point);
+    for (int layer = graph_.top_layer; layer > 0; --layer) {
+        entry = searchLayer(similarity_to, entry, 1, layer).front().second;
+    }
+    bool filtered = session_id != 0 || max_message_id != 0;
+    size_t breadth = search_breadth(filtered ? limit * 4 : limit);
+    std::vector<std::pair<float, uint32_t>> candidates = searchLayer(similarity_to, entry, breadth, 0);
+
+    std::vector<Hit> hits;
+    for (const auto& [score, index] : candidates) {
+        if (hits.size() == limit) {
+            break;
+        }
+        if (matches(index, session_id, max_message_id)) {
+            hits.push_back({message_ids_[index], session_ids_[index], score});
+        }
+    }
+    return hits;
+}
+
+template <typename Similarity>
+std::vector<std::pair<float, uint32_t>> EmbeddingIndex::searchLayer(const Similarity& similarity_to, uint32_t entry,
+                                                                    size_t ef, int layer) const {
+    using Scored = std::pair<float, uint32_t>;
+    std::priority_queue<Scored> candidates;                                       // Best first
+    std::priority_queue<Scored, std::vector<Scored>, std::greater<Scored>> found; // Worst first
+    std::vector<bool> visited(graph_.links.size(), false);
+
+    float entry_score = similarity_to(entry);
+    candidates.emplace(entry_score, entry);
+    found.emplace(entry_score, entry);
+    visited[entry] = true;
+
+    while (!candidates.empty()) {
+        auto [score, node] = candidates.top();
+        if (found.size() >= ef && score < found.top().first) {
+            break;
+        }
+        candidates.pop();
+        for (uint32_t neighbour : graph_.links[node][layer]) {
+            if (visited[neighbour]) {
+                continue;
+            }
+            visited[neighbour] = true;
+            float neighbour_score = similarity_to(neighbour);
+            if (found.size() < ef || neighbour_score > found.top().first) {
+                candidates.emplace(neighbour_score, neighbour);
+                found.emplace(neighbour_score, neighbour);
+                if (found.size() > ef) {
+                    found.pop();
+                }
+            }
+        }
+    }
+
+    std::vector<Scored> result(found.size());
+    for (size_t i = result.size(); i-- > 0;) {
+        result[i] = found.top();
+        found.pop();
+    }
+    return result;
+}
+
+void EmbeddingIndex::selectNeighbours(std::vector<std::pair<float, uint32_t>>& candidates, size_t max_links) const {
+    // HNSW neighbour heuristic: skip a candidate that is closer to an already
+    // selected neighbour than to the base node, so links spread across
+    // clusters; top up with the skipped ones if fewer than max_links remain
+    std::sort(candidates.begin(), candidates.end(), std::greater<>());
+    std::vector<std::pair<float, uint32_t>> selected;
+    std::vector<std::pair<float, uint32_t>> skipped;
+    for (const auto& candidate : candidates) {
+        if (selected.size() == max_links) {
+            break;
+        }
+        bool diverse = std::none_of(selected.begin(), selected.end(), [&](const auto& kept) {
+            return similarity(candidate.second, kept.second) > candidate.first;
+        });
+        (diverse ? selected : skipped).push_back(candidate);
+    }
+    for (size_t i = 0; i < skipped.size() && selected.size() < max_links; ++i) {
+        selected.push_back(skipped[i]);
+    }
+    candidates = std::move(selected);
+}
+
+void EmbeddingIndex::graphInsert(uint32_t index) {
+    // Layer drawn from an exponential distribution with mL = 1 / ln(M)
+    std::uniform_real_distribution<double> uniform(std::nextafter(0.0, 1.0), 1.0);
+    int layer = static_cast<int>(-std::log(uniform(graph_.rng)) / std::log(static_cast<double>(Graph::kMaxLinks)));
+
+    if (graph_.links.size() <= index) {
+        graph_.links.resize(index + 1);
+    }
+    graph_.links[index].resize(layer + 1);
+    if (graph_.entry_point < 0) {
+        graph_.entry_point = static_cast<int>(index);
+        graph_.top_layer = layer;
+        return;
+    }
+
+    auto similarity_to = [&](uint32_t other) { return similarity(index, other); };
+    uint32_t entry = static_cast<uint32_t>(graph_.entry_point);
+    for (int l = graph_.top_layer; l > layer; --l) {
+        entry = searchLayer(similarity_to, entry, 1, l).front().second;
+    }
+
+    for (int l = std::min(layer, graph_.top_layer); l >= 0; --l) {
+        std::vector<std::pair<float, uint32_t>> candidates = searchLayer(similarity_to, entry, Graph::kConstructionSearch, l);
+        entry = candidates.front().second;
+        size_t max_links = l == 0 ? Graph::kMaxBaseLinks : Graph::kMaxLinks;
+        selectNeighbours(candidates, max_links);
+
+        std::vector<uint32_t>& links = graph_.links[index][l];
+        for (const auto& [score, neighbour] : candidates) {
+            links.push_back(neighbour);
+
+            std::vector<uint32_t>& back_links = graph_.links[neighbour][l];
+            back_links.push_back(index);
+            if (back_links.size() > max_links) {
+                std::vector<std::pair<float, uint32_t>> scored;
+                scored.reserve(back_links.size());
+                for (uint32_t other : back_links) {
+                    scored.emplace_back(similarity(neighbour, other), other);
+                }
+                selectNeighbours(scored, max_links);
+                back_links.clear();
+                for (const auto& kept : scored) {
+                    back_links.push_back(kept.second);
+                }
+            }
+        }
+    }
+
+    if (layer > graph_.top_layer) {
+        graph_.entry_point = static_cast<int>(index);
+        graph_.top_layer = layer;
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * EmbeddingIndex - in-memory nearest-neighbour search over message embeddings
+ *
+ * Vectors are L2-normalized and quantized to int8 with one scale per vector
+ * (a quarter of the float32 size), stored row-major in one contiguous matrix:
+ * - Small indexes are scanned exhaustively with an int8 dot product
+ *   (AVX2 when the CPU supports it, an auto-vectorized loop otherwise)
+ * - Once the index reaches hnsw_min_size vectors an HNSW graph is built over
+ *   the same rows, a batch of rows per add() so no single call holds the lock
+ *   for long; when it covers every row, searches visit only a few hundred rows
+ *
+ * Scores are cosine similarities in [-1, 1]. The index is thread-safe; adds
+ * take an exclusive lock, searches a shared one.
+ */
+class EmbeddingIndex {
+public:
+    // Normalized, int8-quantized vector: value[i] ~= data[i] * scale
+    struct Quantized {
+        std::vector<int8_t> data;
+        float scale = 0;
+    };
+
+    struct Hit {
+        int message_id = 0;
+        int session_id = 0;
+        float score = 0;    // Cosine similarity
+    };
+
+    /**
+     * Constructor
+     * @param hnsw_min_size Vector count from which searches use the HNSW graph
+     */
+    explicit EmbeddingIndex(size_t hnsw_min_size = 20000);
+
+    EmbeddingIndex(const EmbeddingIndex&) = delete;
+    EmbeddingIndex& operator=(const EmbeddingIndex&) = delete;
+
+    // Normalize and quantize a float vector (all zeros stays all zeros)
+    static Quantized quantize(const std::vector<float>& vector);
+
+    /**
+     * Add (or replace) the vector of a message
+     * The first vector fixes the dimension; vectors of another size are ignored
+     * @return true if the vector was added
+     */
+    bool add(int message_id, int session_id, const Quantized& vector);
+
+    /**
+     * Most similar messages to a query, best first
+     * @param query Quantized query vector
+     * @param limit Maximum hits
+     * @param session_id Only messages of this session, 0 for all sessions
+     * @param max_message_id Only messages with a smaller id (0 = no bound);
+     *        used to skip messages that are still in the context window
+     */
+    std::vector<Hit> search(const Quantized& query, size_t limit, int session_id = 0,
+                            int max_message_id = 0) const;
+
+    size_t size() const;
+    size_t dimensions() const;
+    bool usesGraph() const;
+
+    // The dot product kernel selected for this CPU ("avx2" or "generic")
+    static const char* kernelName();
+
+private:
+    // Hierarchical navigable small world graph over matrix rows
+    struct Graph {
+        static constexpr size_t kMaxLinks = 16;         // Per node on upper layers
+        static constexpr size_t kMaxBaseLinks = 32;     // Per node on layer 0
+        static constexpr size_t kConstructionSearch = 100;
+        static constexpr size_t kInsertsPerAdd = 32;    // Catch-up rate while building
+
+        std::vector<std::vector<std::vector<uint32_t>>> links; // [node][layer] -> neighbours
+        int entry_point = -1;
+        int top_layer = -1;
+        std::mt19937 rng{0x5eed};
+    };
+
+    mutable std::shared_mutex mutex_;
+    size_t hnsw_min_size_;
+    size_t dims_ = 0;
+    std::vector<int8_t> matrix_;        // size() * dims_ values
+    std::vector<float> scales_;
+    std::vector<int> message_ids_;
+    std::vector<int> session_ids_;
+    std::unordered_map<int, uint32_t> row_of_message_;
+    Graph graph_;
+    uint32_t graph_rows_ = 0;           // Rows [0, graph_rows_) are linked into the graph
+
+    const int8_t* row(uint32_t index) const { return matrix_.data() + static_cast<size_t>(index) * dims_; }
+    float similarity(const Quantized& query, uint32_t index) const;
+    float similarity(uint32_t a, uint32_t b) const;
+
+    bool matches(uint32_t index, int session_id, int max_message_id) const;
+    std::vector<Hit> scan(const Quantized& query, size_t limit, int session_id, int max_message_id) const;
+    std::vector<Hit> graphSearch(const Quantized& query, size_t limit, int session_id, int max_message_id) const;
+
+    // Graph maintenance (callers hold the exclusive lock)
+    void graphInsert(uint32_t index);
+    template <typename Similarity>
+    std::vector<std::pair<float, uint32_t>> searchLayer(const Similarity& similarity_to, uint32_t entry,
+                                                        size_t ef, int layer) const;
+    void selectNeighbours(std::vector<std::pair<float, uint32_t>>& candidates, size_t max_links) const;
+};
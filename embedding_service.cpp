@@ -0,0 +1,241 @@
+#include "embedding_service.h"
+#include "database/database_core.h"
+#include "database/embedding_repository.h"
+#include "database/message_repository.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+// Embedding inputs are cut to this many bytes (about 2k tokens, well inside
+// the 8k-token input limit of common embedding models)
+constexpr size_t kMaxInputBytes = 8000;
+
+// Idle re-check for messages saved by other processes
+constexpr std::chrono::seconds kPollInterval{60};
+
+// A vector computed by search() waits this many background rounds for its
+// message to be committed (write-behind) before it is dropped and re-embedded
+constexpr int kMaxStoreAttempts = 3;
+
+constexpr std::chrono::seconds kMinBackoff{2};
+constexpr std::chrono::seconds kMaxBackoff{300};
+
+long env_long(const char* name, long fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    try {
+        return std::stol(value);
+    } catch (...) {
+        return fallback;
+    }
+}
+
+// Cut at a UTF-8 character boundary
+std::string truncate_input(const std::string& text) {
+    if (text.size() <= kMaxInputBytes) {
+        return text;
+    }
+    size_t end = kMaxInputBytes;
+    while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+        --end;
+    }
+    return text.substr(0, end);
+}
+
+} // namespace
+
+EmbeddingService::Options EmbeddingService::Options::fromEnvironment() {
+    Options options;
+    if (const char* model = std::getenv("LLM_CLI_EMBEDDING_MODEL")) {
+        options.model = model;
+    }
+    options.batch_size = static_cast<size_t>(std::clamp<long>(
+        env_long("LLM_CLI_EMBEDDING_BATCH", static_cast<long>(options.batch_size)), 1, 256));
+    options.hnsw_min_size = static_cast<size_t>(std::max<long>(
+        env_long("LLM_CLI_EMBEDDING_HNSW_MIN", static_cast<long>(options.hnsw_min_size)), 1));
+    options.recall = static_cast<size_t>(std::clamp<long>(
+        env_long("LLM_CLI_SEMANTIC_RECALL", static_cast<long>(options.recall)), 0, 20));
+    if (const char* score = std::getenv("LLM_CLI_SEMANTIC_RECALL_MIN_SCORE")) {
+        try {
+            options.recall_min_score = std::stof(score);
+        } catch (...) {
+        }
+    }
+    options.recall_timeout = std::chrono::milliseconds(std::clamp<long>(
+        env_long("LLM_CLI_SEMANTIC_RECALL_TIMEOUT_MS", static_cast<long>(options.recall_timeout.count())), 100, 60000));
+    return options;
+}
+
+EmbeddingService::EmbeddingService(UserInterface& ui, Options options)
+    : options_(std::move(options))
+    , pool_(2, /*share_connections=*/false)
+    , api_(ui, model_id_, pool_)
+    , index_(options_.hnsw_min_size) {
+    if (options_.enabled()) {
+        thread_ = std::thread([this]() { run(); });
+    }
+}
+
+EmbeddingService::~EmbeddingService() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void EmbeddingService::notify() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        notified_ = true;
+    }
+    wake_cv_.notify_all();
+}
+
+std::string EmbeddingService::lastError() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_error_;
+}
+
+std::vector<std::vector<float>> EmbeddingService::embed(const std::vector<std::string>& texts,
+                                                        const std::atomic<bool>* cancel,
+                                                        std::stop_token stop,
+                                                        std::chrono::milliseconds timeout) {
+    std::vector<std::string> inputs;
+    inputs.reserve(texts.size());
+    for (const auto& text : texts) {
+        inputs.push_back(truncate_input(text));
+    }
+    return api_.embed(inputs, options_.model, cancel, std::move(stop), timeout);
+}
+
+std::vector<EmbeddingIndex::Hit> EmbeddingService::search(const Query& query) {
+    if (!options_.enabled()) {
+        throw std::runtime_error("Semantic memory is disabled (set LLM_CLI_EMBEDDING_MODEL)");
+    }
+    TraceSpan span("memory.search");
+    EmbeddingIndex::Quantized vector = EmbeddingIndex::quantize(
+        embed({std::string(query.text)}, nullptr, query.stop, query.timeout).front());
+    std::vector<EmbeddingIndex::Hit> hits = index_.search(vector, query.limit, query.session_id,
+                                                          query.before_message_id);
+
+    if (query.message_id > 0 && query.session_id > 0) {
+        index_.add(query.message_id, query.session_id, vector);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            computed_.push_back({query.message_id, std::move(vector)});
+        }
+        wake_cv_.notify_all();
+    }
+    return hits;
+}
+
+void EmbeddingService::run() {
+    std::unique_ptr<database::DatabaseCore> core;
+    std::unique_ptr<database::EmbeddingRepository> embeddings;
+    std::unique_ptr<database::MessageRepository> messages;
+    try {
+        core = std::make_unique<database::DatabaseCore>();
+        embeddings = std::make_unique<database::EmbeddingRepository>(*core);
+        messages = std::make_unique<database::MessageRepository>(*core);
+        TraceSpan span("memory.load");
+        embeddings->forEachEmbedding(options_.model, [this](int message_id, int session_id, float scale,
+                                                            const int8_t* data, size_t dims) {
+            index_.add(message_id, session_id, {std::vector<int8_t>(data, data + dims), scale});
+        });
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_error_ = e.what();
+        return;
+    }
+
+    // Messages up to after_id are all embedded; 0 while the backlog is worked off
+    int after_id = 0;
+    auto backoff = kMinBackoff;
+    std::vector<Computed> deferred;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        std::vector<Computed> computed = std::move(deferred);
+        deferred.clear();
+        std::move(computed_.begin(), computed_.end(), std::back_inserter(computed));
+        computed_.clear();
+        notified_ = false;
+        lock.unlock();
+
+        bool failed = false;
+        bool idle = false;
+        try {
+            std::vector<database::EmbeddingRepository::PendingText> pending;
+            {
+                TraceSpan span("memory.batch");
+                if (!computed.empty()) {
+                    core->beginTransaction();
+                    try {
+                        for (auto& entry : computed) {
+                            if (!embeddings->storeEmbedding(entry.message_id, options_.model, entry.vector.scale, entry.vector.data)
+                                && ++entry.attempts < kMaxStoreAttempts) {
+                                deferred.push_back(std::move(entry));
+                            }
+                        }
+                        core->commitTransaction();
+                    } catch (...) {
+                        core->rollbackTransaction();
+                        throw;
+                    }
+                }
+                int newest_id = messages->maxMessageId();
+                pending = embeddings->pendingMessages(options_.model, after_id, options_.batch_size);
+                if (pending.empty()) {
+                    after_id = std::max(after_id, newest_id);
+                    idle = true;
+                } else {
+                    std::vector<std::string> texts;
+                    texts.reserve(pending.size());
+                    for (const auto& text : pending) {
+                        texts.push_back(text.content);
+                    }
+                    std::vector<std::vector<float>> vectors = embed(texts, &stopping_);
+
+                    core->beginTransaction();
+                    try {
+                        for (size_t i = 0; i < pending.size(); ++i) {
+                            EmbeddingIndex::Quantized vector = EmbeddingIndex::quantize(vectors[i]);
+                            embeddings->storeEmbedding(pending[i].message_id, options_.model, vector.scale, vector.data);
+                            index_.add(pending[i].message_id, pending[i].session_id, vector);
+                        }
+                        core->commitTransaction();
+                    } catch (...) {
+                        core->rollbackTransaction();
+                        throw;
+                    }
+                }
+            }
+            lock.lock();
+            last_error_.clear();
+            lock.unlock();
+            backoff = kMinBackoff;
+        } catch (const std::exception& e) {
+            lock.lock();
+            last_error_ = e.what();
+            lock.unlock();
+            failed = true;
+        }
+
+        lock.lock();
+        if (failed) {
+            // Vectors computed by search() but not stored are embedded again later
+            wake_cv_.wait_for(lock, backoff, [this] { return stopping_.load(); });
+            backoff = std::min(backoff * 2, kMaxBackoff);
+        } else if (idle) {
+            wake_cv_.wait_for(lock, kPollInterval, [this] { return stopping_ || notified_ || !computed_.empty(); });
+        }
+    }
+}
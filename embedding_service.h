@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "api_client.h"
+#include "embedding_index.h"
+#include "http_connection_pool.h"
+#include "ui_interface.h"
+
+/**
+ * EmbeddingService - semantic memory over the conversation history
+ *
+ * A background thread keeps an EmbeddingIndex in step with the message store:
+ * - At startup it loads the stored vectors (message_embeddings) into the index
+ * - It then embeds user and assistant messages that have no vector yet, newest
+ *   first, in batches of batch_size per embeddings request, storing the
+ *   quantized vectors and adding them to the index
+ * - notify() wakes it after new messages were saved; failures back off
+ *
+ * search() embeds a query on the calling thread and returns the most similar
+ * messages. Embedding requests use their own connections, so they never
+ * queue behind (or share a connection cache with) the chat stream.
+ *
+ * Opt-in: enabled when LLM_CLI_EMBEDDING_MODEL names an embeddings model.
+ */
+class EmbeddingService {
+public:
+    struct Options {
+        std::string model;                 // LLM_CLI_EMBEDDING_MODEL (empty = disabled)
+        size_t batch_size = 32;            // LLM_CLI_EMBEDDING_BATCH: messages per request
+        size_t hnsw_min_size = 20000;      // LLM_CLI_EMBEDDING_HNSW_MIN: vectors before the HNSW graph is used
+        size_t recall = 3;                 // LLM_CLI_SEMANTIC_RECALL: messages recalled into each request (0 = off)
+        float recall_min_score = 0.35f;    // LLM_CLI_SEMANTIC_RECALL_MIN_SCORE: cosine similarity
+        std::chrono::milliseconds recall_timeout{2000}; // LLM_CLI_SEMANTIC_RECALL_TIMEOUT_MS: query embedding per turn
+
+        static Options fromEnvironment();
+        bool enabled() const { return !model.empty(); }
+    };
+
+    struct Query {
+        std::string_view text;
+        size_t limit = 5;
+        int session_id = 0;                // 0 = all sessions
+        int before_message_id = 0;         // Only older messages (0 = no bound)
+        // The text is the content of this saved message (in session_id): its
+        // vector is stored too, so the background thread does not embed it again
+        int message_id = 0;
+        std::stop_token stop;              // Aborts the embeddings request (OperationCancelled)
+        std::chrono::milliseconds timeout{std::chrono::seconds(60)};
+    };
+
+    /**
+     * Constructor - starts the background thread (none when disabled)
+     * @param ui Status sink for the embeddings client (errors are kept, not shown)
+     */
+    EmbeddingService(UserInterface& ui, Options options);
+
+    // Stops the background thread (aborting its request in flight); messages
+    // not embedded yet are picked up by the next run
+    ~EmbeddingService();
+
+    EmbeddingService(const EmbeddingService&) = delete;
+    EmbeddingService& operator=(const EmbeddingService&) = delete;
+
+    const Options& options() const { return options_; }
+
+    // Wake the background thread: new messages were saved
+    void notify();
+
+    /**
+     * Most similar indexed messages to a text, best first
+     * @throws std::runtime_error if the query cannot be embedded in time,
+     *         OperationCancelled once query.stop is requested
+     */
+    std::vector<EmbeddingIndex::Hit> search(const Query& query);
+
+    // Vectors in the index
+    size_t indexedCount() const { return index_.size(); }
+
+    // Error of the last failed background batch (empty once a batch succeeds)
+    std::string lastError() const;
+
+private:
+    // Vector computed by search() for a saved message, stored by the background thread
+    struct Computed {
+        int message_id;
+        EmbeddingIndex::Quantized vector;
+        int attempts = 0;  // Stores skipped because the message was not committed yet
+    };
+
+    Options options_;
+    std::string model_id_;             // ApiClient reference target (unused for embeddings)
+    HttpConnectionPool pool_;
+    ApiClient api_;
+    EmbeddingIndex index_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<bool> stopping_{false}; // Set under mutex_; also aborts a background request
+    bool notified_ = false;
+    std::vector<Computed> computed_;
+    std::string last_error_;
+    std::thread thread_;
+
+    void run();
+    std::vector<std::vector<float>> embed(const std::vector<std::string>& texts, const std::atomic<bool>* cancel = nullptr,
+                                          std::stop_token stop = {},
+                                          std::chrono::milliseconds timeout = std::chrono::seconds(60));
+};
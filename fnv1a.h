@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a - a fast non-cryptographic hash for change detection and
+// cache keys. Not stable across a change of these constants, so anything
+// persisted with it is keyed to this exact variant.
+constexpr uint64_t kFnvOffsetBasis = 1469598103934665603ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+// Folds one byte into a running hash
+constexpr uint64_t fnv1a_mix(uint64_t hash, unsigned char byte) {
+    return (hash ^ byte) * kFnvPrime;
+}
+
+// Hashes data, continuing from hash so fields can be chained
+constexpr uint64_t fnv1a_hash(std::string_view data, uint64_t hash = kFnvOffsetBasis) {
+    for (char c : data) hash = fnv1a_mix(hash, static_cast<unsigned char>(c));
+    return hash;
+}
@@ -0,0 +1,159 @@
+#include "http_connection_pool.h"
+#include <stdexcept>
+
+HttpConnectionPool::HttpConnectionPool(size_t max_idle_handles, bool share_connections)
+    : share_(curl_share_init()), max_idle_handles_(max_idle_handles) {
+    if (!share_) {
+        throw std::runtime_error("Failed to initialize CURL share handle");
+    }
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &HttpConnectionPool::lockShare);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &HttpConnectionPool::unlockShare);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    if (share_connections) {
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+}
+
+HttpConnectionPool::~HttpConnectionPool() {
+    // All leases must be returned before the pool is destroyed
+    for (const Entry& entry : idle_handles_) {
+        curl_easy_cleanup(entry.curl);
+        curl_multi_cleanup(entry.multi);
+    }
+    idle_handles_.clear();
+    curl_share_cleanup(share_);
+}
+
+HttpConnectionPool::Handle HttpConnectionPool::acquire() {
+    Entry entry{nullptr, nullptr};
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (!idle_handles_.empty()) {
+            entry = idle_handles_.back();
+            idle_handles_.pop_back();
+        }
+    }
+    if (!entry.curl) {
+        entry.curl = curl_easy_init();
+        if (!entry.curl) {
+            throw std::runtime_error("Failed to initialize CURL");
+        }
+        entry.multi = curl_multi_init();
+        if (!entry.multi) {
+            curl_easy_cleanup(entry.curl);
+            throw std::runtime_error("Failed to initialize CURL multi handle");
+        }
+    }
+    applyDefaults(entry.curl);
+    return Handle(this, entry.curl, entry.multi);
+}
+
+void HttpConnectionPool::release(CURL* curl, CURLM* multi) {
+    // curl_easy_reset drops per-request options; the open connections live in
+    // the multi's connection cache and are kept with it
+    curl_easy_reset(curl);
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (idle_handles_.size() < max_idle_handles_) {
+            idle_handles_.push_back({curl, multi});
+            return;
+        }
+    }
+    curl_easy_cleanup(curl);
+    curl_multi_cleanup(multi);
+}
+
+void HttpConnectionPool::applyDefaults(CURL* curl) {
+    curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 60L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 30L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+}
+
+void HttpConnectionPool::lockShare(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    (void)handle;
+    (void)access;
+    auto* pool = static_cast<HttpConnectionPool*>(userptr);
+    pool->share_locks_[static_cast<size_t>(data) % pool->share_locks_.size()].lock();
+}
+
+void HttpConnectionPool::unlockShare(CURL* handle, curl_lock_data data, void* userptr) {
+    (void)handle;
+    auto* pool = static_cast<HttpConnectionPool*>(userptr);
+    pool->share_locks_[static_cast<size_t>(data) % pool->share_locks_.size()].unlock();
+}
+
+// --- Handle ---
+
+HttpConnectionPool::Handle::Handle(Handle&& other) noexcept
+    : pool_(other.pool_), curl_(other.curl_), multi_(other.multi_) {
+    other.pool_ = nullptr;
+    other.curl_ = nullptr;
+    other.multi_ = nullptr;
+}
+
+HttpConnectionPool::Handle& HttpConnectionPool::Handle::operator=(Handle&& other) noexcept {
+    if (this != &other) {
+        if (pool_ && curl_) {
+            pool_->release(curl_, multi_);
+        }
+        pool_ = other.pool_;
+        curl_ = other.curl_;
+        multi_ = other.multi_;
+        other.pool_ = nullptr;
+        other.curl_ = nullptr;
+        other.multi_ = nullptr;
+    }
+    return *this;
+}
+
+HttpConnectionPool::Handle::~Handle() {
+    if (pool_ && curl_) {
+        pool_->release(curl_, multi_);
+    }
+}
+
+CURLcode perform_transfer(const HttpConnectionPool::Handle& handle, const std::stop_token& stop) {
+    if (stop.stop_requested()) {
+        return CURLE_ABORTED_BY_CALLBACK;
+    }
+    CURL* curl = handle.get();
+    CURLM* multi = handle.multi();
+    if (curl_multi_add_handle(multi, curl) != CURLM_OK) {
+        return CURLE_FAILED_INIT;
+    }
+
+    CURLcode result = CURLE_ABORTED_BY_CALLBACK;
+    {
+        std::stop_callback wake(stop, [multi]() { curl_multi_wakeup(multi); });
+        bool done = false;
+        while (!done && !stop.stop_requested()) {
+            int still_running = 0;
+            CURLMcode mc = curl_multi_perform(multi, &still_running);
+            if (mc != CURLM_OK) {
+                result = CURLE_RECV_ERROR;
+                break;
+            }
+            int messages_left = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi, &messages_left)) {
+                if (msg->msg == CURLMSG_DONE) {
+                    result = msg->data.result;
+                    done = true;
+                }
+            }
+            if (!done && !stop.stop_requested()) {
+                curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+            }
+        }
+    }
+    // Removing the handle keeps its finished connection in the multi's cache;
+    // libcurl closes a non-multiplexed connection abandoned by a stop, as its
+    // response was not read to the end
+    curl_multi_remove_handle(multi, curl);
+    return result;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <stop_token>
+#include <vector>
+
+/**
+ * HttpConnectionPool keeps CURL easy handles alive between requests:
+ * - Each pooled easy handle is paired with its own persistent multi handle,
+ *   which owns the handle's connection cache; perform_transfer() runs every
+ *   transfer on it, so open connections survive across calls
+ * - A CURLSH share lets every handle use the same DNS and TLS session caches
+ * - Handles are configured for HTTP/2 over TLS when the server supports it
+ *
+ * The pool is thread-safe; each leased Handle is owned by a single thread
+ * until it goes out of scope and is returned to the pool.
+ *
+ * libcurl does not support a shared connection cache across transfers that
+ * run concurrently on different threads, and every pool in the program is
+ * used that way (research sub-queries, the model refresh thread, hedged
+ * streams, batch workers), so connections are not shared by default: each
+ * pooled handle's multi keeps its own. share_connections = true is only safe
+ * for a pool whose transfers never overlap.
+ */
+class HttpConnectionPool {
+public:
+    explicit HttpConnectionPool(size_t max_idle_handles = 8, bool share_connections = false);
+    ~HttpConnectionPool();
+
+    HttpConnectionPool(const HttpConnectionPool&) = delete;
+    HttpConnectionPool& operator=(const HttpConnectionPool&) = delete;
+
+    // RAII lease of a pooled easy handle - returned to the pool on destruction
+    class Handle {
+    public:
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&& other) noexcept;
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+        ~Handle();
+
+        CURL* get() const { return curl_; }
+        // The handle's persistent multi; the easy handle must be removed from
+        // it again before the lease ends
+        CURLM* multi() const { return multi_; }
+
+    private:
+        friend class HttpConnectionPool;
+        Handle(HttpConnectionPool* pool, CURL* curl, CURLM* multi) : pool_(pool), curl_(curl), multi_(multi) {}
+
+        HttpConnectionPool* pool_;
+        CURL* curl_;
+        CURLM* multi_;
+    };
+
+    // Lease a handle with the shared caches and keep-alive defaults applied
+    // Throws std::runtime_error if CURL cannot allocate the handle or its multi
+    Handle acquire();
+
+private:
+    CURLSH* share_;
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> share_locks_;
+
+    struct Entry {
+        CURL* curl;
+        CURLM* multi;
+    };
+
+    std::mutex pool_mutex_;
+    std::vector<Entry> idle_handles_;
+    size_t max_idle_handles_;
+
+    void release(CURL* curl, CURLM* multi);
+    void applyDefaults(CURL* curl);
+
+    static void lockShare(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlockShare(CURL* handle, curl_lock_data data, void* userptr);
+};
+
+// Run a transfer on a leased handle's persistent multi, so the connection it
+// used stays open for the handle's next transfer. A stop request wakes the
+// loop, so the transfer is abandoned within milliseconds even while the
+// server is silent (CURLE_ABORTED_BY_CALLBACK).
+CURLcode perform_transfer(const HttpConnectionPool::Handle& handle, const std::stop_token& stop = {});
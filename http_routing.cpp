@@ -0,0 +1,27 @@
+#include "http_routing.h"
+#include <cstdlib>
+
+namespace {
+
+std::string replay_server() {
+    const char* server = std::getenv("LLM_CLI_REPLAY_SERVER");
+    std::string value = server ? server : "";
+    while (!value.empty() && value.back() == '/') {
+        value.pop_back();
+    }
+    return value;
+}
+
+} // anonymous namespace
+
+std::string route_url(const std::string& url) {
+    static const std::string server = replay_server();
+    if (server.empty()) {
+        return url;
+    }
+    size_t scheme_end = url.find("://");
+    if (scheme_end == std::string::npos) {
+        return url; // Not an absolute URL; leave it to libcurl
+    }
+    return server + "/" + url.substr(0, scheme_end) + "/" + url.substr(scheme_end + 3);
+}
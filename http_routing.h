@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Outbound request routing for offline record/replay
+ *
+ * With LLM_CLI_REPLAY_SERVER set (e.g. http://127.0.0.1:8089), every request
+ * the client makes - chat completions, the model catalog, search pages and
+ * visited URLs - goes to that server instead, with the original scheme and
+ * host moved into the path:
+ *   https://openrouter.ai/api/v1/models
+ *   -> http://127.0.0.1:8089/https/openrouter.ai/api/v1/models
+ * llm_mock_server (loadtest/) records and replays exchanges on that
+ * interface. Without the variable URLs are returned unchanged.
+ */
+std::string route_url(const std::string& url);
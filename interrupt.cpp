@@ -0,0 +1,97 @@
+#include "interrupt.h"
+#include "database/message_writer.h"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+
+namespace {
+
+// Signal handler state (lock-free atomics and a pipe: async-signal-safe)
+int wake_pipe[2] = {-1, -1};
+std::atomic<bool> turn_active{false};
+std::atomic<bool> stop_sent{false};
+struct sigaction previous_action;
+
+constexpr char kStopByte = 1;
+constexpr char kQuitByte = 0;
+
+extern "C" void handle_sigint(int) {
+    if (!turn_active.load() || stop_sent.exchange(true)) {
+        // At the prompt, or asked twice: end the process as SIGINT always did,
+        // once the write-behind queue (e.g. the interrupted reply) is committed
+        if (!database::MessageWriter::deferSignal(SIGINT)) {
+            std::signal(SIGINT, SIG_DFL);
+            std::raise(SIGINT);
+        }
+        return;
+    }
+    char byte = kStopByte;
+    if (write(wake_pipe[1], &byte, 1) < 0) {
+        // Nothing that is safe to do here
+    }
+}
+
+} // namespace
+
+TurnInterrupter::TurnInterrupter() {
+    if (pipe(wake_pipe) != 0) {
+        throw std::runtime_error("Failed to create the interrupt pipe");
+    }
+    watcher_ = std::thread([this]() { watch(); });
+
+    struct sigaction action {};
+    action.sa_handler = handle_sigint;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, &previous_action);
+}
+
+TurnInterrupter::~TurnInterrupter() {
+    sigaction(SIGINT, &previous_action, nullptr);
+    char byte = kQuitByte;
+    if (write(wake_pipe[1], &byte, 1) == 1 && watcher_.joinable()) {
+        watcher_.join();
+    } else if (watcher_.joinable()) {
+        watcher_.detach();
+    }
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    wake_pipe[0] = wake_pipe[1] = -1;
+}
+
+TurnInterrupter::Turn TurnInterrupter::beginTurn() {
+    std::stop_token token;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        source_.emplace();
+        token = source_->get_token();
+    }
+    stop_sent.store(false);
+    turn_active.store(true);
+    return Turn(this, std::move(token));
+}
+
+void TurnInterrupter::endTurn() {
+    turn_active.store(false);
+    std::lock_guard<std::mutex> lock(mutex_);
+    source_.reset();
+}
+
+void TurnInterrupter::watch() {
+    char byte = kQuitByte;
+    while (true) {
+        ssize_t n = read(wake_pipe[0], &byte, 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0 || byte == kQuitByte) {
+            return;
+        }
+        // Runs the stop_callbacks of everything in flight
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (source_) {
+            source_->request_stop();
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+
+// Thrown when an operation stops because its stop_token was triggered
+class OperationCancelled : public std::runtime_error {
+public:
+    OperationCancelled() : std::runtime_error("Cancelled by the user") {}
+};
+
+// Appended to the saved part of a reply that was interrupted mid-stream, so
+// the next request shows the model where it was cut off
+inline constexpr const char* kInterruptedReplyMarker = "\n\n[Interrupted by the user]";
+
+/**
+ * TurnInterrupter - Ctrl+C stops the running turn instead of the process
+ *
+ * While a Turn is active, SIGINT requests a stop on that turn's stop_source.
+ * The signal handler itself only writes a byte to a pipe (async-signal-safe);
+ * a watcher thread calls request_stop(), so stop_callbacks registered by the
+ * transfers in flight (which wake their curl_multi loops) run in ordinary
+ * thread context. API transfers run on their pooled handle's persistent multi
+ * (perform_transfer()): a stop abandons only the transfer in flight, and the
+ * handle's other kept-alive connections stay open for the next turn.
+ *
+ * Outside a turn (at the prompt), and on a second Ctrl+C while a stopped turn
+ * is still unwinding, SIGINT keeps its default action and ends the process,
+ * after the write-behind queue is committed (MessageWriter::deferSignal()).
+ * One instance per process.
+ */
+class TurnInterrupter {
+public:
+    // Installs the SIGINT handler and starts the watcher thread
+    // @throws std::runtime_error if the pipe cannot be created
+    TurnInterrupter();
+
+    // Restores the previous SIGINT handler and stops the watcher
+    ~TurnInterrupter();
+
+    TurnInterrupter(const TurnInterrupter&) = delete;
+    TurnInterrupter& operator=(const TurnInterrupter&) = delete;
+
+    // RAII scope of one turn: Ctrl+C stops token() until it is destroyed
+    class Turn {
+    public:
+        Turn(Turn&& other) noexcept : owner_(other.owner_), token_(std::move(other.token_)) { other.owner_ = nullptr; }
+        Turn(const Turn&) = delete;
+        Turn& operator=(const Turn&) = delete;
+        Turn& operator=(Turn&&) = delete;
+        ~Turn() { if (owner_) owner_->endTurn(); }
+
+        const std::stop_token& token() const { return token_; }
+
+    private:
+        friend class TurnInterrupter;
+        Turn(TurnInterrupter* owner, std::stop_token token) : owner_(owner), token_(std::move(token)) {}
+        TurnInterrupter* owner_;
+        std::stop_token token_;
+    };
+
+    Turn beginTurn();
+
+private:
+    std::mutex mutex_;
+    std::optional<std::stop_source> source_; // Source of the active turn
+    std::thread watcher_;
+
+    void endTurn();
+    void watch();
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * JsonCompletenessScanner - finds where a JSON object or array that arrives in
+ * fragments is closed, without parsing it
+ *
+ * Tracks only the nesting depth and whether the scan is inside a string (and
+ * just after a backslash there), so each byte is looked at once and nothing is
+ * buffered. "Complete" means the top-level brackets balanced; whether the text
+ * is valid JSON is still for the real parser to decide. A top-level scalar is
+ * never reported complete.
+ */
+class JsonCompletenessScanner {
+public:
+    // Scan the next fragment; true once the top-level value has been closed
+    bool feed(std::string_view fragment) {
+        for (size_t i = 0; i < fragment.size() && !complete_; ++i) {
+            char c = fragment[i];
+            if (in_string_) {
+                if (escaped_) {
+                    escaped_ = false;
+                } else if (c == '\\') {
+                    escaped_ = true;
+                } else if (c == '"') {
+                    in_string_ = false;
+                }
+            } else if (c == '"') {
+                in_string_ = true;
+            } else if (c == '{' || c == '[') {
+                ++depth_;
+            } else if ((c == '}' || c == ']') && depth_ > 0) {
+                complete_ = --depth_ == 0;
+            }
+        }
+        return complete_;
+    }
+
+    bool complete() const { return complete_; }
+
+private:
+    uint32_t depth_ = 0;
+    bool in_string_ = false;
+    bool escaped_ = false;
+    bool complete_ = false;
+};
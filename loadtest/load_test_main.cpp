@@ -0,0 +1,178 @@
+#include "chat_client.h"
+#include "database.h"
+#include "scripted_interface.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// llm_loadtest --prompts FILE [--turns N] [--sessions K] [--verbose] [--live]
+//
+// Runs N scripted turns (per session) through ChatClient in K concurrent
+// sessions and reports throughput and latency percentiles. Meant to run
+// against llm_mock_server in replay mode (LLM_CLI_REPLAY_SERVER); --live is
+// required to send the turns to the real API. The chat history is written to
+// a fresh scratch directory, never to the current one.
+
+namespace {
+
+struct Options {
+    std::string prompts_path;
+    size_t turns = 100;
+    size_t sessions = 1;
+    bool verbose = false;
+    bool live = false;
+};
+
+[[noreturn]] void usage() {
+    std::fprintf(stderr, "usage: llm_loadtest --prompts FILE [--turns N] [--sessions K] [--verbose] [--live]\n");
+    std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--verbose") {
+            options.verbose = true;
+        } else if (flag == "--live") {
+            options.live = true;
+        } else if (i + 1 < argc && flag == "--prompts") {
+            options.prompts_path = argv[++i];
+        } else if (i + 1 < argc && flag == "--turns") {
+            options.turns = std::strtoul(argv[++i], nullptr, 10);
+        } else if (i + 1 < argc && flag == "--sessions") {
+            options.sessions = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            usage();
+        }
+    }
+    if (options.prompts_path.empty()) usage();
+    return options;
+}
+
+// One prompt per non-empty line
+std::vector<std::string> load_prompts(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Failed to open prompt script " + path);
+    }
+    std::vector<std::string> prompts;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty()) prompts.push_back(line);
+    }
+    if (prompts.empty()) {
+        throw std::runtime_error("Prompt script " + path + " has no prompts");
+    }
+    return prompts;
+}
+
+// Nearest-rank percentile of a sorted, non-empty vector
+double percentile(const std::vector<double>& sorted, double p) {
+    size_t rank = static_cast<size_t>(p * static_cast<double>(sorted.size()) + 0.999999);
+    rank = std::clamp<size_t>(rank, 1, sorted.size());
+    return sorted[rank - 1];
+}
+
+void print_distribution(const char* name, std::vector<double> samples) {
+    if (samples.empty()) {
+        std::printf("  %-30s no samples\n", name);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    std::printf("  %-30s %7zu %9.1f %9.1f %9.1f %9.1f\n", name, samples.size(), percentile(samples, 0.50),
+                percentile(samples, 0.95), percentile(samples, 0.99), samples.back());
+}
+
+std::string enter_scratch_directory() {
+    std::string pattern = (std::filesystem::temp_directory_path() / "llm_loadtest_XXXXXX").string();
+    if (!mkdtemp(pattern.data())) {
+        throw std::runtime_error("Failed to create scratch directory");
+    }
+    std::filesystem::current_path(pattern);
+    return pattern;
+}
+
+struct Session {
+    std::unique_ptr<ScriptedInterface> ui;
+    std::unique_ptr<PersistenceManager> db;
+    std::unique_ptr<ChatClient> client;
+};
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    Options options = parse_options(argc, argv);
+    if (!std::getenv("LLM_CLI_REPLAY_SERVER") && !options.live) {
+        std::fprintf(stderr, "llm_loadtest: LLM_CLI_REPLAY_SERVER is not set; pass --live to use the real API\n");
+        return 2;
+    }
+
+    try {
+        std::vector<std::string> prompts = load_prompts(std::filesystem::absolute(options.prompts_path).string());
+        std::string scratch = enter_scratch_directory();
+        std::printf("llm_loadtest: %zu session(s) x %zu turns, history in %s\n", options.sessions, options.turns,
+                    scratch.c_str());
+
+        // Sessions are set up one at a time so model catalog loading is not measured
+        std::vector<Session> sessions(options.sessions);
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            // Each session starts at a different prompt
+            std::vector<std::string> script(prompts.begin() + static_cast<std::ptrdiff_t>(i % prompts.size()), prompts.end());
+            script.insert(script.end(), prompts.begin(), prompts.begin() + static_cast<std::ptrdiff_t>(i % prompts.size()));
+            sessions[i].ui = std::make_unique<ScriptedInterface>(std::move(script), options.turns);
+            sessions[i].ui->setVerbose(options.verbose);
+            sessions[i].db = std::make_unique<PersistenceManager>(PersistenceManager::WriteMode::WriteBehind);
+            // Each conversation writes to its own session in the shared message store
+            sessions[i].db->setActiveSession(sessions[i].db->createSession());
+            sessions[i].client = std::make_unique<ChatClient>(*sessions[i].ui, *sessions[i].db);
+            sessions[i].client->initialize_model_manager();
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (Session& session : sessions) {
+            threads.emplace_back([&session] { session.client->run(); });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        ScriptedInterface::Timings total;
+        for (const Session& session : sessions) {
+            ScriptedInterface::Timings timings = session.ui->timings();
+            total.turn_ms.insert(total.turn_ms.end(), timings.turn_ms.begin(), timings.turn_ms.end());
+            total.first_chunk_ms.insert(total.first_chunk_ms.end(), timings.first_chunk_ms.begin(), timings.first_chunk_ms.end());
+            total.errors += timings.errors;
+        }
+
+        std::printf("\n%zu turns in %.2f s: %.1f turns/s, %zu errors\n\n", total.turn_ms.size(), wall_s,
+                    wall_s > 0 ? static_cast<double>(total.turn_ms.size()) / wall_s : 0.0, total.errors);
+        std::printf("  %-30s %7s %9s %9s %9s %9s\n", "latency (ms)", "count", "p50", "p95", "p99", "max");
+        print_distribution("turn", total.turn_ms);
+        print_distribution("first chunk", total.first_chunk_ms);
+
+        std::printf("\n  stages (last %zu spans)\n", Tracer::kCapacity);
+        for (const auto& stage : Tracer::global().stageStats()) {
+            std::printf("  %-30s %7zu %9.1f %9.1f %9.1f %9.1f\n", stage.stage.c_str(), stage.count, stage.p50_ms,
+                        stage.p95_ms, stage.p99_ms, stage.max_ms);
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "llm_loadtest failed: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
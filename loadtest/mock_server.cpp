@@ -0,0 +1,545 @@
+// llm_mock_server - records and replays the HTTP exchanges of llm-cli
+//
+//   llm_mock_server record <dir> [--port N]
+//   llm_mock_server replay <dir> [--port N] [--latency-ms N] [--jitter-ms N]
+//                                [--event-delay-ms N] [--speed F]
+//
+// Clients reach it through LLM_CLI_REPLAY_SERVER (see http_routing.h), which
+// puts the original URL into the request path. In record mode each request is
+// forwarded upstream and the response is appended to <dir>/exchanges.jsonl;
+// request headers (including Authorization) are never written. In replay mode
+// responses are served from that file without any network access.
+//
+// Replay matching, most specific first:
+//   1. same method, URL and request body
+//   2. same method and URL, and the same request "shape" (for chat
+//      completions: role of the last message and whether it streams)
+//   3. same method, URL without its query string, and shape
+// Candidates at levels 2 and 3 are served round-robin, so synthetic turns with
+// new prompts or search queries still get realistic responses.
+//
+// Timing: by default each response waits for its recorded time to first byte,
+// and SSE events are spread over the recorded transfer time (scaled by
+// --speed; 0 disables delays). --latency-ms, --jitter-ms and --event-delay-ms
+// override the recorded timings.
+
+#include "fnv1a.h"
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct Options {
+    bool record = false;
+    std::string directory;
+    int port = 8089;
+    long latency_ms = -1;     // < 0: use the recorded time to first byte
+    long jitter_ms = 0;
+    long event_delay_ms = -1; // < 0: spread events over the recorded transfer time
+    double speed = 1.0;
+};
+
+struct Request {
+    std::string method;
+    std::string target;
+    std::vector<std::pair<std::string, std::string>> headers; // Names lower-cased
+    std::string body;
+
+    const std::string* header(std::string_view name) const {
+        for (const auto& [key, value] : headers) {
+            if (key == name) return &value;
+        }
+        return nullptr;
+    }
+};
+
+struct Exchange {
+    std::string method;
+    std::string url;
+    std::string request_hash;
+    std::string shape;
+    long status = 200;
+    std::string content_type;
+    std::string body;
+    long ttfb_ms = 0;
+    long duration_ms = 0;
+};
+
+std::string fnv1a(std::string_view data) {
+    uint64_t hash = fnv1a_hash(data);
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+    return text;
+}
+
+// Coarse request kind used for fuzzy matching
+std::string request_shape(const std::string& body) {
+    if (body.empty() || body.front() != '{') return "";
+    auto json = nlohmann::json::parse(body, nullptr, false);
+    if (!json.is_object() || !json.contains("messages") || !json["messages"].is_array() || json["messages"].empty()) {
+        return "";
+    }
+    std::string shape = json["messages"].back().value("role", "");
+    if (json.value("stream", false)) shape += "+stream";
+    if (json.contains("tools")) shape += "+tools";
+    return shape;
+}
+
+// /https/host/path?query -> https://host/path?query
+std::optional<std::string> original_url(const std::string& target) {
+    for (const char* scheme : {"/https/", "/http/"}) {
+        size_t length = std::strlen(scheme);
+        if (target.compare(0, length, scheme) == 0) {
+            return std::string(scheme + 1, length - 2) + "://" + target.substr(length);
+        }
+    }
+    return std::nullopt;
+}
+
+std::string without_query(const std::string& url) {
+    return url.substr(0, url.find('?'));
+}
+
+const char* reason_phrase(long status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        default: return "Status";
+    }
+}
+
+// --- Socket I/O ---
+
+bool send_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+class Connection {
+public:
+    explicit Connection(int fd) : fd_(fd) {}
+    ~Connection() { ::close(fd_); }
+
+    int fd() const { return fd_; }
+
+    // Read one request; nullopt when the peer closed the connection
+    std::optional<Request> readRequest() {
+        size_t header_end;
+        while ((header_end = buffer_.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) return std::nullopt;
+        }
+        Request request;
+        std::string_view head(buffer_.data(), header_end);
+        size_t line_end = head.find("\r\n");
+        std::string_view request_line = head.substr(0, line_end);
+        size_t first_space = request_line.find(' ');
+        size_t second_space = request_line.find(' ', first_space + 1);
+        if (first_space == std::string_view::npos || second_space == std::string_view::npos) {
+            return std::nullopt;
+        }
+        request.method = std::string(request_line.substr(0, first_space));
+        request.target = std::string(request_line.substr(first_space + 1, second_space - first_space - 1));
+
+        while (line_end != std::string_view::npos) {
+            head.remove_prefix(line_end + 2);
+            line_end = head.find("\r\n");
+            std::string_view line = head.substr(0, line_end);
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos) continue;
+            std::string name(line.substr(0, colon));
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            std::string_view value = line.substr(colon + 1);
+            while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+            request.headers.emplace_back(std::move(name), std::string(value));
+        }
+        buffer_.erase(0, header_end + 4);
+
+        size_t content_length = 0;
+        if (const std::string* length = request.header("content-length")) {
+            content_length = std::strtoul(length->c_str(), nullptr, 10);
+        }
+        if (const std::string* expect = request.header("expect"); expect && content_length > buffer_.size()) {
+            send_all(fd_, "HTTP/1.1 100 Continue\r\n\r\n");
+        }
+        while (buffer_.size() < content_length) {
+            if (!fill()) return std::nullopt;
+        }
+        request.body = buffer_.substr(0, content_length);
+        buffer_.erase(0, content_length);
+        return request;
+    }
+
+private:
+    int fd_;
+    std::string buffer_;
+
+    bool fill() {
+        char chunk[16384];
+        ssize_t received = ::recv(fd_, chunk, sizeof(chunk), 0);
+        if (received <= 0) return false;
+        buffer_.append(chunk, static_cast<size_t>(received));
+        return true;
+    }
+};
+
+// --- Recording ---
+
+size_t append_body(char* data, size_t size, size_t nmemb, void* userdata) {
+    static_cast<std::string*>(userdata)->append(data, size * nmemb);
+    return size * nmemb;
+}
+
+class Recorder {
+public:
+    explicit Recorder(const std::string& directory)
+        : out_(directory + "/exchanges.jsonl", std::ios::app | std::ios::binary) {
+        if (!out_) {
+            throw std::runtime_error("Failed to open " + directory + "/exchanges.jsonl for writing");
+        }
+    }
+
+    std::optional<Exchange> forward(const Request& request, const std::string& url) {
+        CURL* curl = curl_easy_init();
+        if (!curl) return std::nullopt;
+
+        struct curl_slist* headers = nullptr;
+        for (const auto& [name, value] : request.headers) {
+            // Conditional headers are dropped so every recording has a full body
+            if (name == "host" || name == "content-length" || name == "connection" || name == "expect" ||
+                name == "accept-encoding" || name == "if-none-match" || name == "if-modified-since") {
+                continue;
+            }
+            headers = curl_slist_append(headers, (name + ": " + value).c_str());
+        }
+
+        Exchange exchange;
+        exchange.method = request.method;
+        exchange.url = url;
+        exchange.request_hash = fnv1a(request.body);
+        exchange.shape = request_shape(request.body);
+
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request.method.c_str());
+        if (!request.body.empty()) {
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.c_str());
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(request.body.size()));
+        }
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, ""); // Store decoded bodies
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 180L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, append_body);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &exchange.body);
+
+        CURLcode res = curl_easy_perform(curl);
+        if (res == CURLE_OK) {
+            char* content_type = nullptr;
+            curl_off_t ttfb_us = 0, total_us = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &exchange.status);
+            curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &content_type);
+            curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb_us);
+            curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total_us);
+            if (content_type) exchange.content_type = content_type;
+            exchange.ttfb_ms = static_cast<long>(ttfb_us / 1000);
+            exchange.duration_ms = static_cast<long>(total_us / 1000);
+        } else {
+            std::fprintf(stderr, "upstream error for %s: %s\n", url.c_str(), curl_easy_strerror(res));
+        }
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(curl);
+        if (res != CURLE_OK) return std::nullopt;
+
+        save(exchange);
+        return exchange;
+    }
+
+private:
+    std::mutex mutex_;
+    std::ofstream out_;
+
+    void save(const Exchange& exchange) {
+        nlohmann::json line = {
+            {"method", exchange.method},
+            {"url", exchange.url},
+            {"request_hash", exchange.request_hash},
+            {"shape", exchange.shape},
+            {"status", exchange.status},
+            {"content_type", exchange.content_type},
+            {"ttfb_ms", exchange.ttfb_ms},
+            {"duration_ms", exchange.duration_ms},
+            {"body", exchange.body},
+        };
+        std::string text = line.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+        std::lock_guard<std::mutex> lock(mutex_);
+        out_ << text << '\n';
+        out_.flush();
+    }
+};
+
+// --- Replay ---
+
+class ReplayStore {
+public:
+    explicit ReplayStore(const std::string& directory) {
+        std::ifstream in(directory + "/exchanges.jsonl", std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Failed to open " + directory + "/exchanges.jsonl");
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+            auto json = nlohmann::json::parse(line, nullptr, false);
+            if (!json.is_object()) continue;
+            Exchange exchange;
+            exchange.method = json.value("method", "GET");
+            exchange.url = json.value("url", "");
+            exchange.request_hash = json.value("request_hash", "");
+            exchange.shape = json.value("shape", "");
+            exchange.status = json.value("status", 200L);
+            exchange.content_type = json.value("content_type", "");
+            exchange.ttfb_ms = json.value("ttfb_ms", 0L);
+            exchange.duration_ms = json.value("duration_ms", 0L);
+            exchange.body = json.value("body", "");
+            size_t index = exchanges_.size();
+            exchanges_.push_back(std::move(exchange));
+            const Exchange& stored = exchanges_.back();
+            exact_.emplace(stored.method + " " + stored.url + " " + stored.request_hash, index);
+            by_url_[stored.method + " " + stored.url + " " + stored.shape].indices.push_back(index);
+            by_path_[stored.method + " " + without_query(stored.url) + " " + stored.shape].indices.push_back(index);
+        }
+    }
+
+    size_t size() const { return exchanges_.size(); }
+
+    const Exchange* match(const Request& request, const std::string& url) {
+        std::string shape = request_shape(request.body);
+        auto exact = exact_.find(request.method + " " + url + " " + fnv1a(request.body));
+        if (exact != exact_.end()) return &exchanges_[exact->second];
+        if (const Exchange* found = roundRobin(by_url_, request.method + " " + url + " " + shape)) return found;
+        return roundRobin(by_path_, request.method + " " + without_query(url) + " " + shape);
+    }
+
+private:
+    struct Candidates {
+        std::vector<size_t> indices;
+        size_t next = 0;
+    };
+
+    std::vector<Exchange> exchanges_;
+    std::unordered_map<std::string, size_t> exact_;
+    std::mutex mutex_;
+    std::map<std::string, Candidates> by_url_;
+    std::map<std::string, Candidates> by_path_;
+
+    const Exchange* roundRobin(std::map<std::string, Candidates>& groups, const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = groups.find(key);
+        if (it == groups.end() || it->second.indices.empty()) return nullptr;
+        Candidates& candidates = it->second;
+        size_t index = candidates.indices[candidates.next++ % candidates.indices.size()];
+        return &exchanges_[index];
+    }
+};
+
+void sleep_ms(double ms) {
+    if (ms > 0) std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms));
+}
+
+// SSE bodies are split after each event so they can be paced
+std::vector<std::string_view> split_events(std::string_view body) {
+    std::vector<std::string_view> events;
+    while (!body.empty()) {
+        size_t end = body.find("\n\n");
+        size_t length = end == std::string_view::npos ? body.size() : end + 2;
+        events.push_back(body.substr(0, length));
+        body.remove_prefix(length);
+    }
+    return events;
+}
+
+bool send_response(int fd, const Exchange& exchange, const Options& options, std::mt19937& rng) {
+    double first_byte_ms = options.latency_ms >= 0 ? static_cast<double>(options.latency_ms)
+                                                   : static_cast<double>(exchange.ttfb_ms) * options.speed;
+    if (options.jitter_ms > 0) {
+        first_byte_ms += std::uniform_real_distribution<double>(0, static_cast<double>(options.jitter_ms))(rng);
+    }
+    sleep_ms(first_byte_ms);
+
+    std::string head = "HTTP/1.1 " + std::to_string(exchange.status) + " " + reason_phrase(exchange.status) + "\r\n";
+    if (!exchange.content_type.empty()) head += "Content-Type: " + exchange.content_type + "\r\n";
+    head += "Connection: keep-alive\r\n";
+
+    bool streaming = exchange.content_type.find("text/event-stream") != std::string::npos;
+    if (!streaming) {
+        head += "Content-Length: " + std::to_string(exchange.body.size()) + "\r\n\r\n";
+        return send_all(fd, head) && send_all(fd, exchange.body);
+    }
+
+    head += "Transfer-Encoding: chunked\r\n\r\n";
+    if (!send_all(fd, head)) return false;
+    std::vector<std::string_view> events = split_events(exchange.body);
+    double per_event_ms = options.event_delay_ms >= 0
+        ? static_cast<double>(options.event_delay_ms)
+        : events.empty() ? 0.0
+                         : static_cast<double>(std::max(0L, exchange.duration_ms - exchange.ttfb_ms)) * options.speed /
+                               static_cast<double>(events.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (i > 0) sleep_ms(per_event_ms);
+        char size_line[32];
+        std::snprintf(size_line, sizeof(size_line), "%zx\r\n", events[i].size());
+        if (!send_all(fd, size_line) || !send_all(fd, events[i]) || !send_all(fd, "\r\n")) return false;
+    }
+    return send_all(fd, "0\r\n\r\n");
+}
+
+bool send_error(int fd, long status, const std::string& message) {
+    std::string head = "HTTP/1.1 " + std::to_string(status) + " " + reason_phrase(status) + "\r\n" +
+                       "Content-Type: text/plain\r\nContent-Length: " + std::to_string(message.size()) +
+                       "\r\nConnection: keep-alive\r\n\r\n";
+    return send_all(fd, head) && send_all(fd, message);
+}
+
+// --- Server ---
+
+std::atomic<uint64_t> g_requests{0};
+
+void serve_connection(int fd, const Options& options, Recorder* recorder, ReplayStore* store) {
+    Connection connection(fd);
+    std::mt19937 rng(static_cast<unsigned>(fd) * 7919u + static_cast<unsigned>(g_requests.load()));
+    while (auto request = connection.readRequest()) {
+        g_requests.fetch_add(1, std::memory_order_relaxed);
+        std::optional<std::string> url = original_url(request->target);
+        if (!url) {
+            if (!send_error(fd, 400, "Expected /<scheme>/<host>/<path>; set LLM_CLI_REPLAY_SERVER on the client")) return;
+            continue;
+        }
+
+        bool sent;
+        if (recorder) {
+            std::optional<Exchange> exchange = recorder->forward(*request, *url);
+            std::fprintf(stderr, "record %s %s -> %ld\n", request->method.c_str(), url->c_str(),
+                         exchange ? exchange->status : 502L);
+            Options live = options;
+            live.latency_ms = 0;     // The upstream wait already happened
+            live.event_delay_ms = 0;
+            live.jitter_ms = 0;
+            sent = exchange ? send_response(fd, *exchange, live, rng) : send_error(fd, 502, "Upstream request failed");
+        } else if (const Exchange* exchange = store->match(*request, *url)) {
+            sent = send_response(fd, *exchange, options, rng);
+        } else {
+            std::fprintf(stderr, "replay miss %s %s\n", request->method.c_str(), url->c_str());
+            sent = send_error(fd, 404, "No recorded exchange for " + *url);
+        }
+        if (!sent) return;
+    }
+}
+
+[[noreturn]] void usage() {
+    std::fprintf(stderr,
+                 "usage: llm_mock_server record <dir> [--port N]\n"
+                 "       llm_mock_server replay <dir> [--port N] [--latency-ms N] [--jitter-ms N]\n"
+                 "                                    [--event-delay-ms N] [--speed F]\n");
+    std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+    if (argc < 3) usage();
+    Options options;
+    std::string mode = argv[1];
+    if (mode != "record" && mode != "replay") usage();
+    options.record = mode == "record";
+    options.directory = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) usage();
+        const char* value = argv[++i];
+        if (flag == "--port") options.port = std::atoi(value);
+        else if (flag == "--latency-ms") options.latency_ms = std::atol(value);
+        else if (flag == "--jitter-ms") options.jitter_ms = std::atol(value);
+        else if (flag == "--event-delay-ms") options.event_delay_ms = std::atol(value);
+        else if (flag == "--speed") options.speed = std::atof(value);
+        else usage();
+    }
+    return options;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    Options options = parse_options(argc, argv);
+    try {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        std::unique_ptr<Recorder> recorder;
+        std::unique_ptr<ReplayStore> store;
+        if (options.record) {
+            std::filesystem::create_directories(options.directory);
+            recorder = std::make_unique<Recorder>(options.directory);
+        } else {
+            store = std::make_unique<ReplayStore>(options.directory);
+            std::fprintf(stderr, "loaded %zu exchanges from %s\n", store->size(), options.directory.c_str());
+        }
+
+        int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listener < 0) throw std::runtime_error("socket() failed");
+        int reuse = 1;
+        ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(options.port));
+        if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 128) != 0) {
+            throw std::runtime_error("Failed to listen on 127.0.0.1:" + std::to_string(options.port));
+        }
+        std::fprintf(stderr, "%s on http://127.0.0.1:%d (export LLM_CLI_REPLAY_SERVER=http://127.0.0.1:%d)\n",
+                     options.record ? "recording" : "replaying", options.port, options.port);
+
+        while (true) {
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) continue;
+            std::thread(serve_connection, fd, std::cref(options), recorder.get(), store.get()).detach();
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "llm_mock_server: %s\n", e.what());
+        return 1;
+    }
+}
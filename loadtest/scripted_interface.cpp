@@ -0,0 +1,55 @@
+#include "scripted_interface.h"
+#include <cstdio>
+
+ScriptedInterface::ScriptedInterface(std::vector<std::string> prompts, size_t turns)
+    : prompts_(std::move(prompts)), turns_(turns) {}
+
+double ScriptedInterface::elapsedMs(Clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+std::optional<std::string> ScriptedInterface::promptUserInput() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (turn_start_) {
+        timings_.turn_ms.push_back(elapsedMs(*turn_start_));
+    }
+    if (next_turn_ >= turns_ || prompts_.empty()) {
+        turn_start_.reset();
+        return std::nullopt;
+    }
+    const std::string& prompt = prompts_[next_turn_ % prompts_.size()];
+    ++next_turn_;
+    first_chunk_seen_ = false;
+    turn_start_ = Clock::now();
+    return prompt;
+}
+
+void ScriptedInterface::displayError(const std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++timings_.errors;
+    if (verbose_) {
+        std::fprintf(stderr, "[turn %zu] error: %s\n", next_turn_, error.c_str());
+    }
+}
+
+void ScriptedInterface::displayStreamingChunk(const std::string& chunk) {
+    if (chunk.empty()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!first_chunk_seen_ && turn_start_) {
+        first_chunk_seen_ = true;
+        timings_.first_chunk_ms.push_back(elapsedMs(*turn_start_));
+    }
+}
+
+void ScriptedInterface::displayPartialResult(const std::string&, const std::string& content) {
+    displayStreamingChunk(content);
+}
+
+void ScriptedInterface::displayToolOutputChunk(const std::string& chunk) {
+    displayStreamingChunk(chunk);
+}
+
+ScriptedInterface::Timings ScriptedInterface::timings() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return timings_;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ui_interface.h"
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * ScriptedInterface - UserInterface that plays a fixed prompt script
+ *
+ * promptUserInput() hands out the prompts in order (cycling through the
+ * script) until the turn budget is used up, then ends the session. Output is
+ * discarded; per-turn timings are kept:
+ * - turn latency: from handing out a prompt until the next prompt is requested
+ *   (the whole ChatClient::processTurn, including tool calls)
+ * - first chunk latency: from handing out a prompt until the first streamed
+ *   chunk (of the reply, or of a research tool's progress) is displayed
+ */
+class ScriptedInterface : public NullUserInterface {
+public:
+    struct Timings {
+        std::vector<double> turn_ms;
+        std::vector<double> first_chunk_ms;
+        size_t errors = 0;
+    };
+
+    ScriptedInterface(std::vector<std::string> prompts, size_t turns);
+
+    std::optional<std::string> promptUserInput() override;
+    void displayError(const std::string& error) override;
+    void displayStreamingChunk(const std::string& chunk) override;
+    void displayPartialResult(const std::string& title, const std::string& content) override;
+    void displayToolOutputChunk(const std::string& chunk) override;
+
+    // Timings of the turns completed so far
+    Timings timings() const;
+
+    // Print errors as they happen (off by default)
+    void setVerbose(bool verbose) { verbose_ = verbose; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::string> prompts_;
+    size_t turns_;
+    size_t next_turn_ = 0;
+    bool verbose_ = false;
+
+    std::optional<Clock::time_point> turn_start_;
+    bool first_chunk_seen_ = false;
+
+    mutable std::mutex mutex_; // Errors and status may arrive from tool worker threads
+    Timings timings_;
+
+    static double elapsedMs(Clock::time_point since);
+};
@@ -4,23 +4,182 @@
 #include "chat_client.h" // Include the ChatClient header
 #include "cli_interface.h" // Include the CLI UI implementation header
 #include "database.h"    // Include the PersistenceManager header
-#include <stop_token>      // Include for std::stop_token
+#include "batch_runner.h"  // Non-interactive --batch mode
+#include "interrupt.h"     // Ctrl+C cancels the running turn
+#include "trace.h"         // Startup phase spans (--profile-startup)
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>         // For getenv
+#include <cstring>
+#include <fstream>
 
 // Use std namespace explicitly to avoid potential conflicts
 using std::cerr;
 using std::endl;
 using std::string;
 
-int main() {
+static void print_usage() {
+    cerr << "usage: llm-cli                                   interactive chat\n"
+            "       llm-cli --batch [FILE|-] [--concurrency N] [--model ID]\n"
+            "                 one prompt (text or JSON) per line in, one JSON response per line out\n"
+            "       llm-cli --profile-startup                 time each startup phase up to the prompt, then exit\n";
+}
+
+// Run one startup phase as a "startup.<phase>" span; returns what f returns
+template <typename F>
+static auto startup_phase(const char* stage, F&& f) {
+    TraceSpan span(stage);
+    return f();
+}
+
+// --profile-startup report: the startup.*, db.* and tools.* spans recorded so
+// far in start order, split into the path to the prompt (the main thread) and
+// work done in the background
+static std::string startup_report(uint64_t ready_ns) {
+    std::vector<Tracer::Span> spans;
+    for (const Tracer::Span& span : Tracer::global().snapshot()) {
+        std::string_view stage = span.stage;
+        if (stage.starts_with("startup.") || stage.starts_with("db.") || stage.starts_with("tools.")) {
+            spans.push_back(span);
+        }
+    }
+    std::sort(spans.begin(), spans.end(),
+              [](const Tracer::Span& a, const Tracer::Span& b) { return a.start_ns < b.start_ns; });
+    uint32_t main_thread = 0;
+    for (const Tracer::Span& span : spans) {
+        if (std::string_view(span.stage).starts_with("startup.")) {
+            main_thread = span.thread; // The first phase runs on the main thread
+            break;
+        }
+    }
+
+    auto line = [](const Tracer::Span& span) {
+        // Phases flush left, the operations inside them indented
+        bool phase = std::string_view(span.stage).starts_with("startup.");
+        char buffer[160];
+        std::snprintf(buffer, sizeof(buffer), "  %s%-36s %8.2f ms  (at %.2f ms)\n", phase ? "" : "  ", span.stage,
+                      span.duration_ns / 1e6, span.start_ns / 1e6);
+        return std::string(buffer);
+    };
+    char header[96];
+    std::snprintf(header, sizeof(header), "Startup profile: prompt ready %.2f ms after process start\n",
+                  ready_ns / 1e6);
+    std::string report = header;
+    report += "Path to the prompt:\n";
+    for (const Tracer::Span& span : spans) {
+        if (span.thread == main_thread && span.start_ns < ready_ns) report += line(span);
+    }
+    report += "Background (finished so far):\n";
+    for (const Tracer::Span& span : spans) {
+        if (span.thread != main_thread) report += line(span);
+    }
+    return report;
+}
+
+// llm-cli --batch: requests from FILE (or stdin) to stdout; exit status 1 if any request failed
+static int run_batch(int argc, char** argv) {
+    std::string input_path = "-";
+    BatchRunner::Options options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--batch") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] != '-') input_path = argv[++i];
+            else if (i + 1 < argc && std::strcmp(argv[i + 1], "-") == 0) ++i;
+        } else if ((std::strcmp(arg, "--concurrency") == 0 || std::strcmp(arg, "-j") == 0) && i + 1 < argc) {
+            options.concurrency = std::strtoul(argv[++i], nullptr, 10);
+            if (options.concurrency == 0) {
+                cerr << "--concurrency must be a positive number" << endl;
+                return 2;
+            }
+        } else if (std::strcmp(arg, "--model") == 0 && i + 1 < argc) {
+            options.model_id = argv[++i];
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+
+    try {
+        PersistenceManager db_manager; // Settings and the model cache only; batch requests keep no history
+        BatchRunner runner(db_manager, options);
+        size_t failures;
+        if (input_path == "-") {
+            failures = runner.run(std::cin, std::cout);
+        } else {
+            std::ifstream input(input_path);
+            if (!input) {
+                cerr << "Cannot open " << input_path << endl;
+                return 2;
+            }
+            failures = runner.run(input, std::cout);
+        }
+        if (failures > 0) {
+            cerr << failures << " request(s) failed" << endl;
+            return 1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Fatal Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    bool profile_startup = false;
+    if (argc > 1) {
+        bool batch = false;
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--batch") == 0) batch = true;
+        }
+        if (batch) {
+            return run_batch(argc, argv);
+        }
+        if (argc != 2 || std::strcmp(argv[1], "--profile-startup") != 0) {
+            print_usage();
+            return std::strcmp(argv[1], "--help") == 0 || std::strcmp(argv[1], "-h") == 0 ? 0 : 2;
+        }
+        profile_startup = true;
+    }
+
+    // Each phase up to the prompt is a startup.* span (see --profile-startup);
+    // schema migrations, session history, tool schemas and the model catalog
+    // are skipped, deferred to a background thread or built on first use
     CliInterface cli_ui; // Instantiate the CLI UI
-    PersistenceManager db_manager; // Instantiate the DB manager
+    // Message saves go through a background writer unless LLM_CLI_SYNC_WRITES is set
+    PersistenceManager db_manager = startup_phase("startup.database", [] {
+        return PersistenceManager(std::getenv("LLM_CLI_SYNC_WRITES")
+                                      ? PersistenceManager::WriteMode::Synchronous
+                                      : PersistenceManager::WriteMode::WriteBehind);
+    });
     try {
-        cli_ui.initialize(); // Initialize the UI
+        startup_phase("startup.ui", [&] { cli_ui.initialize(); }); // Initialize the UI
+
+        // LLM_CLI_SESSION=<name> resumes (or starts) a named session, e.g. one per terminal
+        if (const char* session_name = std::getenv("LLM_CLI_SESSION"); session_name && *session_name) {
+            TraceSpan span("startup.session");
+            auto session = db_manager.findSession(session_name);
+            db_manager.setActiveSession(session ? session->id : db_manager.createSession(session_name));
+        }
+
+        // Inject the UI and DB manager into the client
+        ChatClient client = startup_phase("startup.chat_client", [&] { return ChatClient(cli_ui, db_manager); });
+        client.startSession(); // Orphan cleanup and context seeding, in the background
+        // Use the saved model from the cache (the catalog loads in the background),
+        // or fetch the models from the API on a first launch
+        startup_phase("startup.models", [&] { client.initialize_model_manager(); });
+
+        if (profile_startup) {
+            uint64_t ready_ns = Tracer::nowNs();
+            client.awaitSession();
+            cli_ui.displayOutput(startup_report(ready_ns), "");
+            cli_ui.shutdown();
+            return 0;
+        }
 
-        ChatClient client(cli_ui, db_manager); // Inject the UI and DB manager into the client
-        client.initialize_model_manager(); // Attempt to initialize models, fetch from API, or use default
-        // Pass a default (non-stoppable) stop_token as the CLI uses Ctrl+D for exit
-        client.run();
+        // Ctrl+C stops the running turn (streams, tools, research); at the prompt it
+        // still ends the process, and Ctrl+D exits normally
+        TurnInterrupter interrupter;
+        client.run(&interrupter);
 
         cli_ui.shutdown(); // Shutdown the UI
         cli_ui.displayOutput("\nExiting...\n", ""); // Use UI for final message
@@ -0,0 +1,173 @@
+#include "model_index.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+
+// Per-token price string from the API -> USD per million tokens (< 0 if unknown)
+double per_million(const std::string& price) {
+    if (price.empty()) return -1;
+    char* end = nullptr;
+    double value = std::strtod(price.c_str(), &end);
+    if (end == price.c_str() || value < 0) return -1;
+    return value * 1e6;
+}
+
+uint8_t parse_modalities(const std::string& modalities_json) {
+    uint8_t mask = 0;
+    // Missing or malformed - no modality information
+    auto modalities = nlohmann::json::parse(modalities_json, nullptr, false);
+    if (!modalities.is_array()) return 0;
+    for (const auto& modality : modalities) {
+        if (modality.is_string()) {
+            mask |= ModelIndex::parseModality(modality.get_ref<const std::string&>());
+        }
+    }
+    return mask;
+}
+
+char lower(char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+} // anonymous namespace
+
+ModelIndex::ModelIndex(const std::vector<ModelData>& models) {
+    // Reserve up front so the interned views stay valid while appending
+    size_t total = 0;
+    for (const auto& model : models) {
+        total += model.id.size() + model.name.size();
+    }
+    strings_.reserve(total);
+    entries_.reserve(models.size());
+    by_id_.reserve(models.size());
+
+    auto intern = [this](const std::string& text) {
+        size_t offset = strings_.size();
+        strings_.append(text);
+        return std::string_view(strings_.data() + offset, text.size());
+    };
+
+    for (const auto& model : models) {
+        if (model.id.empty() || by_id_.count(model.id)) continue;
+        Entry entry;
+        entry.id = intern(model.id);
+        entry.name = intern(model.name.empty() ? model.id : model.name);
+        entry.context_length = model.context_length;
+        entry.prompt_price = per_million(model.pricing_prompt);
+        entry.completion_price = per_million(model.pricing_completion);
+        entry.input_modalities = parse_modalities(model.architecture_input_modalities);
+        by_id_.emplace(entry.id, static_cast<uint32_t>(entries_.size()));
+        entries_.push_back(entry);
+    }
+
+    by_id_order_.resize(entries_.size());
+    for (uint32_t i = 0; i < by_id_order_.size(); ++i) by_id_order_[i] = i;
+    std::sort(by_id_order_.begin(), by_id_order_.end(),
+              [this](uint32_t a, uint32_t b) { return entries_[a].id < entries_[b].id; });
+}
+
+const ModelIndex::Entry* ModelIndex::find(std::string_view id) const {
+    auto it = by_id_.find(id);
+    return it != by_id_.end() ? &entries_[it->second] : nullptr;
+}
+
+std::vector<const ModelIndex::Entry*> ModelIndex::prefixMatches(std::string_view prefix, size_t limit) const {
+    std::vector<const Entry*> matches;
+    auto it = std::lower_bound(by_id_order_.begin(), by_id_order_.end(), prefix,
+                               [this](uint32_t index, std::string_view value) { return entries_[index].id < value; });
+    for (; it != by_id_order_.end() && matches.size() < limit; ++it) {
+        const Entry& entry = entries_[*it];
+        if (entry.id.substr(0, prefix.size()) != prefix) break;
+        matches.push_back(&entry);
+    }
+    return matches;
+}
+
+std::optional<int> ModelIndex::fuzzyScore(std::string_view query, std::string_view candidate) {
+    if (query.empty()) return 0;
+    // Greedy left-to-right subsequence match: consecutive characters and
+    // matches at word boundaries ("openai/gpt-4o": o, g, 4) score higher
+    int score = 0;
+    int streak = 0;
+    size_t q = 0;
+    for (size_t i = 0; i < candidate.size() && q < query.size(); ++i) {
+        if (lower(candidate[i]) != query[q]) {
+            streak = 0;
+            continue;
+        }
+        int points = 1;
+        if (i == 0 || std::string_view("/-_.: ").find(candidate[i - 1]) != std::string_view::npos) {
+            points += 3;
+        }
+        points += 2 * streak;
+        score += points;
+        ++streak;
+        ++q;
+    }
+    if (q < query.size()) return std::nullopt;
+    // Prefer shorter candidates among equal matches
+    return score * 16 - static_cast<int>(std::min<size_t>(candidate.size(), 15));
+}
+
+std::vector<std::pair<int, const ModelIndex::Entry*>> ModelIndex::scoreAll(std::string_view query) const {
+    // Words are matched in order; spaces between them match anything
+    std::string lowered;
+    for (char c : query) {
+        if (c != ' ') lowered += lower(c);
+    }
+
+    std::vector<std::pair<int, const Entry*>> scored;
+    for (const Entry& entry : entries_) {
+        auto id_score = fuzzyScore(lowered, entry.id);
+        auto name_score = fuzzyScore(lowered, entry.name);
+        if (id_score || name_score) {
+            scored.emplace_back(std::max(id_score.value_or(0), name_score.value_or(0)), &entry);
+        }
+    }
+    std::stable_sort(scored.begin(), scored.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+    return scored;
+}
+
+std::vector<const ModelIndex::Entry*> ModelIndex::fuzzyMatches(std::string_view query, size_t limit) const {
+    std::vector<const Entry*> matches;
+    for (const auto& [score, entry] : scoreAll(query)) {
+        if (matches.size() >= limit) break;
+        matches.push_back(entry);
+    }
+    return matches;
+}
+
+std::vector<const ModelIndex::Entry*> ModelIndex::filter(const Filter& filter) const {
+    auto passes = [&filter](const Entry& entry) {
+        if (entry.context_length < filter.min_context_length) return false;
+        if (filter.max_prompt_price &&
+            (entry.prompt_price < 0 || entry.prompt_price > *filter.max_prompt_price)) return false;
+        if ((entry.input_modalities & filter.required_modalities) != filter.required_modalities) return false;
+        return true;
+    };
+
+    std::vector<const Entry*> matches;
+    if (filter.query.empty()) {
+        for (const Entry& entry : entries_) {
+            if (passes(entry)) matches.push_back(&entry);
+        }
+    } else {
+        for (const auto& [score, entry] : scoreAll(filter.query)) {
+            if (passes(*entry)) matches.push_back(entry);
+        }
+    }
+    return matches;
+}
+
+uint8_t ModelIndex::parseModality(std::string_view name) {
+    if (name == "text") return kText;
+    if (name == "image") return kImage;
+    if (name == "audio") return kAudio;
+    if (name == "file") return kFile;
+    if (name == "video") return kVideo;
+    return 0;
+}
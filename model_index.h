@@ -0,0 +1,95 @@
+#pragma once
+
+#include "model_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * ModelIndex - read-only, in-memory view of the model catalog
+ *
+ * Built once per catalog refresh from the cached ModelData rows. Ids and
+ * names are interned into one contiguous buffer and every entry is a small
+ * fixed-size record, so lookups, completion and filtering never touch SQLite
+ * or copy strings:
+ * - find(): exact id lookup (hash map over the interned ids)
+ * - prefixMatches(): ids starting with a prefix (binary search over sorted ids)
+ * - fuzzyMatches(): subsequence match on id and name, best score first
+ * - filter(): context length, prompt price and input modality filters
+ *
+ * An index is immutable once built; ModelManager shares snapshots of it.
+ */
+class ModelIndex {
+public:
+    // Input modalities (bit flags)
+    enum Modality : uint8_t {
+        kText = 1 << 0,
+        kImage = 1 << 1,
+        kAudio = 1 << 2,
+        kFile = 1 << 3,
+        kVideo = 1 << 4,
+    };
+
+    struct Entry {
+        std::string_view id;        // Interned
+        std::string_view name;      // Interned
+        int context_length = 0;
+        double prompt_price = -1;   // USD per million prompt tokens, < 0 if unknown
+        double completion_price = -1;
+        uint8_t input_modalities = 0;
+    };
+
+    // Filters for filter(); unset fields match every model
+    struct Filter {
+        std::string query;                 // Fuzzy-matched against id and name
+        int min_context_length = 0;
+        std::optional<double> max_prompt_price; // USD per million prompt tokens
+        uint8_t required_modalities = 0;   // All of these input modalities
+    };
+
+    ModelIndex() = default;
+    explicit ModelIndex(const std::vector<ModelData>& models);
+
+    ModelIndex(const ModelIndex&) = delete;
+    ModelIndex& operator=(const ModelIndex&) = delete;
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+    // Entries in catalog order (as returned by the database: by name)
+    const std::vector<Entry>& entries() const { return entries_; }
+
+    // Exact id lookup, nullptr if absent
+    const Entry* find(std::string_view id) const;
+
+    // Ids starting with prefix (case-sensitive), in id order
+    std::vector<const Entry*> prefixMatches(std::string_view prefix, size_t limit = SIZE_MAX) const;
+
+    // Models whose id or name contains the query's characters in order
+    // (case-insensitive), best match first
+    std::vector<const Entry*> fuzzyMatches(std::string_view query, size_t limit = SIZE_MAX) const;
+
+    // Models passing every filter; fuzzy-ranked when filter.query is set,
+    // catalog order otherwise
+    std::vector<const Entry*> filter(const Filter& filter) const;
+
+    // Parse a modality name ("image", "audio", ...); 0 if unknown
+    static uint8_t parseModality(std::string_view name);
+
+    // Subsequence match score of query in candidate (higher is better), or
+    // nullopt if candidate does not contain query's characters in order.
+    // query must be lower case; candidate is compared case-insensitively
+    static std::optional<int> fuzzyScore(std::string_view query, std::string_view candidate);
+
+private:
+    std::string strings_;                 // Interned ids and names
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> by_id_order_;   // Entry indices sorted by id
+    std::unordered_map<std::string_view, uint32_t> by_id_;
+
+    std::vector<std::pair<int, const Entry*>> scoreAll(std::string_view query) const;
+};
@@ -1,11 +1,18 @@
 #include "model_manager.h"
 #include "config.h"
 #include "curl_utils.h"
+#include "fnv1a.h"
+#include "http_connection_pool.h"
+#include "http_routing.h"
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
+#include <cctype>
+#include <cstdint>
 #include <cstdlib>
 #include <stdexcept>
 #include <memory>
+#include <string_view>
+#include <utility>
 
 // Helper function to get OpenRouter API key
 static std::string get_openrouter_api_key() {
@@ -20,16 +27,112 @@ static std::string get_openrouter_api_key() {
     throw std::runtime_error("OPENROUTER_API_KEY not set at compile time or in environment");
 }
 
-ModelManager::ModelManager(UserInterface& ui_ref, PersistenceManager& db_ref)
-    : ui(ui_ref), db(db_ref), active_model_id(DEFAULT_MODEL_ID) {
+// Settings keys for the cached catalog's validators and body hash
+static constexpr const char* kModelsEtagKey = "models_etag";
+static constexpr const char* kModelsLastModifiedKey = "models_last_modified";
+static constexpr const char* kModelsCatalogHashKey = "models_catalog_hash";
+
+// FNV-1a over the response body - detects an unchanged catalog when the
+// server sends no validators
+static std::string catalog_hash(std::string_view body) {
+    return std::to_string(fnv1a_hash(body));
+}
+
+// e.g. "3 added, 1 updated, 0 removed"
+static std::string describeSync(const ModelSyncResult& sync) {
+    return std::to_string(sync.inserted) + " added, " + std::to_string(sync.updated) + " updated, " +
+           std::to_string(sync.deleted) + " removed";
+}
+
+// Record ETag / Last-Modified of the models response
+static size_t catalog_header_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    auto* headers = static_cast<std::pair<std::string, std::string>*>(userdata);
+    size_t total_size = size * nitems;
+    std::string_view line(buffer, total_size);
+
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+        return total_size;
+    }
+    std::string name(line.substr(0, colon));
+    for (char& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    std::string_view value = line.substr(colon + 1);
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == '\r' || value.back() == '\n' || value.back() == ' ')) value.remove_suffix(1);
+
+    if (name == "etag") {
+        headers->first.assign(value);
+    } else if (name == "last-modified") {
+        headers->second.assign(value);
+    }
+    return total_size;
+}
+
+// Abort the transfer once the model manager is shutting down
+static int catalog_progress_callback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    return static_cast<std::atomic<bool>*>(clientp)->load() ? 1 : 0;
+}
+
+ModelManager::ModelManager(UserInterface& ui_ref, PersistenceManager& db_ref, HttpConnectionPool& pool_ref)
+    : ui(ui_ref), db(db_ref), connection_pool(pool_ref), active_model_id(DEFAULT_MODEL_ID) {
     // Constructor initializes with default model ID as fallback
 }
 
-ModelManager::~ModelManager() = default;
+ModelManager::~ModelManager() {
+    stop_refresh = true;
+    if (refresh_thread.joinable()) {
+        refresh_thread.join();
+    }
+}
 
 void ModelManager::initialize() {
     ui.setLoadingModelsState(true);
     
+    std::string previously_selected_model_id;
+    try {
+        previously_selected_model_id = db.loadSetting("selected_model_id").value_or("");
+    } catch (const std::exception& e) {
+        ui.displayError("Minor: Could not load previously selected model ID: " + std::string(e.what()));
+    }
+    
+    // Usual launch: the saved model is still cached, so only its row is read;
+    // the full catalog (index, UI list) is loaded on refresh_thread
+    std::optional<ModelData> selected_model;
+    if (!previously_selected_model_id.empty()) {
+        try {
+            selected_model = db.getModelById(previously_selected_model_id);
+        } catch (const std::exception& e) {
+            ui.displayError("Minor: Could not read the models cache: " + std::string(e.what()));
+        }
+    }
+    if (selected_model) {
+        this->active_model_id = selected_model->id;
+        this->active_context_length = selected_model->context_length;
+        ui.setLoadingModelsState(false);
+        ui.displayStatus("Model manager initialized. Active model: " + this->active_model_id);
+        catalog_deferred = true;
+        refresh_thread = std::thread([this]() { backgroundRefresh(); });
+        return;
+    }
+    
+    // Serve the cached catalog right away and revalidate it in the background
+    std::vector<ModelData> cached_models;
+    try {
+        cached_models = db.getAllModels();
+    } catch (const std::exception& e) {
+        ui.displayError("Minor: Could not read the models cache: " + std::string(e.what()));
+    }
+    if (!cached_models.empty()) {
+        publishIndex(cached_models);
+        selectActiveModel(cached_models, "from cache", previously_selected_model_id);
+        ui.setLoadingModelsState(false);
+        ui.displayStatus("Model manager initialized. Active model: " + this->active_model_id);
+        ui.updateModelsList(cached_models);
+        refresh_thread = std::thread([this]() { backgroundRefresh(); });
+        return;
+    }
+    
+    // First launch (or emptied cache): nothing to serve, wait for the API
     try {
         loadModels();
     } catch (const std::exception& e) {
@@ -41,7 +144,9 @@ void ModelManager::initialize() {
     ui.displayStatus("Model manager initialized. Active model: " + this->active_model_id);
     
     try {
-        ui.updateModelsList(db.getAllModels());
+        std::vector<ModelData> models = db.getAllModels();
+        publishIndex(models);
+        ui.updateModelsList(models);
     } catch (const std::exception& e) {
         ui.displayError("Failed to update UI with model list after initialization: " + std::string(e.what()));
     }
@@ -68,16 +173,15 @@ void ModelManager::loadModels() {
     
     try {
         ui.displayStatus("Attempting to fetch models from API...");
-        std::string api_response_str = fetchModelsFromAPI();
-        std::vector<ModelData> fetched_models = parseModelsFromAPIResponse(api_response_str);
+        ModelSyncResult sync;
+        std::vector<ModelData> fetched_models = refreshCatalog(db, false, sync).value_or(std::vector<ModelData>());
         
         if (fetched_models.empty()) {
             ui.displayError("API returned no models. Will attempt to load from cache.");
             throw std::runtime_error("No models returned from API");
         }
         
-        cacheModelsToDB(fetched_models);
-        ui.displayStatus("Successfully fetched and cached " + std::to_string(fetched_models.size()) + " models from API.");
+        ui.displayStatus("Successfully fetched and cached " + std::to_string(fetched_models.size()) + " models from API (" + describeSync(sync) + ").");
         selectActiveModel(fetched_models, "from API", previously_selected_model_id);
         
     } catch (const std::exception& api_or_parse_error) {
@@ -111,12 +215,67 @@ void ModelManager::loadModels() {
     }
 }
 
-std::string ModelManager::fetchModelsFromAPI() {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        throw std::runtime_error("Failed to initialize CURL for fetching models.");
+std::optional<std::vector<ModelData>> ModelManager::refreshCatalog(PersistenceManager& store, bool conditional,
+                                                                  ModelSyncResult& sync) {
+    CatalogResponse response = fetchModelsFromAPI(conditional, store);
+    if (response.http_code == 304) {
+        return std::nullopt;
     }
-    auto curl_guard = std::unique_ptr<CURL, decltype(&curl_easy_cleanup)>{curl, curl_easy_cleanup};
+    
+    auto saveValidators = [&](const std::string& hash) {
+        store.saveSetting(kModelsEtagKey, response.etag);
+        store.saveSetting(kModelsLastModifiedKey, response.last_modified);
+        store.saveSetting(kModelsCatalogHashKey, hash);
+    };
+    
+    // Same body as last time (e.g. the server sent no validators)
+    std::string hash = catalog_hash(response.body);
+    if (conditional && store.loadSetting(kModelsCatalogHashKey).value_or("") == hash) {
+        saveValidators(hash);
+        return std::nullopt;
+    }
+    
+    std::vector<ModelData> fetched_models = parseModelsFromAPIResponse(response.body);
+    if (fetched_models.empty()) {
+        return fetched_models; // Keep the cache and its validators
+    }
+    sync = cacheModelsToDB(fetched_models, store);
+    saveValidators(hash);
+    if (conditional && sync.changed() == 0) {
+        return std::nullopt; // Body changed but no model did (e.g. reordered)
+    }
+    return fetched_models;
+}
+
+void ModelManager::backgroundRefresh() {
+    try {
+        // Own connection - the main one belongs to the chat thread
+        PersistenceManager store(PersistenceManager::WriteMode::Synchronous);
+        if (catalog_deferred) {
+            // Skipped by initialize(): load the cached catalog first
+            std::vector<ModelData> cached = store.getAllModels();
+            publishIndex(cached);
+            ui.updateModelsList(cached);
+        }
+        ModelSyncResult sync;
+        auto models = refreshCatalog(store, true, sync);
+        if (models && !models->empty() && !stop_refresh) {
+            // Same order as the database returns (by name)
+            std::vector<ModelData> cached = store.getAllModels();
+            publishIndex(cached);
+            ui.displayStatus("Model catalog updated (" + describeSync(sync) + ").");
+            ui.updateModelsList(cached);
+        }
+    } catch (const std::exception& e) {
+        if (!stop_refresh) {
+            ui.displayError("Background model refresh failed (using cached models): " + std::string(e.what()));
+        }
+    }
+}
+
+ModelManager::CatalogResponse ModelManager::fetchModelsFromAPI(bool conditional, PersistenceManager& store) {
+    auto handle = connection_pool.acquire();
+    CURL* curl = handle.get();
     
     std::string api_key = get_openrouter_api_key();
     
@@ -126,30 +285,48 @@ std::string ModelManager::fetchModelsFromAPI() {
     headers = curl_slist_append(headers, ("Authorization: Bearer " + api_key).c_str());
     headers = curl_slist_append(headers, "HTTP-Referer: https://llm-cli.tsatsin.com");
     headers = curl_slist_append(headers, "X-Title: LLM-cli");
+    if (conditional) {
+        // Let the server answer 304 if the catalog is unchanged
+        std::string etag = store.loadSetting(kModelsEtagKey).value_or("");
+        std::string last_modified = store.loadSetting(kModelsLastModifiedKey).value_or("");
+        if (!etag.empty()) {
+            headers = curl_slist_append(headers, ("If-None-Match: " + etag).c_str());
+        }
+        if (!last_modified.empty()) {
+            headers = curl_slist_append(headers, ("If-Modified-Since: " + last_modified).c_str());
+        }
+    }
     headers_guard.reset(headers);
     
-    std::string response_buffer;
-    const char* api_url = OPENROUTER_API_URL_MODELS;
+    CatalogResponse response;
+    std::pair<std::string, std::string> validators;
+    const std::string api_url = route_url(OPENROUTER_API_URL_MODELS);
     
-    curl_easy_setopt(curl, CURLOPT_URL, api_url);
+    curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_buffer);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response.body);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, catalog_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &validators);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, catalog_progress_callback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &stop_refresh);
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
     
-    CURLcode res = curl_easy_perform(curl);
+    CURLcode res = perform_transfer(handle);
     
     if (res != CURLE_OK) {
         throw std::runtime_error("API request to fetch models failed: " + std::string(curl_easy_strerror(res)));
     }
     
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    if (http_code != 200) {
-        throw std::runtime_error("API request to fetch models returned HTTP status " + std::to_string(http_code) + ". Response: " + response_buffer);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.http_code);
+    if (response.http_code != 200 && response.http_code != 304) {
+        throw std::runtime_error("API request to fetch models returned HTTP status " + std::to_string(response.http_code) + ". Response: " + response.body);
     }
+    response.etag = std::move(validators.first);
+    response.last_modified = std::move(validators.second);
     
-    return response_buffer;
+    return response;
 }
 
 std::vector<ModelData> ModelManager::parseModelsFromAPIResponse(const std::string& api_response) {
@@ -257,12 +434,12 @@ std::vector<ModelData> ModelManager::parseModelsFromAPIResponse(const std::strin
     return parsed_models;
 }
 
-void ModelManager::cacheModelsToDB(const std::vector<ModelData>& models) {
+ModelSyncResult ModelManager::cacheModelsToDB(const std::vector<ModelData>& models, PersistenceManager& store) {
     if (models.empty()) {
-        return;
+        return {};
     }
     try {
-        db.replaceModelsInDB(models);
+        return store.replaceModelsInDB(models);
     } catch (const std::exception& e) {
         throw;
     }
@@ -306,6 +483,14 @@ void ModelManager::selectActiveModel(const std::vector<ModelData>& available_mod
         ui.displayError("No suitable model found in available list (" + context_msg + "). Using compile-time default: " + this->active_model_id);
     }
     
+    this->active_context_length = 0;
+    for (const auto& model : available_models) {
+        if (model.id == this->active_model_id) {
+            this->active_context_length = model.context_length;
+            break;
+        }
+    }
+    
     // Persist selection
     try {
         db.saveSetting("selected_model_id", this->active_model_id);
@@ -314,24 +499,65 @@ void ModelManager::selectActiveModel(const std::vector<ModelData>& available_mod
     }
 }
 
+std::shared_ptr<const ModelIndex> ModelManager::modelIndex() const {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    if (!index_published) {
+        // Asked for before refresh_thread has loaded the catalog (e.g. /model
+        // right after startup): load it here instead
+        try {
+            model_index = std::make_shared<const ModelIndex>(db.getAllModels());
+            index_published = true;
+        } catch (const std::exception& e) {
+            ui.displayError("Could not read the models cache: " + std::string(e.what()));
+        }
+    }
+    return model_index;
+}
+
+void ModelManager::publishIndex(const std::vector<ModelData>& models) {
+    auto index = std::make_shared<const ModelIndex>(models);
+    std::lock_guard<std::mutex> lock(index_mutex);
+    model_index = std::move(index);
+    index_published = true;
+}
+
 void ModelManager::setActiveModel(const std::string& model_id) {
-    // Validate model exists
-    auto model = db.getModelById(model_id);
-    if (!model.has_value()) {
-        ui.displayError("Model '" + model_id + "' not found.");
-        return; // Don't change active_model_id if validation fails
+    // Validate model exists (exact id, else a unique prefix). Fuzzy matches are
+    // only suggested: a typo must not switch to (and persist) another model
+    auto index = modelIndex();
+    const ModelIndex::Entry* model = index->find(model_id);
+    if (!model) {
+        auto candidates = index->prefixMatches(model_id, 6);
+        bool fuzzy = candidates.empty();
+        if (fuzzy) {
+            candidates = index->fuzzyMatches(model_id, 6);
+        }
+        if (fuzzy || candidates.size() != 1) {
+            std::string message = "Model '" + model_id + "' not found.";
+            if (!candidates.empty()) {
+                message += " Did you mean:";
+                for (size_t i = 0; i < candidates.size() && i < 5; ++i) {
+                    message += (i == 0 ? " " : ", ") + std::string(candidates[i]->id);
+                }
+                message += candidates.size() > 5 ? ", ...?" : "?";
+            }
+            ui.displayError(message);
+            return; // Don't change active_model_id if validation fails
+        }
+        model = candidates.front();
     }
     
     // Set the active model
-    this->active_model_id = model_id;
+    this->active_model_id = std::string(model->id);
+    this->active_context_length = model->context_length;
     
     // Persist the selection
     try {
-        db.saveSetting("selected_model_id", model_id);
+        db.saveSetting("selected_model_id", this->active_model_id);
     } catch (const std::exception& e) {
         ui.displayError("Warning: Could not persist model selection: " + std::string(e.what()));
     }
     
     // Display success
-    ui.displayStatus("Active model set to: " + model->name + " (" + model_id + ")");
-}
\ No newline at end of file
+    ui.displayStatus("Active model set to: " + std::string(model->name) + " (" + this->active_model_id + ")");
+}
@@ -1,14 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 #include "model_types.h"
+#include "model_index.h"
 #include "database.h"
 #include "ui_interface.h"
 
 // Forward declarations
 class PersistenceManager;
 class UserInterface;
+class HttpConnectionPool;
 
 /**
  * ModelManager handles all model-related operations:
@@ -17,34 +24,87 @@ class UserInterface;
  * - Caching models to the database
  * - Managing the active model selection
  * - Asynchronous model loading on startup
+ *
+ * Startup is served from the cached models table (stale-while-revalidate):
+ * the catalog is refreshed on a background thread with a conditional request
+ * and UserInterface::updateModelsList is notified if it changed. Only a first
+ * launch with an empty cache waits for the API. When the saved model is in
+ * the cache, startup reads just that row and the catalog itself is loaded on
+ * the background thread too.
+ *
+ * Lookups go through an in-memory ModelIndex rebuilt once per catalog change;
+ * modelIndex() returns the current snapshot (safe to hold across a refresh).
  */
 class ModelManager {
 public:
-    explicit ModelManager(UserInterface& ui_ref, PersistenceManager& db_ref);
+    explicit ModelManager(UserInterface& ui_ref, PersistenceManager& db_ref, HttpConnectionPool& pool_ref);
     ~ModelManager();
 
     // Initialization - must be called before using the model manager
+    // Returns without network I/O when the models cache is populated
     void initialize();
 
     // Get the currently active model ID
     std::string getActiveModelId() const { return active_model_id; }
     
+    // Context length (tokens) of the active model, 0 if unknown
+    int getActiveContextLength() const { return active_context_length; }
+    
     // Set the active model (validates existence and persists selection)
+    // An id that is not in the catalog selects its unique prefix match; fuzzy
+    // matches are listed as suggestions only
     void setActiveModel(const std::string& model_id);
+    
+    // Current catalog snapshot (never null; read from the models cache on
+    // first use if the background load has not finished yet)
+    std::shared_ptr<const ModelIndex> modelIndex() const;
 
 private:
     // References to dependencies
     UserInterface& ui;
     PersistenceManager& db;
+    HttpConnectionPool& connection_pool; // Shared with ApiClient so the models fetch reuses its connections
 
     // Active model state
     std::string active_model_id;
+    int active_context_length = 0;
+
+    // Catalog snapshot, replaced whole by publishIndex() (or loaded from the
+    // cache by modelIndex() when asked for before anything was published)
+    mutable std::mutex index_mutex;
+    mutable std::shared_ptr<const ModelIndex> model_index = std::make_shared<ModelIndex>();
+    mutable bool index_published = false;
+    void publishIndex(const std::vector<ModelData>& models);
+
+    // initialize() read only the selected model; refresh_thread loads the catalog
+    bool catalog_deferred = false;
+
+    // Background catalog refresh (joined on destruction)
+    std::thread refresh_thread;
+    std::atomic<bool> stop_refresh{false};
+
+    // Response of the models endpoint (body is empty for 304 Not Modified)
+    struct CatalogResponse {
+        long http_code = 0;
+        std::string body;
+        std::string etag;
+        std::string last_modified;
+    };
 
     // Private methods for model loading pipeline
     void loadModels();
-    std::string fetchModelsFromAPI();
+    CatalogResponse fetchModelsFromAPI(bool conditional, PersistenceManager& store);
     std::vector<ModelData> parseModelsFromAPIResponse(const std::string& api_response);
-    void cacheModelsToDB(const std::vector<ModelData>& models);
+    ModelSyncResult cacheModelsToDB(const std::vector<ModelData>& models, PersistenceManager& store);
+    
+    // Fetch the catalog and write it to store; nullopt if it has not changed
+    // since the last refresh (conditional: send the stored validators)
+    // sync receives the rows written
+    std::optional<std::vector<ModelData>> refreshCatalog(PersistenceManager& store, bool conditional,
+                                                         ModelSyncResult& sync);
+    
+    // Runs on refresh_thread with its own database connection
+    void backgroundRefresh();
     
     // Helper to select the appropriate active model from a list
     void selectActiveModel(const std::vector<ModelData>& available_models, 
@@ -1,6 +1,7 @@
 #ifndef MODEL_TYPES_H
 #define MODEL_TYPES_H
 
+#include <cstddef>
 #include <string>
 #include <vector> // Included for potential future use, not strictly necessary for ModelData alone
 
@@ -32,4 +33,14 @@ struct ModelData {
         : id(std::move(id)), name(std::move(name)) {}
 };
 
+// Row counts written by a catalog sync (ModelRepository::replaceModels)
+struct ModelSyncResult {
+    size_t inserted = 0;
+    size_t updated = 0;
+    size_t deleted = 0;
+    size_t unchanged = 0;
+
+    size_t changed() const { return inserted + updated + deleted; }
+};
+
 #endif // MODEL_TYPES_H
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "request_scheduler.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+double env_double(const char* name, double fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    try {
+        return std::max(std::stod(value), 0.0);
+    } catch (...) {
+        return fallback;
+    }
+}
+
+} // namespace
+
+RequestScheduler::Options RequestScheduler::Options::fromEnvironment() {
+    Options options;
+    options.requests_per_second = env_double("LLM_CLI_RATE_RPS", 0);
+    options.burst = env_double("LLM_CLI_RATE_BURST", std::max(1.0, options.requests_per_second));
+    options.tokens_per_minute = env_double("LLM_CLI_RATE_TPM", 0);
+    return options;
+}
+
+RequestScheduler::RequestScheduler(Options options) : options_(options) {
+}
+
+RequestScheduler& RequestScheduler::shared() {
+    static RequestScheduler instance(Options::fromEnvironment());
+    return instance;
+}
+
+void RequestScheduler::Bucket::refill(Clock::time_point now) {
+    if (capacity <= 0) return;
+    double elapsed = std::chrono::duration<double>(now - updated).count();
+    level = std::min(capacity, level + elapsed * per_second);
+    updated = now;
+}
+
+RequestScheduler::Clock::duration RequestScheduler::Bucket::waitFor(double cost) const {
+    if (capacity <= 0 || level >= cost) {
+        return Clock::duration::zero();
+    }
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((cost - level) / per_second));
+}
+
+RequestScheduler::ModelState& RequestScheduler::stateFor(const std::string& model, Clock::time_point now) {
+    auto [it, inserted] = models_.try_emplace(model);
+    if (inserted) {
+        // Buckets start full
+        it->second.requests = {options_.requests_per_second > 0 ? options_.burst : 0,
+                               options_.requests_per_second, options_.burst, now};
+        it->second.tokens = {options_.tokens_per_minute, options_.tokens_per_minute / 60.0,
+                             options_.tokens_per_minute, now};
+    }
+    return it->second;
+}
+
+RequestScheduler::Clock::duration RequestScheduler::readyIn(ModelState& state, size_t tokens, Clock::time_point now) {
+    state.requests.refill(now);
+    state.tokens.refill(now);
+    // A request larger than the whole bucket goes once the bucket is full
+    double token_cost = std::min(static_cast<double>(tokens), state.tokens.capacity);
+    return std::max({state.not_before - now, state.requests.waitFor(1), state.tokens.waitFor(token_cost),
+                     Clock::duration::zero()});
+}
+
+void RequestScheduler::consume(ModelState& state, size_t tokens) {
+    if (state.requests.capacity > 0) state.requests.level -= 1;
+    if (state.tokens.capacity > 0) state.tokens.level -= std::min(static_cast<double>(tokens), state.tokens.capacity);
+}
+
+bool RequestScheduler::acquire(const std::string& model, size_t tokens, Priority priority, const std::stop_token& stop) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ModelState& state = stateFor(model, Clock::now());
+    std::deque<uint64_t>& queue = state.queues[static_cast<int>(priority)];
+    const uint64_t ticket = next_ticket_++;
+    queue.push_back(ticket);
+
+    auto is_head = [&state, ticket]() {
+        const auto& first = state.queues[0].empty() ? state.queues[1] : state.queues[0];
+        return first.front() == ticket;
+    };
+    auto leave = [&]() {
+        queue.erase(std::find(queue.begin(), queue.end(), ticket));
+        changed_.notify_all();
+    };
+
+    while (true) {
+        if (!is_head()) {
+            // Woken when a request ahead of this one goes or gives up
+            if (!changed_.wait(lock, stop, is_head)) {
+                leave();
+                return false;
+            }
+            continue;
+        }
+        auto now = Clock::now();
+        Clock::duration wait = readyIn(state, tokens, now);
+        if (wait == Clock::duration::zero()) {
+            consume(state, tokens);
+            leave();
+            return true;
+        }
+        // An interactive request arriving meanwhile takes over the head
+        changed_.wait_for(lock, stop, wait, [] { return false; });
+        if (stop.stop_requested()) {
+            leave();
+            return false;
+        }
+    }
+}
+
+bool RequestScheduler::tryAcquire(const std::string& model, size_t tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    ModelState& state = stateFor(model, now);
+    if (!state.queues[0].empty() || !state.queues[1].empty() ||
+        readyIn(state, tokens, now) != Clock::duration::zero()) {
+        return false;
+    }
+    consume(state, tokens);
+    return true;
+}
+
+void RequestScheduler::throttle(const std::string& model, std::chrono::milliseconds delay) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    ModelState& state = stateFor(model, now);
+    state.not_before = std::max(state.not_before, now + std::chrono::duration_cast<Clock::duration>(delay));
+    changed_.notify_all();
+}
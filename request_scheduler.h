@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <unordered_map>
+
+/**
+ * RequestScheduler - client-side rate limiting of API requests, per model
+ *
+ * Every attempt ApiClient sends (retries included) first takes a slot here.
+ * Each model has two token buckets: requests per second
+ * (LLM_CLI_RATE_RPS, bursts of LLM_CLI_RATE_BURST) and estimated prompt tokens
+ * per minute (LLM_CLI_RATE_TPM); 0 leaves a bucket unlimited, the default.
+ * A 429 pauses the model for its Retry-After, whatever the limits are.
+ *
+ * Requests that cannot go yet wait in a queue per model instead of failing:
+ * interactive requests (streamed chat turns) go ahead of background ones
+ * (non-streaming research sub-queries and synthesis), and each class is
+ * first come, first served. Only the head of a model's queue consumes
+ * capacity, so a large request is not starved by smaller ones behind it.
+ * Thread-safe; one instance per process.
+ */
+class RequestScheduler {
+public:
+    enum class Priority { Interactive = 0, Background = 1 };
+
+    struct Options {
+        double requests_per_second = 0;  // LLM_CLI_RATE_RPS (0 = unlimited)
+        double burst = 0;                // LLM_CLI_RATE_BURST (default: max(1, requests_per_second))
+        double tokens_per_minute = 0;    // LLM_CLI_RATE_TPM (0 = unlimited)
+
+        static Options fromEnvironment();
+    };
+
+    explicit RequestScheduler(Options options);
+
+    static RequestScheduler& shared();
+
+    // Wait for the model's turn and capacity, then take a request slot and
+    // `tokens` from its buckets; false (without taking anything) if stop was
+    // requested while waiting
+    bool acquire(const std::string& model, size_t tokens, Priority priority, const std::stop_token& stop);
+
+    // Take a slot only if one is free now and nobody is queued for the model
+    bool tryAcquire(const std::string& model, size_t tokens);
+
+    // Hold every request to the model for `delay` (e.g. after a 429)
+    void throttle(const std::string& model, std::chrono::milliseconds delay);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Bucket {
+        double capacity = 0;   // 0 = unlimited
+        double per_second = 0;
+        double level = 0;
+        Clock::time_point updated{};
+
+        void refill(Clock::time_point now);
+        // Time until `cost` is available (zero if it is now)
+        Clock::duration waitFor(double cost) const;
+    };
+
+    struct ModelState {
+        Bucket requests;
+        Bucket tokens;
+        Clock::time_point not_before{};
+        std::deque<uint64_t> queues[2]; // Tickets by Priority
+    };
+
+    Options options_;
+    std::mutex mutex_;
+    std::condition_variable_any changed_;
+    std::unordered_map<std::string, ModelState> models_;
+    uint64_t next_ticket_ = 0;
+
+    ModelState& stateFor(const std::string& model, Clock::time_point now);
+    // Time until a request of `tokens` can go (zero if it can now)
+    Clock::duration readyIn(ModelState& state, size_t tokens, Clock::time_point now);
+    void consume(ModelState& state, size_t tokens);
+};
@@ -0,0 +1,151 @@
+#include "retry_policy.h"
+#include "config.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+
+namespace {
+
+long env_long(const char* name, long fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    try {
+        return std::stol(value);
+    } catch (...) {
+        return fallback;
+    }
+}
+
+std::vector<std::string> split_models(const std::string& list) {
+    std::vector<std::string> models;
+    std::stringstream stream(list);
+    std::string model;
+    while (std::getline(stream, model, ',')) {
+        model.erase(0, model.find_first_not_of(" \t"));
+        model.erase(model.find_last_not_of(" \t") + 1);
+        if (!model.empty()) models.push_back(model);
+    }
+    return models;
+}
+
+} // namespace
+
+RetryPolicy::Options RetryPolicy::Options::fromEnvironment() {
+    Options options;
+    options.attempts_per_model = static_cast<int>(std::clamp<long>(
+        env_long("LLM_CLI_RETRY_ATTEMPTS", options.attempts_per_model), 1, 10));
+    options.base_delay = std::chrono::milliseconds(std::max<long>(
+        env_long("LLM_CLI_RETRY_BASE_MS", static_cast<long>(options.base_delay.count())), 0));
+    options.max_delay = std::chrono::milliseconds(std::max<long>(
+        env_long("LLM_CLI_RETRY_MAX_MS", static_cast<long>(options.max_delay.count())), 0));
+    options.hedge_after = std::chrono::milliseconds(std::max<long>(
+        env_long("LLM_CLI_HEDGE_AFTER_MS", 0), 0));
+    const char* fallbacks = std::getenv("LLM_CLI_FALLBACK_MODELS");
+    options.fallback_models = fallbacks ? split_models(fallbacks) : std::vector<std::string>{DEFAULT_MODEL_ID};
+    return options;
+}
+
+RetryPolicy::RetryPolicy(Options options) : options_(std::move(options)) {
+}
+
+std::vector<std::string> RetryPolicy::candidates(const std::string& requested) const {
+    std::vector<std::string> models;
+    models.reserve(options_.fallback_models.size() + 1);
+    if (!requested.empty()) models.push_back(requested);
+    for (const auto& model : options_.fallback_models) {
+        if (std::find(models.begin(), models.end(), model) == models.end()) {
+            models.push_back(model);
+        }
+    }
+    return models;
+}
+
+RetryPolicy::Action RetryPolicy::classify(CURLcode transport, long http_status) {
+    if (transport != CURLE_OK) {
+        return Action::Retry;
+    }
+    if (http_status == 200) {
+        return Action::Done;
+    }
+    if (http_status == 408 || http_status == 429 || http_status >= 500) {
+        return Action::Retry;
+    }
+    if (http_status == 404) {
+        return Action::NextModel;
+    }
+    return Action::Fail;
+}
+
+std::optional<std::chrono::milliseconds> RetryPolicy::backoff(int retry, long retry_after_seconds) const {
+    using std::chrono::milliseconds;
+    if (retry_after_seconds >= 0) {
+        milliseconds requested(retry_after_seconds * 1000);
+        if (requested > options_.max_delay) {
+            return std::nullopt;
+        }
+        return requested;
+    }
+
+    // Full jitter: spreads the retries of concurrent research calls apart
+    milliseconds ceiling = options_.base_delay * (1LL << std::min(retry, 20));
+    ceiling = std::min(ceiling, options_.max_delay);
+    thread_local std::mt19937_64 random(std::random_device{}());
+    std::uniform_int_distribution<long long> jitter(0, std::max<long long>(ceiling.count(), 0));
+    return milliseconds(jitter(random));
+}
+
+bool RetryPolicy::sleepFor(std::chrono::milliseconds delay, const std::stop_token& stop) {
+    std::mutex mutex;
+    std::condition_variable_any cv;
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait_for(lock, stop, delay, [] { return false; });
+    return !stop.stop_requested();
+}
+
+CircuitBreakers::CircuitBreakers(int threshold, std::chrono::seconds cooldown)
+    : threshold_(std::max(threshold, 1)), cooldown_(cooldown) {
+}
+
+CircuitBreakers& CircuitBreakers::shared() {
+    static CircuitBreakers instance(static_cast<int>(env_long("LLM_CLI_BREAKER_FAILURES", 5)),
+                                    std::chrono::seconds(std::max<long>(env_long("LLM_CLI_BREAKER_COOLDOWN_S", 30), 0)));
+    return instance;
+}
+
+bool CircuitBreakers::allow(const std::string& model) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = breakers_.find(model);
+    if (it == breakers_.end() || it->second.consecutive_failures < threshold_) {
+        return true;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now < it->second.open_until) {
+        return false;
+    }
+    // Half-open: this caller makes the trial; others skip the model until it
+    // reports back (or, if it never does, until another cooldown has passed)
+    it->second.open_until = now + cooldown_;
+    return true;
+}
+
+bool CircuitBreakers::isOpen(const std::string& model) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = breakers_.find(model);
+    return it != breakers_.end() && it->second.consecutive_failures >= threshold_ &&
+        std::chrono::steady_clock::now() < it->second.open_until;
+}
+
+void CircuitBreakers::recordSuccess(const std::string& model) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    breakers_.erase(model);
+}
+
+void CircuitBreakers::recordFailure(const std::string& model) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Breaker& breaker = breakers_[model];
+    if (++breaker.consecutive_failures >= threshold_) {
+        breaker.open_until = std::chrono::steady_clock::now() + cooldown_;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * RetryPolicy - when, how long and on which model ApiClient retries a request
+ *
+ * A request walks an ordered list of candidate models: the requested one,
+ * then LLM_CLI_FALLBACK_MODELS (comma-separated, default DEFAULT_MODEL_ID).
+ * On each candidate:
+ * - Transport errors, 408, 429 and 5xx are retried on the same model up to
+ *   attempts_per_model times, after a full-jitter exponential backoff
+ *   (random in [0, min(max_delay, base_delay * 2^n)]). A Retry-After header
+ *   raises the wait to at least that long; one beyond max_delay moves on to
+ *   the next model instead of waiting
+ * - 404 (unknown or unavailable model) moves on at once
+ * - Any other status fails the request
+ * The fallback applies to that request only; the active model never changes.
+ *
+ * Streaming calls can also be hedged: with hedge_after set, a second request
+ * goes to the next candidate when the first has produced no token by then,
+ * and whichever streams first is kept.
+ */
+class RetryPolicy {
+public:
+    struct Options {
+        int attempts_per_model = 3;                  // LLM_CLI_RETRY_ATTEMPTS
+        std::chrono::milliseconds base_delay{500};   // LLM_CLI_RETRY_BASE_MS
+        std::chrono::milliseconds max_delay{20000};  // LLM_CLI_RETRY_MAX_MS
+        std::vector<std::string> fallback_models;    // LLM_CLI_FALLBACK_MODELS
+        std::chrono::milliseconds hedge_after{0};    // LLM_CLI_HEDGE_AFTER_MS (0 = no hedging)
+
+        static Options fromEnvironment();
+    };
+
+    enum class Action {
+        Done,      // Success
+        Retry,     // Transient: same model again after a backoff
+        NextModel, // This model cannot serve the request
+        Fail       // Request error: no retry helps
+    };
+
+    explicit RetryPolicy(Options options);
+
+    const Options& options() const { return options_; }
+
+    // Requested model followed by the fallbacks, without duplicates
+    std::vector<std::string> candidates(const std::string& requested) const;
+
+    // Classify a finished attempt (transport result, HTTP status if CURLE_OK)
+    static Action classify(CURLcode transport, long http_status);
+
+    // Wait before same-model retry number `retry` (0-based); retry_after_seconds
+    // is the server's Retry-After (-1 if absent). nullopt: the server asks for
+    // longer than max_delay, so move on to the next model.
+    std::optional<std::chrono::milliseconds> backoff(int retry, long retry_after_seconds) const;
+
+    // Sleep for `delay` unless stop is requested first; false if it was
+    static bool sleepFor(std::chrono::milliseconds delay, const std::stop_token& stop);
+
+private:
+    Options options_;
+};
+
+/**
+ * CircuitBreakers - per-model circuit breakers shared by every ApiClient
+ *
+ * After `threshold` consecutive failures a model's breaker opens and requests
+ * skip it (falling over to the next candidate) for `cooldown`. Then a single
+ * trial request is let through (half-open): success closes the breaker, a
+ * failure opens it for another cooldown. Thresholds come from
+ * LLM_CLI_BREAKER_FAILURES (default 5) and LLM_CLI_BREAKER_COOLDOWN_S (30).
+ * Thread-safe.
+ */
+class CircuitBreakers {
+public:
+    CircuitBreakers(int threshold, std::chrono::seconds cooldown);
+
+    // Process-wide instance, created on first use
+    static CircuitBreakers& shared();
+
+    // Whether a request may go to the model now (takes the half-open trial slot)
+    bool allow(const std::string& model);
+
+    // Whether the model's breaker is open, without taking a trial slot
+    bool isOpen(const std::string& model);
+
+    void recordSuccess(const std::string& model);
+    void recordFailure(const std::string& model);
+
+private:
+    struct Breaker {
+        int consecutive_failures = 0;
+        std::chrono::steady_clock::time_point open_until{}; // Also reserves the half-open trial
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Breaker> breakers_;
+    int threshold_;
+    std::chrono::seconds cooldown_;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * SharedText - immutable, reference-counted string
+ *
+ * Holds message content: the text is allocated once (when read from the DB
+ * or produced by the model/tools) and every later copy of the Message - into
+ * the context window, write-behind queue, retry contexts - only bumps a
+ * reference count. Converts implicitly to const std::string& so read-only
+ * call sites are unchanged.
+ */
+class SharedText {
+public:
+    SharedText() = default;
+    SharedText(std::string text) : text_(std::make_shared<const std::string>(std::move(text))) {}
+    SharedText(const char* text) : SharedText(std::string(text)) {}
+    SharedText(const char* text, size_t size) : SharedText(std::string(text, size)) {}
+
+    const std::string& str() const { return text_ ? *text_ : emptyString(); }
+    operator const std::string&() const { return str(); }
+    operator std::string_view() const { return str(); }
+
+    const char* c_str() const { return str().c_str(); }
+    const char* data() const { return str().data(); }
+    size_t size() const { return str().size(); }
+    size_t length() const { return size(); }
+    bool empty() const { return str().empty(); }
+    char front() const { return str().front(); }
+    char back() const { return str().back(); }
+
+    // Number of SharedText instances referring to this buffer (0 for empty)
+    long useCount() const { return text_.use_count(); }
+
+    friend bool operator==(const SharedText& a, const SharedText& b) { return a.str() == b.str(); }
+    friend bool operator==(const SharedText& a, std::string_view b) { return a.str() == b; }
+    friend std::ostream& operator<<(std::ostream& os, const SharedText& text) { return os << text.str(); }
+
+private:
+    std::shared_ptr<const std::string> text_;
+
+    static const std::string& emptyString() {
+        static const std::string empty_text;
+        return empty_text;
+    }
+};
@@ -0,0 +1,360 @@
+#include "sse_parser.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// SAX handler that extracts choices[0].delta.content and choices[0].finish_reason.
+// It aborts (requesting a full parse) as soon as it sees a root "error" key or a
+// delta "tool_calls" key, since those frames need the complete structure.
+class DeltaFrameHandler {
+public:
+    explicit DeltaFrameHandler(std::string& content_out) : content(content_out) {
+        content.clear();
+    }
+
+    std::string& content;
+    bool has_content = false;
+    bool has_finish_reason = false;
+    std::string finish_reason;
+    bool needs_full_parse = false;
+
+    bool null() { return scalar(); }
+    bool boolean(bool) { return scalar(); }
+    bool number_integer(nlohmann::json::number_integer_t) { return scalar(); }
+    bool number_unsigned(nlohmann::json::number_unsigned_t) { return scalar(); }
+    bool number_float(nlohmann::json::number_float_t, const std::string&) { return scalar(); }
+    bool binary(nlohmann::json::binary_t&) { return scalar(); }
+
+    bool string(std::string& value) {
+        if (!frames.empty()) {
+            const Frame& parent = frames.back();
+            if (parent.node == Node::Delta && parent.key == Key::Content) {
+                content.append(value);
+                has_content = true;
+            } else if (parent.node == Node::Choice0 && parent.key == Key::FinishReason) {
+                finish_reason = std::move(value);
+                has_finish_reason = true;
+            }
+        }
+        return scalar();
+    }
+
+    bool start_object(std::size_t) { return push(false); }
+    bool start_array(std::size_t) { return push(true); }
+    bool end_object() { return pop(); }
+    bool end_array() { return pop(); }
+
+    bool key(std::string& name) {
+        Frame& frame = frames.back();
+        frame.key = classify(name);
+        if ((frame.node == Node::Root && frame.key == Key::Error) ||
+            (frame.node == Node::Delta && frame.key == Key::ToolCalls)) {
+            needs_full_parse = true;
+            return false; // Stop the SAX parse; caller falls back to a full parse
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) {
+        return false;
+    }
+
+private:
+    enum class Node { Other, Root, Choices, Choice0, Delta };
+    enum class Key { Other, Choices, Delta, Content, FinishReason, Error, ToolCalls };
+
+    struct Frame {
+        Node node;
+        bool is_array;
+        std::size_t index;
+        Key key;
+    };
+    std::vector<Frame> frames;
+
+    static Key classify(const std::string& name) {
+        if (name == "content") return Key::Content;
+        if (name == "delta") return Key::Delta;
+        if (name == "choices") return Key::Choices;
+        if (name == "finish_reason") return Key::FinishReason;
+        if (name == "error") return Key::Error;
+        if (name == "tool_calls") return Key::ToolCalls;
+        return Key::Other;
+    }
+
+    // Determine what the container being opened represents from its parent position
+    Node childNode() const {
+        if (frames.empty()) return Node::Root;
+        const Frame& parent = frames.back();
+        switch (parent.node) {
+            case Node::Root:    return (!parent.is_array && parent.key == Key::Choices) ? Node::Choices : Node::Other;
+            case Node::Choices: return (parent.is_array && parent.index == 0) ? Node::Choice0 : Node::Other;
+            case Node::Choice0: return (!parent.is_array && parent.key == Key::Delta) ? Node::Delta : Node::Other;
+            default:            return Node::Other;
+        }
+    }
+
+    bool push(bool is_array) {
+        Node node = childNode();
+        if (frames.empty() && is_array) node = Node::Other; // Root must be an object
+        frames.push_back({node, is_array, 0, Key::Other});
+        return true;
+    }
+
+    bool pop() {
+        frames.pop_back();
+        return scalar();
+    }
+
+    // Called after every complete value to advance the parent's array index
+    bool scalar() {
+        if (!frames.empty() && frames.back().is_array) {
+            ++frames.back().index;
+        }
+        return true;
+    }
+};
+
+} // anonymous namespace
+
+SseStreamParser::SseStreamParser(ApiClient::StreamingResponse& response, const ChunkCallback* chunk_callback,
+                                 const ApiClient::ToolCallCallback* tool_call_callback)
+    : response_(&response), chunk_callback_(chunk_callback), tool_call_callback_(tool_call_callback) {
+}
+
+void SseStreamParser::reset(ApiClient::StreamingResponse& response) {
+    response_ = &response;
+    partial_line_.clear();
+    stream_finished_ = false;
+}
+
+bool SseStreamParser::feed(const char* data, size_t size) {
+    std::string_view chunk(data, size);
+    size_t offset = 0;
+
+    // Complete a line left over from the previous chunk
+    if (!partial_line_.empty()) {
+        size_t line_end = chunk.find('\n');
+        if (line_end == std::string_view::npos) {
+            partial_line_.append(chunk);
+            return true;
+        }
+        partial_line_.append(chunk.substr(0, line_end));
+        std::string line = std::move(partial_line_);
+        partial_line_.clear();
+        if (!processLine(line)) {
+            return false;
+        }
+        offset = line_end + 1;
+    }
+
+    // Scan the remaining complete lines directly in the received buffer
+    while (offset < chunk.size()) {
+        size_t line_end = chunk.find('\n', offset);
+        if (line_end == std::string_view::npos) {
+            partial_line_.assign(chunk.substr(offset));
+            break;
+        }
+        if (!processLine(chunk.substr(offset, line_end - offset))) {
+            return false;
+        }
+        offset = line_end + 1;
+    }
+    return true;
+}
+
+bool SseStreamParser::processLine(std::string_view line) {
+    // Trim trailing whitespace
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+        line.remove_suffix(1);
+    }
+
+    // Skip empty lines, SSE comments (e.g., ": OPENROUTER PROCESSING") and
+    // anything after the stream has finished
+    if (line.empty() || line.front() == ':' || stream_finished_) {
+        return true;
+    }
+
+    constexpr std::string_view data_prefix = "data: ";
+    if (line.substr(0, data_prefix.size()) != data_prefix) {
+        return true;
+    }
+    return processData(line.substr(data_prefix.size()));
+}
+
+bool SseStreamParser::processData(std::string_view data) {
+    // Check for stream end
+    if (data == "[DONE]") {
+        stream_finished_ = true;
+        return true;
+    }
+
+    // Fast path: content/finish_reason frames without building a DOM
+    DeltaFrameHandler handler(content_scratch_);
+    bool parsed = nlohmann::json::sax_parse(data.begin(), data.end(), &handler);
+    if (parsed) {
+        if (handler.has_finish_reason) {
+            setFinishReason(std::move(handler.finish_reason));
+        }
+        if (handler.has_content) {
+            return emitContent(handler.content);
+        }
+        return true;
+    }
+    if (!handler.needs_full_parse) {
+        // Ignore JSON parsing errors for individual chunks
+        return true;
+    }
+
+    // Slow path: tool_call or error frame
+    try {
+        return processFullFrame(nlohmann::json::parse(data.begin(), data.end()));
+    } catch (const nlohmann::json::exception& e) {
+        // Ignore JSON parsing errors for individual chunks
+        return true;
+    }
+}
+
+bool SseStreamParser::emitContent(const std::string& content) {
+    response_->accumulated_content += content;
+
+    // Call the chunk callback (must not let exceptions escape to C code)
+    if (chunk_callback_ && *chunk_callback_) {
+        try {
+            (*chunk_callback_)(content);
+        } catch (const std::exception& e) {
+            // Capture exception and signal error to stop transfer
+            response_->callback_exception = true;
+            response_->callback_exception_message =
+                std::string("Callback exception: ") + e.what();
+            return false;
+        } catch (...) {
+            // Capture unknown exception
+            response_->callback_exception = true;
+            response_->callback_exception_message =
+                "Unknown callback exception occurred";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SseStreamParser::announceToolCall(ApiClient::StreamingResponse::ToolCallBuffer& buffer) {
+    if (buffer.announced || buffer.id.empty() || buffer.name.empty() || !buffer.arguments_scanner.complete()) {
+        return true;
+    }
+    buffer.announced = true;
+
+    // Same exception handling as the chunk callback
+    try {
+        (*tool_call_callback_)(buffer);
+    } catch (const std::exception& e) {
+        response_->callback_exception = true;
+        response_->callback_exception_message =
+            std::string("Tool call callback exception: ") + e.what();
+        return false;
+    } catch (...) {
+        response_->callback_exception = true;
+        response_->callback_exception_message =
+            "Unknown tool call callback exception occurred";
+        return false;
+    }
+    return true;
+}
+
+bool SseStreamParser::processFullFrame(const nlohmann::json& chunk_json) {
+    // Check for mid-stream error
+    if (chunk_json.contains("error")) {
+        response_->has_error = true;
+        response_->error_message = chunk_json["error"]["message"].get<std::string>();
+
+        // Check for error finish_reason
+        if (chunk_json.contains("choices") && !chunk_json["choices"].empty()) {
+            auto finish_reason = chunk_json["choices"][0].value("finish_reason", "");
+            if (finish_reason == "error") {
+                response_->finish_reason = "error";
+            }
+        }
+        stream_finished_ = true;
+        return true;
+    }
+
+    // Extract content delta and tool calls
+    if (!chunk_json.contains("choices") || chunk_json["choices"].empty()) {
+        return true;
+    }
+    const auto& choice = chunk_json["choices"][0];
+
+    if (choice.contains("delta")) {
+        const auto& delta = choice["delta"];
+
+        // Handle content
+        if (delta.contains("content") && !delta["content"].is_null()) {
+            if (!emitContent(delta["content"].get<std::string>())) {
+                return false;
+            }
+        }
+
+        // Handle tool_calls - append each delta to its per-index buffer in place
+        if (delta.contains("tool_calls") && !delta["tool_calls"].is_null()) {
+            response_->has_tool_calls = true;
+            auto& buffers = response_->tool_call_buffers;
+
+            for (const auto& tool_call_delta : delta["tool_calls"]) {
+                if (!tool_call_delta.contains("index")) continue;
+
+                int index = tool_call_delta["index"].get<int>();
+                if (index < 0) continue;
+                if (buffers.size() <= static_cast<size_t>(index)) {
+                    buffers.resize(static_cast<size_t>(index) + 1);
+                }
+                auto& buffer = buffers[static_cast<size_t>(index)];
+                response_->tool_calls_dirty = true;
+
+                // id and type appear once
+                if (tool_call_delta.contains("id") && tool_call_delta["id"].is_string()) {
+                    buffer.id = tool_call_delta["id"].get_ref<const std::string&>();
+                }
+                if (tool_call_delta.contains("type") && tool_call_delta["type"].is_string()) {
+                    buffer.type = tool_call_delta["type"].get_ref<const std::string&>();
+                }
+
+                if (tool_call_delta.contains("function")) {
+                    const auto& func_delta = tool_call_delta["function"];
+                    buffer.has_function = true;
+
+                    // Function name appears once
+                    if (func_delta.contains("name") && func_delta["name"].is_string()) {
+                        buffer.name = func_delta["name"].get_ref<const std::string&>();
+                    }
+
+                    // Arguments are streamed incrementally - append only the new fragment
+                    if (func_delta.contains("arguments") && func_delta["arguments"].is_string()) {
+                        const auto& fragment = func_delta["arguments"].get_ref<const std::string&>();
+                        buffer.has_arguments = true;
+                        buffer.arguments.append(fragment);
+                        buffer.arguments_scanner.feed(fragment);
+                    }
+                }
+
+                if (tool_call_callback_ && *tool_call_callback_ && !announceToolCall(buffer)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    // Check for finish_reason
+    if (choice.contains("finish_reason") && !choice["finish_reason"].is_null()) {
+        setFinishReason(choice["finish_reason"].get<std::string>());
+    }
+    return true;
+}
+
+void SseStreamParser::setFinishReason(std::string finish_reason) {
+    response_->finish_reason = std::move(finish_reason);
+    // The tool_calls are complete once the choice finishes - build the JSON once
+    if (response_->has_tool_calls) {
+        response_->materializeToolCalls();
+    }
+}
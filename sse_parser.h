@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include "api_client.h"
+
+/**
+ * SseStreamParser incrementally decodes an OpenRouter SSE stream:
+ * - Complete lines are scanned in place in each received chunk (no per-line copies)
+ * - Only a trailing partial line is buffered until the next chunk arrives
+ * - Plain content frames go through a SAX fast path that reads
+ *   choices[0].delta.content / finish_reason without building a JSON DOM
+ * - tool_calls and error frames fall back to a full nlohmann::json parse; tool_call
+ *   argument fragments are appended to per-index buffers on the StreamingResponse
+ * - Each buffer's arguments are scanned as they grow; the tool call callback
+ *   gets a call as soon as its arguments object closes, before the stream ends
+ */
+class SseStreamParser {
+public:
+    using ChunkCallback = std::function<void(const std::string&)>;
+
+    SseStreamParser(ApiClient::StreamingResponse& response, const ChunkCallback* chunk_callback,
+                    const ApiClient::ToolCallCallback* tool_call_callback = nullptr);
+
+    // Feed raw bytes received from the transport
+    // Returns false if the transfer should be aborted (chunk callback threw)
+    bool feed(const char* data, size_t size);
+
+    // Bytes received but not yet consumed as a complete line
+    // (for non-200 responses this holds the raw error body)
+    std::string_view pending() const { return partial_line_; }
+
+    // Prepare for a new stream (e.g. on retry)
+    void reset(ApiClient::StreamingResponse& response);
+
+private:
+    ApiClient::StreamingResponse* response_;
+    const ChunkCallback* chunk_callback_;
+    const ApiClient::ToolCallCallback* tool_call_callback_;
+    std::string partial_line_;
+    std::string content_scratch_;  // Reused across frames by the SAX fast path
+    bool stream_finished_ = false; // Set after [DONE] or a mid-stream error
+
+    bool processLine(std::string_view line);
+    bool processData(std::string_view data);
+    bool processFullFrame(const nlohmann::json& chunk_json);
+    bool emitContent(const std::string& content);
+    bool announceToolCall(ApiClient::StreamingResponse::ToolCallBuffer& buffer);
+    void setFinishReason(std::string finish_reason);
+};
@@ -0,0 +1,272 @@
+#include "terminal_renderer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+long env_long(const char* name, long fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    try {
+        return std::stol(value);
+    } catch (...) {
+        return fallback;
+    }
+}
+
+constexpr std::string_view kFence = "```";
+
+} // namespace
+
+// --- MarkdownStyler ---
+
+void MarkdownStyler::appendStyle(std::string& out) const {
+    if (heading_ || bold_) out += "\x1b[1m";
+    if (code_ || fence_) out += "\x1b[36m";
+}
+
+void MarkdownStyler::restyle(std::string& out) const {
+    out += kReset;
+    appendStyle(out);
+}
+
+void MarkdownStyler::feed(std::string_view chunk, std::string& out) {
+    for (char c : chunk) {
+        if (line_start_) {
+            line_head_ += c;
+            decideLineHead(out, false);
+        } else if (fence_) {
+            out += c;
+            line_start_ = (c == '\n');
+        } else {
+            inlineChar(c, out);
+        }
+    }
+}
+
+void MarkdownStyler::finish(std::string& out) {
+    if (line_start_ && !line_head_.empty()) {
+        decideLineHead(out, true);
+    }
+    if (pending_star_) {
+        out += '*';
+    }
+    if (styled()) {
+        out += kReset;
+    }
+    *this = MarkdownStyler();
+}
+
+// Called with each new byte of line_head_ until the line's kind is known
+void MarkdownStyler::decideLineHead(std::string& out, bool force) {
+    const std::string& head = line_head_;
+    if (!force && head.size() < kFence.size() && kFence.starts_with(head)) {
+        return; // May still become a fence
+    }
+    if (head == kFence) {
+        line_start_ = false;
+        line_head_.clear();
+        if (!fence_) {
+            fence_ = true;
+            restyle(out);
+            out += kFence;
+        } else {
+            out += kFence;
+            fence_ = false;
+            restyle(out);
+        }
+        return;
+    }
+    if (!force && !fence_ && head.front() == '#') {
+        size_t hashes = head.find_first_not_of('#');
+        if (hashes == std::string::npos) {
+            if (head.size() <= 6) return; // May still become a heading
+        } else if (head[hashes] == ' ' && hashes <= 6) {
+            heading_ = true;
+            line_start_ = false;
+            restyle(out);
+            out += head;
+            line_head_.clear();
+            return;
+        }
+    }
+
+    // An ordinary line: the held-back bytes are rendered like any others
+    line_start_ = false;
+    std::string held = std::move(line_head_);
+    line_head_.clear();
+    for (char c : held) {
+        if (fence_) {
+            out += c;
+            line_start_ = (c == '\n');
+        } else {
+            inlineChar(c, out);
+        }
+    }
+}
+
+void MarkdownStyler::inlineChar(char c, std::string& out) {
+    if (pending_star_) {
+        pending_star_ = false;
+        if (c == '*') {
+            bold_ = !bold_;
+            restyle(out);
+            return;
+        }
+        out += '*';
+    }
+    switch (c) {
+    case '*':
+        if (code_) {
+            out += c;
+        } else {
+            pending_star_ = true;
+        }
+        return;
+    case '`':
+        code_ = !code_;
+        restyle(out);
+        return;
+    case '\n':
+        // Headings and inline code end with the line
+        if (heading_ || code_) {
+            heading_ = false;
+            code_ = false;
+            restyle(out);
+        }
+        out += c;
+        line_start_ = true;
+        return;
+    default:
+        out += c;
+    }
+}
+
+// --- TerminalRenderer ---
+
+TerminalRenderer::Options TerminalRenderer::Options::fromEnvironment() {
+    Options options;
+    options.frame = std::chrono::milliseconds(std::clamp<long>(
+        env_long("LLM_CLI_RENDER_FRAME_MS", static_cast<long>(options.frame.count())), 0, 1000));
+    const char* markdown = std::getenv("LLM_CLI_MARKDOWN");
+    const char* no_color = std::getenv("NO_COLOR");
+    options.markdown = !(markdown && std::string_view(markdown) == "0") && !(no_color && *no_color);
+    return options;
+}
+
+TerminalRenderer::TerminalRenderer(int fd, Options options)
+    : fd_(fd), options_(options), terminal_(isatty(fd) == 1) {
+    if (terminal_) {
+        thread_ = std::thread(&TerminalRenderer::run, this);
+    }
+}
+
+TerminalRenderer::~TerminalRenderer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join(); // Writes out whatever is left first
+    }
+}
+
+void TerminalRenderer::write(std::string_view text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool urgent = text.find('\n') != std::string_view::npos;
+    if (terminal_ && styler_.styled()) {
+        std::string out(MarkdownStyler::kReset);
+        out += text;
+        styler_.appendStyle(out);
+        enqueue(out, urgent);
+    } else {
+        enqueue(text, urgent);
+    }
+}
+
+void TerminalRenderer::writeMarkdown(std::string_view chunk) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!terminal_ || !options_.markdown) {
+        enqueue(chunk, chunk.find('\n') != std::string_view::npos);
+        return;
+    }
+    std::string out;
+    out.reserve(chunk.size() + 16);
+    styler_.feed(chunk, out);
+    enqueue(out, out.find('\n') != std::string::npos);
+}
+
+void TerminalRenderer::endMarkdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!terminal_ || !options_.markdown) {
+        return;
+    }
+    std::string out;
+    styler_.finish(out);
+    enqueue(out, false);
+}
+
+void TerminalRenderer::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!terminal_ || written_ >= queued_) {
+        return;
+    }
+    uint64_t target = queued_;
+    urgent_ = true;
+    wake_.notify_one();
+    drained_.wait(lock, [&] { return written_ >= target; });
+}
+
+void TerminalRenderer::enqueue(std::string_view text, bool urgent) {
+    if (text.empty()) {
+        return;
+    }
+    if (!terminal_) {
+        writeAll(text);
+        return;
+    }
+    if (pending_.empty()) {
+        pending_since_ = std::chrono::steady_clock::now();
+    }
+    pending_.append(text);
+    queued_ += text.size();
+    urgent_ = urgent_ || urgent;
+    wake_.notify_one();
+}
+
+void TerminalRenderer::run() {
+    std::string frame; // Swapped with pending_, so both buffers keep their capacity
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [&] { return stopping_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            break; // Stopping with nothing left to write
+        }
+        if (!urgent_ && !stopping_) {
+            // Let the rest of the frame's chunks join this write
+            wake_.wait_until(lock, pending_since_ + options_.frame, [&] { return urgent_ || stopping_; });
+        }
+        frame.swap(pending_);
+        urgent_ = false;
+        lock.unlock();
+        writeAll(frame);
+        lock.lock();
+        written_ += frame.size();
+        frame.clear();
+        drained_.notify_all();
+    }
+}
+
+void TerminalRenderer::writeAll(std::string_view text) {
+    while (!text.empty()) {
+        ssize_t n = ::write(fd_, text.data(), text.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return; // Output is gone (closed terminal or pipe); drop the rest
+        }
+        text.remove_prefix(static_cast<size_t>(n));
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * MarkdownStyler - incremental markdown to ANSI styling for streamed text
+ *
+ * Each chunk is styled once, as it arrives: the state (line start, heading,
+ * code fence, bold, inline code) carries over between chunks, so nothing
+ * already rendered is scanned again. Bytes that cannot be decided yet (a
+ * trailing '*', the start of a line that may become a fence or heading) are
+ * held back until the next chunk or finish().
+ *
+ * Handled: "# " headings (bold), **bold** (markers hidden), `inline code`
+ * (markers hidden) and ``` fenced blocks (shown in the code colour).
+ * Everything else passes through unchanged.
+ */
+class MarkdownStyler {
+public:
+    // Append the styled form of chunk to out
+    void feed(std::string_view chunk, std::string& out);
+
+    // Emit anything held back, close open styles and start over
+    void finish(std::string& out);
+
+    // Whether a style is active (text written between chunks needs a reset)
+    bool styled() const { return heading_ || fence_ || bold_ || code_; }
+
+    // Escape sequences that end / restore the active style
+    static constexpr std::string_view kReset = "\x1b[0m";
+    void appendStyle(std::string& out) const;
+
+private:
+    bool line_start_ = true;
+    std::string line_head_;  // Undecided start of the current line
+    bool pending_star_ = false;
+    bool heading_ = false;
+    bool fence_ = false;
+    bool bold_ = false;
+    bool code_ = false;
+
+    void inlineChar(char c, std::string& out);
+    void decideLineHead(std::string& out, bool force);
+    void restyle(std::string& out) const;
+};
+
+/**
+ * TerminalRenderer - coalescing writer for the CLI's stdout
+ *
+ * On a terminal, text is appended to a buffer that a renderer thread writes
+ * out with one write(2) per frame (LLM_CLI_RENDER_FRAME_MS, default 16ms),
+ * or sooner when a newline arrives, instead of one flush per streamed token.
+ * Markdown chunks are styled on the way in (LLM_CLI_MARKDOWN=0 or NO_COLOR
+ * turns that off).
+ *
+ * When stdout is not a terminal there is no thread and no styling: every
+ * write goes straight to the file descriptor.
+ * Thread-safe; flush() returns once everything written before it is out.
+ */
+class TerminalRenderer {
+public:
+    struct Options {
+        std::chrono::milliseconds frame{16}; // LLM_CLI_RENDER_FRAME_MS
+        bool markdown = true;                // LLM_CLI_MARKDOWN (0 disables), NO_COLOR
+
+        static Options fromEnvironment();
+    };
+
+    explicit TerminalRenderer(int fd, Options options = Options::fromEnvironment());
+    ~TerminalRenderer();
+
+    TerminalRenderer(const TerminalRenderer&) = delete;
+    TerminalRenderer& operator=(const TerminalRenderer&) = delete;
+
+    bool isTerminal() const { return terminal_; }
+
+    // Plain text (any active markdown style is suspended around it)
+    void write(std::string_view text);
+
+    // A chunk of a markdown stream; endMarkdown() closes the stream
+    void writeMarkdown(std::string_view chunk);
+    void endMarkdown();
+
+    // Block until everything written so far has reached the file descriptor
+    void flush();
+
+private:
+    const int fd_;
+    const Options options_;
+    const bool terminal_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;     // Renderer: pending text, newline, flush or stop
+    std::condition_variable drained_;  // flush(): written_ advanced
+    std::string pending_;
+    std::chrono::steady_clock::time_point pending_since_;
+    bool urgent_ = false;              // Write without waiting out the frame
+    bool stopping_ = false;
+    uint64_t queued_ = 0;              // Bytes appended so far
+    uint64_t written_ = 0;             // Bytes written so far
+    MarkdownStyler styler_;
+    std::thread thread_;
+
+    // Append to the buffer (or write directly); caller holds mutex_
+    void enqueue(std::string_view text, bool urgent);
+    void run();
+    void writeAll(std::string_view text);
+};
@@ -0,0 +1,202 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+// --- KeyedSemaphore ---
+
+void KeyedSemaphore::setLimit(const std::string& key, size_t limit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot& slot = slots_[key];
+        slot.explicit_limit = true;
+        slot.limit = limit;
+    }
+    cv_.notify_all();
+}
+
+void KeyedSemaphore::setDefaultLimit(size_t limit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        default_limit_ = limit;
+        for (auto& [key, slot] : slots_) {
+            if (!slot.explicit_limit) slot.limit = limit;
+        }
+    }
+    cv_.notify_all();
+}
+
+KeyedSemaphore::Permit KeyedSemaphore::acquire(const std::string& key) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto [it, inserted] = slots_.try_emplace(key);
+    Slot& slot = it->second;
+    if (inserted) {
+        slot.limit = default_limit_;
+    }
+    cv_.wait(lock, [&slot]() { return slot.limit == 0 || slot.in_use < slot.limit; });
+    ++slot.in_use;
+    return Permit(this, key);
+}
+
+std::optional<KeyedSemaphore::Permit> KeyedSemaphore::tryAcquire(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = slots_.try_emplace(key);
+    Slot& slot = it->second;
+    if (inserted) {
+        slot.limit = default_limit_;
+    }
+    if (slot.limit != 0 && slot.in_use >= slot.limit) {
+        return std::nullopt;
+    }
+    ++slot.in_use;
+    return Permit(this, key);
+}
+
+void KeyedSemaphore::release(const std::string& key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = slots_.find(key);
+        if (it != slots_.end() && it->second.in_use > 0) {
+            --it->second.in_use;
+        }
+    }
+    cv_.notify_all();
+}
+
+// --- ThreadPool ---
+
+thread_local ThreadPool* ThreadPool::current_pool_ = nullptr;
+thread_local size_t ThreadPool::current_worker_ = 0;
+
+// Read a positive integer from the environment, or return the fallback
+static size_t env_size(const char* name, size_t fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    try {
+        long long parsed = std::stoll(value);
+        return parsed > 0 ? static_cast<size_t>(parsed) : fallback;
+    } catch (...) {
+        return fallback;
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(
+        env_size("LLM_CLI_WORKER_THREADS", std::max<size_t>(4, std::thread::hardware_concurrency())),
+        env_size("LLM_CLI_MAX_CONNECTIONS_PER_HOST", 4));
+    return pool;
+}
+
+ThreadPool::ThreadPool(size_t worker_count, size_t max_connections_per_host)
+    : host_limits_(max_connections_per_host) {
+    if (worker_count == 0) {
+        worker_count = 1;
+    }
+    local_queues_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        local_queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    workers_.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::noteQueued() {
+    size_t depth = queued_.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t peak = peak_queued_.load(std::memory_order_relaxed);
+    while (depth > peak && !peak_queued_.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {
+    }
+}
+
+void ThreadPool::enqueue(Task task) {
+    if (current_pool_ == this) {
+        // Subtask of a running task - keep it local so the spawning worker can help with it
+        WorkerQueue& queue = *local_queues_[current_worker_];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+        noteQueued();
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        injection_queue_.push_back(std::move(task));
+        noteQueued();
+    }
+    {
+        // Taking the lock orders this notify after any worker's predicate check
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    cv_.notify_one();
+}
+
+bool ThreadPool::tryPopLocal(size_t index, Task& task) {
+    WorkerQueue& queue = *local_queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ThreadPool::tryPopInjected(Task& task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (injection_queue_.empty()) return false;
+    task = std::move(injection_queue_.front());
+    injection_queue_.pop_front();
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ThreadPool::trySteal(size_t thief, Task& task) {
+    size_t count = local_queues_.size();
+    for (size_t offset = 1; offset < count; ++offset) {
+        WorkerQueue& victim = *local_queues_[(thief + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runLocalTask() {
+    Task task;
+    if (!tryPopLocal(current_worker_, task)) {
+        return false;
+    }
+    task(); // packaged_task captures any exception in its future
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    current_pool_ = this;
+    current_worker_ = index;
+
+    while (true) {
+        Task task;
+        if (tryPopLocal(index, task) || tryPopInjected(task) || trySteal(index, task)) {
+            task(); // packaged_task captures any exception in its future
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopping_ && queued_.load(std::memory_order_relaxed) == 0) {
+            return; // Stopping and fully drained
+        }
+        cv_.wait(lock, [this]() { return stopping_ || queued_.load(std::memory_order_relaxed) > 0; });
+    }
+}
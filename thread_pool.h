@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * KeyedSemaphore - independent counting semaphores looked up by key
+ *
+ * Used to cap how many operations of one kind (e.g. a given tool, or
+ * connections to one host) run at once. Keys without an explicit limit use
+ * the default limit (0 = unlimited).
+ */
+class KeyedSemaphore {
+public:
+    explicit KeyedSemaphore(size_t default_limit = 0) : default_limit_(default_limit) {}
+
+    // Set the maximum number of concurrent holders for a key (0 = unlimited)
+    void setLimit(const std::string& key, size_t limit);
+
+    // Set the limit used by keys that have no explicit limit
+    void setDefaultLimit(size_t limit);
+
+    // RAII permit - released on destruction
+    class Permit {
+    public:
+        Permit(Permit&& other) noexcept : owner_(other.owner_), key_(std::move(other.key_)) { other.owner_ = nullptr; }
+        Permit(const Permit&) = delete;
+        Permit& operator=(const Permit&) = delete;
+        Permit& operator=(Permit&&) = delete;
+        ~Permit() { if (owner_) owner_->release(key_); }
+
+    private:
+        friend class KeyedSemaphore;
+        Permit(KeyedSemaphore* owner, std::string key) : owner_(owner), key_(std::move(key)) {}
+        KeyedSemaphore* owner_;
+        std::string key_;
+    };
+
+    // Block until a permit for the key is available
+    Permit acquire(const std::string& key);
+
+    // A permit if one is available right now (for event loops that cannot block)
+    std::optional<Permit> tryAcquire(const std::string& key);
+
+private:
+    struct Slot {
+        bool explicit_limit = false;
+        size_t limit = 0;
+        size_t in_use = 0;
+    };
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string, Slot> slots_;
+    size_t default_limit_;
+
+    void release(const std::string& key);
+};
+
+/**
+ * ThreadPool - work-stealing executor with a fixed set of worker threads
+ *
+ * - Tasks submitted from outside the pool go to a shared injection queue
+ * - Tasks submitted from a worker go to that worker's own deque (LIFO for the
+ *   owner, FIFO for idle workers stealing from it)
+ * - await() lets a task wait for subtasks it spawned: while the future is not
+ *   ready the waiting worker runs tasks from its own deque, so nested fan-out
+ *   (deep_research -> web_research -> visit_url) cannot starve the pool
+ *
+ * shared() returns the process-wide instance used by ToolExecutor and the
+ * research tools. Its size comes from LLM_CLI_WORKER_THREADS (default: number
+ * of hardware threads, at least 4); LLM_CLI_MAX_CONNECTIONS_PER_HOST caps
+ * concurrent fetches per host (default 4).
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t worker_count, size_t max_connections_per_host = 4);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide executor, created on first use
+    static ThreadPool& shared();
+
+    template <typename F>
+    auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> future = packaged->get_future();
+        enqueue([packaged]() { (*packaged)(); });
+        return future;
+    }
+
+    // Wait for a future produced by submit(), running the calling worker's own
+    // queued tasks in the meantime. Safe to call from any thread.
+    template <typename R>
+    R await(std::future<R>& future) {
+        if (current_pool_ == this) {
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                if (!runLocalTask()) {
+                    break; // Nothing left to help with - remaining subtasks run elsewhere
+                }
+            }
+        }
+        return future.get();
+    }
+
+    size_t workerCount() const { return workers_.size(); }
+
+    // Tasks queued but not yet started (across all queues)
+    size_t queueDepth() const { return queued_.load(std::memory_order_relaxed); }
+
+    // Highest queue depth observed since startup
+    size_t peakQueueDepth() const { return peak_queued_.load(std::memory_order_relaxed); }
+
+    // Per-host connection caps for fetch tasks (key: host name)
+    KeyedSemaphore& hostLimits() { return host_limits_; }
+
+private:
+    using Task = std::function<void()>;
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<WorkerQueue>> local_queues_;
+    std::deque<Task> injection_queue_;
+    std::mutex mutex_;               // Guards injection_queue_, stopping_ and sleeping workers
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> peak_queued_{0};
+    KeyedSemaphore host_limits_;
+
+    static thread_local ThreadPool* current_pool_;
+    static thread_local size_t current_worker_;
+
+    void enqueue(Task task);
+    void workerLoop(size_t index);
+    bool tryPopLocal(size_t index, Task& task);
+    bool tryPopInjected(Task& task);
+    bool trySteal(size_t thief, Task& task);
+    bool runLocalTask();
+    void noteQueued();
+};
@@ -1,68 +1,174 @@
 #include "tool_executor.h"
 #include "tools.h"
+#include "tool_registry.h"
 #include "api_client.h"
 #include "chat_client.h"
+#include "interrupt.h"
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 static int synthetic_tool_call_counter = 0;
 
+// Appended to a copy of the context when retrying a final response that tried to use tools
+static Message noToolInstruction() {
+    return {"system", "IMPORTANT: Do not use any tools or functions in your response. Provide a direct text answer only."};
+}
+
+EarlyToolCalls::~EarlyToolCalls() {
+    for (auto& call : calls_) {
+        if (call.result.valid()) {
+            try {
+                ThreadPool::shared().await(call.result);
+            } catch (...) {
+                // Result unused either way
+            }
+        }
+    }
+}
+
+std::future<Message> EarlyToolCalls::take(const std::string& id, const std::string& name, const std::string& arguments) {
+    for (auto& call : calls_) {
+        if (call.result.valid() && call.id == id && call.name == name && call.arguments == arguments) {
+            return std::move(call.result);
+        }
+    }
+    return {};
+}
+
 ToolExecutor::ToolExecutor(UserInterface& ui_ref,
                            PersistenceManager& db_ref,
                            ToolManager& tool_manager_ref,
                            ApiClient& api_client_ref,
                            ChatClient& chat_client_ref,
+                           ContextWindow& context_window_ref,
                            std::string& active_model_id_ref)
     : ui(ui_ref), db(db_ref), toolManager(tool_manager_ref), 
       apiClient(api_client_ref), chatClient(chat_client_ref), 
-      active_model_id_ref(active_model_id_ref) {
+      contextWindow(context_window_ref), active_model_id_ref(active_model_id_ref) {
+    // Per-tool concurrency limits come from the registry (0: only bounded by the shared executor size)
+    for (const ToolDescriptor& tool : all_tools()) {
+        toolLimits.setLimit(std::string(tool.name), tool.max_concurrent);
+    }
+}
+
+ToolExecutor::~ToolExecutor() = default;
+
+void ToolExecutor::saveAssistantMessage(SharedText content, const std::string& model_id) {
+    const std::string& model = model_id.empty() ? this->active_model_id_ref : model_id;
+    Message msg{"assistant", content, db.saveAssistantMessage(content, model)};
+    if (!model.empty()) msg.model_id = model;
+    contextWindow.append(std::move(msg));
 }
 
-std::string ToolExecutor::executeAndPrepareToolResult(
+void ToolExecutor::saveAssistantToolCalls(const nlohmann::json& response_message) {
+    Message msg{"assistant"};
+    const auto& content = response_message.value("content", nlohmann::json());
+    if (content.is_string()) msg.content = content.get<std::string>();
+    if (!this->active_model_id_ref.empty()) msg.model_id = this->active_model_id_ref;
+    
+    const auto& tool_calls = response_message["tool_calls"];
+    std::string ids;
+    for (const auto& tool_call : tool_calls) {
+        if (tool_call.contains("id") && tool_call["id"].is_string()) {
+            if (!ids.empty()) ids += '\n';
+            ids += tool_call["id"].get<std::string>();
+        }
+    }
+    msg.tool_calls = tool_calls.dump();
+    msg.tool_call_ids = std::move(ids);
+    
+    msg.id = db.saveAssistantToolCalls(msg);
+    contextWindow.append(std::move(msg));
+}
+
+void ToolExecutor::saveToolResults(std::vector<Message> tool_results) {
+    db.beginTransaction();
+    try {
+        for (auto& msg : tool_results) {
+            msg.id = db.saveToolMessage(msg);
+        }
+        db.commitTransaction();
+    } catch (...) {
+        db.rollbackTransaction();
+        throw;
+    }
+    
+    // Only committed results become part of the context (sharing the queued text)
+    for (auto& msg : tool_results) {
+        contextWindow.append(std::move(msg));
+    }
+}
+
+Message ToolExecutor::toolResult(const std::string& tool_call_id, const std::string& function_name, std::string content) {
+    Message msg{"tool", std::move(content)};
+    msg.tool_call_id = tool_call_id;
+    msg.tool_name = function_name;
+    return msg;
+}
+
+Message ToolExecutor::executeAndPrepareToolResult(
     const std::string& tool_call_id,
     const std::string& function_name,
-    const nlohmann::json& function_args
+    const nlohmann::json& function_args,
+    const std::stop_token& stop
 ) {
     std::string tool_result_str;
     try {
+        if (stop.stop_requested()) {
+            throw OperationCancelled();
+        }
+        auto permit = toolLimits.acquire(function_name);
         tool_result_str = toolManager.execute_tool(db, chatClient, ui, function_name, function_args);
+    } catch (const OperationCancelled&) {
+        tool_result_str = "Error: '" + function_name + "' was cancelled by the user before it finished.";
     } catch (const std::exception& e) {
         ui.displayError("Tool execution error for '" + function_name + "': " + e.what());
         tool_result_str = "Error executing tool '" + function_name + "': " + e.what();
     }
     
-    nlohmann::json tool_result_content;
-    tool_result_content["role"] = "tool";
-    tool_result_content["tool_call_id"] = tool_call_id;
-    tool_result_content["name"] = function_name;
-    tool_result_content["content"] = tool_result_str;
-    
-    return tool_result_content.dump();
+    return toolResult(tool_call_id, function_name, std::move(tool_result_str));
+}
+
+void ToolExecutor::dispatchEarly(const ApiClient::StreamingResponse::ToolCallBuffer& tool_call, EarlyToolCalls& early,
+                                 const std::stop_token& stop) {
+    nlohmann::json function_args = nlohmann::json::parse(tool_call.arguments, nullptr, false);
+    if (function_args.is_discarded()) {
+        return;
+    }
+    early.calls_.push_back({tool_call.id, tool_call.name, tool_call.arguments, ThreadPool::shared().submit(
+        [this, tool_call_id = tool_call.id, function_name = tool_call.name, function_args = std::move(function_args), stop]() {
+            return executeAndPrepareToolResult(tool_call_id, function_name, function_args, stop);
+        })});
 }
 
-bool ToolExecutor::executeStandardToolCalls(const nlohmann::json& response_message,
-                                            std::vector<Message>& context) {
+bool ToolExecutor::executeStandardToolCalls(const nlohmann::json& response_message, const std::stop_token& stop,
+                                            EarlyToolCalls* early) {
     if (response_message.is_null() || !response_message.contains("tool_calls") || response_message["tool_calls"].is_null()) {
         return false;
     }
     
     // Save the assistant's message requesting tool use
-    db.saveAssistantMessage(response_message.dump(), this->active_model_id_ref);
+    saveAssistantToolCalls(response_message);
     
-    // Execute all tools and collect results
-    std::vector<std::string> tool_result_messages;
+    // Execute all tools and collect results, keeping the order of the tool_calls array
+    struct PendingToolResult {
+        Message ready_result;              // Filled directly for argument errors
+        std::future<Message> future;       // Valid when the call was dispatched to the pool
+    };
+    std::vector<PendingToolResult> pending_results;
     bool any_tool_executed = false;
     
     auto buildArgError = [&](const std::string& tool_call_id, const std::string& function_name, const std::string& error_msg) {
-        nlohmann::json err;
-        err["tool_call_id"] = tool_call_id;
-        err["name"] = function_name;
-        err["content"] = error_msg;
-        tool_result_messages.push_back(err.dump());
+        pending_results.push_back({toolResult(tool_call_id, function_name, error_msg), {}});
         any_tool_executed = true;
     };
+
+    const auto& tool_calls = response_message["tool_calls"];
+    // A single call runs inline; several are fanned out to the shared executor
+    bool run_concurrently = tool_calls.is_array() && tool_calls.size() > 1;
     
-    for (const auto& tool_call : response_message["tool_calls"]) {
+    for (const auto& tool_call : tool_calls) {
         if (!tool_call.contains("id") || !tool_call.contains("function") || 
             !tool_call["function"].contains("name") || !tool_call["function"].contains("arguments")) {
             continue;
@@ -70,10 +176,11 @@ bool ToolExecutor::executeStandardToolCalls(const nlohmann::json& response_messa
         
         std::string tool_call_id = tool_call["id"];
         std::string function_name = tool_call["function"]["name"];
+        std::string args_str;
         nlohmann::json function_args;
         
         try {
-            std::string args_str = tool_call["function"]["arguments"].get<std::string>();
+            args_str = tool_call["function"]["arguments"].get<std::string>();
             function_args = nlohmann::json::parse(args_str);
         } catch (const nlohmann::json::parse_error& e) {
             buildArgError(tool_call_id, function_name, "Error: Failed to parse arguments JSON: " + std::string(e.what()));
@@ -83,41 +190,68 @@ bool ToolExecutor::executeStandardToolCalls(const nlohmann::json& response_messa
             continue;
         }
         
-        std::string result_msg_json = executeAndPrepareToolResult(tool_call_id, function_name, function_args);
-        tool_result_messages.push_back(result_msg_json);
+        // Already running since its arguments were streamed
+        if (early) {
+            if (std::future<Message> started = early->take(tool_call_id, function_name, args_str); started.valid()) {
+                pending_results.push_back({{}, std::move(started)});
+                any_tool_executed = true;
+                continue;
+            }
+        }
+        
+        if (run_concurrently) {
+            pending_results.push_back({{}, ThreadPool::shared().submit(
+                [this, tool_call_id, function_name, function_args, stop]() {
+                    return executeAndPrepareToolResult(tool_call_id, function_name, function_args, stop);
+                })});
+        } else {
+            pending_results.push_back({executeAndPrepareToolResult(tool_call_id, function_name, function_args, stop), {}});
+        }
         any_tool_executed = true;
     }
     
     if (!any_tool_executed) {
         return false;
     }
+
+    // Wait for every dispatched call; executeAndPrepareToolResult already turns
+    // tool exceptions into error results, so get() only rethrows on internal failures
+    std::vector<Message> tool_result_messages;
+    tool_result_messages.reserve(pending_results.size());
+    for (auto& pending : pending_results) {
+        if (pending.future.valid()) {
+            tool_result_messages.push_back(ThreadPool::shared().await(pending.future));
+        } else {
+            tool_result_messages.push_back(std::move(pending.ready_result));
+        }
+    }
     
-    // Save all collected tool results to the database
+    // Save all collected tool results to the database (and the context window)
     try {
-        db.beginTransaction();
-        for (const auto& msg_json : tool_result_messages) {
-            db.saveToolMessage(msg_json);
-        }
-        db.commitTransaction();
+        saveToolResults(std::move(tool_result_messages));
     } catch (const std::exception& e) {
-        db.rollbackTransaction();
         ui.displayError("Database error saving tool results: " + std::string(e.what()));
         return false;
     }
     
-    // Reload context including tool results
-    context = db.getContextHistory();
+    // Cancelled while the tools ran: their results are saved, the answer is not requested
+    if (stop.stop_requested()) {
+        throw OperationCancelled();
+    }
     
     // Make final streaming API call to get text response
     std::string final_content;
+    std::string final_model;
     bool final_response_success = false;
+    std::vector<Message> retry_context;
 
     for (int attempt = 0; attempt < 3 && !final_response_success; attempt++) {
-        // Add no-tool instruction on retry attempts
+        // Add no-tool instruction on retry attempts (to a copy - the window only holds saved messages)
         if (attempt > 0) {
-            Message no_tool_msg{"system", "IMPORTANT: Do not use any tools or functions in your response. Provide a direct text answer only."};
-            context.push_back(no_tool_msg);
+            retry_context = contextWindow.messages();
+            retry_context.push_back(noToolInstruction());
         }
+        const std::vector<Message>& context = attempt > 0 ? retry_context : contextWindow.messages();
 
         try {
             // Use streaming for final response
@@ -129,14 +263,19 @@ bool ToolExecutor::executeStandardToolCalls(const nlohmann::json& response_messa
                 false,  // use_tools = false (we want text only)
                 [this](const std::string& chunk) {
                     ui.displayStreamingChunk(chunk);
-                }
+                },
+                {},
+                stop
             );
 
             ui.endStreamingOutput();
 
-            // Remove retry instruction if added
-            if (attempt > 0) {
-                context.pop_back();
+            // Keep the part of the answer that was shown
+            if (streaming_result.cancelled) {
+                if (!streaming_result.accumulated_content.empty()) {
+                    saveAssistantMessage(streaming_result.accumulated_content + kInterruptedReplyMarker, streaming_result.model);
+                }
+                throw OperationCancelled();
             }
 
             // Check for errors
@@ -161,15 +300,15 @@ bool ToolExecutor::executeStandardToolCalls(const nlohmann::json& response_messa
             // Success - we have the content
             if (!streaming_result.accumulated_content.empty()) {
                 final_content = streaming_result.accumulated_content;
+                final_model = streaming_result.model;
                 final_response_success = true;
                 break;
             }
 
+        } catch (const OperationCancelled&) {
+            throw;
         } catch (const std::exception& e) {
             ui.endStreamingOutput();  // Ensure cleanup
-            if (attempt > 0 && context.back().role == "system") {
-                context.pop_back();
-            }
             if (attempt == 2) {
                 ui.displayError("Failed to get final response: " + std::string(e.what()));
                 break;
@@ -183,18 +322,20 @@ bool ToolExecutor::executeStandardToolCalls(const nlohmann::json& response_messa
         return false;
     }
     
-    db.saveAssistantMessage(final_content, this->active_model_id_ref);
+    saveAssistantMessage(std::move(final_content), final_model);
     // Note: Content already displayed during streaming, no need to display again
     return true;
 }
 
-bool ToolExecutor::executeFallbackFunctionTags(const std::string& content,
-                                               std::vector<Message>& context) {
+bool ToolExecutor::executeFallbackFunctionTags(const std::string& content, const std::stop_token& stop) {
     bool any_executed = false;
     std::string content_str = content;
     size_t search_pos = 0;
     
     while (true) {
+        if (stop.stop_requested()) {
+            throw OperationCancelled();
+        }
         size_t func_start = std::string::npos;
         size_t name_start = std::string::npos;
         const std::string start_tag1 = "<function>";
@@ -346,34 +487,34 @@ bool ToolExecutor::executeFallbackFunctionTags(const std::string& content,
             }
             
             std::string function_block = content_str.substr(func_start, func_end + 11 - func_start);
-            db.saveAssistantMessage(function_block, this->active_model_id_ref);
-            context = db.getContextHistory();
+            saveAssistantMessage(std::move(function_block));
             
             std::string tool_call_id = "synth_" + std::to_string(++synthetic_tool_call_counter);
-            std::string tool_result_msg_json = executeAndPrepareToolResult(tool_call_id, function_name, function_args);
+            Message tool_result_msg = executeAndPrepareToolResult(tool_call_id, function_name, function_args, stop);
             
             try {
-                db.beginTransaction();
-                db.saveToolMessage(tool_result_msg_json);
-                db.commitTransaction();
+                saveToolResults({std::move(tool_result_msg)});
             } catch (const std::exception& e) {
-                db.rollbackTransaction();
                 ui.displayError("Database error saving fallback tool result: " + std::string(e.what()));
                 search_pos = func_end + 11;
                 continue;
             }
-            
-            context = db.getContextHistory();
+            if (stop.stop_requested()) {
+                throw OperationCancelled();
+            }
             
             // Make final streaming API call
             std::string final_content;
+            std::string final_model;
             bool final_response_success = false;
+            std::vector<Message> retry_context;
 
             for (int attempt = 0; attempt < 3 && !final_response_success; attempt++) {
                 if (attempt > 0) {
-                    Message no_tool_msg{"system", "IMPORTANT: Do not use any tools or functions in your response. Provide a direct text answer only."};
-                    context.push_back(no_tool_msg);
+                    retry_context = contextWindow.messages();
+                    retry_context.push_back(noToolInstruction());
                 }
+                const std::vector<Message>& context = attempt > 0 ? retry_context : contextWindow.messages();
 
                 try {
                     ui.startStreamingOutput(this->active_model_id_ref);
@@ -384,13 +525,18 @@ bool ToolExecutor::executeFallbackFunctionTags(const std::string& content,
                         false,  // use_tools = false
                         [this](const std::string& chunk) {
                             ui.displayStreamingChunk(chunk);
-                        }
+                        },
+                        {},
+                        stop
                     );
 
                     ui.endStreamingOutput();
 
-                    if (attempt > 0) {
-                        context.pop_back();
+                    if (streaming_result.cancelled) {
+                        if (!streaming_result.accumulated_content.empty()) {
+                            saveAssistantMessage(streaming_result.accumulated_content + kInterruptedReplyMarker, streaming_result.model);
+                        }
+                        throw OperationCancelled();
                     }
 
                     if (streaming_result.has_error) {
@@ -415,6 +561,7 @@ bool ToolExecutor::executeFallbackFunctionTags(const std::string& content,
 
                     if (!streaming_result.accumulated_content.empty()) {
                         final_content = streaming_result.accumulated_content;
+                        final_model = streaming_result.model;
                         final_response_success = true;
                         break;
                     } else {
@@ -425,11 +572,10 @@ bool ToolExecutor::executeFallbackFunctionTags(const std::string& content,
                         continue;
                     }
 
+                } catch (const OperationCancelled&) {
+                    throw;
                 } catch (const std::exception& e) {
                     ui.endStreamingOutput();
-                    if (attempt > 0 && !context.empty() && context.back().role == "system") {
-                        context.pop_back();
-                    }
                     if (attempt == 2) {
                         ui.displayError("Failed to get final response after fallback tool: " + std::string(e.what()));
                         break;
@@ -439,7 +585,7 @@ bool ToolExecutor::executeFallbackFunctionTags(const std::string& content,
             }
             
             if (final_response_success) {
-                db.saveAssistantMessage(final_content, this->active_model_id_ref);
+                saveAssistantMessage(std::move(final_content), final_model);
                 // Note: Content already displayed during streaming, no need to display again
                 any_executed = true;
             } else {
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <future>
+#include <stop_token>
 #include <string>
 #include <vector>
+#include <memory>
 #include <nlohmann/json.hpp>
+#include "api_client.h"
 #include "database.h"
+#include "context_window.h"
 #include "ui_interface.h"
+#include "thread_pool.h"
 
 // Forward declarations
 class PersistenceManager;
@@ -13,9 +19,42 @@ class ToolManager;
 class ApiClient;
 class ChatClient;
 
+/**
+ * EarlyToolCalls - tool calls started while the response was still streaming
+ *
+ * Filled by ToolExecutor::dispatchEarly() from the stream's tool call callback
+ * and handed to executeStandardToolCalls(), which takes over every started call
+ * whose id, name and arguments match the final tool_calls array. Calls nobody
+ * took over (the stream failed or was retried) are waited for on destruction,
+ * so no tool outlives the turn that started it; their results are dropped.
+ */
+class EarlyToolCalls {
+public:
+    EarlyToolCalls() = default;
+    EarlyToolCalls(const EarlyToolCalls&) = delete;
+    EarlyToolCalls& operator=(const EarlyToolCalls&) = delete;
+    ~EarlyToolCalls();
+
+    size_t size() const { return calls_.size(); }
+
+private:
+    friend class ToolExecutor;
+    struct Call {
+        std::string id;
+        std::string name;
+        std::string arguments;         // Exactly as streamed
+        std::future<Message> result;
+    };
+    std::vector<Call> calls_;
+
+    // The started call's result, if one matches (invalid future otherwise)
+    std::future<Message> take(const std::string& id, const std::string& name, const std::string& arguments);
+};
+
 /**
  * ToolExecutor handles the execution of tool calls:
- * - Standard tool_calls from API responses
+ * - Standard tool_calls from API responses (independent calls run concurrently,
+ *   and may be started mid-stream once their arguments are complete)
  * - Fallback <function> tag parsing and execution
  * - Collecting tool results and making follow-up API calls
  * - Managing the complete tool execution flow
@@ -27,17 +66,29 @@ public:
                          ToolManager& tool_manager_ref,
                          ApiClient& api_client_ref,
                          ChatClient& chat_client_ref,
+                         ContextWindow& context_window_ref,
                          std::string& active_model_id_ref);
+    ~ToolExecutor();
     
-    // Execute standard tool_calls from API response
+    // Start a streamed tool call whose arguments are complete on the shared
+    // executor, overlapping it with the rest of the response (for use as the
+    // tool call callback of a streaming call). Calls with unparsable arguments
+    // are left for executeStandardToolCalls() to report.
+    void dispatchEarly(const ApiClient::StreamingResponse::ToolCallBuffer& tool_call, EarlyToolCalls& early,
+                       const std::stop_token& stop);
+    
+    // Execute standard tool_calls from API response, reusing matching calls
+    // already started by dispatchEarly()
     // Returns true if tools were executed and final response obtained
-    bool executeStandardToolCalls(const nlohmann::json& response_message,
-                                  std::vector<Message>& context);
+    // Throws OperationCancelled once stop is requested, after saving the tool
+    // results (and any part of the final answer that was streamed)
+    bool executeStandardToolCalls(const nlohmann::json& response_message, const std::stop_token& stop,
+                                  EarlyToolCalls* early = nullptr);
     
     // Parse and execute fallback <function> tags from content
     // Returns true if any fallback functions were executed
-    bool executeFallbackFunctionTags(const std::string& content,
-                                     std::vector<Message>& context);
+    // Throws OperationCancelled like executeStandardToolCalls()
+    bool executeFallbackFunctionTags(const std::string& content, const std::stop_token& stop);
 
 private:
     UserInterface& ui;
@@ -45,10 +96,31 @@ private:
     ToolManager& toolManager;
     ApiClient& apiClient;
     ChatClient& chatClient;
+    ContextWindow& contextWindow;   // Saved messages are appended here as well as to the DB
     std::string& active_model_id_ref;
+
+    // Per-tool caps on how many calls of the same tool may run at once
+    KeyedSemaphore toolLimits;
+    
+    // Save an assistant message from model_id (default: the active model) and add it to the context window
+    void saveAssistantMessage(SharedText content, const std::string& model_id = {});
+    
+    // Save the assistant message requesting tools (structured tool_calls record)
+    // and add it to the context window
+    void saveAssistantToolCalls(const nlohmann::json& response_message);
     
-    // Helper to execute a single tool and prepare result JSON
-    std::string executeAndPrepareToolResult(const std::string& tool_call_id,
+    // Save tool result messages in one transaction, then add them to the context window
+    // Throws (after rolling back) on database errors
+    void saveToolResults(std::vector<Message> tool_results);
+    
+    // Build an unsaved tool result message
+    static Message toolResult(const std::string& tool_call_id, const std::string& function_name, std::string content);
+    
+    // Helper to execute a single tool and prepare its result message
+    // (a call that is cancelled, or not started before the stop, gets a note as its result)
+    Message executeAndPrepareToolResult(const std::string& tool_call_id,
                                            const std::string& function_name,
-                                           const nlohmann::json& function_args);
+                                           const nlohmann::json& function_args,
+                                           const std::stop_token& stop);
+
 };
\ No newline at end of file
@@ -0,0 +1,423 @@
+#include "tool_registry.h"
+#include "tools_impl/search_web_tool.h"
+#include "tools_impl/visit_url_tool.h"
+#include "tools_impl/datetime_tool.h"
+#include "tools_impl/read_history_tool.h"
+#include "tools_impl/search_history_tool.h"
+#include "tools_impl/recall_history_tool.h"
+#include "tools_impl/web_research_tool.h"
+#include "tools_impl/deep_research_tool.h"
+#include "chat_client.h"
+#include "database.h"
+#include "embedding_service.h"
+#include "fnv1a.h"
+#include "interrupt.h"
+#include "ui_interface.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// --- Tool Schemas ---
+
+nlohmann::json search_web_schema() {
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", "search_web"},
+            {"description", "Search the web for information using DuckDuckGo Lite. Use this for recent events, specific facts, or topics outside general knowledge."},
+            {"parameters", {
+                {"type", "object"},
+                {"properties", {
+                    {"query", {
+                        {"type", "string"},
+                        {"description", "The search query string."}
+                    }}
+                }},
+                {"required", {"query"}}
+            }}
+        }}
+    };
+}
+
+nlohmann::json get_current_datetime_schema() {
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", "get_current_datetime"},
+            {"description", "Get the current date and time."},
+            {"parameters", { // No parameters needed
+                {"type", "object"},
+                {"properties", {
+                    {"format", {
+                        {"type", "string"},
+                        {"description", "The format of the date and time to return."},
+                        {"default", "%Y-%m-%d %H:%M:%S"} // Default format
+                    }}
+                }},
+                {"additionalProperties", false} // No additional properties allowed
+            }}
+        }}
+    };
+}
+
+nlohmann::json visit_url_schema() {
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", "visit_url"},
+            {"description", "Fetch the main text content of a given URL."},
+            {"parameters", {
+                {"type", "object"},
+                {"properties", {
+                    {"url", {
+                        {"type", "string"},
+                        {"description", "The full URL to visit (including http:// or https://)."}
+                    }}
+                }},
+                {"required", {"url"}}
+            }}
+        }}
+    };
+}
+
+nlohmann::json read_history_schema() {
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", "read_history"},
+            {"description", "Read past messages from the conversation history database within a specified time range."},
+            {"parameters", {
+                {"type", "object"},
+                {"properties", {
+                    {"start_time", {
+                        {"type", "string"},
+                        {"description", "The start timestamp (inclusive) in 'YYYY-MM-DD HH:MM:SS' format."}
+                    }},
+                    {"end_time", {
+                        {"type", "string"},
+                        {"description", "The end timestamp (inclusive) in 'YYYY-MM-DD HH:MM:SS' format."}
+                    }},
+                    {"limit", {
+                        {"type", "integer"},
+                        {"description", "The maximum number of messages to retrieve within the range."},
+                        {"default", 50} // Default limit if not specified
+                    }}
+                }},
+                {"required", {"start_time", "end_time"}} // Require time range
+            }}
+        }}
+    };
+}
+
+nlohmann::json search_history_schema() {
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", "search_history"},
+            {"description", "Search past conversation messages (user and assistant) by keywords. Returns the best-matching messages first, with timestamps, ids and snippets around the matches. Prefer this over read_history when looking for a topic rather than a time range."},
+            {"parameters", {
+                {"type", "object"},
+                {"properties", {
+                    {"query", {
+                        {"type", "string"},
+                        {"description", "Keywords to find; every word must match (falls back to any word if nothing matches). End a word with * for prefix matching."}
+                    }},
+                    {"match_any", {
+                        {"type", "boolean"},
+                        {"description", "Match messages with any of the words instead of all of them. Pass it back as given in the 'More matches' line when paging."},
+                        {"default", false}
+                    }},
+                    {"limit", {
+                        {"type", "integer"},
+                        {"description", "Maximum matches per page (1-50)."},
+                        {"default", 10}
+                    }},
+                    {"page", {
+                        {"type", "integer"},
+                        {"description", "Page of results to return, starting at 1."},
+                        {"default", 1}
+                    }},
+                    {"all_sessions", {
+                        {"type", "boolean"},
+                        {"description", "Search every conversation session instead of only the current one."},
+                        {"default", false}
+                    }}
+                }},
+                {"required", {"query"}}
+            }}
+        }}
+    };
+}
+
+nlohmann::json recall_history_schema() {
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", "recall_history"},
+            {"description", "Find past conversation messages by meaning (semantic search over message embeddings), even when they share no words with the query. Returns the closest messages first with ids, timestamps, similarity and an excerpt. Use search_history for exact keywords."},
+            {"parameters", {
+                {"type", "object"},
+                {"properties", {
+                    {"query", {
+                        {"type", "string"},
+                        {"description", "What to recall, as a phrase or question."}
+                    }},
+                    {"limit", {
+                        {"type", "integer"},
+                        {"description", "Maximum messages to return (1-20)."},
+                        {"default", 5}
+                    }},
+                    {"all_sessions", {
+                        {"type", "boolean"},
+                        {"description", "Search every conversation session instead of only the current one."},
+                        {"default", false}
+                    }}
+                }},
+                {"required", {"query"}}
+            }}
+        }}
+    };
+}
+
+nlohmann::json web_research_schema() {
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", "web_research"},
+            {"description", 
+             "Performs multi-step web research on a given topic. This involves: "
+             "1. Using 'search_web' to find relevant web pages. "
+             "2. Analyzing search results and using 'visit_url' on promising links. "
+             "3. Reading the content from visited pages. "
+             "4. Synthesizing the gathered information into a comprehensive answer or summary for the user's original request. "
+             "Use this tool when a user asks a question that requires gathering and combining information from multiple web sources."},
+            {"parameters", {
+                {"type", "object"},
+                {"properties", {
+                    {"topic", {
+                        {"type", "string"},
+                        {"description", "The core topic or question to research."}
+                    }}
+                    // Note: The LLM will need to generate the 'query' for search_web itself based on the topic.
+                }},
+                {"required", {"topic"}}
+            }}
+        }}
+    };
+}
+
+nlohmann::json deep_research_schema() {
+    return {
+        {"type", "function"},
+        {"function", {
+            {"name", "deep_research"},
+            {"description",
+             "Performs in-depth research on a complex topic or goal. This tool autonomously breaks down the goal into multiple sub-topics, performs web research ('web_research' tool) for each sub-topic, and then synthesizes the findings into a comprehensive final report. Use this for broad questions requiring multi-faceted investigation beyond a single web search."},
+            {"parameters", {
+                {"type", "object"},
+                {"properties", {
+                    {"goal", {
+                        {"type", "string"},
+                        {"description", "The main research goal or complex question to investigate."}
+                    }}
+                    // Note: The tool itself will generate specific queries for internal 'web_research' calls.
+                }},
+                {"required", {"goal"}}
+            }}
+        }}
+    };
+}
+
+// --- Tool Handlers ---
+
+std::string run_search_web(ToolContext& ctx, const nlohmann::json& args) {
+    std::string query = args.value("query", "");
+    if (query.empty()) {
+        throw std::runtime_error("'query' argument missing or empty for search_web tool.");
+    }
+    ctx.ui.displayStatus("[Searching web for: " + query + "]"); // Use UI for status
+    try {
+        SearchWebOptions search_options = SearchWebOptions::fromEnvironment();
+        search_options.cache = ctx.content_cache;
+        search_options.stop = ctx.client.stopToken();
+        return search_web(query, search_options);
+    } catch (const OperationCancelled&) {
+        throw;
+    } catch (const std::exception& e) {
+        return "Error performing web search: " + std::string(e.what());
+    }
+}
+
+std::string run_get_current_datetime(ToolContext& ctx, const nlohmann::json&) {
+    ctx.ui.displayStatus("[Getting current date and time]"); // Use UI for status
+    try {
+        return get_current_datetime();
+    } catch (const std::exception& e) {
+        return "Error getting current date and time.";
+    }
+}
+
+std::string run_visit_url(ToolContext& ctx, const nlohmann::json& args) {
+    std::string url_to_visit = args.value("url", "");
+    if (url_to_visit.empty()) {
+        throw std::runtime_error("'url' argument missing or empty for visit_url tool.");
+    }
+    ctx.ui.displayStatus("[Visiting URL: " + url_to_visit + "]"); // Use UI for status
+    try {
+        return visit_url(url_to_visit, ctx.content_cache, ctx.client.stopToken());
+    } catch (const OperationCancelled&) {
+        throw;
+    } catch (const std::exception& e) {
+        return "Error visiting URL: " + std::string(e.what());
+    }
+}
+
+std::string run_read_history(ToolContext& ctx, const nlohmann::json& args) {
+    std::string start_time = args.value("start_time", "");
+    std::string end_time = args.value("end_time", "");
+    size_t limit = args.value("limit", 50);
+
+    if (start_time.empty() || end_time.empty()) {
+        throw std::runtime_error("'start_time' or 'end_time' missing for read_history tool.");
+    }
+    ctx.ui.displayStatus("[Reading history (" + start_time + " to " + end_time + ", Limit: " + std::to_string(limit) + ")]"); // Use UI for status
+    try {
+        return read_history(ctx.db, start_time, end_time, limit);
+    } catch (const std::exception& e) {
+        return "Error reading history: " + std::string(e.what());
+    }
+}
+
+std::string run_search_history(ToolContext& ctx, const nlohmann::json& args) {
+    std::string query = args.value("query", "");
+    if (query.empty()) {
+        throw std::runtime_error("'query' argument missing or empty for search_history tool.");
+    }
+    int limit = std::clamp(args.value("limit", 10), 1, 50);
+    int page = std::max(args.value("page", 1), 1);
+    bool all_sessions = args.value("all_sessions", false);
+    bool match_any = args.value("match_any", false);
+    ctx.ui.displayStatus("[Searching history for: " + query + "]"); // Use UI for status
+    try {
+        return search_history(ctx.db, query, static_cast<size_t>(limit), static_cast<size_t>(page), all_sessions,
+                              match_any);
+    } catch (const std::exception& e) {
+        return "Error searching history: " + std::string(e.what());
+    }
+}
+
+std::string run_recall_history(ToolContext& ctx, const nlohmann::json& args) {
+    std::string query = args.value("query", "");
+    if (query.empty()) {
+        throw std::runtime_error("'query' argument missing or empty for recall_history tool.");
+    }
+    int limit = std::clamp(args.value("limit", 5), 1, 20);
+    bool all_sessions = args.value("all_sessions", false);
+    EmbeddingService* memory = ctx.client.semanticMemory();
+    if (!memory) {
+        return "Semantic memory is disabled (set LLM_CLI_EMBEDDING_MODEL to an embeddings model).";
+    }
+    ctx.ui.displayStatus("[Recalling history about: " + query + "]"); // Use UI for status
+    try {
+        return recall_history(ctx.db, *memory, query, static_cast<size_t>(limit), all_sessions,
+                              ctx.client.stopToken());
+    } catch (const OperationCancelled&) {
+        throw;
+    } catch (const std::exception& e) {
+        return "Error recalling history: " + std::string(e.what());
+    }
+}
+
+// recall_history is only offered when an embeddings model is configured
+bool semantic_memory_enabled() {
+    return EmbeddingService::Options::fromEnvironment().enabled();
+}
+
+std::string run_web_research(ToolContext& ctx, const nlohmann::json& args) {
+    std::string topic = args.value("topic", "");
+    if (topic.empty()) {
+        throw std::runtime_error("'topic' argument missing or empty for web_research tool.");
+    }
+    ctx.ui.displayStatus("[Performing web research on: " + topic + "]"); // Use UI for status
+    return perform_web_research(ctx.db, ctx.client, ctx.ui, topic);
+}
+
+std::string run_deep_research(ToolContext& ctx, const nlohmann::json& args) {
+    std::string goal = args.value("goal", "");
+    if (goal.empty()) {
+        throw std::runtime_error("'goal' argument missing or empty for deep_research tool.");
+    }
+    ctx.ui.displayStatus("[Performing deep research for: " + goal + "]"); // Use UI for status
+    return perform_deep_research(ctx.db, ctx.client, ctx.ui, goal);
+}
+
+// --- Registry Table ---
+
+// Research tools fan out into many requests of their own, so few run at once
+constexpr std::array kTools = {
+    ToolDescriptor{"search_web",           search_web_schema,           run_search_web,           nullptr,                 0, true},
+    ToolDescriptor{"get_current_datetime", get_current_datetime_schema, run_get_current_datetime, nullptr,                 0, false},
+    ToolDescriptor{"visit_url",            visit_url_schema,            run_visit_url,            nullptr,                 0, true},
+    ToolDescriptor{"read_history",         read_history_schema,         run_read_history,         nullptr,                 0, false},
+    ToolDescriptor{"search_history",       search_history_schema,       run_search_history,       nullptr,                 0, false},
+    ToolDescriptor{"web_research",         web_research_schema,         run_web_research,         nullptr,                 2, false},
+    ToolDescriptor{"deep_research",        deep_research_schema,        run_deep_research,        nullptr,                 1, false},
+    ToolDescriptor{"recall_history",       recall_history_schema,       run_recall_history,       semantic_memory_enabled, 0, false},
+};
+
+// Perfect hash over the tool names: FNV-1a with a seed chosen at compile time
+// so that every name lands in its own slot of a power-of-two table
+constexpr size_t kSlotCount = 16;
+static_assert(kSlotCount >= kTools.size() && (kSlotCount & (kSlotCount - 1)) == 0);
+
+constexpr uint64_t name_hash(std::string_view name, uint32_t seed) {
+    return fnv1a_hash(name, kFnvOffsetBasis ^ seed);
+}
+
+constexpr bool seed_is_perfect(uint32_t seed) {
+    std::array<bool, kSlotCount> used{};
+    for (const auto& tool : kTools) {
+        size_t slot = name_hash(tool.name, seed) & (kSlotCount - 1);
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t find_seed() {
+    for (uint32_t seed = 0; seed < 100000; ++seed) {
+        if (seed_is_perfect(seed)) return seed;
+    }
+    return UINT32_MAX;
+}
+
+constexpr uint32_t kSeed = find_seed();
+static_assert(kSeed != UINT32_MAX, "no collision-free seed for the tool names; grow kSlotCount");
+
+// Slot -> index into kTools (-1: empty)
+constexpr std::array<int8_t, kSlotCount> kSlots = [] {
+    std::array<int8_t, kSlotCount> slots{};
+    slots.fill(-1);
+    for (size_t i = 0; i < kTools.size(); ++i) {
+        slots[name_hash(kTools[i].name, kSeed) & (kSlotCount - 1)] = static_cast<int8_t>(i);
+    }
+    return slots;
+}();
+
+} // namespace
+
+std::span<const ToolDescriptor> all_tools() {
+    return kTools;
+}
+
+const ToolDescriptor* find_tool(std::string_view name) {
+    int8_t index = kSlots[name_hash(name, kSeed) & (kSlotCount - 1)];
+    if (index < 0 || kTools[index].name != name) {
+        return nullptr;
+    }
+    return &kTools[index];
+}
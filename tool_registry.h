@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+class PersistenceManager;
+class ChatClient;
+class UserInterface;
+
+// What a tool handler gets to work with besides its arguments
+struct ToolContext {
+    PersistenceManager& db;
+    ChatClient& client;
+    UserInterface& ui;
+    PersistenceManager* content_cache; // &db for cacheable tools, otherwise nullptr
+};
+
+/**
+ * ToolDescriptor - everything known about one built-in tool
+ *
+ * The descriptors live in a constexpr table in tool_registry.cpp; lookups by
+ * name go through a perfect hash computed from that table at compile time.
+ * ToolManager builds the API definitions from the schemas once (on the first
+ * request), ToolExecutor takes the concurrency limits from here.
+ */
+struct ToolDescriptor {
+    std::string_view name;
+
+    // JSON schema of the tool as sent in the request's "tools" array
+    nlohmann::json (*schema)();
+
+    // Runs the tool; returns the result text (errors the model should see are
+    // returned as text), throws on invalid arguments and OperationCancelled
+    std::string (*handler)(ToolContext& ctx, const nlohmann::json& args);
+
+    // Whether the tool is offered (nullptr: always)
+    bool (*available)();
+
+    // Maximum calls of this tool running at once (0: only bounded by the shared executor)
+    size_t max_concurrent;
+
+    // Results may be served from the on-disk content cache (search_web,
+    // visit_url): the handler gets it as ToolContext::content_cache
+    bool cacheable;
+};
+
+// All built-in tools, in the order they are offered to the model
+std::span<const ToolDescriptor> all_tools();
+
+// The tool with that name, or nullptr
+const ToolDescriptor* find_tool(std::string_view name);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
@@ -12,12 +13,15 @@ class UserInterface; // Forward declaration
 
 class ToolManager {
 public:
-    // Constructor might need PersistenceManager if tools need DB access directly
-    // For now, let's pass it to execute_tool if needed.
-    ToolManager(); 
+    // The definitions of the registered tools (see tool_registry.h) are built
+    // once, on first use - not at startup
+    ToolManager() = default;
 
     // Returns a JSON array of all tool definitions for the API call
-    nlohmann::json get_tool_definitions() const;
+    const nlohmann::json& get_tool_definitions() const;
+
+    // Returns the tool definitions array, serialized once
+    const std::string& get_tool_definitions_json() const;
 
     // Executes a tool based on its name and arguments
     // Returns the result as a string. Throws exceptions on failure.
@@ -27,15 +31,14 @@ public:
     std::string execute_tool(PersistenceManager& db, class ChatClient& client, UserInterface& ui, const std::string& tool_name, const nlohmann::json& args);
 
 private:
-    // Tool definitions (JSON schemas for the API)
-    // These are initialized in the ToolManager constructor (in tools.cpp)
-    // and aggregated by get_tool_definitions().
-    nlohmann::json search_web_tool;
-    nlohmann::json get_current_datetime_tool;
-    nlohmann::json visit_url_tool;
-    nlohmann::json read_history_tool;
-    nlohmann::json web_research_tool;
-    nlohmann::json deep_research_tool; // Added declaration
+    // Schemas of the available registered tools, in registry order
+    mutable nlohmann::json tool_definitions;
+
+    // Serialized form of tool_definitions, reused by every API request
+    mutable std::string tool_definitions_json;
+
+    mutable std::once_flag definitions_built;
+    void build_definitions() const;
 };
 
 // Tool implementations (free functions)
@@ -43,5 +46,7 @@ private:
 #include "tools_impl/visit_url_tool.h"
 #include "tools_impl/datetime_tool.h"
 #include "tools_impl/read_history_tool.h"
+#include "tools_impl/search_history_tool.h"
+#include "tools_impl/recall_history_tool.h"
 #include "tools_impl/web_research_tool.h"
 #include "tools_impl/deep_research_tool.h"
@@ -0,0 +1,51 @@
+#include "tools_impl/content_cache.h"
+#include <cctype>
+#include <ctime>
+
+static char to_lower_char(char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+std::string search_cache_key(const std::string& query) {
+    std::string key = "search:";
+    bool pending_space = false;
+    for (char c : query) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pending_space = true;
+            continue;
+        }
+        if (pending_space && key.size() > 7) key.push_back(' ');
+        pending_space = false;
+        key.push_back(to_lower_char(c));
+    }
+    return key;
+}
+
+std::string page_cache_key(const std::string& url) {
+    size_t begin = url.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "url:";
+    size_t end = url.find_last_not_of(" \t\r\n") + 1;
+    std::string normalized = url.substr(begin, end - begin);
+
+    size_t fragment = normalized.find('#');
+    if (fragment != std::string::npos) {
+        normalized.erase(fragment);
+    }
+
+    // Scheme and host are case-insensitive; path and query are not
+    size_t scheme_end = normalized.find("://");
+    size_t host_end = scheme_end == std::string::npos
+        ? 0 : normalized.find_first_of("/?", scheme_end + 3);
+    if (host_end == std::string::npos) {
+        host_end = normalized.size();
+        normalized.push_back('/'); // "http://a.com" and "http://a.com/" are the same page
+    }
+    for (size_t i = 0; i < host_end; ++i) {
+        normalized[i] = to_lower_char(normalized[i]);
+    }
+    return "url:" + normalized;
+}
+
+int64_t cache_now() {
+    return static_cast<int64_t>(std::time(nullptr));
+}
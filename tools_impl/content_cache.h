@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Cache keys and lifetimes for web content stored via PersistenceManager's
+// content cache (search_web results and visit_url page text).
+
+// Search results change quickly; pages are revalidated with ETag/Last-Modified
+constexpr int64_t kSearchCacheTtlSeconds = 6 * 60 * 60;
+constexpr int64_t kPageCacheTtlSeconds = 24 * 60 * 60;
+
+// "search:" + lower-cased query with whitespace collapsed
+std::string search_cache_key(const std::string& query);
+
+// "url:" + URL with scheme/host lower-cased and the fragment removed
+std::string page_cache_key(const std::string& url);
+
+// Current time in Unix seconds
+int64_t cache_now();
@@ -1,7 +1,10 @@
 #include "tools_impl/deep_research_tool.h"
 #include "tools_impl/web_research_tool.h"
+#include "tools_impl/research_synthesis.h"
 #include "chat_client.h"
+#include "interrupt.h"
 #include "ui_interface.h" // Include UI interface
+#include "thread_pool.h"
 #include <vector>
 #include <future>
 #include <mutex>
@@ -12,6 +15,7 @@
 std::string perform_deep_research(PersistenceManager& db, ChatClient& client, UserInterface& ui, const std::string& goal) {
     std::string aggregated_results = "Deep Research Results for: " + goal + "\n\n";
     std::vector<std::string> sub_queries;
+    std::vector<ResearchSource> findings; // Successful sub-results, for the final synthesis
 
     try {
         ui.displayStatus("  [Deep Research Step 1: Generating sub-queries...]"); // Use UI for status
@@ -55,14 +59,24 @@ std::string perform_deep_research(PersistenceManager& db, ChatClient& client, Us
         }
 
         ui.displayStatus("  [Deep Research Step 2: Launching parallel web research for " + std::to_string(sub_queries.size()) + " sub-queries...]"); // Use UI for status
+        ThreadPool& executor = ThreadPool::shared();
         std::vector<std::future<std::pair<std::string, std::string>>> research_futures;
         std::mutex results_mutex;
 
         for (const std::string& sub_query : sub_queries) {
-            research_futures.push_back(std::async(std::launch::async,
+            research_futures.push_back(executor.submit(
                 [&db, &client, &ui, &sub_query]() -> std::pair<std::string, std::string> { // Capture ui
                 try {
-                    std::string result = perform_web_research(db, client, ui, sub_query); // Pass ui
+                    // Sub-queries still queued when the turn is cancelled never start
+                    if (client.stopToken().stop_requested()) {
+                        throw OperationCancelled();
+                    }
+                    // Sub-reports are shown whole as each finishes; streaming several at
+                    // once would interleave them
+                    std::string result = perform_web_research(db, client, ui, sub_query, false); // Pass ui
+                    if (result.rfind("Error", 0) != 0) {
+                        ui.displayPartialResult("Findings for \"" + sub_query + "\"", result);
+                    }
                     return {sub_query, result};
                 } catch (const std::exception& e) {
                     #ifdef VERBOSE_LOGGING
@@ -74,9 +88,14 @@ std::string perform_deep_research(PersistenceManager& db, ChatClient& client, Us
             }));
         }
 
+#ifdef VERBOSE_LOGGING
+        ui.displayStatus("  [Deep Research: executor queue depth " + std::to_string(executor.queueDepth()) +
+                         ", " + std::to_string(executor.workerCount()) + " workers]");
+#endif
+
         for (size_t i = 0; i < research_futures.size(); ++i) {
             try {
-                std::pair<std::string, std::string> result_pair = research_futures[i].get();
+                std::pair<std::string, std::string> result_pair = executor.await(research_futures[i]);
                 const std::string& sub_query = result_pair.first;
                 const std::string& research_result_or_error = result_pair.second;
 
@@ -89,6 +108,7 @@ std::string perform_deep_research(PersistenceManager& db, ChatClient& client, Us
                     aggregated_results += "--- Results for Sub-query: \"" + sub_query + "\" ---\n";
                     aggregated_results += research_result_or_error;
                     aggregated_results += "\n--- End Results for Sub-query ---\n\n";
+                    findings.push_back({"Results for Sub-query: \"" + sub_query + "\"", research_result_or_error});
                 }
             } catch (const std::exception& e) {
                 std::lock_guard<std::mutex> lock(results_mutex);
@@ -96,61 +116,37 @@ std::string perform_deep_research(PersistenceManager& db, ChatClient& client, Us
             }
         }
 
+        if (client.stopToken().stop_requested()) {
+            throw OperationCancelled();
+        }
+
+        // Sub-results that together exceed the model's context are condensed first
+        std::string research_findings = findings.empty() ? aggregated_results
+                                                         : condense_for_synthesis(client, ui, goal, findings);
+
         ui.displayStatus("  [Deep Research Step 3: Synthesizing final report...]"); // Use UI for status
         std::vector<Message> synthesis_context;
         synthesis_context.push_back({"system", "You are a research assistant. Based *only* on the provided research goal and the aggregated results from multiple web research sub-queries, synthesize a comprehensive final report that directly addresses the original goal. Integrate the findings smoothly. DO NOT USE ANY TOOLS OR FUNCTIONS. Do not add any preamble like 'Based on the provided text...'."});
-        synthesis_context.push_back({"user", "Original Research Goal: " + goal + "\n\nAggregated Research Findings:\n" + aggregated_results});
-
-        std::string final_report;
-        bool synthesis_success = false;
-
-        for (int attempt = 0; attempt < 3 && !synthesis_success; attempt++) {
-            if (attempt > 0) {
-                synthesis_context[0].content = "CRITICAL INSTRUCTION: You are a research assistant. Your ONLY task is to write a plain text report based on the provided research. DO NOT USE ANY TOOLS OR FUNCTIONS WHATSOEVER. DO NOT INCLUDE ANY <function> TAGS OR TOOL CALLS. Just write normal text.";
-            }
-
-            std::string final_response_str = client.makeApiCall(synthesis_context, false);
-            nlohmann::json final_response_json;
-            try {
-                final_response_json = nlohmann::json::parse(final_response_str);
-            } catch (const nlohmann::json::parse_error& e) {
-                // JSON Parsing Error (Final Synthesis)
-                if (attempt == 2) {
-                    return "Error: Failed to parse final synthesis response from LLM. Raw aggregated results follow:\n\n" + aggregated_results;
-                }
-                continue;
-            }
-
-            if (final_response_json.contains("choices") &&
-                !final_response_json["choices"].empty() &&
-                final_response_json["choices"][0].contains("message")) {
-
-                auto message = final_response_json["choices"][0]["message"];
-
-                if (message.contains("tool_calls") && !message["tool_calls"].is_null()) {
-                    // Warning: Final synthesis response contains tool_calls. Retrying with stronger instructions.
-                    continue;
-                }
-
-                if (message.contains("content") && message["content"].is_string()) {
-                    final_report = message["content"];
-                    synthesis_success = true;
-                    break;
-                }
-            }
-
-            if (attempt == 2) {
-                // Error: Invalid API response structure (Final Synthesis).
-                return "Error: Invalid response structure from LLM during final synthesis. Raw aggregated results follow:\n\n" + aggregated_results;
-            }
-        }
-
-        if (!synthesis_success) {
+        synthesis_context.push_back({"user", "Original Research Goal: " + goal + "\n\nAggregated Research Findings:\n" + research_findings});
+
+        SynthesisResult synthesis = run_synthesis(client, ui, std::move(synthesis_context),
+            "CRITICAL INSTRUCTION: You are a research assistant. Your ONLY task is to write a plain text report based on the provided research. DO NOT USE ANY TOOLS OR FUNCTIONS WHATSOEVER. DO NOT INCLUDE ANY <function> TAGS OR TOOL CALLS. Just write normal text.",
+            "Deep research report: " + goal);
+        switch (synthesis.status) {
+        case SynthesisResult::Status::Ok:
+            break;
+        case SynthesisResult::Status::ParseError:
+            return "Error: Failed to parse final synthesis response from LLM. Raw aggregated results follow:\n\n" + aggregated_results;
+        case SynthesisResult::Status::InvalidResponse:
+            return "Error: Invalid response structure from LLM during final synthesis. Raw aggregated results follow:\n\n" + aggregated_results;
+        case SynthesisResult::Status::ToolCalls:
             return "I conducted deep research on '" + goal + "' but encountered technical difficulties synthesizing the final report. Here are the raw research findings:\n\n" + aggregated_results;
         }
         ui.displayStatus("[Deep research complete for: " + goal + "]"); // Use UI for status
-        return final_report;
+        return synthesis.text;
 
+    } catch (const OperationCancelled&) {
+        throw;
     } catch (const std::exception& e) {
         ui.displayError("Deep research failed during execution: " + std::string(e.what())); // Use UI for error
         return "Error performing deep research: " + std::string(e.what()) + "\n\nPartial results gathered:\n" + aggregated_results;
@@ -0,0 +1,513 @@
+#include "tools_impl/html_utils.h"
+#include <array>
+#include <cctype>
+#include <cstdint>
+
+// --- Gumbo DOM helpers ---
+
+GumboNode* gumbo_find_tag(GumboNode* node, GumboTag tag) {
+    if (!node || node->type != GUMBO_NODE_ELEMENT) {
+        return nullptr;
+    }
+    if (node->v.element.tag == tag) {
+        return node;
+    }
+    GumboVector* children = &node->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        GumboNode* found = gumbo_find_tag(static_cast<GumboNode*>(children->data[i]), tag);
+        if (found) {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+GumboNode* gumbo_find_tag_with_class(GumboNode* node, GumboTag tag, std::string_view class_part) {
+    if (!node || node->type != GUMBO_NODE_ELEMENT) {
+        return nullptr;
+    }
+    if (node->v.element.tag == tag) {
+        GumboAttribute* class_attr = gumbo_get_attribute(&node->v.element.attributes, "class");
+        if (class_attr && class_attr->value && std::string_view(class_attr->value).find(class_part) != std::string_view::npos) {
+            return node;
+        }
+    }
+    GumboVector* children = &node->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        GumboNode* found = gumbo_find_tag_with_class(static_cast<GumboNode*>(children->data[i]), tag, class_part);
+        if (found) {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+std::string gumbo_get_text(GumboNode* node) {
+    std::string result;
+    if (!node) return result;
+    if (node->type == GUMBO_NODE_TEXT) {
+        return node->v.text.text;
+    }
+    if (node->type != GUMBO_NODE_ELEMENT) {
+        return result;
+    }
+    if (node->v.element.tag == GUMBO_TAG_SCRIPT || node->v.element.tag == GUMBO_TAG_STYLE) {
+        return result;
+    }
+    GumboVector* children = &node->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        result += gumbo_get_text(static_cast<GumboNode*>(children->data[i]));
+    }
+    return result;
+}
+
+void gumbo_append_text(GumboNode* root, std::string& out) {
+    if (!root) return;
+    bool pending_space = false;
+    std::vector<GumboNode*> stack;
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        GumboNode* node = stack.back();
+        stack.pop_back();
+
+        if (node->type == GUMBO_NODE_TEXT || node->type == GUMBO_NODE_CDATA) {
+            for (const char* p = node->v.text.text; *p; ++p) {
+                unsigned char c = static_cast<unsigned char>(*p);
+                if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v') {
+                    pending_space = true;
+                } else {
+                    if (pending_space && !out.empty()) out.push_back(' ');
+                    pending_space = false;
+                    out.push_back(static_cast<char>(c));
+                }
+            }
+        } else if (node->type == GUMBO_NODE_WHITESPACE) {
+            pending_space = true;
+        } else if (node->type == GUMBO_NODE_ELEMENT) {
+            if (node->v.element.tag == GUMBO_TAG_SCRIPT || node->v.element.tag == GUMBO_TAG_STYLE) {
+                continue;
+            }
+            // Push children in reverse so they are visited in document order
+            GumboVector* children = &node->v.element.children;
+            for (unsigned int i = children->length; i > 0; --i) {
+                stack.push_back(static_cast<GumboNode*>(children->data[i - 1]));
+            }
+        }
+    }
+}
+
+// --- Tokenizer ---
+
+namespace html {
+
+namespace {
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+bool is_alpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Elements that never have an end tag
+bool is_void_element(std::string_view name) {
+    static constexpr std::array<std::string_view, 14> kVoid = {
+        "area", "base", "br", "col", "embed", "hr", "img", "input", "link", "meta", "param", "source", "track", "wbr"};
+    for (std::string_view v : kVoid) {
+        if (iequals(name, v)) return true;
+    }
+    return false;
+}
+
+// Start of the next '<' that opens a tag, comment or declaration (npos: none)
+size_t find_markup(std::string_view html, size_t from) {
+    for (size_t pos = html.find('<', from); pos != std::string_view::npos; pos = html.find('<', pos + 1)) {
+        if (pos + 1 < html.size()) {
+            char c = html[pos + 1];
+            if (is_alpha(c) || c == '/' || c == '!' || c == '?') return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+bool has_class_token(std::string_view classes, std::string_view token) {
+    size_t pos = 0;
+    while (pos < classes.size()) {
+        while (pos < classes.size() && is_space(classes[pos])) ++pos;
+        size_t end = pos;
+        while (end < classes.size() && !is_space(classes[end])) ++end;
+        if (end > pos && classes.substr(pos, end - pos) == token) return true;
+        pos = end;
+    }
+    return false;
+}
+
+void append_utf8(uint32_t cp, std::string& out) {
+    if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) cp = 0xFFFD;
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Named references seen on result pages; others are kept as written
+struct NamedEntity {
+    std::string_view name;
+    uint32_t codepoint;
+};
+constexpr std::array<NamedEntity, 19> kNamedEntities = {{
+    {"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''}, {"nbsp", 0xA0},
+    {"ndash", 0x2013}, {"mdash", 0x2014}, {"lsquo", 0x2018}, {"rsquo", 0x2019}, {"ldquo", 0x201C},
+    {"rdquo", 0x201D}, {"hellip", 0x2026}, {"bull", 0x2022}, {"middot", 0xB7}, {"laquo", 0xAB},
+    {"raquo", 0xBB}, {"copy", 0xA9}, {"reg", 0xAE},
+}};
+
+void trim(std::string& text) {
+    text.erase(0, text.find_first_not_of(" \n\r\t"));
+    text.erase(text.find_last_not_of(" \n\r\t") + 1);
+}
+
+} // anonymous namespace
+
+bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tokenizer::skipRawText() {
+    std::string_view name = raw_text_end_;
+    raw_text_end_ = {};
+    for (size_t pos = html_.find("</", pos_); pos != std::string_view::npos; pos = html_.find("</", pos + 2)) {
+        if (iequals(html_.substr(pos + 2, name.size()), name)) {
+            pos_ = pos;
+            return true;
+        }
+    }
+    pos_ = html_.size();
+    return false;
+}
+
+bool Tokenizer::next(Token& token) {
+    if (!raw_text_end_.empty() && !skipRawText()) {
+        return false;
+    }
+    while (pos_ < html_.size()) {
+        if (html_[pos_] != '<' || find_markup(html_, pos_) != pos_) {
+            size_t end = find_markup(html_, pos_ + 1);
+            if (end == std::string_view::npos) end = html_.size();
+            token = Token{Token::Kind::Text, {}, {}, html_.substr(pos_, end - pos_)};
+            pos_ = end;
+            return true;
+        }
+
+        char kind = html_[pos_ + 1];
+        if (kind == '!' || kind == '?') {
+            size_t end = html_.compare(pos_, 4, "<!--") == 0 ? html_.find("-->", pos_ + 4) : html_.find('>', pos_ + 2);
+            pos_ = end == std::string_view::npos ? html_.size() : end + (html_[end] == '-' ? 3 : 1);
+            continue;
+        }
+
+        bool end_tag = kind == '/';
+        size_t name_start = pos_ + (end_tag ? 2 : 1);
+        size_t name_end = name_start;
+        while (name_end < html_.size() && !is_space(html_[name_end]) && html_[name_end] != '/' && html_[name_end] != '>') {
+            ++name_end;
+        }
+
+        // Find the closing '>' outside quoted attribute values
+        size_t close = name_end;
+        char quote = 0;
+        for (; close < html_.size(); ++close) {
+            char c = html_[close];
+            if (quote) {
+                if (c == quote) quote = 0;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '>') {
+                break;
+            }
+        }
+        std::string_view name = html_.substr(name_start, name_end - name_start);
+        std::string_view attributes = html_.substr(name_end, close - name_end);
+        pos_ = close < html_.size() ? close + 1 : html_.size();
+        if (name.empty()) {
+            continue; // "</>" and the like
+        }
+
+        token = Token{end_tag ? Token::Kind::EndTag : Token::Kind::StartTag, name, {}, {}};
+        if (!end_tag) {
+            token.attributes = attributes;
+            token.self_closing = (!attributes.empty() && attributes.back() == '/') || is_void_element(name);
+            if (!token.self_closing && (iequals(name, "script") || iequals(name, "style"))) {
+                raw_text_end_ = name;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+std::string_view find_attribute(std::string_view attributes, std::string_view name) {
+    size_t pos = 0;
+    while (pos < attributes.size()) {
+        while (pos < attributes.size() && (is_space(attributes[pos]) || attributes[pos] == '/')) ++pos;
+        size_t name_end = pos;
+        while (name_end < attributes.size() && !is_space(attributes[name_end]) && attributes[name_end] != '=' &&
+               attributes[name_end] != '/') {
+            ++name_end;
+        }
+        if (name_end == pos) break;
+        std::string_view attr_name = attributes.substr(pos, name_end - pos);
+        pos = name_end;
+        while (pos < attributes.size() && is_space(attributes[pos])) ++pos;
+
+        std::string_view value;
+        if (pos < attributes.size() && attributes[pos] == '=') {
+            ++pos;
+            while (pos < attributes.size() && is_space(attributes[pos])) ++pos;
+            if (pos < attributes.size() && (attributes[pos] == '"' || attributes[pos] == '\'')) {
+                size_t end = attributes.find(attributes[pos], pos + 1);
+                if (end == std::string_view::npos) end = attributes.size();
+                value = attributes.substr(pos + 1, end - pos - 1);
+                pos = end + 1;
+            } else {
+                size_t end = pos;
+                while (end < attributes.size() && !is_space(attributes[end])) ++end;
+                value = attributes.substr(pos, end - pos);
+                pos = end;
+            }
+        }
+        if (iequals(attr_name, name)) {
+            return value;
+        }
+    }
+    return {};
+}
+
+void append_decoded(std::string_view raw, std::string& out) {
+    size_t pos = 0;
+    while (pos < raw.size()) {
+        size_t amp = raw.find('&', pos);
+        if (amp == std::string_view::npos) {
+            out.append(raw.substr(pos));
+            return;
+        }
+        out.append(raw.substr(pos, amp - pos));
+        pos = amp + 1;
+
+        size_t semi = raw.find(';', pos);
+        if (semi == std::string_view::npos || semi - pos > 10 || semi == pos) {
+            out += '&';
+            continue;
+        }
+        std::string_view ref = raw.substr(pos, semi - pos);
+        bool decoded = false;
+        if (ref[0] == '#') {
+            bool hex = ref.size() > 1 && (ref[1] == 'x' || ref[1] == 'X');
+            std::string_view digits = ref.substr(hex ? 2 : 1);
+            uint32_t cp = 0;
+            bool valid = !digits.empty();
+            for (char c : digits) {
+                int value = std::isdigit(static_cast<unsigned char>(c)) ? c - '0'
+                          : hex && std::isxdigit(static_cast<unsigned char>(c)) ? (std::tolower(static_cast<unsigned char>(c)) - 'a' + 10)
+                          : -1;
+                if (value < 0 || cp > 0x10FFFF) {
+                    valid = false;
+                    break;
+                }
+                cp = cp * (hex ? 16 : 10) + static_cast<uint32_t>(value);
+            }
+            if (valid) {
+                append_utf8(cp, out);
+                decoded = true;
+            }
+        } else {
+            for (const auto& entity : kNamedEntities) {
+                if (entity.name == ref) {
+                    append_utf8(entity.codepoint, out);
+                    decoded = true;
+                    break;
+                }
+            }
+        }
+        if (decoded) {
+            pos = semi + 1;
+        } else {
+            out += '&';
+        }
+    }
+}
+
+// --- Selector engine ---
+
+namespace {
+
+// The first element matching one selector of a field, and its text so far
+struct Capture {
+    bool active = false;  // Element still open
+    bool done = false;
+    size_t open_index = 0;
+    std::string text;
+    std::string href;
+};
+
+enum Field { kLink, kTitle, kSnippet, kDisplayUrl, kFieldCount };
+
+} // anonymous namespace
+
+std::vector<ScannedResult> scan_results(std::string_view html, const ResultMarkup& markup) {
+    const std::array<const std::vector<Selector>*, kFieldCount> selectors = {
+        &markup.link, &markup.title, &markup.snippet, &markup.display_url};
+    std::array<std::vector<Capture>, kFieldCount> captures;
+    for (size_t f = 0; f < kFieldCount; ++f) {
+        captures[f].resize(selectors[f]->size());
+    }
+
+    std::vector<ScannedResult> results;
+    std::vector<std::string_view> open; // Names of the open elements
+    bool in_block = false;
+    size_t block_index = 0;
+    size_t active_captures = 0;
+
+    // First captured alternative of a field (nullptr: none)
+    auto chosen = [&](Field f) -> Capture* {
+        for (auto& capture : captures[f]) {
+            if (capture.done || capture.active) return &capture;
+        }
+        return nullptr;
+    };
+
+    auto finish_block = [&]() {
+        ScannedResult result;
+        if (Capture* link = chosen(kLink)) {
+            result.url = std::move(link->href);
+            Capture* title = chosen(kTitle);
+            result.title = std::move(title ? title->text : link->text);
+        }
+        if (Capture* snippet = chosen(kSnippet)) result.snippet = std::move(snippet->text);
+        if (Capture* display_url = chosen(kDisplayUrl)) result.display_url = std::move(display_url->text);
+        trim(result.title);
+        trim(result.snippet);
+        trim(result.display_url);
+        if (!result.title.empty() && !result.url.empty()) {
+            results.push_back(std::move(result));
+        }
+        for (auto& field : captures) {
+            for (auto& capture : field) capture = Capture();
+        }
+        active_captures = 0;
+        in_block = false;
+    };
+
+    auto matches = [&](const Selector& selector, const Token& token) {
+        if (!iequals(token.name, selector.tag)) return false;
+        if (!selector.class_part.empty() &&
+            find_attribute(token.attributes, "class").find(selector.class_part) == std::string_view::npos) {
+            return false;
+        }
+        if (!selector.inside.empty()) {
+            for (size_t i = block_index + 1; i < open.size(); ++i) {
+                if (iequals(open[i], selector.inside)) return true;
+            }
+            return false;
+        }
+        return true;
+    };
+
+    Tokenizer tokenizer(html);
+    Token token;
+    while (tokenizer.next(token)) {
+        switch (token.kind) {
+        case Token::Kind::StartTag: {
+            if (!in_block) {
+                if (iequals(token.name, markup.block_tag) && !token.self_closing) {
+                    std::string_view classes = find_attribute(token.attributes, "class");
+                    if (has_class_token(classes, markup.block_class) &&
+                        (markup.exclude_class.empty() || !has_class_token(classes, markup.exclude_class))) {
+                        in_block = true;
+                        block_index = open.size();
+                    }
+                }
+                if (!token.self_closing) open.push_back(token.name);
+                break;
+            }
+
+            bool in_link = false;
+            for (const auto& capture : captures[kLink]) in_link = in_link || capture.active;
+            for (size_t f = 0; f < kFieldCount; ++f) {
+                if (f == kTitle && !in_link) continue;
+                for (size_t i = 0; i < captures[f].size(); ++i) {
+                    Capture& capture = captures[f][i];
+                    if (capture.active || capture.done || !matches((*selectors[f])[i], token)) continue;
+                    if (f == kLink) append_decoded(find_attribute(token.attributes, "href"), capture.href);
+                    if (token.self_closing) {
+                        capture.done = true;
+                    } else {
+                        capture.active = true;
+                        capture.open_index = open.size();
+                        ++active_captures;
+                    }
+                }
+            }
+            if (!token.self_closing) open.push_back(token.name);
+            break;
+        }
+        case Token::Kind::EndTag: {
+            // Close the nearest open element with that name (and any left open inside it)
+            size_t index = open.size();
+            while (index > 0 && !iequals(open[index - 1], token.name)) --index;
+            if (index == 0) break; // Stray end tag
+            open.resize(index - 1);
+            if (!in_block) break;
+            for (auto& field : captures) {
+                for (auto& capture : field) {
+                    if (capture.active && capture.open_index >= open.size()) {
+                        capture.active = false;
+                        capture.done = true;
+                        --active_captures;
+                    }
+                }
+            }
+            if (block_index >= open.size()) finish_block();
+            break;
+        }
+        case Token::Kind::Text: {
+            if (active_captures == 0) break;
+            // Whitespace-only text between elements is not part of the text (as with Gumbo)
+            bool whitespace = true;
+            for (char c : token.text) whitespace = whitespace && is_space(c);
+            if (whitespace) break;
+            for (auto& field : captures) {
+                for (auto& capture : field) {
+                    if (capture.active) append_decoded(token.text, capture.text);
+                }
+            }
+            break;
+        }
+        }
+    }
+    if (in_block) {
+        finish_block();
+    }
+    return results;
+}
+
+} // namespace html
@@ -0,0 +1,99 @@
+#pragma once
+#include <gumbo.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// HTML helpers shared by the web tools: Gumbo DOM walks, and a single-pass
+// tokenizer with a small selector engine for pages whose markup is known
+// (search result pages), which needs no DOM at all.
+
+// --- Gumbo DOM helpers ---
+
+// First element with that tag under node (preorder, node included), or nullptr
+GumboNode* gumbo_find_tag(GumboNode* node, GumboTag tag);
+
+// Same, also requiring class_part to occur in the class attribute
+GumboNode* gumbo_find_tag_with_class(GumboNode* node, GumboTag tag, std::string_view class_part);
+
+// Concatenated text nodes under node (whitespace-only nodes and script/style skipped)
+std::string gumbo_get_text(GumboNode* node);
+
+// Append the visible text under root to out in a single iterative pass,
+// collapsing whitespace runs to one space as it goes. script/style are skipped.
+void gumbo_append_text(GumboNode* root, std::string& out);
+
+// --- Tokenizer ---
+
+namespace html {
+
+struct Token {
+    enum class Kind { StartTag, EndTag, Text };
+    Kind kind = Kind::Text;
+    std::string_view name;       // Tag name as written (compare with iequals)
+    std::string_view attributes; // Raw attribute text of a start tag
+    std::string_view text;       // Raw text (entities not decoded)
+    bool self_closing = false;   // Start tag ending in "/>", or a void element
+};
+
+// Splits HTML into start tags, end tags and text without building a tree.
+// Comments, doctypes and processing instructions are skipped; the contents of
+// script and style are skipped as well. Views point into the input.
+class Tokenizer {
+public:
+    explicit Tokenizer(std::string_view html) : html_(html) {}
+
+    // Next token; false at the end of the input
+    bool next(Token& token);
+
+private:
+    std::string_view html_;
+    size_t pos_ = 0;
+    std::string_view raw_text_end_; // Set after <script>/<style>: skip to this end tag
+
+    bool skipRawText();
+};
+
+bool iequals(std::string_view a, std::string_view b);
+
+// Raw value of an attribute in a start tag's attribute text (empty if absent)
+std::string_view find_attribute(std::string_view attributes, std::string_view name);
+
+// Append raw with character references decoded (numeric ones and the common named ones)
+void append_decoded(std::string_view raw, std::string& out);
+
+// --- Selector engine ---
+
+// An element in a result block: tag plus a substring of its class attribute,
+// optionally only inside an open element with another tag
+struct Selector {
+    std::string_view tag;
+    std::string_view class_part;   // Empty: any class
+    std::string_view inside = {};  // Tag of an enclosing element within the block
+};
+
+// Where the fields of one result live. Each field lists alternatives in order
+// of preference; the first element matching an alternative is used.
+struct ResultMarkup {
+    std::string_view block_tag;        // Element wrapping one result...
+    std::string_view block_class;      // ...with this class token...
+    std::string_view exclude_class;    // ...and not this one (ads)
+    std::vector<Selector> link;        // href is the URL, text the fallback title
+    std::vector<Selector> title;       // Searched inside the link
+    std::vector<Selector> snippet;
+    std::vector<Selector> display_url;
+};
+
+struct ScannedResult {
+    std::string title;       // Trimmed text, entities decoded
+    std::string url;         // Decoded href
+    std::string snippet;
+    std::string display_url;
+};
+
+// Extract every result block of the page in one pass over the markup
+// (blocks are not nested; fields are the text of the first matching element,
+// as with the Gumbo walks). Results lacking a title or URL are left out.
+std::vector<ScannedResult> scan_results(std::string_view html, const ResultMarkup& markup);
+
+} // namespace html
@@ -10,7 +10,8 @@ std::string read_history(PersistenceManager& db, const std::string& start_time,
     std::stringstream ss;
     ss << "History (" << start_time << " to " << end_time << ", Limit: " << limit << "):\n";
     for (const auto& msg : messages) {
-        std::string truncated_content = msg.content;
+        // Tool call requests often have no text; show the requested calls instead
+        std::string truncated_content = (msg.content.empty() && msg.isToolCallRequest()) ? msg.tool_calls.str() : msg.content.str();
         if (truncated_content.length() > 100) {
             truncated_content = truncated_content.substr(0, 97) + "...";
         }
@@ -0,0 +1,55 @@
+#include "tools_impl/recall_history_tool.h"
+#include <iomanip>
+#include <sstream>
+
+std::string recall_excerpt(const std::string& content, size_t max_bytes) {
+    std::string text = content.substr(0, max_bytes);
+    while (!text.empty() && text.size() < content.size() &&
+           (static_cast<unsigned char>(content[text.size()]) & 0xC0) == 0x80) {
+        text.pop_back();
+    }
+    bool cut = text.size() < content.size();
+    size_t pos = 0;
+    while ((pos = text.find('\n', pos)) != std::string::npos) {
+        text.replace(pos, 1, "\\n");
+        pos += 2;
+    }
+    if (cut) text += "...";
+    return text;
+}
+
+std::string recall_history(PersistenceManager& db, EmbeddingService& memory, const std::string& query,
+                           size_t limit, bool all_sessions, std::stop_token stop) {
+    EmbeddingService::Query request;
+    request.stop = std::move(stop);
+    request.text = query;
+    request.limit = limit;
+    request.session_id = all_sessions ? 0 : db.activeSession();
+    std::vector<EmbeddingIndex::Hit> hits = memory.search(request);
+    if (hits.empty()) {
+        std::string error = memory.lastError();
+        return "No messages recalled for \"" + query + "\" (" + std::to_string(memory.indexedCount()) +
+               " messages indexed" + (error.empty() ? "" : "; indexing error: " + error) + ").";
+    }
+
+    std::vector<int> ids;
+    ids.reserve(hits.size());
+    for (const auto& hit : hits) {
+        ids.push_back(hit.message_id);
+    }
+    std::vector<Message> messages = db.getMessagesById(ids);
+
+    std::stringstream ss;
+    ss << "Messages closest in meaning to \"" << query << "\" (best first):\n";
+    for (const auto& msg : messages) {
+        float score = 0;
+        for (const auto& hit : hits) {
+            if (hit.message_id == msg.id) score = hit.score;
+        }
+        ss << "[" << msg.timestamp.str() << " ID: " << msg.id << ", Role: " << msg.role;
+        if (all_sessions) ss << ", Session: " << msg.session_id;
+        ss << ", Similarity: " << std::fixed << std::setprecision(2) << score << "] "
+           << recall_excerpt(msg.content.str()) << "\n";
+    }
+    return ss.str();
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <stop_token>
+#include <string>
+#include "database.h"
+#include "embedding_service.h"
+
+// Semantic search over the conversation history (embedding index): messages
+// closest in meaning to the query, best first, even without shared words
+// (stop aborts the query's embeddings request with OperationCancelled)
+std::string recall_history(PersistenceManager& db, EmbeddingService& memory, const std::string& query,
+                           size_t limit, bool all_sessions, std::stop_token stop = {});
+
+// Excerpt of a message for recall output: at most max_bytes (cut on a UTF-8
+// boundary, "..." appended when cut), newlines escaped
+std::string recall_excerpt(const std::string& content, size_t max_bytes = 600);
@@ -0,0 +1,324 @@
+#include "tools_impl/research_synthesis.h"
+#include "chat_client.h"
+#include "context_budget.h"
+#include "interrupt.h"
+#include "thread_pool.h"
+#include "ui_interface.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <future>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+size_t env_size(const char* name, size_t fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    try {
+        long long parsed = std::stoll(value);
+        return parsed > 0 ? static_cast<size_t>(parsed) : fallback;
+    } catch (...) {
+        return fallback;
+    }
+}
+
+// Chunk size for the map stage and how many of the best chunks are summarized
+// at most (LLM_CLI_RESEARCH_CHUNK_TOKENS, LLM_CLI_RESEARCH_MAX_CHUNKS)
+constexpr size_t kDefaultChunkTokens = 1000;
+constexpr size_t kDefaultMaxChunks = 16;
+// Map calls get at most this many tokens of excerpts each, so they stay quick
+constexpr size_t kMaxMapInputTokens = 6000;
+// Room left in the request budget for the synthesis instructions and topic
+constexpr size_t kSynthesisPromptTokens = 512;
+
+std::string render_sources(const std::vector<ResearchSource>& sources) {
+    std::string rendered;
+    for (const auto& source : sources) {
+        rendered += "\n--- " + source.label + " ---\n";
+        rendered += source.text;
+        rendered += "\n--- End ---\n";
+    }
+    return rendered;
+}
+
+// Cut text at a byte boundary that does not split a UTF-8 sequence
+size_t utf8_boundary(const std::string& text, size_t pos) {
+    while (pos > 0 && pos < text.size() && (static_cast<unsigned char>(text[pos]) & 0xC0) == 0x80) {
+        --pos;
+    }
+    return pos;
+}
+
+struct Chunk {
+    size_t source;
+    std::string text;
+    double score = 0;
+};
+
+// Notes for the topic from a batch of excerpts (empty if none are relevant)
+std::string summarize_batch(ChatClient& client, const std::string& topic, const std::string& excerpts) {
+    std::vector<Message> messages;
+    messages.push_back({"system", "You extract research notes. From the excerpts below, write concise factual notes that are relevant to the research topic, keeping figures, names, dates and the source label of each fact. If nothing is relevant, reply with exactly NONE. DO NOT USE ANY TOOLS OR FUNCTIONS."});
+    messages.push_back({"user", "Research topic: " + topic + "\n\nExcerpts:\n" + excerpts});
+
+    nlohmann::json response = nlohmann::json::parse(client.makeApiCall(messages, false), nullptr, false);
+    if (response.is_discarded() || !response.contains("choices") || response["choices"].empty()) {
+        throw std::runtime_error("Invalid response structure from LLM while summarizing excerpts");
+    }
+    const auto& message = response["choices"][0].value("message", nlohmann::json::object());
+    if (!message.contains("content") || !message["content"].is_string()) {
+        throw std::runtime_error("Summary response has no text content");
+    }
+    std::string notes = message["content"].get<std::string>();
+    notes.erase(0, notes.find_first_not_of(" \t\r\n"));
+    notes.erase(notes.find_last_not_of(" \t\r\n") + 1);
+    return notes == "NONE" ? std::string() : notes;
+}
+
+} // namespace
+
+std::vector<std::string> Bm25Index::terms(const std::string& text) {
+    std::vector<std::string> result;
+    std::string term;
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (std::isalnum(byte) || byte >= 0x80) {
+            term += static_cast<char>(std::tolower(byte));
+        } else if (!term.empty()) {
+            if (term.size() > 1) result.push_back(std::move(term));
+            term.clear();
+        }
+    }
+    if (term.size() > 1) result.push_back(std::move(term));
+    return result;
+}
+
+Bm25Index::Bm25Index(const std::vector<std::string>& documents) {
+    documents_.reserve(documents.size());
+    std::vector<std::string> all_terms;
+    size_t total_length = 0;
+    for (const auto& document : documents) {
+        std::vector<std::string> document_terms = terms(document);
+        std::sort(document_terms.begin(), document_terms.end());
+        total_length += document_terms.size();
+        // Each distinct term counts once towards document frequency
+        std::unique_copy(document_terms.begin(), document_terms.end(), std::back_inserter(all_terms));
+        documents_.push_back(std::move(document_terms));
+    }
+    std::sort(all_terms.begin(), all_terms.end());
+    for (auto it = all_terms.begin(); it != all_terms.end();) {
+        auto end = std::upper_bound(it, all_terms.end(), *it);
+        document_frequency_.emplace_back(*it, static_cast<size_t>(end - it));
+        it = end;
+    }
+    average_length_ = documents_.empty() ? 0 : static_cast<double>(total_length) / documents_.size();
+}
+
+double Bm25Index::score(size_t document, const std::vector<std::string>& query_terms) const {
+    constexpr double k1 = 1.2;
+    constexpr double b = 0.75;
+    const auto& document_terms = documents_[document];
+    const double length_norm = average_length_ > 0 ? document_terms.size() / average_length_ : 1.0;
+    const double n = static_cast<double>(documents_.size());
+
+    double total = 0;
+    for (const auto& term : query_terms) {
+        auto [first, last] = std::equal_range(document_terms.begin(), document_terms.end(), term);
+        double tf = static_cast<double>(last - first);
+        if (tf == 0) continue;
+        auto df_it = std::lower_bound(document_frequency_.begin(), document_frequency_.end(), term,
+                                      [](const auto& entry, const std::string& t) { return entry.first < t; });
+        double df = static_cast<double>(df_it->second);
+        double idf = std::log(1.0 + (n - df + 0.5) / (df + 0.5));
+        total += idf * tf * (k1 + 1) / (tf + k1 * (1 - b + b * length_norm));
+    }
+    return total;
+}
+
+std::vector<std::string> chunk_text(const std::string& text, size_t max_tokens) {
+    // estimate_tokens() counts about 4 bytes per token
+    const size_t max_bytes = std::max<size_t>(max_tokens, 1) * 4;
+    std::vector<std::string> chunks;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = std::min(text.size(), pos + max_bytes);
+        if (end < text.size()) {
+            // Break at the last paragraph, line or word boundary in the second half
+            size_t floor = pos + max_bytes / 2;
+            for (const char* separator : {"\n\n", "\n", " "}) {
+                size_t cut = text.rfind(separator, end);
+                if (cut != std::string::npos && cut > floor) {
+                    end = cut;
+                    break;
+                }
+            }
+            end = utf8_boundary(text, end);
+            if (end <= pos) end = std::min(text.size(), pos + max_bytes);
+        }
+        std::string chunk = text.substr(pos, end - pos);
+        if (chunk.find_first_not_of(" \t\r\n") != std::string::npos) {
+            chunks.push_back(std::move(chunk));
+        }
+        pos = end;
+    }
+    return chunks;
+}
+
+std::string condense_for_synthesis(ChatClient& client, UserInterface& ui, const std::string& topic,
+                                   const std::vector<ResearchSource>& sources) {
+    const size_t request_budget = client.requestTokenBudget();
+    const size_t budget_tokens = request_budget > kSynthesisPromptTokens ? request_budget - kSynthesisPromptTokens
+                                                                         : request_budget / 2;
+    std::string rendered = render_sources(sources);
+    if (estimate_tokens(rendered) <= budget_tokens) {
+        return rendered;
+    }
+
+    // --- Map: rank chunks by relevance and summarize the best ones ---
+    const size_t chunk_tokens = std::min(env_size("LLM_CLI_RESEARCH_CHUNK_TOKENS", kDefaultChunkTokens),
+                                         std::max<size_t>(budget_tokens / 2, 1));
+    const size_t max_chunks = env_size("LLM_CLI_RESEARCH_MAX_CHUNKS", kDefaultMaxChunks);
+
+    std::vector<Chunk> chunks;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        for (std::string& text : chunk_text(sources[i].text, chunk_tokens)) {
+            chunks.push_back({i, std::move(text)});
+        }
+    }
+    std::vector<std::string> chunk_texts;
+    chunk_texts.reserve(chunks.size());
+    for (const auto& chunk : chunks) chunk_texts.push_back(chunk.text);
+    Bm25Index index(chunk_texts);
+    const std::vector<std::string> query = Bm25Index::terms(topic);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        chunks[i].score = index.score(i, query);
+    }
+    // Ties (e.g. no query term anywhere) keep document order
+    std::stable_sort(chunks.begin(), chunks.end(), [](const Chunk& a, const Chunk& b) { return a.score > b.score; });
+    if (chunks.size() > max_chunks) {
+        chunks.resize(max_chunks);
+    }
+
+    // Batches of excerpts in rank order, each within one map call's budget
+    const size_t batch_tokens = std::min(budget_tokens, kMaxMapInputTokens);
+    std::vector<std::string> batches;
+    size_t batch_used = 0;
+    for (const auto& chunk : chunks) {
+        std::string excerpt = "\n--- Excerpt from " + sources[chunk.source].label + " ---\n" + chunk.text + "\n";
+        size_t tokens = estimate_tokens(excerpt);
+        if (batches.empty() || batch_used + tokens > batch_tokens) {
+            batches.emplace_back();
+            batch_used = 0;
+        }
+        batches.back() += excerpt;
+        batch_used += tokens;
+    }
+
+    ui.displayStatus("  [Research: condensing " + std::to_string(chunks.size()) + " relevant excerpts in " +
+                     std::to_string(batches.size()) + " parallel summaries...]");
+    ThreadPool& executor = ThreadPool::shared();
+    std::vector<std::future<std::string>> summaries;
+    summaries.reserve(batches.size());
+    for (const std::string& batch : batches) {
+        summaries.push_back(executor.submit([&client, &topic, &batch]() {
+            if (client.stopToken().stop_requested()) {
+                throw OperationCancelled();
+            }
+            return summarize_batch(client, topic, batch);
+        }));
+    }
+
+    // --- Reduce: notes replace the raw material, best batches first ---
+    // Every summary is awaited: the map tasks reference this frame
+    std::string notes;
+    bool cancelled = false;
+    bool notes_full = false;
+    for (size_t i = 0; i < summaries.size(); ++i) {
+        std::string summary;
+        try {
+            summary = executor.await(summaries[i]);
+        } catch (const OperationCancelled&) {
+            cancelled = true;
+            continue;
+        } catch (const std::exception&) {
+            // A failed summary falls back to the start of its batch
+            summary = batches[i].substr(0, utf8_boundary(batches[i], std::min(batches[i].size(), size_t{2000})));
+        }
+        if (summary.empty() || notes_full) continue;
+        std::string block = "\n--- Research notes " + std::to_string(i + 1) + " ---\n" + summary + "\n--- End ---\n";
+        if (estimate_tokens(notes) + estimate_tokens(block) > budget_tokens) {
+            notes_full = true;
+            continue;
+        }
+        notes += block;
+    }
+    if (cancelled || client.stopToken().stop_requested()) {
+        throw OperationCancelled();
+    }
+    if (notes.empty()) {
+        notes = "\nNo material relevant to the topic was found in the visited pages.\n";
+    }
+    return notes;
+}
+
+SynthesisResult run_synthesis(ChatClient& client, UserInterface& ui, std::vector<Message> messages,
+                              const std::string& retry_system_prompt, const std::string& stream_title) {
+    SynthesisResult result;
+    for (int attempt = 0; attempt < 3; attempt++) {
+        if (attempt > 0) {
+            messages[0].content = retry_system_prompt;
+        }
+
+        if (!stream_title.empty()) {
+            ui.startToolOutput(stream_title);
+            ApiClient::StreamingResponse response;
+            try {
+                response = client.makeStreamingApiCall(messages, [&ui](const std::string& chunk) {
+                    ui.displayToolOutputChunk(chunk);
+                });
+            } catch (...) {
+                ui.endToolOutput();
+                throw;
+            }
+            ui.endToolOutput();
+            if (response.cancelled) {
+                throw OperationCancelled();
+            }
+            if (response.has_tool_calls) {
+                result.status = SynthesisResult::Status::ToolCalls;
+                continue;
+            }
+            if (!response.accumulated_content.empty()) {
+                result.status = SynthesisResult::Status::Ok;
+                result.text = std::move(response.accumulated_content);
+                return result;
+            }
+            result.status = SynthesisResult::Status::InvalidResponse;
+            continue;
+        }
+
+        nlohmann::json response = nlohmann::json::parse(client.makeApiCall(messages, false), nullptr, false);
+        if (response.is_discarded()) {
+            result.status = SynthesisResult::Status::ParseError;
+            continue;
+        }
+        if (response.contains("choices") && !response["choices"].empty() &&
+            response["choices"][0].contains("message")) {
+            const auto& message = response["choices"][0]["message"];
+            if (message.contains("tool_calls") && !message["tool_calls"].is_null()) {
+                // Retried with stronger instructions
+                result.status = SynthesisResult::Status::ToolCalls;
+                continue;
+            }
+            if (message.contains("content") && message["content"].is_string()) {
+                result.status = SynthesisResult::Status::Ok;
+                result.text = message["content"].get<std::string>();
+                return result;
+            }
+        }
+        result.status = SynthesisResult::Status::InvalidResponse;
+    }
+    return result;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "database.h" // Message
+class ChatClient;
+class UserInterface; // Forward declaration
+
+// One block of research material (a search result list, a page, a sub-report)
+struct ResearchSource {
+    std::string label; // e.g. "Content from https://..." (kept with every excerpt)
+    std::string text;
+};
+
+// Relevance of text chunks to a query: Okapi BM25 (k1 = 1.2, b = 0.75) over
+// lower-cased alphanumeric terms, with IDF taken from the chunks themselves
+class Bm25Index {
+public:
+    explicit Bm25Index(const std::vector<std::string>& documents);
+
+    double score(size_t document, const std::vector<std::string>& query_terms) const;
+
+    static std::vector<std::string> terms(const std::string& text);
+
+private:
+    std::vector<std::vector<std::string>> documents_; // Sorted terms per document
+    std::vector<std::pair<std::string, size_t>> document_frequency_; // Sorted by term
+    double average_length_ = 0;
+};
+
+// Split text into chunks of about max_tokens tokens, preferring paragraph,
+// then line, then word boundaries
+std::vector<std::string> chunk_text(const std::string& text, size_t max_tokens);
+
+// Research material for a synthesis prompt about `topic`, sized to the
+// client's request budget less room for the synthesis instructions. Sources
+// that fit are passed through verbatim, labelled.
+// Otherwise they are map-reduced: cut into chunks, the chunks BM25 ranks most
+// relevant to the topic are summarized into notes by parallel API calls, and
+// the notes (highest ranked first) replace the raw text. Throws
+// OperationCancelled when the turn is stopped.
+std::string condense_for_synthesis(ChatClient& client, UserInterface& ui, const std::string& topic,
+                                   const std::vector<ResearchSource>& sources);
+
+// Outcome of run_synthesis(), by what went wrong on the last attempt
+struct SynthesisResult {
+    enum class Status {
+        Ok,              // text holds the answer
+        ParseError,      // Response was not JSON
+        InvalidResponse, // No text content in the response
+        ToolCalls        // The model kept asking for tools instead of answering
+    };
+    Status status = Status::ToolCalls;
+    std::string text;
+};
+
+// Ask for a plain-text answer to `messages` in up to three attempts; from the
+// second on, the system message is replaced by retry_system_prompt. With a
+// stream_title the answer is streamed to the UI as it is written (one tool
+// stream at a time, so only from the tool's own thread); otherwise it is
+// fetched whole. Throws OperationCancelled when the turn is stopped.
+SynthesisResult run_synthesis(ChatClient& client, UserInterface& ui, std::vector<Message> messages,
+                              const std::string& retry_system_prompt, const std::string& stream_title = {});
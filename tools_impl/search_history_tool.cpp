@@ -0,0 +1,73 @@
+#include "tools_impl/search_history_tool.h"
+#include <cctype>
+#include <sstream>
+
+std::string history_match_expression(const std::string& query, bool match_any) {
+    std::string expression;
+    std::string word;
+    auto flush_word = [&](bool prefix) {
+        if (word.empty()) return;
+        if (!expression.empty()) expression += match_any ? " OR " : " ";
+        expression += '"' + word + '"';
+        if (prefix) expression += '*';
+        word.clear();
+    };
+    for (char c : query) {
+        unsigned char u = static_cast<unsigned char>(c);
+        // Same word characters as the unicode61 tokenizer for ASCII; UTF-8 bytes are kept whole
+        if (std::isalnum(u) || u >= 0x80 || c == '_') {
+            word += c;
+        } else {
+            flush_word(c == '*');
+        }
+    }
+    flush_word(false);
+    return expression;
+}
+
+std::string search_history(PersistenceManager& db, const std::string& query, size_t limit, size_t page,
+                           bool all_sessions, bool match_any) {
+    std::string match = history_match_expression(query, match_any);
+    if (match.empty()) {
+        return "No searchable words in query \"" + query + "\".";
+    }
+    size_t offset = (page - 1) * limit;
+
+    // One extra hit tells whether another page exists
+    std::vector<HistorySearchHit> hits = db.searchHistory(match, limit + 1, offset, all_sessions);
+    bool fell_back = false;
+    if (hits.empty() && !match_any && page == 1 && match.find(' ') != std::string::npos) {
+        // No message has every word; rank messages with any of them instead of
+        // making the model retry with fewer words (later pages keep this mode)
+        match_any = true;
+        hits = db.searchHistory(history_match_expression(query, true), limit + 1, offset, all_sessions);
+        fell_back = true;
+    }
+    if (hits.empty()) {
+        return "No messages match \"" + query + "\"" + (page > 1 ? " on page " + std::to_string(page) : "") + ".";
+    }
+    bool more = hits.size() > limit;
+    if (more) hits.pop_back();
+
+    std::stringstream ss;
+    ss << "History matches for \"" << query << "\" (page " << page << ", best first"
+       << (fell_back ? "; no message contains all words, showing messages with any of them"
+                     : match_any ? "; messages with any of the words" : "")
+       << "):\n";
+    for (const auto& hit : hits) {
+        std::string snippet = hit.snippet;
+        size_t pos = 0;
+        while ((pos = snippet.find('\n', pos)) != std::string::npos) {
+            snippet.replace(pos, 1, "\\n");
+            pos += 2;
+        }
+        ss << "[" << hit.timestamp << " ID: " << hit.id << ", Role: " << hit.role;
+        if (all_sessions) ss << ", Session: " << hit.session_id;
+        ss << "] " << snippet << "\n";
+    }
+    if (more) {
+        ss << "More matches: call search_history with page=" << (page + 1)
+           << (match_any ? ", match_any=true" : "") << ".\n";
+    }
+    return ss.str();
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+#include "database.h"
+
+// Ranked keyword search over the conversation history (full-text index)
+// Returns one page of hits with snippets; page is 1-based. Words are ANDed
+// unless match_any is set; a first page with no hit for all words falls back
+// to any word, and the next-page hint then carries match_any=true.
+std::string search_history(PersistenceManager& db, const std::string& query, size_t limit, size_t page,
+                           bool all_sessions, bool match_any = false);
+
+// FTS5 MATCH expression for free-form keywords: each word is quoted (so
+// punctuation such as "gpt-4o" cannot break the query syntax) and a trailing
+// '*' keeps prefix matching. Words are ANDed, or ORed when match_any is set.
+// Returns an empty string if the query has no searchable words.
+std::string history_match_expression(const std::string& query, bool match_any);
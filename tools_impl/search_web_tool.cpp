@@ -4,71 +4,22 @@
 #include <string>
 #include <sstream>
 #include <vector>
-#include <functional>
 #include <stdexcept> // For runtime_error
 #include <cstdlib>   // For getenv
 #include <nlohmann/json.hpp> // For JSON parsing
 #include <iostream> // Keep for cerr warning (static handle init failure)
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include "curl_utils.h" // Include the shared callback
+#include "http_routing.h"
 #include "config.h"     // For BRAVE_SEARCH_API_KEY
-
-// --- Gumbo helpers (static) ---
-static GumboNode* find_node_by_tag(GumboNode* node, GumboTag tag) {
-    if (!node || node->type != GUMBO_NODE_ELEMENT) {
-        return nullptr;
-    }
-    if (node->v.element.tag == tag) {
-        return node;
-    }
-    GumboVector* children = &node->v.element.children;
-    for (unsigned int i = 0; i < children->length; ++i) {
-        GumboNode* found = find_node_by_tag(static_cast<GumboNode*>(children->data[i]), tag);
-        if (found) {
-            return found;
-        }
-    }
-    return nullptr;
-}
-
-static GumboNode* find_node_by_tag_and_class(GumboNode* node, GumboTag tag, const std::string& class_name) {
-    if (!node || node->type != GUMBO_NODE_ELEMENT) {
-        return nullptr;
-    }
-    if (node->v.element.tag == tag) {
-        GumboAttribute* class_attr = gumbo_get_attribute(&node->v.element.attributes, "class");
-        if (class_attr && std::string(class_attr->value).find(class_name) != std::string::npos) {
-            return node;
-        }
-    }
-    GumboVector* children = &node->v.element.children;
-    for (unsigned int i = 0; i < children->length; ++i) {
-        GumboNode* found = find_node_by_tag_and_class(static_cast<GumboNode*>(children->data[i]), tag, class_name);
-        if (found) {
-            return found;
-        }
-    }
-    return nullptr;
-}
-
-static std::string gumbo_get_text(GumboNode* node) {
-    if (!node) return "";
-    if (node->type == GUMBO_NODE_TEXT) {
-        return node->v.text.text;
-    }
-    if (node->type != GUMBO_NODE_ELEMENT) {
-        return "";
-    }
-    if (node->v.element.tag == GUMBO_TAG_SCRIPT || node->v.element.tag == GUMBO_TAG_STYLE) {
-        return "";
-    }
-    std::string result;
-    GumboVector* children = &node->v.element.children;
-    for (unsigned int i = 0; i < children->length; ++i) {
-        GumboNode* child = static_cast<GumboNode*>(children->data[i]);
-        result += gumbo_get_text(child);
-    }
-    return result;
-}
+#include "database.h"
+#include "tools_impl/content_cache.h"
+#include "tools_impl/html_utils.h"
+#include "interrupt.h"
 
 // --- Constants ---
 constexpr const char* kUserAgent = "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/108.0.0.0 Safari/537.36";
@@ -98,7 +49,7 @@ static CURL* setup_search_curl(const std::string& base_url, const std::string& q
     // Append User-Agent header (caller manages the list lifecycle)
     *headers = curl_slist_append(*headers, std::string("User-Agent: ").append(kUserAgent).c_str());
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_URL, route_url(url).c_str());
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, *headers);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
@@ -110,216 +61,203 @@ static CURL* setup_search_curl(const std::string& base_url, const std::string& q
 }
 
 
-// --- Implementation of parse_brave_search_html ---
-std::string parse_brave_search_html(const std::string& html) {
-    GumboOutput* output = gumbo_parse(html.c_str());
-    std::string result = "Web results:\n\n";
-    int count = 0;
+// --- Search result page parsing ---
+// Pages are scanned once with html::scan_results(); the Gumbo DOM walks below
+// only run when that finds nothing (changed or malformed markup).
 
-    std::vector<GumboNode*> result_divs;
-    std::function<void(GumboNode*)> find_result_divs =
-        [&](GumboNode* node) {
-        if (!node || node->type != GUMBO_NODE_ELEMENT) return;
-        if (node->v.element.tag == GUMBO_TAG_DIV) {
-            GumboAttribute* class_attr = gumbo_get_attribute(&node->v.element.attributes, "class");
-            if (class_attr && class_attr->value) {
-                std::string classes = " " + std::string(class_attr->value) + " ";
-                if (classes.find(" snippet ") != std::string::npos) {
-                    result_divs.push_back(node);
-                    return;
-                }
-            }
-        }
-        GumboVector* children = &node->v.element.children;
-        for (unsigned int i = 0; i < children->length; ++i) {
-            find_result_divs(static_cast<GumboNode*>(children->data[i]));
-        }
-    };
+namespace {
 
-    if (output && output->root) {
-        find_result_divs(output->root);
+const html::ResultMarkup& brave_markup() {
+    static const html::ResultMarkup markup{
+        "div", "snippet", "",
+        {{"a", "heading-serpresult"}},
+        {{"div", "title"}},
+        {{"div", "snippet-description"}, {"div", "snippet-content"}},
+        {{"cite", "snippet-url"}, {"div", "url"}},
+    };
+    return markup;
+}
 
-        for (GumboNode* result_div : result_divs) {
-            std::string title;
-            std::string url;
-            std::string snippet;
-            std::string display_url_text;
+const html::ResultMarkup& ddg_markup() {
+    static const html::ResultMarkup markup{
+        "div", "result", "result--ad",
+        {{"a", "result__a", "h2"}},
+        {},
+        {{"a", "result__snippet"}},
+        {{"a", "result__url"}},
+    };
+    return markup;
+}
 
-            GumboNode* title_a = find_node_by_tag_and_class(result_div, GUMBO_TAG_A, "heading-serpresult");
-            if (title_a) {
-                GumboAttribute* href = gumbo_get_attribute(&title_a->v.element.attributes, "href");
-                if (href && href->value) {
-                    url = href->value;
-                }
-                GumboNode* title_div = find_node_by_tag_and_class(title_a, GUMBO_TAG_DIV, "title");
-                if (title_div) {
-                    title = gumbo_get_text(title_div);
-                } else {
-                    title = gumbo_get_text(title_a);
-                }
-                title.erase(0, title.find_first_not_of(" \n\r\t"));
-                title.erase(title.find_last_not_of(" \n\r\t") + 1);
-            }
+void trim_text(std::string& text) {
+    text.erase(0, text.find_first_not_of(" \n\r\t"));
+    text.erase(text.find_last_not_of(" \n\r\t") + 1);
+}
 
-            GumboNode* snippet_div = find_node_by_tag_and_class(result_div, GUMBO_TAG_DIV, "snippet-description");
-            if (snippet_div) {
-                snippet = gumbo_get_text(snippet_div);
-                snippet.erase(0, snippet.find_first_not_of(" \n\r\t"));
-                snippet.erase(snippet.find_last_not_of(" \n\r\t") + 1);
-            } else {
-                GumboNode* snippet_content_div = find_node_by_tag_and_class(result_div, GUMBO_TAG_DIV, "snippet-content");
-                if (snippet_content_div) {
-                    snippet = gumbo_get_text(snippet_content_div);
-                    snippet.erase(0, snippet.find_first_not_of(" \n\r\t"));
-                    snippet.erase(snippet.find_last_not_of(" \n\r\t") + 1);
-                }
-            }
+// Trimmed text of the first element under root matching one of the
+// (tag, class part) alternatives, in order of preference
+std::string dom_field(GumboNode* root, std::initializer_list<std::pair<GumboTag, const char*>> alternatives) {
+    for (const auto& [tag, class_part] : alternatives) {
+        if (GumboNode* node = gumbo_find_tag_with_class(root, tag, class_part)) {
+            std::string text = gumbo_get_text(node);
+            trim_text(text);
+            return text;
+        }
+    }
+    return {};
+}
 
-            GumboNode* url_cite = find_node_by_tag_and_class(result_div, GUMBO_TAG_CITE, "snippet-url");
-            if (url_cite) {
-                display_url_text = gumbo_get_text(url_cite);
-                display_url_text.erase(0, display_url_text.find_first_not_of(" \n\r\t"));
-                display_url_text.erase(display_url_text.find_last_not_of(" \n\r\t") + 1);
-            } else {
-                GumboNode* url_div = find_node_by_tag_and_class(result_div, GUMBO_TAG_DIV, "url");
-                if (url_div) {
-                    display_url_text = gumbo_get_text(url_div);
-                    display_url_text.erase(0, display_url_text.find_first_not_of(" \n\r\t"));
-                    display_url_text.erase(display_url_text.find_last_not_of(" \n\r\t") + 1);
-                }
+// Result blocks of a parsed page: elements with block_tag whose class has
+// the block_class token and not the exclude_class one (not searched inside)
+void dom_result_blocks(GumboNode* node, const char* block_class, const char* exclude_class, std::vector<GumboNode*>& blocks) {
+    if (!node || node->type != GUMBO_NODE_ELEMENT) return;
+    if (node->v.element.tag == GUMBO_TAG_DIV) {
+        GumboAttribute* class_attr = gumbo_get_attribute(&node->v.element.attributes, "class");
+        if (class_attr && class_attr->value) {
+            std::string classes = " " + std::string(class_attr->value) + " ";
+            if (classes.find(" " + std::string(block_class) + " ") != std::string::npos &&
+                (!*exclude_class || classes.find(" " + std::string(exclude_class) + " ") == std::string::npos)) {
+                blocks.push_back(node);
+                return;
             }
+        }
+    }
+    GumboVector* children = &node->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        dom_result_blocks(static_cast<GumboNode*>(children->data[i]), block_class, exclude_class, blocks);
+    }
+}
 
-            if (!title.empty() && !url.empty()) {
-                result += std::to_string(++count) + ". " + title + "\n";
-                if (!snippet.empty()) {
-                    result += "   " + snippet + "\n";
-                }
-                std::string display_url = display_url_text.empty() ? url : display_url_text;
-                result += "   " + display_url + " [href=" + url + "]\n\n";
+std::vector<html::ScannedResult> brave_results_dom(const std::string& html) {
+    std::vector<html::ScannedResult> results;
+    GumboOutput* output = gumbo_parse(html.c_str());
+    if (!output) return results;
+    std::vector<GumboNode*> blocks;
+    dom_result_blocks(output->root, "snippet", "", blocks);
+    for (GumboNode* block : blocks) {
+        html::ScannedResult result;
+        GumboNode* title_a = gumbo_find_tag_with_class(block, GUMBO_TAG_A, "heading-serpresult");
+        if (title_a) {
+            GumboAttribute* href = gumbo_get_attribute(&title_a->v.element.attributes, "href");
+            if (href && href->value) {
+                result.url = href->value;
             }
+            GumboNode* title_div = gumbo_find_tag_with_class(title_a, GUMBO_TAG_DIV, "title");
+            result.title = gumbo_get_text(title_div ? title_div : title_a);
+            trim_text(result.title);
+        }
+        result.snippet = dom_field(block, {{GUMBO_TAG_DIV, "snippet-description"}, {GUMBO_TAG_DIV, "snippet-content"}});
+        result.display_url = dom_field(block, {{GUMBO_TAG_CITE, "snippet-url"}, {GUMBO_TAG_DIV, "url"}});
+        if (!result.title.empty() && !result.url.empty()) {
+            results.push_back(std::move(result));
         }
-        gumbo_destroy_output(&kGumboDefaultOptions, output);
     }
-
-    std::string final_result = count > 0 ? result : "No results found or failed to parse results page.";
-    return final_result;
+    gumbo_destroy_output(&kGumboDefaultOptions, output);
+    return results;
 }
 
-
-// --- Implementation of parse_ddg_html (adapted from user provided code) ---
-// Parses the html.duckduckgo.com/html/ structure
-// Note: This function uses a static CURL handle for URL decoding to improve performance.
-// The handle is intentionally never cleaned up as it exists for the lifetime of the application.
-std::string parse_ddg_html(const std::string& html) {
+std::vector<html::ScannedResult> ddg_results_dom(const std::string& html) {
+    std::vector<html::ScannedResult> results;
     GumboOutput* output = gumbo_parse(html.c_str());
-    std::string result = "Web results (from DuckDuckGo):\n\n"; // Indicate source
-    int count = 0;
-
-    std::vector<GumboNode*> result_divs;
-    std::function<void(GumboNode*)> find_result_divs =
-        [&](GumboNode* node) {
-        if (!node || node->type != GUMBO_NODE_ELEMENT) return;
-
-        // Check if the node is a DIV with class containing "result"
-        if (node->v.element.tag == GUMBO_TAG_DIV) {
-            GumboAttribute* class_attr = gumbo_get_attribute(&node->v.element.attributes, "class");
-            // Check if class exists and contains "result" as a word
-            if (class_attr && class_attr->value) {
-                 std::string classes = " " + std::string(class_attr->value) + " ";
-                 // DDG HTML uses "result" class for the main container
-                 if (classes.find(" result ") != std::string::npos && classes.find(" result--ad ") == std::string::npos) { // Exclude ads
-                     result_divs.push_back(node);
-                     // Don't recurse further into a result div
-                     return;
-                 }
+    if (!output) return results;
+    std::vector<GumboNode*> blocks;
+    // DDG HTML uses "result" class for the main container; ads are excluded
+    dom_result_blocks(output->root, "result", "result--ad", blocks);
+    for (GumboNode* block : blocks) {
+        html::ScannedResult result;
+        // Title and URL are usually within h2 > a.result__a
+        GumboNode* title_h2 = gumbo_find_tag(block, GUMBO_TAG_H2);
+        GumboNode* title_a = title_h2 ? gumbo_find_tag_with_class(title_h2, GUMBO_TAG_A, "result__a") : nullptr;
+        if (title_a) {
+            GumboAttribute* href = gumbo_get_attribute(&title_a->v.element.attributes, "href");
+            if (href && href->value) {
+                result.url = href->value;
             }
+            result.title = gumbo_get_text(title_a);
+            trim_text(result.title);
+        }
+        result.snippet = dom_field(block, {{GUMBO_TAG_A, "result__snippet"}});
+        result.display_url = dom_field(block, {{GUMBO_TAG_A, "result__url"}});
+        if (!result.title.empty() && !result.url.empty()) {
+            results.push_back(std::move(result));
         }
+    }
+    gumbo_destroy_output(&kGumboDefaultOptions, output);
+    return results;
+}
 
-        // Recurse into children if not a result div
-        GumboVector* children = &node->v.element.children;
-        for (unsigned int i = 0; i < children->length; ++i) {
-            find_result_divs(static_cast<GumboNode*>(children->data[i]));
+// DDG often uses redirection links; the target is the uddg parameter
+// Example: /l/?kh=-1&uddg=https%3A%2F%2Fwww.example.com
+// Note: This uses a static CURL handle for URL decoding, intentionally never
+// cleaned up as it exists for the lifetime of the application.
+void decode_ddg_redirects(std::vector<html::ScannedResult>& results) {
+    for (auto& result : results) {
+        size_t uddg_pos = result.url.find("uddg=");
+        if (uddg_pos == std::string::npos) continue;
+        std::string encoded_url = result.url.substr(uddg_pos + 5); // Length of "uddg="
+        static CURL* unescape_handle = curl_easy_init();
+        if (!unescape_handle) {
+            // Static handle initialization failed (should be rare)
+            std::cerr << "Warning: Failed to initialize static CURL handle for URL unescaping." << std::endl;
+            return;
         }
-    };
+        int outlength;
+        char* decoded = curl_easy_unescape(unescape_handle, encoded_url.c_str(), encoded_url.length(), &outlength);
+        if (decoded) {
+            result.url = std::string(decoded, outlength);
+            curl_free(decoded);
+        }
+    }
+}
 
-    if (output && output->root) {
-        find_result_divs(output->root);
-
-        for (GumboNode* result_div : result_divs) {
-            std::string title;
-            std::string url;
-            std::string snippet;
-            std::string display_url_text; // The visible URL text
-
-            // Find Title and URL (usually within h2 > a.result__a)
-            GumboNode* title_h2 = find_node_by_tag(result_div, GUMBO_TAG_H2);
-            GumboNode* title_a = title_h2 ? find_node_by_tag_and_class(title_h2, GUMBO_TAG_A, "result__a") : nullptr;
-
-            if (title_a) {
-                GumboAttribute* href = gumbo_get_attribute(&title_a->v.element.attributes, "href");
-                if (href && href->value) {
-                    url = href->value;
-                    // DDG often uses redirection links, try to decode them
-                    // Example: /l/?kh=-1&uddg=https%3A%2F%2Fwww.example.com
-                    size_t uddg_pos = url.find("uddg=");
-                    if (uddg_pos != std::string::npos) {
-                        std::string encoded_url = url.substr(uddg_pos + 5); // Length of "uddg="
-                        // Use a static handle for efficiency, initialized only once.
-                        // Note: This handle is intentionally not cleaned up; it persists for the application's lifetime.
-                        // For a CLI tool, this is generally acceptable.
-                        static CURL* unescape_handle = curl_easy_init();
-                        if (unescape_handle) {
-                            int outlength;
-                            char* decoded = curl_easy_unescape(unescape_handle, encoded_url.c_str(), encoded_url.length(), &outlength);
-                            if (decoded) {
-                                url = std::string(decoded, outlength);
-                                curl_free(decoded);
-                            }
-                            // Do not call curl_easy_cleanup here; the handle is static.
-                        } else {
-                            // Handle error: static handle initialization failed (should be rare)
-                            std::cerr << "Warning: Failed to initialize static CURL handle for URL unescaping." << std::endl;
-                        }
-                    }
-                }
-                title = gumbo_get_text(title_a);
-                title.erase(0, title.find_first_not_of(" \n\r\t"));
-                title.erase(title.find_last_not_of(" \n\r\t") + 1);
-            }
+std::string format_results(const std::vector<html::ScannedResult>& results, std::string result, const char* empty_message) {
+    if (results.empty()) {
+        return empty_message;
+    }
+    int count = 0;
+    for (const auto& item : results) {
+        result += std::to_string(++count) + ". " + item.title + "\n";
+        if (!item.snippet.empty()) {
+            result += "   " + item.snippet + "\n";
+        }
+        // Use the display URL text if available, otherwise fallback to the actual URL
+        const std::string& display_url = item.display_url.empty() ? item.url : item.display_url;
+        result += "   " + display_url + " [href=" + item.url + "]\n\n";
+    }
+    return result;
+}
 
-            // Find Snippet (usually within a.result__snippet)
-            GumboNode* snippet_a = find_node_by_tag_and_class(result_div, GUMBO_TAG_A, "result__snippet");
-            if (snippet_a) {
-                snippet = gumbo_get_text(snippet_a);
-                snippet.erase(0, snippet.find_first_not_of(" \n\r\t"));
-                snippet.erase(snippet.find_last_not_of(" \n\r\t") + 1);
-            }
+constexpr const char* kBraveNoResults = "No results found or failed to parse results page.";
+constexpr const char* kDdgNoResults = "No results found or failed to parse results page (DuckDuckGo)."; // Indicate source on failure too
 
-            // Find Display URL (usually within a.result__url)
-            GumboNode* url_a = find_node_by_tag_and_class(result_div, GUMBO_TAG_A, "result__url");
-            if (url_a) {
-                display_url_text = gumbo_get_text(url_a);
-                display_url_text.erase(0, display_url_text.find_first_not_of(" \n\r\t"));
-                display_url_text.erase(display_url_text.find_last_not_of(" \n\r\t") + 1);
-            }
+} // anonymous namespace
 
-            // Add result if we found the essentials (title and actual URL)
-            if (!title.empty() && !url.empty()) {
-                result += std::to_string(++count) + ". " + title + "\n";
-                if (!snippet.empty()) {
-                    result += "   " + snippet + "\n";
-                }
-                // Use the display URL text if available, otherwise fallback to the actual URL
-                std::string display_url = display_url_text.empty() ? url : display_url_text;
-                result += "   " + display_url + " [href=" + url + "]\n\n";
-            }
-        } // End loop through result divs
+std::string parse_brave_search_html(const std::string& html) {
+    std::vector<html::ScannedResult> results = html::scan_results(html, brave_markup());
+    if (results.empty()) {
+        results = brave_results_dom(html);
+    }
+    return format_results(results, "Web results:\n\n", kBraveNoResults);
+}
+
+std::string parse_brave_search_html_dom(const std::string& html) {
+    return format_results(brave_results_dom(html), "Web results:\n\n", kBraveNoResults);
+}
 
-        gumbo_destroy_output(&kGumboDefaultOptions, output);
+// Parses the html.duckduckgo.com/html/ structure
+std::string parse_ddg_html(const std::string& html) {
+    std::vector<html::ScannedResult> results = html::scan_results(html, ddg_markup());
+    if (results.empty()) {
+        results = ddg_results_dom(html);
     }
+    decode_ddg_redirects(results);
+    return format_results(results, "Web results (from DuckDuckGo):\n\n", kDdgNoResults);
+}
 
-    std::string final_result = count > 0 ? result : "No results found or failed to parse results page (DuckDuckGo)."; // Indicate source on failure too
-    return final_result;
+std::string parse_ddg_html_dom(const std::string& html) {
+    std::vector<html::ScannedResult> results = ddg_results_dom(html);
+    decode_ddg_redirects(results);
+    return format_results(results, "Web results (from DuckDuckGo):\n\n", kDdgNoResults);
 }
 
 
@@ -343,32 +281,29 @@ std::string get_brave_api_key() {
     return "";
 }
 
-// Function to call the Brave Search API
-std::string call_brave_search_api(const std::string& query, const std::string& api_key) {
+// Helper to set up a CURL handle for the Brave Search API
+static CURL* setup_brave_api_curl(const std::string& query, const std::string& api_key,
+                                  std::string& response_string, struct curl_slist** headers) {
     CURL* curl = curl_easy_init();
-    if (!curl) {
-        throw std::runtime_error("Failed to initialize CURL for Brave API search");
-    }
+    if (!curl) return nullptr;
 
-    std::string response_string;
     std::string url = "https://api.search.brave.com/res/v1/web/search";
     char *escaped_query = curl_easy_escape(curl, query.c_str(), query.length());
     if (!escaped_query) {
         curl_easy_cleanup(curl);
-        throw std::runtime_error("Failed to escape query for Brave API search");
+        return nullptr;
     }
     url += "?q=" + std::string(escaped_query);
     curl_free(escaped_query);
 
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Accept: application/json");
+    *headers = curl_slist_append(*headers, "Accept: application/json");
     // Note: Accept-Encoding is handled by CURLOPT_ACCEPT_ENCODING below
-    headers = curl_slist_append(headers, ("X-Subscription-Token: " + api_key).c_str());
+    *headers = curl_slist_append(*headers, ("X-Subscription-Token: " + api_key).c_str());
     // Add User-Agent (optional but good practice)
-    headers = curl_slist_append(headers, std::string("User-Agent: ").append(kUserAgent).c_str());
+    *headers = curl_slist_append(*headers, std::string("User-Agent: ").append(kUserAgent).c_str());
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_URL, route_url(url).c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, *headers);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L); // Follow redirects
@@ -377,6 +312,19 @@ std::string call_brave_search_api(const std::string& query, const std::string& a
     // Enable automatic decompression if gzip is used by the server
     curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "gzip");
 
+    return curl;
+}
+
+// Function to call the Brave Search API
+std::string call_brave_search_api(const std::string& query, const std::string& api_key) {
+    std::string response_string;
+    struct curl_slist* headers = nullptr;
+    CURL* curl = setup_brave_api_curl(query, api_key, response_string, &headers);
+    if (!curl) {
+        if (headers) curl_slist_free_all(headers);
+        throw std::runtime_error("Failed to initialize CURL for Brave API search");
+    }
+
     CURLcode res = curl_easy_perform(curl);
     long http_code = 0;
     if (res == CURLE_OK) {
@@ -449,129 +397,298 @@ std::string parse_brave_api_response(const std::string& json_response) {
 }
 
 
-// --- Implementation of search_web ---
-std::string search_web(const std::string& query) {
-    CURL* curl = nullptr; // Initialize later for HTML scraping
-    CURLcode res;
-    std::string response;
-    std::string parsed_result;
-    long http_code = 0;
-    std::string brave_html_error_reason = "Unknown"; // Store failure reason
-    std::string ddg_html_error_reason = "Unknown";   // Store failure reason
+// --- Search backends ---
 
-    // --- Attempt 1: Brave Search ---
-    struct curl_slist* brave_headers = nullptr;
-    curl = setup_search_curl("https://search.brave.com/search", query, response, &brave_headers);
-    if (!curl) {
-        // Cleanup headers if allocated by helper before failure
-        if (brave_headers) curl_slist_free_all(brave_headers);
-        throw std::runtime_error("Failed to setup CURL for Brave search");
+namespace {
+
+enum class SearchBackend { BraveHtml = 0, DuckDuckGoHtml = 1, BraveApi = 2 };
+constexpr size_t kSearchBackendCount = 3;
+
+constexpr const char* kSearchBackendNames[kSearchBackendCount] = {"Brave HTML", "DDG HTML", "Brave API"};
+
+// Prior latency guess for backends with no history; also encodes the
+// historical preference order (Brave HTML, then DDG, then the paid API)
+constexpr double kPriorLatencyMs[kSearchBackendCount] = {1500.0, 2000.0, 3000.0};
+
+// Weight of the newest sample in the latency moving average
+constexpr double kLatencyEwmaAlpha = 0.3;
+
+// Process-wide per-backend history used to order backends
+class SearchBackendHistory {
+public:
+    void record(size_t backend, bool success, double latency_ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        SearchBackendStats& s = stats_[backend];
+        ++s.attempts;
+        if (success) ++s.successes;
+        s.avg_latency_ms = s.attempts == 1 ? latency_ms
+            : kLatencyEwmaAlpha * latency_ms + (1.0 - kLatencyEwmaAlpha) * s.avg_latency_ms;
     }
 
-    res = curl_easy_perform(curl);
-    http_code = 0; // Reset http_code before checking
-    if (res == CURLE_OK) {
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-        if (http_code == 202) {
-            // WARNING: Brave Search: Received HTTP 202 Accepted.
+    // Backends ordered by expected time to a usable answer: average latency
+    // divided by a smoothed success rate (untried backends use the prior)
+    std::vector<size_t> order(const std::vector<size_t>& available) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<double, size_t>> scored;
+        for (size_t backend : available) {
+            const SearchBackendStats& s = stats_[backend];
+            double latency = s.attempts > 0 ? s.avg_latency_ms : kPriorLatencyMs[backend];
+            double success_rate = (s.successes + 1.0) / (s.attempts + 2.0);
+            scored.emplace_back(latency / success_rate, backend);
         }
+        std::stable_sort(scored.begin(), scored.end());
+        std::vector<size_t> ordered;
+        for (const auto& [score, backend] : scored) ordered.push_back(backend);
+        return ordered;
     }
 
-    // Cleanup Brave resources
-    curl_slist_free_all(brave_headers);
-    curl_easy_cleanup(curl);
-    curl = nullptr; // Reset curl handle for safety
-
-    if (res == CURLE_OK && http_code >= 200 && http_code < 300) {
-        parsed_result = parse_brave_search_html(response);
-        // Check if Brave search returned actual results (contains links)
-        if (parsed_result.find("[href=") != std::string::npos) {
-            // Brave Search successful.
-            return parsed_result; // Return Brave results
-        } else {
-            // Brave Search returned no results, falling back to DuckDuckGo...
-            brave_html_error_reason = "No results found or parse failed."; // Capture reason
-        }
-    } else {
-        // Brave Search failed, falling back to DuckDuckGo...
-        if (res != CURLE_OK) {
-            brave_html_error_reason = "CURL error: " + std::string(curl_easy_strerror(res));
-        } else {
-            brave_html_error_reason = "HTTP error: " + std::to_string(http_code);
+    std::vector<SearchBackendStats> snapshot() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<SearchBackendStats> result;
+        for (size_t i = 0; i < kSearchBackendCount; ++i) {
+            result.push_back(stats_[i]);
+            result.back().name = kSearchBackendNames[i];
         }
+        return result;
     }
 
-    // --- Attempt 2: DuckDuckGo HTML Search (Fallback) ---
-    response.clear(); // Clear previous response
-    struct curl_slist* ddg_headers = nullptr;
-    // Note: DDG URL needs extra params, so we pass the base URL with them
-    curl = setup_search_curl("https://html.duckduckgo.com/html/?kl=us-en", query, response, &ddg_headers);
-    if (!curl) {
-        // Cleanup headers if allocated by helper before failure
-        if (ddg_headers) curl_slist_free_all(ddg_headers);
-        // If Brave failed, this means both failed.
-        throw std::runtime_error("Failed to setup CURL for DDG search (after Brave failure)");
+private:
+    std::mutex mutex_;
+    SearchBackendStats stats_[kSearchBackendCount];
+};
+
+SearchBackendHistory& search_history() {
+    static SearchBackendHistory history;
+    return history;
+}
+
+// One in-flight search request
+struct SearchTransfer {
+    size_t backend = 0;
+    CURL* curl = nullptr;
+    struct curl_slist* headers = nullptr;
+    std::string response;
+    std::chrono::steady_clock::time_point started;
+};
+
+long env_long(const char* name, long fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) return fallback;
+    try {
+        return std::stol(value);
+    } catch (...) {
+        return fallback;
     }
+}
 
-    // std::cerr << "DEBUG: DDG Search: Requesting URL (GET): " << /* Need to reconstruct URL if debugging */ << std::endl; // Debug removed
+} // anonymous namespace
 
-    res = curl_easy_perform(curl);
-    http_code = 0; // Reset http_code before checking
-    if (res == CURLE_OK) {
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-        if (http_code == 202) {
-             // WARNING: DDG Search: Received HTTP 202 Accepted.
-        }
+SearchWebOptions SearchWebOptions::fromEnvironment() {
+    SearchWebOptions options;
+    if (const char* mode = std::getenv("LLM_CLI_SEARCH_MODE")) {
+        std::string value(mode);
+        if (value == "sequential") options.mode = Mode::Sequential;
+        else if (value == "parallel") options.mode = Mode::Parallel;
+        else if (value == "hedged") options.mode = Mode::Hedged;
     }
+    long delay = env_long("LLM_CLI_SEARCH_HEDGE_DELAY_MS", options.hedge_delay_ms);
+    if (delay >= 0) options.hedge_delay_ms = delay;
+    return options;
+}
 
-    // Cleanup DDG resources
-    curl_slist_free_all(ddg_headers);
-    curl_easy_cleanup(curl);
-    curl = nullptr; // Reset curl handle for safety
+std::vector<SearchBackendStats> search_backend_stats() {
+    return search_history().snapshot();
+}
 
-    if (res != CURLE_OK) {
-        // DDG Search also failed
-        // Capture DDG failure reason before checking API key
-        ddg_html_error_reason = "CURL error: " + std::string(curl_easy_strerror(res));
-        // Fall through to API attempt
-    } else if (http_code < 200 || http_code >= 300) {
-        // Capture HTTP error for DDG
-        ddg_html_error_reason = "HTTP error: " + std::to_string(http_code);
-        // Fall through to API attempt
-    } else {
-        // Parse DDG results if request was successful
-        parsed_result = parse_ddg_html(response);
-        // Check if DDG search returned actual results (contains links)
-        if (parsed_result.find("[href=") != std::string::npos) {
-            // DuckDuckGo Search successful.
-            return parsed_result; // Return DDG results
-        } else {
-            // DuckDuckGo Search returned no results, falling back to Brave API...
-            ddg_html_error_reason = "No results found or parse failed."; // Capture reason
+// --- Implementation of search_web ---
+std::string search_web(const std::string& query) {
+    return search_web(query, SearchWebOptions::fromEnvironment());
+}
+
+std::string search_web(const std::string& query, const SearchWebOptions& options) {
+    std::string cache_key = search_cache_key(query);
+    if (options.cache) {
+        try {
+            auto cached = options.cache->getCachedContent(cache_key);
+            if (cached && cached->isFresh(cache_now())) {
+                return cached->content;
+            }
+        } catch (const std::exception&) {
+            // Cache errors only cost a live search
         }
     }
 
-
-    // --- Attempt 3: Brave Search API (Final Fallback) ---
     std::string brave_api_key = get_brave_api_key();
-    if (brave_api_key.empty()) {
-        // Brave API key not found. Cannot use API fallback.
-        // Return the last result we got (which was the "no results" message from DDG parser)
-        return parsed_result;
+    std::vector<size_t> available = {static_cast<size_t>(SearchBackend::BraveHtml),
+                                     static_cast<size_t>(SearchBackend::DuckDuckGoHtml)};
+    if (!brave_api_key.empty()) {
+        available.push_back(static_cast<size_t>(SearchBackend::BraveApi));
     }
+    std::vector<size_t> order = search_history().order(available);
 
-    try {
-        // Attempting Brave Search API call...
-        std::string api_response_json = call_brave_search_api(query, brave_api_key);
-        parsed_result = parse_brave_api_response(api_response_json);
-        // Brave Search API call finished.
-        // The parser function handles "no results found" internally
+    std::string error_reasons[kSearchBackendCount] = {"Not attempted", "Not attempted", "Not attempted"};
+    std::string no_results_message; // Last parsed "no results" text, returned if nothing better arrives
+
+    CURLM* multi = curl_multi_init();
+    if (!multi) {
+        throw std::runtime_error("Failed to initialize CURL multi handle for search");
+    }
+
+    std::vector<std::unique_ptr<SearchTransfer>> active;
+    size_t next_backend = 0;
+    auto last_launch = std::chrono::steady_clock::now();
+
+    auto launch_next = [&]() {
+        while (next_backend < order.size()) {
+            auto transfer = std::make_unique<SearchTransfer>();
+            transfer->backend = order[next_backend++];
+            switch (static_cast<SearchBackend>(transfer->backend)) {
+                case SearchBackend::BraveHtml:
+                    transfer->curl = setup_search_curl("https://search.brave.com/search", query,
+                                                       transfer->response, &transfer->headers);
+                    break;
+                case SearchBackend::DuckDuckGoHtml:
+                    // Note: DDG URL needs extra params, so we pass the base URL with them
+                    transfer->curl = setup_search_curl("https://html.duckduckgo.com/html/?kl=us-en", query,
+                                                       transfer->response, &transfer->headers);
+                    break;
+                case SearchBackend::BraveApi:
+                    transfer->curl = setup_brave_api_curl(query, brave_api_key,
+                                                          transfer->response, &transfer->headers);
+                    break;
+            }
+            if (!transfer->curl) {
+                if (transfer->headers) curl_slist_free_all(transfer->headers);
+                error_reasons[transfer->backend] = "Failed to setup CURL";
+                continue; // Try the next backend right away
+            }
+            curl_easy_setopt(transfer->curl, CURLOPT_NOSIGNAL, 1L);
+            curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, transfer.get());
+            transfer->started = std::chrono::steady_clock::now();
+            last_launch = transfer->started;
+            curl_multi_add_handle(multi, transfer->curl);
+            active.push_back(std::move(transfer));
+            return;
+        }
+    };
+
+    auto release = [&](SearchTransfer* transfer) {
+        curl_multi_remove_handle(multi, transfer->curl);
+        curl_easy_cleanup(transfer->curl);
+        curl_slist_free_all(transfer->headers);
+    };
+
+    // Parse a finished transfer; returns the result text if it has usable results
+    auto finish = [&](SearchTransfer* transfer, CURLcode res) -> std::string {
+        double latency_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - transfer->started).count();
+        long http_code = 0;
+        if (res == CURLE_OK) {
+            curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &http_code);
+        }
+
+        std::string parsed_result;
+        if (res != CURLE_OK) {
+            error_reasons[transfer->backend] = "CURL error: " + std::string(curl_easy_strerror(res));
+        } else if (http_code < 200 || http_code >= 300) {
+            error_reasons[transfer->backend] = "HTTP error: " + std::to_string(http_code);
+        } else {
+            switch (static_cast<SearchBackend>(transfer->backend)) {
+                case SearchBackend::BraveHtml:      parsed_result = parse_brave_search_html(transfer->response); break;
+                case SearchBackend::DuckDuckGoHtml: parsed_result = parse_ddg_html(transfer->response); break;
+                case SearchBackend::BraveApi:       parsed_result = parse_brave_api_response(transfer->response); break;
+            }
+            // A result set is only usable if it contains links
+            if (parsed_result.find("[href=") == std::string::npos) {
+                error_reasons[transfer->backend] = "No results found or parse failed.";
+                no_results_message = parsed_result;
+                parsed_result.clear();
+            }
+        }
+        search_history().record(transfer->backend, !parsed_result.empty(), latency_ms);
         return parsed_result;
-    } catch (const std::exception& e) {
-        // Brave Search API failed.
-        // Return the detailed error message including reasons for each failure
-        return "All search methods failed. Brave HTML: " + brave_html_error_reason +
-               ", DDG HTML: " + ddg_html_error_reason +
-               ", Brave API: " + std::string(e.what());
+    };
+
+    // A stop request wakes the poll below so the loop ends right away
+    auto wake_multi = [multi]() { curl_multi_wakeup(multi); };
+    std::optional<std::stop_callback<decltype(wake_multi)>> wake;
+    wake.emplace(options.stop, wake_multi);
+
+    std::string winner;
+    launch_next();
+    while (!active.empty() && !options.stop.stop_requested()) {
+        int still_running = 0;
+        if (curl_multi_perform(multi, &still_running) != CURLM_OK) {
+            break;
+        }
+
+        int messages_left = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &messages_left)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            SearchTransfer* transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&transfer));
+            CURLcode res = msg->data.result;
+            std::string parsed_result = finish(transfer, res);
+            release(transfer);
+            active.erase(std::find_if(active.begin(), active.end(),
+                [transfer](const auto& t) { return t.get() == transfer; }));
+            if (!parsed_result.empty()) {
+                winner = std::move(parsed_result);
+                break;
+            }
+        }
+        if (!winner.empty()) {
+            break;
+        }
+
+        // Start the next backend when nothing is in flight (a failure arrived),
+        // or when the hedge delay has passed without an answer
+        auto now = std::chrono::steady_clock::now();
+        bool hedge_due = options.mode == SearchWebOptions::Mode::Parallel ||
+            (options.mode == SearchWebOptions::Mode::Hedged &&
+             now - last_launch >= std::chrono::milliseconds(options.hedge_delay_ms));
+        if (active.empty() || hedge_due) {
+            launch_next();
+        }
+
+        if (!active.empty()) {
+            curl_multi_poll(multi, nullptr, 0, 50, nullptr);
+        }
+    }
+
+    // Cancel the losing transfers (not counted in the backend history)
+    wake.reset();
+    for (auto& transfer : active) {
+        release(transfer.get());
+    }
+    active.clear();
+    curl_multi_cleanup(multi);
+    if (winner.empty() && options.stop.stop_requested()) {
+        throw OperationCancelled();
+    }
+
+    if (!winner.empty()) {
+        if (options.cache) {
+            CachedContent entry;
+            entry.key = cache_key;
+            entry.content = winner;
+            entry.fetched_at = cache_now();
+            entry.expires_at = entry.fetched_at + kSearchCacheTtlSeconds;
+            try {
+                options.cache->storeCachedContent(entry);
+            } catch (const std::exception&) {
+                // Cache write failures are not fatal
+            }
+        }
+        return winner;
+    }
+    if (!no_results_message.empty()) {
+        return no_results_message;
+    }
+    std::string failure = "All search methods failed.";
+    for (size_t backend : available) {
+        failure += std::string(backend == available.front() ? " " : ", ") +
+                   kSearchBackendNames[backend] + ": " + error_reasons[backend];
     }
+    return failure;
 }
@@ -1,14 +1,55 @@
 #pragma once
+#include <stop_token>
 #include <string>
+#include <vector>
 
-// Performs a web search using the preferred method (currently DDG HTML scraping).
+class PersistenceManager;
+
+// How search_web() spreads a query over its backends (Brave HTML, DuckDuckGo
+// HTML and, when a key is configured, the Brave Search API)
+struct SearchWebOptions {
+    enum class Mode {
+        Sequential, // Next backend starts only after the previous one failed
+        Hedged,     // Next backend also starts if no answer arrived within hedge_delay_ms
+        Parallel    // All backends start at once
+    };
+    Mode mode = Mode::Hedged;
+    long hedge_delay_ms = 1500;
+    PersistenceManager* cache = nullptr; // Content cache for result pages (optional)
+    std::stop_token stop;                // Abandons the search (OperationCancelled)
+
+    // Defaults overridden by LLM_CLI_SEARCH_MODE (sequential|hedged|parallel)
+    // and LLM_CLI_SEARCH_HEDGE_DELAY_MS
+    static SearchWebOptions fromEnvironment();
+};
+
+// Observed behaviour of one search backend since startup
+struct SearchBackendStats {
+    std::string name;
+    unsigned attempts = 0;
+    unsigned successes = 0;
+    double avg_latency_ms = 0.0; // Moving average over completed attempts
+};
+
+// Performs a web search. Backends are tried in order of their observed latency
+// and success rate; the first response with results wins and the remaining
+// transfers are cancelled. With a cache, results younger than
+// kSearchCacheTtlSeconds are returned without any request.
 std::string search_web(const std::string& query);
+std::string search_web(const std::string& query, const SearchWebOptions& options);
+
+// Per-backend history used to order search backends
+std::vector<SearchBackendStats> search_backend_stats();
 
-// --- HTML Parsing Helpers (Potentially legacy/alternative methods) ---
+// --- HTML Parsing Helpers ---
 // Parses search results from Brave Search HTML (if used).
 std::string parse_brave_search_html(const std::string& html);
 // Parses search results from DuckDuckGo Lite HTML (currently used by search_web).
 std::string parse_ddg_html(const std::string& html);
+// Both scan the markup in one pass and build a Gumbo DOM only when that finds
+// no result; the DOM-only versions give the same output (used by llm_bench)
+std::string parse_brave_search_html_dom(const std::string& html);
+std::string parse_ddg_html_dom(const std::string& html);
 
 // --- Brave Search API Helpers (Alternative method) ---
 // Retrieves the Brave Search API key from environment or config.
@@ -2,109 +2,410 @@
 #include <curl/curl.h>
 #include <gumbo.h>
 #include <string>
-#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
 // #include <iostream> // Not needed after removing debug/error prints
-#include "curl_utils.h" // Include the shared callback
+#include "thread_pool.h"
+#include "http_routing.h"
+#include "database.h"
+#include "tools_impl/content_cache.h"
+#include "tools_impl/html_utils.h"
+#include "interrupt.h"
+#include <optional>
+#include <string_view>
 
-// --- Gumbo helpers (static) ---
-static GumboNode* find_node_by_tag(GumboNode* node, GumboTag tag) {
-    if (!node || node->type != GUMBO_NODE_ELEMENT) {
-        return nullptr;
+// Host part of a URL, used as the key for per-host connection caps
+static std::string url_host(const std::string& url_str) {
+    std::string host;
+    CURLU* parsed = curl_url();
+    if (!parsed) return host;
+    char* part = nullptr;
+    if (curl_url_set(parsed, CURLUPART_URL, url_str.c_str(), 0) == CURLUE_OK &&
+        curl_url_get(parsed, CURLUPART_HOST, &part, 0) == CURLUE_OK) {
+        host = part;
+        curl_free(part);
     }
-    if (node->v.element.tag == tag) {
-        return node;
-    }
-    GumboVector* children = &node->v.element.children;
-    for (unsigned int i = 0; i < children->length; ++i) {
-        GumboNode* found = find_node_by_tag(static_cast<GumboNode*>(children->data[i]), tag);
-        if (found) {
-            return found;
-        }
-    }
-    return nullptr;
+    curl_url_cleanup(parsed);
+    return host;
 }
 
-static std::string gumbo_get_text(GumboNode* node) {
-    if (!node) return "";
-    if (node->type == GUMBO_NODE_TEXT) {
-        return node->v.text.text;
-    }
-    if (node->type != GUMBO_NODE_ELEMENT) {
-        return "";
-    }
-    if (node->v.element.tag == GUMBO_TAG_SCRIPT || node->v.element.tag == GUMBO_TAG_STYLE) {
-        return "";
+// Download state for one page: the body is capped at max_bytes and non-text
+// responses are rejected as soon as their headers arrive
+struct PageBuffer {
+    CURL* curl = nullptr;
+    size_t max_bytes = 0;
+    std::string body;
+    bool truncated = false;
+    bool checked_content_type = false;
+    std::string rejected_content_type;
+    std::string etag;          // Validators of the final response, for the content cache
+    std::string last_modified;
+};
+
+// Content types worth extracting text from (missing Content-Type is accepted)
+static bool is_text_content_type(const char* content_type) {
+    if (!content_type) return true;
+    std::string type(content_type);
+    for (char& c : type) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return type.rfind("text/", 0) == 0 ||
+           type.rfind("application/xhtml+xml", 0) == 0 ||
+           type.rfind("application/xml", 0) == 0;
+}
+
+static size_t page_write_callback(char* contents, size_t size, size_t nmemb, void* userdata) {
+    auto* page = static_cast<PageBuffer*>(userdata);
+    size_t total_size = size * nmemb;
+
+    if (!page->checked_content_type) {
+        page->checked_content_type = true;
+        char* content_type = nullptr;
+        curl_easy_getinfo(page->curl, CURLINFO_CONTENT_TYPE, &content_type);
+        if (!is_text_content_type(content_type)) {
+            page->rejected_content_type = content_type;
+            return 0; // Abort the transfer
+        }
+        if (page->max_bytes > 0) {
+            curl_off_t content_length = -1;
+            curl_easy_getinfo(page->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+            page->body.reserve(content_length > 0
+                ? std::min(static_cast<size_t>(content_length), page->max_bytes)
+                : std::min<size_t>(64 * 1024, page->max_bytes));
+        }
     }
-    std::string result;
-    GumboVector* children = &node->v.element.children;
-    for (unsigned int i = 0; i < children->length; ++i) {
-        GumboNode* child = static_cast<GumboNode*>(children->data[i]);
-        result += gumbo_get_text(child);
+
+    if (page->max_bytes > 0 && page->body.size() + total_size > page->max_bytes) {
+        page->body.append(contents, page->max_bytes - page->body.size());
+        page->truncated = true;
+        return 0; // Stop downloading - keep what fits under the cap
     }
-    return result;
+    page->body.append(contents, total_size);
+    return total_size;
 }
 
-// WriteCallback moved to curl_utils.h
+// Record ETag / Last-Modified; a new status line (redirect) starts a fresh set
+static size_t page_header_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    auto* page = static_cast<PageBuffer*>(userdata);
+    size_t total_size = size * nitems;
+    std::string_view line(buffer, total_size);
 
-// --- Implementation of visit_url ---
-std::string visit_url(const std::string& url_str) {
-    CURL* curl = curl_easy_init();
-    if (!curl) throw std::runtime_error("Failed to initialize CURL");
+    if (line.rfind("HTTP/", 0) == 0) {
+        page->etag.clear();
+        page->last_modified.clear();
+        return total_size;
+    }
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+        return total_size;
+    }
+    std::string name(line.substr(0, colon));
+    for (char& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    std::string_view value = line.substr(colon + 1);
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == '\r' || value.back() == '\n' || value.back() == ' ')) value.remove_suffix(1);
 
-    std::string html_content;
-    long http_code = 0;
+    if (name == "etag") {
+        page->etag.assign(value);
+    } else if (name == "last-modified") {
+        page->last_modified.assign(value);
+    }
+    return total_size;
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url_str.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &html_content);
+// Apply the per-transfer options used by visit_urls
+static void configure_fetch(CURL* curl, const std::string& url_str, PageBuffer* page, long timeout_ms, size_t max_bytes) {
+    page->curl = curl;
+    page->max_bytes = max_bytes;
+    curl_easy_setopt(curl, CURLOPT_URL, route_url(url_str).c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, page_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, page);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, page_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, page);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
     curl_easy_setopt(curl, CURLOPT_USERAGENT, "llm-cli-tool/1.0");
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 15L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-    curl_easy_cleanup(curl);
-
+// Error string for a failed transfer, or empty if the page was fetched
+static std::string fetch_error(CURLcode res, long http_code, const PageBuffer& page) {
+    if (!page.rejected_content_type.empty()) {
+        return "Error: Unsupported content type '" + page.rejected_content_type + "'";
+    }
+    if (res == CURLE_WRITE_ERROR && page.truncated) {
+        res = CURLE_OK; // Stopped on purpose at the size cap
+    }
     if (res != CURLE_OK) {
         return "Error fetching URL: " + std::string(curl_easy_strerror(res));
     }
-
     if (http_code >= 400) {
         return "Error: Received HTTP status code " + std::to_string(http_code);
     }
+    return "";
+}
 
-    GumboOutput* output = gumbo_parse(html_content.c_str());
+std::string extract_html_text(const std::string& html) {
+    GumboOutput* output = gumbo_parse_with_options(&kGumboDefaultOptions, html.data(), html.size());
     if (!output || !output->root) {
         if (output) gumbo_destroy_output(&kGumboDefaultOptions, output);
-        return "Error: Failed to parse HTML content.";
+        throw std::runtime_error("Failed to parse HTML content.");
     }
 
-    GumboNode* body = find_node_by_tag(output->root, GUMBO_TAG_BODY);
+    GumboNode* body = gumbo_find_tag(output->root, GUMBO_TAG_BODY);
     std::string extracted_text;
+    extracted_text.reserve(html.size()); // Text never exceeds the markup it came from
+    gumbo_append_text(body ? body : output->root, extracted_text);
+
+    gumbo_destroy_output(&kGumboDefaultOptions, output);
+    return extracted_text;
+}
 
-    if (body) {
-        extracted_text = gumbo_get_text(body);
-    } else {
-        extracted_text = gumbo_get_text(output->root);
+// Parse fetched HTML and return its visible text with whitespace collapsed
+static std::string extract_page_text(const PageBuffer& page) {
+    std::string extracted_text;
+    try {
+        extracted_text = extract_html_text(page.body);
+    } catch (const std::runtime_error& e) {
+        return "Error: " + std::string(e.what());
     }
 
-    std::stringstream ss_in(extracted_text);
-    std::string segment;
-    std::stringstream ss_out;
-    bool first = true;
-    while (ss_in >> segment) {
-        if (!first) ss_out << " ";
-        ss_out << segment;
-        first = false;
+    if (extracted_text.empty()) {
+        return "No text content found.";
     }
-    extracted_text = ss_out.str();
+    if (page.truncated) {
+        extracted_text += " [Page truncated at " + std::to_string(page.max_bytes) + " bytes]";
+    }
+    extracted_text.shrink_to_fit();
+    return extracted_text;
+}
 
-    gumbo_destroy_output(&kGumboDefaultOptions, output);
+// --- Implementation of visit_url ---
+std::string visit_url(const std::string& url_str, PersistenceManager* cache, std::stop_token stop) {
+    VisitUrlOptions options;
+    options.cache = cache;
+    options.stop = stop;
 
-    std::string result = extracted_text.empty() ? "No text content found." : extracted_text;
+    std::string content = visit_urls({url_str}, options).front().content;
+    if (stop.stop_requested()) {
+        throw OperationCancelled();
+    }
+    return content;
+}
 
+// --- Implementation of visit_urls ---
+std::vector<VisitUrlResult> visit_urls(const std::vector<std::string>& urls, const VisitUrlOptions& options) {
+    std::vector<VisitUrlResult> results(urls.size());
+    for (size_t i = 0; i < urls.size(); ++i) {
+        results[i].url = urls[i];
+        results[i].content = "Error: URL was not visited.";
+    }
+    if (urls.empty()) {
+        return results;
+    }
+
+    CURLM* multi = curl_multi_init();
+    if (!multi) throw std::runtime_error("Failed to initialize CURL multi handle");
+
+    struct Transfer {
+        CURL* curl = nullptr;
+        std::optional<KeyedSemaphore::Permit> host_permit; // Held while the transfer runs
+        struct curl_slist* headers = nullptr;  // Conditional request headers
+        PageBuffer page;
+        std::optional<CachedContent> cached;   // Stale cache entry being revalidated
+        bool cache_checked = false;
+    };
+    std::vector<Transfer> transfers(urls.size());
+    std::vector<size_t> fetched; // Indices of pages downloaded successfully, in completion order
+    size_t successes = 0;        // Pages available so far (downloaded or served from cache)
+    int64_t now = cache_now();
+
+    // Lookup failures only cost a fetch, so cache errors never fail the batch
+    auto cache_lookup = [&](const std::string& url) -> std::optional<CachedContent> {
+        if (!options.cache) return std::nullopt;
+        try {
+            return options.cache->getCachedContent(page_cache_key(url));
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    };
+
+    size_t max_parallel = options.max_parallel > 0 ? options.max_parallel : urls.size();
+    std::vector<size_t> queued(urls.size()); // Not started yet, in input order
+    for (size_t i = 0; i < urls.size(); ++i) queued[i] = i;
+    size_t active = 0;
+    KeyedSemaphore& host_limits = ThreadPool::shared().hostLimits();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.overall_deadline_ms);
+
+    // Start queued transfers up to the parallelism limit, skipping hosts that
+    // are at their limit for now; each transfer's own timeout only starts
+    // counting once it is actually added to the multi handle
+    auto start_transfers = [&]() {
+        for (auto it = queued.begin(); it != queued.end() && active < max_parallel;) {
+            size_t index = *it;
+
+            // Fresh cache hit: no HTTP fetch and no HTML parse (looked up once,
+            // even if the URL then waits for a host permit)
+            Transfer& transfer = transfers[index];
+            if (!transfer.cache_checked) {
+                transfer.cache_checked = true;
+                transfer.cached = cache_lookup(urls[index]);
+                if (transfer.cached && transfer.cached->isFresh(now)) {
+                    results[index].content = std::move(transfer.cached->content);
+                    results[index].ok = true;
+                    ++successes;
+                    it = queued.erase(it);
+                    continue;
+                }
+            }
+
+            std::optional<KeyedSemaphore::Permit> permit = host_limits.tryAcquire(url_host(urls[index]));
+            if (!permit) {
+                ++it;
+                continue;
+            }
+            it = queued.erase(it);
+
+            CURL* curl = curl_easy_init();
+            if (!curl) {
+                results[index].content = "Error fetching URL: Failed to initialize CURL";
+                continue;
+            }
+            transfer.host_permit.emplace(std::move(*permit));
+            configure_fetch(curl, urls[index], &transfer.page, options.per_url_timeout_ms, options.max_bytes);
+            curl_easy_setopt(curl, CURLOPT_PRIVATE, reinterpret_cast<char*>(index));
+            const std::optional<CachedContent>& cached = transfer.cached;
+            if (cached && (!cached->etag.empty() || !cached->last_modified.empty())) {
+                // Stale entry with validators - ask the server whether it changed
+                if (!cached->etag.empty()) {
+                    transfer.headers = curl_slist_append(transfer.headers, ("If-None-Match: " + cached->etag).c_str());
+                }
+                if (!cached->last_modified.empty()) {
+                    transfer.headers = curl_slist_append(transfer.headers,
+                                                         ("If-Modified-Since: " + cached->last_modified).c_str());
+                }
+                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer.headers);
+            } else {
+                transfer.cached.reset(); // Nothing to revalidate
+            }
+            transfer.curl = curl;
+            curl_multi_add_handle(multi, curl);
+            ++active;
+        }
+    };
+
+    auto finish_transfer = [&](CURL* curl, CURLcode res) {
+        char* private_data = nullptr;
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, &private_data);
+        size_t index = reinterpret_cast<size_t>(private_data);
+        long http_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+        Transfer& transfer = transfers[index];
+        std::string error = fetch_error(res, http_code, transfer.page);
+        if (error.empty() && http_code == 304 && transfer.cached) {
+            // Not modified - serve the cached text and extend its lifetime
+            results[index].content = std::move(transfer.cached->content);
+            results[index].ok = true;
+            ++successes;
+            try {
+                options.cache->refreshCachedContent(transfer.cached->key, cache_now() + kPageCacheTtlSeconds);
+            } catch (const std::exception&) {
+                // Cache write failures are not fatal
+            }
+        } else if (error.empty()) {
+            fetched.push_back(index);
+            ++successes;
+        } else {
+            results[index].content = std::move(error);
+            std::string().swap(transfers[index].page.body);
+        }
+        curl_multi_remove_handle(multi, curl);
+        curl_easy_cleanup(curl);
+        curl_slist_free_all(transfer.headers);
+        transfer.curl = nullptr;
+        transfer.headers = nullptr;
+        transfer.host_permit.reset();
+        --active;
+    };
+
+    // A stop request wakes the poll below so the loop ends right away
+    auto wake_multi = [multi]() { curl_multi_wakeup(multi); };
+    std::optional<std::stop_callback<decltype(wake_multi)>> wake;
+    wake.emplace(options.stop, wake_multi);
 
-    return result;
+    start_transfers();
+    while ((active > 0 || !queued.empty()) && !(options.first_k > 0 && successes >= options.first_k) &&
+           !options.stop.stop_requested()) {
+        int still_running = 0;
+        CURLMcode mc = curl_multi_perform(multi, &still_running);
+        if (mc != CURLM_OK) {
+            break;
+        }
+
+        int messages_left = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &messages_left)) {
+            if (msg->msg == CURLMSG_DONE) {
+                finish_transfer(msg->easy_handle, msg->data.result);
+            }
+        }
+
+        if (options.first_k > 0 && successes >= options.first_k) {
+            break; // Early return - enough pages downloaded
+        }
+        if (options.overall_deadline_ms > 0 && std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        if (options.stop.stop_requested()) {
+            break;
+        }
+
+        start_transfers();
+        // With nothing running this waits for other fetches to free host permits
+        curl_multi_poll(multi, nullptr, 0, active > 0 ? 100 : 20, nullptr);
+    }
+
+    // Cancel whatever is still in flight
+    wake.reset();
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        if (transfers[i].curl) {
+            curl_multi_remove_handle(multi, transfers[i].curl);
+            curl_easy_cleanup(transfers[i].curl);
+            curl_slist_free_all(transfers[i].headers);
+            transfers[i].curl = nullptr;
+            transfers[i].headers = nullptr;
+            transfers[i].host_permit.reset();
+            results[i].content = options.stop.stop_requested()
+                ? "Error: Cancelled by the user."
+                : "Error: Cancelled before completion (deadline or enough pages fetched).";
+        }
+    }
+    curl_multi_cleanup(multi);
+
+    // Extract text after the event loop so parsing never stalls in-flight transfers
+    for (size_t index : fetched) {
+        PageBuffer& page = transfers[index].page;
+        results[index].content = extract_page_text(page);
+        results[index].ok = results[index].content.rfind("Error:", 0) != 0;
+        std::string().swap(page.body);
+
+        if (options.cache && results[index].ok) {
+            CachedContent entry;
+            entry.key = page_cache_key(urls[index]);
+            entry.content = results[index].content;
+            entry.etag = page.etag;
+            entry.last_modified = page.last_modified;
+            entry.fetched_at = cache_now();
+            entry.expires_at = entry.fetched_at + kPageCacheTtlSeconds;
+            try {
+                options.cache->storeCachedContent(entry);
+            } catch (const std::exception&) {
+                // Cache write failures are not fatal
+            }
+        }
+    }
+    return results;
 }
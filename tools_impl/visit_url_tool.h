@@ -1,4 +1,44 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <cstddef>
+#include <stop_token>
 
-std::string visit_url(const std::string& url);
+class PersistenceManager;
+
+// Pages are cut off after this many bytes of HTML
+constexpr size_t kDefaultMaxPageBytes = 2 * 1024 * 1024;
+
+// Fetch one page and return its text. With a cache, fresh entries are served
+// without a request and stale ones are revalidated with ETag/Last-Modified.
+// Throws OperationCancelled if stop is requested before the page arrived.
+std::string visit_url(const std::string& url, PersistenceManager* cache = nullptr, std::stop_token stop = {});
+
+// Visible text of an HTML document (body only, script/style skipped, whitespace
+// collapsed); empty if there is none
+std::string extract_html_text(const std::string& html);
+
+// Options for fetching several pages concurrently with visit_urls()
+struct VisitUrlOptions {
+    long per_url_timeout_ms = 15000;     // Timeout for each individual transfer
+    long overall_deadline_ms = 0;        // Stop the whole batch after this long (0 = no deadline)
+    size_t first_k = 0;                  // Return once this many pages were fetched (0 = wait for all)
+    size_t max_parallel = 8;             // Transfers in flight at once (0 = all)
+    size_t max_bytes = kDefaultMaxPageBytes; // Download cap per page (0 = unlimited)
+    PersistenceManager* cache = nullptr;     // Content cache for page text (optional)
+    std::stop_token stop;                    // Abandons the transfers still in flight
+};
+
+struct VisitUrlResult {
+    std::string url;
+    bool ok = false;    // True when content holds extracted page text
+    std::string content; // Page text, or an error message when !ok
+};
+
+// Fetch several URLs on a single curl_multi event loop.
+// Each transfer holds a permit from ThreadPool::shared().hostLimits()
+// (LLM_CLI_MAX_CONNECTIONS_PER_HOST), shared with every other fetch in the
+// process; URLs whose host is at its limit wait in the loop for a permit.
+// Results are returned in the order of the input URLs.
+std::vector<VisitUrlResult> visit_urls(const std::vector<std::string>& urls,
+                                       const VisitUrlOptions& options = {});
@@ -1,20 +1,30 @@
 #include "tools_impl/web_research_tool.h"
 #include "tools_impl/search_web_tool.h"
 #include "tools_impl/visit_url_tool.h"
+#include "tools_impl/research_synthesis.h"
 #include "chat_client.h"
+#include "interrupt.h"
 #include "ui_interface.h" // Include UI interface
 #include <sstream>
 #include <vector>
-#include <future>
-#include <mutex>
 #include <nlohmann/json.hpp>
 #include <string> // For std::to_string
 
-std::string perform_web_research(PersistenceManager& db, ChatClient& client, UserInterface& ui, const std::string& topic) {
+// Page fetching limits for the synthesis step: slow hosts are dropped rather
+// than holding up the answer
+static constexpr long kPageTimeoutMs = 10000;
+static constexpr long kVisitDeadlineMs = 15000;
+static constexpr size_t kPagesForSynthesis = 5;
+
+std::string perform_web_research(PersistenceManager& db, ChatClient& client, UserInterface& ui, const std::string& topic,
+                                 bool stream_report) {
     try {
         ui.displayStatus("  [Research Step 1: Searching web...]"); // Use UI for status
         std::string search_query = topic;
-        std::string search_results_raw = search_web(search_query);
+        SearchWebOptions search_options = SearchWebOptions::fromEnvironment();
+        search_options.cache = &db;
+        search_options.stop = client.stopToken();
+        std::string search_results_raw = search_web(search_query, search_options);
 
         std::vector<std::string> urls;
         std::stringstream ss_search(search_results_raw);
@@ -38,49 +48,39 @@ std::string perform_web_research(PersistenceManager& db, ChatClient& client, Use
         }
         ui.displayStatus("  [Research Step 2: Found " + std::to_string(urls.size()) + " absolute URLs. Visiting all...]"); // Use UI for status
 
-        std::string visited_content_summary = "\n\nVisited Pages Content:\n";
-        std::mutex summary_mutex;
+        std::vector<ResearchSource> sources;
+        sources.push_back({"Web search results for '" + topic + "'", search_results_raw});
+        std::string visit_failures;
 
         if (urls.empty()) {
-            visited_content_summary += "No relevant URLs found in search results to visit.\n";
+            visit_failures += "No relevant URLs found in search results to visit.\n";
         } else {
-            std::vector<std::future<std::pair<std::string, std::string>>> futures;
-
-            for (const std::string& url : urls) {
-                futures.push_back(std::async(std::launch::async, [url]() {
-                    try {
-                        std::string content = visit_url(url);
-                        return std::make_pair(url, content);
-                    } catch (const std::exception& e) {
-                        return std::make_pair(url, "Error visiting URL: " + std::string(e.what()));
-                    }
-                }));
-            }
+            VisitUrlOptions visit_options;
+            visit_options.per_url_timeout_ms = kPageTimeoutMs;
+            visit_options.overall_deadline_ms = kVisitDeadlineMs;
+            visit_options.first_k = kPagesForSynthesis;
+            visit_options.cache = &db;
+            visit_options.stop = client.stopToken();
 
             ui.displayStatus("  [Research Step 3: Waiting for URL visits to complete...]"); // Use UI for status
-            for (size_t i = 0; i < futures.size(); ++i) {
-                try {
-                    std::pair<std::string, std::string> result = futures[i].get();
-                    const std::string& url = result.first;
-                    const std::string& content_or_error = result.second;
-
-                    std::lock_guard<std::mutex> lock(summary_mutex);
-                    if (content_or_error.rfind("Error visiting URL:", 0) == 0) {
-                        visited_content_summary += "\n--- Failed to visit " + url + ": " + content_or_error.substr(20) + " ---\n";
-                    } else {
-                        visited_content_summary += "\n--- Content from " + url + " ---\n";
-                        visited_content_summary += content_or_error;
-                        visited_content_summary += "\n--- End Content ---\n";
-                    }
-                } catch (const std::exception& e) {
-                    std::lock_guard<std::mutex> lock(summary_mutex);
-                    visited_content_summary += "\n--- Error retrieving result from future: " + std::string(e.what()) + " ---\n";
+            std::vector<VisitUrlResult> pages = visit_urls(urls, visit_options);
+            for (const VisitUrlResult& page : pages) {
+                if (page.ok) {
+                    sources.push_back({"Content from " + page.url, page.content});
+                } else {
+                    visit_failures += "--- Failed to visit " + page.url + ": " + page.content + " ---\n";
                 }
             }
         }
 
+        if (client.stopToken().stop_requested()) {
+            throw OperationCancelled();
+        }
+
+        // Pages that do not fit the model's context are condensed (map-reduce) first
+        std::string synthesis_context = condense_for_synthesis(client, ui, topic, sources) + visit_failures;
+
         ui.displayStatus("  [Research Step 4: Synthesizing results...]"); // Use UI for status
-        std::string synthesis_context = "Web search results for '" + topic + "':\n" + search_results_raw + visited_content_summary;
 
         std::vector<Message> synthesis_messages;
         synthesis_messages.push_back({"system", "You are a research assistant. Based *only* on the provided text which contains web search results and content from visited web pages, synthesize a comprehensive answer to the original research topic. Do not add any preamble like 'Based on the provided text...'."});
@@ -88,55 +88,26 @@ std::string perform_web_research(PersistenceManager& db, ChatClient& client, Use
 
         synthesis_messages[0].content = "You are a research assistant. Based *only* on the provided text which contains web search results and content from visited web pages, synthesize a comprehensive answer to the original research topic. DO NOT USE ANY TOOLS OR FUNCTIONS. Do not add any preamble like 'Based on the provided text...'";
 
-        std::string final_synthesized_content;
-        bool synthesis_success = false;
-
-        for (int attempt = 0; attempt < 3 && !synthesis_success; attempt++) {
-            if (attempt > 0) {
-                synthesis_messages[0].content = "CRITICAL INSTRUCTION: You are a research assistant. Your ONLY task is to write a plain text summary based on the provided research. DO NOT USE ANY TOOLS OR FUNCTIONS WHATSOEVER. DO NOT INCLUDE ANY <function> TAGS OR TOOL CALLS. Just write normal text.";
-            }
-
-            std::string synthesis_response_str = client.makeApiCall(synthesis_messages, false);
-            nlohmann::json synthesis_response_json;
-            try {
-                synthesis_response_json = nlohmann::json::parse(synthesis_response_str);
-            } catch (const nlohmann::json::parse_error& e) {
-                // JSON Parsing Error (Synthesis Response)
-                if (attempt == 2) return "Error: Failed to parse synthesis response from LLM.";
-                continue;
-            }
-
-            if (synthesis_response_json.contains("choices") &&
-                !synthesis_response_json["choices"].empty() &&
-                synthesis_response_json["choices"][0].contains("message")) {
-
-                auto message = synthesis_response_json["choices"][0]["message"];
-
-                if (message.contains("tool_calls") && !message["tool_calls"].is_null()) {
-                    // Warning: Synthesis response contains tool_calls. Retrying with stronger instructions.
-                    continue;
-                }
-
-                if (message.contains("content") && message["content"].is_string()) {
-                    final_synthesized_content = message["content"];
-                    synthesis_success = true;
-                    break;
-                }
-            }
-
-            if (attempt == 2) {
-                // Error: Invalid API response structure (Synthesis Response).
-                return "Error: Invalid response structure from LLM during synthesis.";
-            }
-        }
-
-        if (!synthesis_success) {
+        // Streamed so the answer shows up as it is written, not after the last token
+        SynthesisResult synthesis = run_synthesis(client, ui, std::move(synthesis_messages),
+            "CRITICAL INSTRUCTION: You are a research assistant. Your ONLY task is to write a plain text summary based on the provided research. DO NOT USE ANY TOOLS OR FUNCTIONS WHATSOEVER. DO NOT INCLUDE ANY <function> TAGS OR TOOL CALLS. Just write normal text.",
+            stream_report ? "Research: " + topic : std::string());
+        switch (synthesis.status) {
+        case SynthesisResult::Status::Ok:
+            break;
+        case SynthesisResult::Status::ParseError:
+            return "Error: Failed to parse synthesis response from LLM.";
+        case SynthesisResult::Status::InvalidResponse:
+            return "Error: Invalid response structure from LLM during synthesis.";
+        case SynthesisResult::Status::ToolCalls:
             return "I researched information about '" + topic + "' but encountered technical difficulties synthesizing the results. The search found relevant information, but I was unable to properly summarize it due to API limitations.";
         }
 
         ui.displayStatus("[Web research complete for: " + topic + "]"); // Use UI for status
-        return final_synthesized_content;
+        return synthesis.text;
 
+    } catch (const OperationCancelled&) {
+        throw;
     } catch (const std::exception& e) {
         ui.displayError("Web research failed during execution: " + std::string(e.what())); // Use UI for error
         return "Error performing web research: " + std::string(e.what());
@@ -4,4 +4,7 @@
 class ChatClient;
 class UserInterface; // Forward declaration
 
-std::string perform_web_research(PersistenceManager& db, ChatClient& client, UserInterface& ui, const std::string& topic);
+// stream_report shows the synthesized answer as it is written; callers running
+// several researches at once pass false and get only the returned text
+std::string perform_web_research(PersistenceManager& db, ChatClient& client, UserInterface& ui, const std::string& topic,
+                                 bool stream_report = true);
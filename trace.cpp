@@ -0,0 +1,142 @@
+#include "trace.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+
+namespace {
+
+const std::chrono::steady_clock::time_point process_start = std::chrono::steady_clock::now();
+
+uint32_t current_thread_number() {
+    static std::atomic<uint32_t> next_thread{1};
+    thread_local uint32_t number = next_thread.fetch_add(1, std::memory_order_relaxed);
+    return number;
+}
+
+// Nearest-rank percentile of a sorted, non-empty vector
+uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    size_t rank = static_cast<size_t>(p * static_cast<double>(sorted.size()) + 0.999999);
+    rank = std::clamp<size_t>(rank, 1, sorted.size());
+    return sorted[rank - 1];
+}
+
+double to_ms(uint64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+} // anonymous namespace
+
+Tracer& Tracer::global() {
+    static Tracer tracer;
+    return tracer;
+}
+
+uint64_t Tracer::nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - process_start).count());
+}
+
+const char* Tracer::intern(const std::string& name) {
+    static std::mutex mutex;
+    static std::unordered_set<std::string> names; // Node-based: c_str() stays valid
+    std::lock_guard<std::mutex> lock(mutex);
+    return names.insert(name).first->c_str();
+}
+
+void Tracer::record(const char* stage, uint64_t start_ns, uint64_t duration_ns, uint64_t value) {
+    uint64_t ticket = next_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[ticket % kCapacity];
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.stage.store(stage, std::memory_order_relaxed);
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(duration_ns, std::memory_order_relaxed);
+    slot.value.store(value, std::memory_order_relaxed);
+    slot.thread.store(current_thread_number(), std::memory_order_relaxed);
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+std::vector<Tracer::Span> Tracer::snapshot() const {
+    uint64_t end = next_.load(std::memory_order_acquire);
+    uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+
+    std::vector<Span> spans;
+    spans.reserve(static_cast<size_t>(end - begin));
+    for (uint64_t ticket = begin; ticket < end; ++ticket) {
+        const Slot& slot = slots_[ticket % kCapacity];
+        uint64_t expected = 2 * ticket + 2;
+        if (slot.sequence.load(std::memory_order_acquire) != expected) {
+            continue; // Still being written, or already overwritten
+        }
+        Span span;
+        span.stage = slot.stage.load(std::memory_order_relaxed);
+        span.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+        span.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+        span.value = slot.value.load(std::memory_order_relaxed);
+        span.thread = slot.thread.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != expected || !span.stage) {
+            continue; // Overwritten while copying
+        }
+        spans.push_back(span);
+    }
+    return spans;
+}
+
+std::vector<Tracer::StageStats> Tracer::stageStats() const {
+    struct Samples {
+        std::vector<uint64_t> durations;
+        std::vector<double> rates;
+    };
+    std::map<std::string, Samples> by_stage;
+    for (const Span& span : snapshot()) {
+        Samples& samples = by_stage[span.stage];
+        samples.durations.push_back(span.duration_ns);
+        if (span.value > 0 && span.duration_ns > 0) {
+            samples.rates.push_back(static_cast<double>(span.value) * 1e9 / static_cast<double>(span.duration_ns));
+        }
+    }
+
+    std::vector<StageStats> stats;
+    stats.reserve(by_stage.size());
+    for (auto& [stage, samples] : by_stage) {
+        std::sort(samples.durations.begin(), samples.durations.end());
+        StageStats entry;
+        entry.stage = stage;
+        entry.count = samples.durations.size();
+        entry.p50_ms = to_ms(percentile(samples.durations, 0.50));
+        entry.p95_ms = to_ms(percentile(samples.durations, 0.95));
+        entry.p99_ms = to_ms(percentile(samples.durations, 0.99));
+        entry.max_ms = to_ms(samples.durations.back());
+        if (!samples.rates.empty()) {
+            auto middle = samples.rates.begin() + static_cast<std::ptrdiff_t>((samples.rates.size() - 1) / 2);
+            std::nth_element(samples.rates.begin(), middle, samples.rates.end());
+            entry.p50_rate = *middle;
+        }
+        stats.push_back(std::move(entry));
+    }
+    return stats;
+}
+
+std::string Tracer::chromeTraceJson() const {
+    nlohmann::json events = nlohmann::json::array();
+    for (const Span& span : snapshot()) {
+        nlohmann::json event = {
+            {"name", span.stage},
+            {"cat", "llm-cli"},
+            {"ph", "X"},
+            {"ts", static_cast<double>(span.start_ns) / 1e3},
+            {"dur", static_cast<double>(span.duration_ns) / 1e3},
+            {"pid", 1},
+            {"tid", span.thread},
+        };
+        if (span.value > 0) {
+            event["args"] = {{"value", span.value}};
+        }
+        events.push_back(std::move(event));
+    }
+    return nlohmann::json{{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}}.dump();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Tracer - per-stage latency spans for /stats
+ *
+ * Spans (stage name, start, duration, optional value such as a token count)
+ * are written into a fixed-size lock-free ring buffer: recording is one
+ * fetch_add plus a few relaxed stores, so spans can be taken on every
+ * request, tool call and database operation. Readers copy the buffer with a
+ * per-slot sequence check and skip slots that are being overwritten; the
+ * oldest spans are overwritten once kCapacity spans have been recorded.
+ *
+ * Stage names must outlive the tracer - string literals, or intern() for
+ * names built at runtime (e.g. "tool.<name>").
+ *
+ * Stages recorded:
+ * - api.payload, api.connect, api.ttfb, api.stream, api.total (ApiClient)
+ * - tool.<name> (ToolManager::execute_tool)
+ * - db.<operation> (PersistenceManager)
+ * - tools.definitions (ToolManager, first request only)
+ * - startup.<phase> (main, ChatClient::startSession; see --profile-startup)
+ */
+class Tracer {
+public:
+    static constexpr size_t kCapacity = 4096;
+
+    struct Span {
+        const char* stage = nullptr;
+        uint64_t start_ns = 0;      // Since process start (steady clock)
+        uint64_t duration_ns = 0;
+        uint64_t value = 0;         // Stage-specific amount (api.stream: output tokens)
+        uint32_t thread = 0;        // Small per-thread number
+    };
+
+    struct StageStats {
+        std::string stage;
+        size_t count = 0;
+        double p50_ms = 0;
+        double p95_ms = 0;
+        double p99_ms = 0;
+        double max_ms = 0;
+        double p50_rate = 0;        // Median value per second (0 if the stage has no values)
+    };
+
+    static Tracer& global();
+
+    // Monotonic nanoseconds since process start
+    static uint64_t nowNs();
+
+    // Stable copy of a runtime-built stage name (deduplicated)
+    static const char* intern(const std::string& name);
+
+    void record(const char* stage, uint64_t start_ns, uint64_t duration_ns, uint64_t value = 0);
+
+    // Spans currently in the buffer, oldest first
+    std::vector<Span> snapshot() const;
+
+    // Percentiles per stage over the buffered spans, sorted by stage name
+    std::vector<StageStats> stageStats() const;
+
+    // Buffered spans in Chrome trace event format (chrome://tracing, Perfetto)
+    std::string chromeTraceJson() const;
+
+    // Spans recorded since startup (including overwritten ones)
+    uint64_t recordedCount() const { return next_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};  // 2*ticket+1 while writing, 2*ticket+2 when complete
+        std::atomic<const char*> stage{nullptr};
+        std::atomic<uint64_t> start_ns{0};
+        std::atomic<uint64_t> duration_ns{0};
+        std::atomic<uint64_t> value{0};
+        std::atomic<uint32_t> thread{0};
+    };
+
+    std::array<Slot, kCapacity> slots_;
+    std::atomic<uint64_t> next_{0};
+};
+
+/**
+ * TraceSpan - RAII span from construction to destruction
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* stage) : stage_(stage), start_ns_(Tracer::nowNs()) {}
+    ~TraceSpan() { Tracer::global().record(stage_, start_ns_, Tracer::nowNs() - start_ns_); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* stage_;
+    uint64_t start_ns_;
+};
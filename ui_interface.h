@@ -51,6 +51,41 @@ public:
     virtual void endStreamingOutput() = 0;
     // --- End Methods for Streaming Support ---
 
+    // --- Methods for Tool Progress ---
+    // A result a tool has ready before it finishes (e.g. the findings of one
+    // deep_research sub-query). May be called from several tool threads at once.
+    virtual void displayPartialResult(const std::string& title, const std::string& content) = 0;
+
+    // Output a tool streams while producing it (e.g. a research report as the
+    // model writes it); one tool stream at a time, all calls from one thread
+    virtual void startToolOutput(const std::string& title) = 0;
+    virtual void displayToolOutputChunk(const std::string& chunk) = 0;
+    virtual void endToolOutput() = 0;
+    // --- End Methods for Tool Progress ---
+
     // Virtual destructor to ensure proper cleanup of derived classes.
     virtual ~UserInterface() = default;
+};
+
+// Headless UserInterface that ends input at once and discards all output.
+// Non-interactive front ends (batch mode, benchmarks, load tests) derive from
+// it and override only the callbacks they care about.
+class NullUserInterface : public UserInterface {
+public:
+    std::optional<std::string> promptUserInput() override { return std::nullopt; }
+    void displayOutput(const std::string&, const std::string&) override {}
+    void displayError(const std::string&) override {}
+    void displayStatus(const std::string&) override {}
+    void initialize() override {}
+    void shutdown() override {}
+    bool isGuiMode() const override { return false; }
+    void setLoadingModelsState(bool) override {}
+    void updateModelsList(const std::vector<ModelData>&) override {}
+    void startStreamingOutput(const std::string&) override {}
+    void displayStreamingChunk(const std::string&) override {}
+    void endStreamingOutput() override {}
+    void displayPartialResult(const std::string&, const std::string&) override {}
+    void startToolOutput(const std::string&) override {}
+    void displayToolOutputChunk(const std::string&) override {}
+    void endToolOutput() override {}
 };
\ No newline at end of file